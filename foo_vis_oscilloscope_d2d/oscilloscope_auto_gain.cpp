@@ -0,0 +1,164 @@
+#include "stdafx.h"
+
+#include "oscilloscope_auto_gain.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    const t_uint32 g_blocks_per_second = 200;
+    const double g_attack_time = 0.02;
+    const double g_release_time = 0.5;
+    // Silence would ask for an infinite gain; this is +40 dB.
+    const double g_max_gain = 100.0;
+
+    audio_sample peak_dense(const audio_sample * samples, t_size size) {
+        audio_sample peak = 0;
+        t_size index = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+        if (audio_sample_size == 32 && size >= 4) {
+            const float * in = (const float *) samples;
+            __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            __m128 peak4 = _mm_setzero_ps();
+            for (; index + 4 <= size; index += 4) {
+                peak4 = _mm_max_ps(peak4, _mm_and_ps(_mm_loadu_ps(in + index), abs_mask));
+            }
+            peak4 = _mm_max_ps(peak4, _mm_movehl_ps(peak4, peak4));
+            peak4 = _mm_max_ss(peak4, _mm_shuffle_ps(peak4, peak4, _MM_SHUFFLE(1, 1, 1, 1)));
+            peak = (audio_sample) _mm_cvtss_f32(peak4);
+        }
+#endif
+        for (; index < size; ++index) {
+            peak = pfc::max_t<audio_sample>(peak, fabs(samples[index]));
+        }
+        return peak;
+    }
+}
+
+oscilloscope_auto_gain::oscilloscope_auto_gain()
+    : m_window_duration(1.0)
+    , m_sample_rate(0)
+    , m_block_length(1)
+    , m_window_block_count(1)
+    , m_have_position(false)
+    , m_next_sample(0)
+    , m_block_index(0)
+    , m_block_fill(0)
+    , m_block_peak(0)
+    , m_queue_head(0)
+    , m_queue_count(0)
+    , m_have_gain(false)
+    , m_gain(1.0)
+{
+}
+
+void oscilloscope_auto_gain::set_window_duration(double seconds) {
+    if (seconds != m_window_duration) {
+        m_window_duration = seconds;
+        m_sample_rate = 0;
+        m_have_position = false;
+    }
+}
+
+void oscilloscope_auto_gain::reset() {
+    m_sample_rate = 0;
+    m_have_position = false;
+    m_have_gain = false;
+    m_gain = 1.0;
+}
+
+void oscilloscope_auto_gain::update(const oscilloscope_sample_window_view & window, double window_time, const oscilloscope_channel_transform * transforms, t_uint32 trace_count) {
+    if (window.is_empty() || trace_count == 0) {
+        return;
+    }
+
+    if (window.m_sample_rate != m_sample_rate) {
+        m_sample_rate = window.m_sample_rate;
+        m_block_length = pfc::max_t<t_uint32>(m_sample_rate / g_blocks_per_second, 1);
+        m_window_block_count = pfc::max_t<t_uint32>((t_uint32) (m_window_duration * g_blocks_per_second + 0.5), 1);
+        m_queue.set_size(m_window_block_count);
+        m_have_position = false;
+    }
+
+    t_int64 window_start = (t_int64) floor(window_time * m_sample_rate + 0.5);
+    t_int64 window_end = window_start + window.m_sample_count;
+    if (!m_have_position || m_next_sample < window_start || m_next_sample > window_end) {
+        m_have_position = true;
+        m_next_sample = window_start;
+        m_block_index = 0;
+        m_block_fill = 0;
+        m_block_peak = 0;
+        m_queue_head = 0;
+        m_queue_count = 0;
+    }
+
+    double elapsed = (double) (window_end - m_next_sample) / (double) m_sample_rate;
+    add_samples(window, (t_uint32) (m_next_sample - window_start), transforms, trace_count);
+    m_next_sample = window_end;
+
+    audio_sample peak = m_block_peak;
+    if (m_queue_count > 0) {
+        peak = pfc::max_t<audio_sample>(peak, m_queue[m_queue_head].m_peak);
+    }
+    double target = pfc::min_t<double>(1.0 / (double) peak, g_max_gain);
+
+    if (!m_have_gain) {
+        m_have_gain = true;
+        m_gain = target;
+    } else {
+        // A rising peak must shrink the traces quickly before they leave the panel; the gain
+        // recovers slowly once the peak has left the window.
+        double time = (target < m_gain) ? g_attack_time : g_release_time;
+        m_gain += (target - m_gain) * (1.0 - exp(-elapsed / time));
+    }
+}
+
+void oscilloscope_auto_gain::add_samples(const oscilloscope_sample_window_view & window, t_uint32 begin, const oscilloscope_channel_transform * transforms, t_uint32 trace_count) {
+    // With every channel drawn the frames are dense, whatever their order.
+    bool dense = trace_count == window.m_channel_count;
+
+    t_uint32 sample_index = begin;
+    while (sample_index < window.m_sample_count) {
+        t_uint32 count = pfc::min_t<t_uint32>(window.m_sample_count - sample_index, m_block_length - m_block_fill);
+        const audio_sample * frames = window.get_frame(sample_index);
+        audio_sample peak = m_block_peak;
+        if (dense) {
+            peak = pfc::max_t<audio_sample>(peak, peak_dense(frames, (t_size) count * window.m_channel_count));
+        } else {
+            for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+                const audio_sample * samples = frames + transforms[trace_index].m_channel_index;
+                for (t_uint32 frame_index = 0; frame_index < count; ++frame_index) {
+                    peak = pfc::max_t<audio_sample>(peak, fabs(samples[(t_size) frame_index * window.m_channel_count]));
+                }
+            }
+        }
+        m_block_peak = peak;
+
+        sample_index += count;
+        m_block_fill += count;
+        if (m_block_fill == m_block_length) {
+            push_block();
+        }
+    }
+}
+
+void oscilloscope_auto_gain::push_block() {
+    t_uint32 capacity = m_window_block_count;
+
+    // Blocks that left the window go from the front.
+    while (m_queue_count > 0 && m_queue[m_queue_head].m_index <= m_block_index - capacity) {
+        m_queue_head = (m_queue_head + 1) % capacity;
+        --m_queue_count;
+    }
+    // Older blocks that are not louder than the new one can never be the maximum again.
+    while (m_queue_count > 0 && m_queue[(m_queue_head + m_queue_count - 1) % capacity].m_peak <= m_block_peak) {
+        --m_queue_count;
+    }
+
+    block & back = m_queue[(m_queue_head + m_queue_count) % capacity];
+    back.m_index = m_block_index;
+    back.m_peak = m_block_peak;
+    ++m_queue_count;
+
+    ++m_block_index;
+    m_block_fill = 0;
+    m_block_peak = 0;
+}
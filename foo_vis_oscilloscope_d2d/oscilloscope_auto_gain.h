@@ -0,0 +1,55 @@
+#pragma once
+
+#include "oscilloscope_geometry.h"
+
+// Follows the peak level of the drawn channels over a sliding window of stream time, and derives a
+// gain that scales that peak to full height. The samples are reduced to the peaks of short blocks,
+// and the maximum over the window is kept in a monotonic queue of blocks, so each sample is looked
+// at only once, when it first arrives. The gain follows the peak with an attack and a release time.
+class oscilloscope_auto_gain {
+public:
+    oscilloscope_auto_gain();
+
+    // Sets the length of the sliding window. The peak history is dropped if it changed.
+    void set_window_duration(double seconds);
+
+    void reset();
+
+    // Adds the samples of window, whose first sample is at window_time, that are newer than those
+    // added before, reading only the channels of the trace_count transforms. A window that does
+    // not continue or overlap the previous one, as after a seek, starts the peak history over.
+    void update(const oscilloscope_sample_window_view & window, double window_time, const oscilloscope_channel_transform * transforms, t_uint32 trace_count);
+
+    double get_gain() const {return m_gain;}
+
+private:
+    struct block {
+        t_int64 m_index;
+        audio_sample m_peak;
+    };
+
+    void add_samples(const oscilloscope_sample_window_view & window, t_uint32 begin, const oscilloscope_channel_transform * transforms, t_uint32 trace_count);
+    void push_block();
+
+    double m_window_duration;
+
+    t_uint32 m_sample_rate;
+    t_uint32 m_block_length;
+    t_uint32 m_window_block_count;
+
+    bool m_have_position;
+    t_int64 m_next_sample;
+
+    // Peak of the block being filled.
+    t_int64 m_block_index;
+    t_uint32 m_block_fill;
+    audio_sample m_block_peak;
+
+    // Completed blocks within the window with decreasing peaks, oldest first, in a ring.
+    pfc::array_t<block> m_queue;
+    t_uint32 m_queue_head;
+    t_uint32 m_queue_count;
+
+    bool m_have_gain;
+    double m_gain;
+};
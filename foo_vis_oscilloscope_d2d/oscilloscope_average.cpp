@@ -0,0 +1,152 @@
+#include "stdafx.h"
+
+#include "oscilloscope_average.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    // average += (samples - average) * weight
+    void blend(audio_sample * average, const audio_sample * samples, t_size size, audio_sample weight) {
+        t_size index = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+        if (audio_sample_size == 32) {
+            const float * in = (const float *) samples;
+            float * out = (float *) average;
+            __m128 w = _mm_set1_ps((float) weight);
+            for (; index + 4 <= size; index += 4) {
+                __m128 a = _mm_loadu_ps(out + index);
+                __m128 x = _mm_loadu_ps(in + index);
+                _mm_storeu_ps(out + index, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(x, a), w)));
+            }
+        }
+#endif
+        for (; index < size; ++index) {
+            average[index] += (samples[index] - average[index]) * weight;
+        }
+    }
+
+    // sum += samples - oldest; oldest = samples; average = sum * scale; fresh = (restart ? 0 : fresh) + samples
+    void slide(audio_sample * sum, audio_sample * oldest, audio_sample * average, audio_sample * fresh, const audio_sample * samples, t_size size, audio_sample scale, bool restart) {
+        t_size index = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+        if (audio_sample_size == 32) {
+            const float * in = (const float *) samples;
+            float * s = (float *) sum;
+            float * o = (float *) oldest;
+            float * f = (float *) fresh;
+            float * out = (float *) average;
+            __m128 k = _mm_set1_ps((float) scale);
+            __m128 keep = restart ? _mm_setzero_ps() : _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (; index + 4 <= size; index += 4) {
+                __m128 x = _mm_loadu_ps(in + index);
+                __m128 total = _mm_add_ps(_mm_loadu_ps(s + index), _mm_sub_ps(x, _mm_loadu_ps(o + index)));
+                _mm_storeu_ps(s + index, total);
+                _mm_storeu_ps(o + index, x);
+                _mm_storeu_ps(out + index, _mm_mul_ps(total, k));
+                _mm_storeu_ps(f + index, _mm_add_ps(_mm_and_ps(_mm_loadu_ps(f + index), keep), x));
+            }
+        }
+#endif
+        for (; index < size; ++index) {
+            audio_sample x = samples[index];
+            sum[index] += x - oldest[index];
+            oldest[index] = x;
+            average[index] = sum[index] * scale;
+            fresh[index] = (restart ? 0 : fresh[index]) + x;
+        }
+    }
+}
+
+oscilloscope_average::oscilloscope_average()
+    : m_mode(mode_exponential)
+    , m_count(1)
+    , m_channel_count(0)
+    , m_sample_count(0)
+    , m_sample_rate(0)
+    , m_window_count(0)
+    , m_history_position(0)
+{
+}
+
+void oscilloscope_average::set_parameters(t_uint32 mode, t_uint32 count) {
+    if (mode != m_mode || count != m_count) {
+        m_mode = mode;
+        m_count = count;
+        reset();
+    }
+}
+
+void oscilloscope_average::reset() {
+    m_channel_count = 0;
+    m_sample_count = 0;
+    m_sample_rate = 0;
+    m_window_count = 0;
+    m_history_position = 0;
+}
+
+oscilloscope_sample_window_view oscilloscope_average::add(const oscilloscope_sample_window_view & window) {
+    if (m_count <= 1 || window.is_empty()) {
+        return window;
+    }
+
+    if (window.m_channel_count != m_channel_count || window.m_sample_count != m_sample_count || window.m_sample_rate != m_sample_rate) {
+        m_channel_count = window.m_channel_count;
+        m_sample_count = window.m_sample_count;
+        m_sample_rate = window.m_sample_rate;
+        m_window_count = 0;
+        m_history_position = 0;
+    }
+
+    t_size size = window.get_data_size();
+    if (m_window_count == 0) {
+        // Arrays only grow, so that a window of a different length does not reallocate them.
+        if (m_average.get_size() < size) {
+            m_average.set_size(size);
+        }
+        if (m_mode == mode_boxcar) {
+            if (m_sum.get_size() < size) {
+                m_sum.set_size(size);
+                m_fresh_sum.set_size(size);
+            }
+            if (m_history.get_size() < size * m_count) {
+                m_history.set_size(size * m_count);
+            }
+            pfc::memset_t(m_sum.get_ptr(), (audio_sample) 0, size);
+            pfc::memset_t(m_history.get_ptr(), (audio_sample) 0, size * m_count);
+        }
+    }
+
+    if (m_mode == mode_boxcar) {
+        add_boxcar(window.m_samples, size);
+    } else {
+        add_exponential(window.m_samples, size);
+    }
+
+    return oscilloscope_sample_window_view(m_average.get_ptr(), m_channel_count, m_sample_count, m_sample_rate);
+}
+
+void oscilloscope_average::add_exponential(const audio_sample * samples, t_size size) {
+    if (m_window_count < m_count) {
+        ++m_window_count;
+    }
+    if (m_window_count == 1) {
+        pfc::memcpy_t(m_average.get_ptr(), samples, size);
+    } else {
+        blend(m_average.get_ptr(), samples, size, (audio_sample) 1 / (audio_sample) m_window_count);
+    }
+}
+
+void oscilloscope_average::add_boxcar(const audio_sample * samples, t_size size) {
+    // Until the ring is full, the slots leaving the sum are the zeros it was cleared with.
+    if (m_window_count < m_count) {
+        ++m_window_count;
+    }
+    audio_sample * oldest = m_history.get_ptr() + (t_size) m_history_position * size;
+    slide(m_sum.get_ptr(), oldest, m_average.get_ptr(), m_fresh_sum.get_ptr(), samples, size, (audio_sample) 1 / (audio_sample) m_window_count, m_history_position == 0);
+
+    // The windows added since the ring last wrapped around are now all the windows in the ring, so
+    // their sum replaces the running sum along with the rounding errors it has picked up.
+    if (++m_history_position == m_count) {
+        m_history_position = 0;
+        pfc::swap_t(m_sum, m_fresh_sum);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "oscilloscope_sample_window.h"
+
+// Averages consecutive triggered windows, like the "average N acquisitions" mode of a bench scope:
+// noise that is not locked to the trigger cancels out, while the periodic signal remains. The
+// interleaved samples of a window are averaged as they are, all channels in a single pass.
+class oscilloscope_average {
+public:
+    enum {
+        // Each window is blended into the average with a weight of 1 / N. Until N windows have
+        // been seen, the weight is 1 / (windows seen), so the average settles quickly.
+        mode_exponential = 0,
+        // The average of the last N windows.
+        mode_boxcar,
+        mode_count
+    };
+
+    oscilloscope_average();
+
+    // Sets the mode and N. The average starts over if either changed.
+    void set_parameters(t_uint32 mode, t_uint32 count);
+
+    void reset();
+
+    // Adds window to the average, and returns a view of the average. The view stays valid until
+    // the next call. The average starts over whenever the format or length of the window changes.
+    oscilloscope_sample_window_view add(const oscilloscope_sample_window_view & window);
+
+private:
+    void add_exponential(const audio_sample * samples, t_size size);
+    void add_boxcar(const audio_sample * samples, t_size size);
+
+    t_uint32 m_mode;
+    t_uint32 m_count;
+
+    t_uint32 m_channel_count;
+    t_uint32 m_sample_count;
+    t_uint32 m_sample_rate;
+    // Number of windows added since the average started, up to m_count.
+    t_uint32 m_window_count;
+
+    pfc::array_t<audio_sample> m_average;
+
+    // Boxcar mode keeps the last m_count windows in a ring, and their running sum. So that rounding
+    // errors do not build up, the windows are also summed from the start of each round of the ring,
+    // without subtractions, and that sum takes over when the ring wraps around.
+    pfc::array_t<audio_sample> m_history;
+    pfc::array_t<audio_sample> m_sum;
+    pfc::array_t<audio_sample> m_fresh_sum;
+    t_uint32 m_history_position;
+};
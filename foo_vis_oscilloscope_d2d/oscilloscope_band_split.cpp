@@ -0,0 +1,227 @@
+#include "stdafx.h"
+
+#include "oscilloscope_band_split.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    const double g_pi = 3.14159265358979323846;
+    // Crossovers between the low and the mid band and between the mid and the high band. Each is
+    // a pair of Butterworth sections, a 24 dB per octave Linkwitz-Riley crossover.
+    const double g_low_crossover = 250.0;
+    const double g_high_crossover = 2500.0;
+
+    struct biquad {
+        double m_b0, m_b1, m_b2, m_a1, m_a2;
+    };
+
+    const biquad g_pass = {1.0, 0.0, 0.0, 0.0, 0.0};
+
+    // Butterworth low pass or high pass section, after the Audio EQ Cookbook.
+    biquad get_butterworth(double frequency, t_uint32 sample_rate, bool high_pass) {
+        double w0 = 2.0 * g_pi * frequency / sample_rate;
+        double cos_w0 = cos(w0);
+        double alpha = sin(w0) / (2.0 * 0.70710678118654752);
+        double a0 = 1.0 + alpha;
+        biquad result;
+        if (high_pass) {
+            result.m_b0 = (1.0 + cos_w0) / 2.0 / a0;
+            result.m_b1 = -(1.0 + cos_w0) / a0;
+        } else {
+            result.m_b0 = (1.0 - cos_w0) / 2.0 / a0;
+            result.m_b1 = (1.0 - cos_w0) / a0;
+        }
+        result.m_b2 = result.m_b0;
+        result.m_a1 = -2.0 * cos_w0 / a0;
+        result.m_a2 = (1.0 - alpha) / a0;
+        return result;
+    }
+}
+
+oscilloscope_band_split::oscilloscope_band_split()
+    : m_sample_rate(0)
+    , m_channel_count(0)
+    , m_lane_count(0)
+    , m_have_position(false)
+    , m_output_start(0)
+    , m_next_sample(0)
+{
+}
+
+void oscilloscope_band_split::reset() {
+    m_sample_rate = 0;
+    m_channel_count = 0;
+    m_have_position = false;
+}
+
+void oscilloscope_band_split::prepare(t_uint32 sample_rate, t_uint32 channel_count) {
+    m_sample_rate = sample_rate;
+    m_channel_count = channel_count;
+    m_lane_count = (band_count * channel_count + 3) & ~3u;
+
+    // The upper crossover must stay well below Nyquist at low sample rates.
+    double high_crossover = pfc::min_t<double>(g_high_crossover, 0.4 * sample_rate);
+    biquad low_low_pass = get_butterworth(g_low_crossover, sample_rate, false);
+    biquad low_high_pass = get_butterworth(g_low_crossover, sample_rate, true);
+    biquad high_low_pass = get_butterworth(high_crossover, sample_rate, false);
+    biquad high_high_pass = get_butterworth(high_crossover, sample_rate, true);
+    const biquad bands[band_count][stage_count] = {
+        {low_low_pass, low_low_pass, g_pass, g_pass},
+        {low_high_pass, low_high_pass, high_low_pass, high_low_pass},
+        {high_high_pass, high_high_pass, g_pass, g_pass},
+    };
+
+    t_size size = (t_size) stage_count * m_lane_count;
+    m_b0.set_size(size);
+    m_b1.set_size(size);
+    m_b2.set_size(size);
+    m_a1.set_size(size);
+    m_a2.set_size(size);
+    m_s1.set_size(size);
+    m_s2.set_size(size);
+    for (t_uint32 stage = 0; stage < stage_count; ++stage) {
+        for (t_uint32 lane = 0; lane < m_lane_count; ++lane) {
+            // Padding lanes stay silent.
+            biquad coefficients = {0.0, 0.0, 0.0, 0.0, 0.0};
+            if (lane < band_count * channel_count) {
+                coefficients = bands[lane % band_count][stage];
+            }
+            t_size index = (t_size) stage * m_lane_count + lane;
+            m_b0.get_ptr()[index] = (float) coefficients.m_b0;
+            m_b1.get_ptr()[index] = (float) coefficients.m_b1;
+            m_b2.get_ptr()[index] = (float) coefficients.m_b2;
+            m_a1.get_ptr()[index] = (float) coefficients.m_a1;
+            m_a2.get_ptr()[index] = (float) coefficients.m_a2;
+            m_s1.get_ptr()[index] = 0.0f;
+            m_s2.get_ptr()[index] = 0.0f;
+        }
+    }
+}
+
+oscilloscope_sample_window_view oscilloscope_band_split::process(const oscilloscope_sample_window_view & window, double window_time) {
+    if (window.is_empty()) {
+        return window;
+    }
+
+    if (window.m_sample_rate != m_sample_rate || window.m_channel_count != m_channel_count) {
+        prepare(window.m_sample_rate, window.m_channel_count);
+        m_have_position = false;
+    }
+
+    t_int64 window_start = (t_int64) floor(window_time * m_sample_rate + 0.5);
+    t_int64 window_end = window_start + window.m_sample_count;
+    if (m_have_position && (m_next_sample < window_start || m_next_sample > window_end || window_start < m_output_start)) {
+        m_have_position = false;
+    }
+    if (!m_have_position) {
+        for (t_size index = 0; index < m_s1.get_size(); ++index) {
+            m_s1.get_ptr()[index] = m_s2.get_ptr()[index] = 0.0f;
+        }
+        m_have_position = true;
+        m_output_start = m_next_sample = window_start;
+    }
+
+    // Frames more than a window older than this one are dropped, so that a window that starts a
+    // little earlier than the last one, as when the timebase grows, still finds its bands.
+    t_int64 keep_start = pfc::max_t<t_int64>(m_output_start, window_start - window.m_sample_count);
+    t_size kept_count = (t_size) (m_next_sample - keep_start);
+    t_size new_count = (t_size) (window_end - m_next_sample);
+    if (keep_start > m_output_start && kept_count > 0) {
+        audio_sample * output = m_output.get_ptr();
+        memmove(output, output + (t_size) (keep_start - m_output_start) * m_lane_count, kept_count * m_lane_count * sizeof(audio_sample));
+    }
+    m_output_start = keep_start;
+    if (m_output.get_size() < (kept_count + new_count) * m_lane_count) {
+        m_output.set_size((kept_count + new_count) * m_lane_count);
+    }
+
+    if (new_count > 0) {
+        PFC_TRACE_SCOPE(filter);
+        oscilloscope_sample_window_view fresh = window.get_range((t_uint32) (m_next_sample - window_start), (t_uint32) new_count);
+        filter(fresh, m_output.get_ptr() + kept_count * m_lane_count);
+        m_next_sample = window_end;
+    }
+
+    const audio_sample * bands = m_output.get_ptr() + (t_size) (window_start - m_output_start) * m_lane_count;
+    return oscilloscope_sample_window_view(bands, m_lane_count, window.m_sample_count, m_sample_rate);
+}
+
+// Runs the frames of window through the stages of every lane. Each group of four lanes
+// keeps its coefficients and state in registers for the whole run of frames.
+void oscilloscope_band_split::filter(const oscilloscope_sample_window_view & window, audio_sample * out) {
+    t_uint32 count = window.m_sample_count;
+    t_uint32 channel_count = window.m_channel_count;
+    t_uint32 lane_count = m_lane_count;
+    const float * b0 = m_b0.get_ptr();
+    const float * b1 = m_b1.get_ptr();
+    const float * b2 = m_b2.get_ptr();
+    const float * a1 = m_a1.get_ptr();
+    const float * a2 = m_a2.get_ptr();
+    float * s1 = m_s1.get_ptr();
+    float * s2 = m_s2.get_ptr();
+
+    t_uint32 lane = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+    if (audio_sample_size == 32) {
+        for (; lane < lane_count; lane += 4) {
+            // Channel that each of the four lanes filters; padding lanes read the last channel.
+            t_uint32 lane_channels[4];
+            for (t_uint32 offset = 0; offset < 4; ++offset) {
+                lane_channels[offset] = pfc::min_t<t_uint32>((lane + offset) / band_count, channel_count - 1);
+            }
+
+            __m128 cb0[stage_count], cb1[stage_count], cb2[stage_count], ca1[stage_count], ca2[stage_count];
+            __m128 z1[stage_count], z2[stage_count];
+            for (t_uint32 stage = 0; stage < stage_count; ++stage) {
+                t_size index = (t_size) stage * lane_count + lane;
+                cb0[stage] = _mm_load_ps(b0 + index);
+                cb1[stage] = _mm_load_ps(b1 + index);
+                cb2[stage] = _mm_load_ps(b2 + index);
+                ca1[stage] = _mm_load_ps(a1 + index);
+                ca2[stage] = _mm_load_ps(a2 + index);
+                z1[stage] = _mm_load_ps(s1 + index);
+                z2[stage] = _mm_load_ps(s2 + index);
+            }
+
+            const float * in = (const float *) window.m_samples;
+            float * lane_out = (float *) out + lane;
+            for (t_uint32 index = 0; index < count; ++index, in += channel_count, lane_out += lane_count) {
+                __m128 x = _mm_setr_ps(in[lane_channels[0]], in[lane_channels[1]], in[lane_channels[2]], in[lane_channels[3]]);
+                for (t_uint32 stage = 0; stage < stage_count; ++stage) {
+                    __m128 y = _mm_add_ps(_mm_mul_ps(cb0[stage], x), z1[stage]);
+                    z1[stage] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(cb1[stage], x), _mm_mul_ps(ca1[stage], y)), z2[stage]);
+                    z2[stage] = _mm_sub_ps(_mm_mul_ps(cb2[stage], x), _mm_mul_ps(ca2[stage], y));
+                    x = y;
+                }
+                _mm_store_ps(lane_out, x);
+            }
+
+            for (t_uint32 stage = 0; stage < stage_count; ++stage) {
+                t_size index = (t_size) stage * lane_count + lane;
+                _mm_store_ps(s1 + index, z1[stage]);
+                _mm_store_ps(s2 + index, z2[stage]);
+            }
+        }
+    }
+#endif
+    for (; lane < lane_count; ++lane) {
+        t_uint32 channel = pfc::min_t<t_uint32>(lane / band_count, channel_count - 1);
+        for (t_uint32 index = 0; index < count; ++index) {
+            float x = (float) window.get_frame(index)[channel];
+            for (t_uint32 stage = 0; stage < stage_count; ++stage) {
+                t_size offset = (t_size) stage * lane_count + lane;
+                float y = b0[offset] * x + s1[offset];
+                s1[offset] = b1[offset] * x - a1[offset] * y + s2[offset];
+                s2[offset] = b2[offset] * x - a2[offset] * y;
+                x = y;
+            }
+            out[(t_size) index * lane_count + lane] = (audio_sample) x;
+        }
+    }
+
+    // Filters that rang out are cleared before they decay into denormals.
+    for (t_size index = 0; index < m_s1.get_size(); ++index) {
+        if (fabs(s1[index]) + fabs(s2[index]) < 1e-15f) {
+            s1[index] = s2[index] = 0.0f;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "oscilloscope_sample_window.h"
+
+// Splits every channel into a low, a mid and a high band at fixed crossover frequencies. Each band
+// is a cascade of biquads, and the band of each channel is one lane of the filter bank, so all
+// bands of all channels are filtered in a single pass over the frames, four lanes at a time. The
+// filter state carries over from one window to the next: only samples that were not seen before
+// are filtered, and the bands of the rest of the window are kept from the previous calls.
+class oscilloscope_band_split {
+public:
+    enum {
+        band_low = 0,
+        band_mid,
+        band_high,
+        band_count
+    };
+
+    oscilloscope_band_split();
+
+    void reset();
+
+    // Returns the bands of window, whose first sample is at window_time, as a window whose frames
+    // hold the bands of channel c in channels c * band_count + band. Frames may be padded with
+    // unused channels. The view stays valid until the next call. After a seek, or when the format
+    // changes, the filters start over from silence.
+    oscilloscope_sample_window_view process(const oscilloscope_sample_window_view & window, double window_time);
+
+private:
+    enum {
+        stage_count = 4
+    };
+
+    void prepare(t_uint32 sample_rate, t_uint32 channel_count);
+    void filter(const oscilloscope_sample_window_view & window, audio_sample * out);
+
+    t_uint32 m_sample_rate;
+    t_uint32 m_channel_count;
+    // Number of lanes, which is band_count * m_channel_count rounded up to a multiple of four.
+    t_uint32 m_lane_count;
+
+    // Coefficients of the transposed direct form II biquads, by stage and then by lane, and the
+    // two state variables of each stage of each lane. Stages that a band does not need pass their
+    // input through.
+    pfc::mem_block_aligned_t<float> m_b0;
+    pfc::mem_block_aligned_t<float> m_b1;
+    pfc::mem_block_aligned_t<float> m_b2;
+    pfc::mem_block_aligned_t<float> m_a1;
+    pfc::mem_block_aligned_t<float> m_a2;
+    pfc::mem_block_aligned_t<float> m_s1;
+    pfc::mem_block_aligned_t<float> m_s2;
+
+    // Bands of the frames from m_output_start up to m_next_sample, m_lane_count per frame.
+    bool m_have_position;
+    t_int64 m_output_start;
+    t_int64 m_next_sample;
+    pfc::mem_block_aligned_t<audio_sample> m_output;
+};
@@ -0,0 +1,318 @@
+#include "stdafx.h"
+
+#include "oscilloscope_channel_matrix.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    const float g_minus_3db = 0.70710678f;
+
+    // Role of each channel in the fold-down, for the layouts that foobar2000 assumes for a channel
+    // count (audio_chunk::g_guess_channel_config): 'L' and 'R' for the front left and right, 'l' and
+    // 'r' for the other channels of either side, 'C' for centre channels and '-' for the LFE.
+    // Unknown layouts, of more than eight channels, send every channel to both sides.
+    const char * get_fold_down_roles(t_uint32 channel_count) {
+        static const char * const roles[] = {
+            nullptr, nullptr, nullptr,
+            "LR-",      // front, LFE
+            "LRlr",     // front, back
+            "LR-lr",    // front, LFE, back
+            "LRC-lr",   // front, centre, LFE, back
+            "LR-lrlr",  // front, LFE, back, front of centre
+            "LRC-lrlr", // front, centre, LFE, back, front of centre
+        };
+        return channel_count < PFC_TABSIZE(roles) ? roles[channel_count] : nullptr;
+    }
+
+    // With both channel counts known at compile time the loops are unrolled and the weights are
+    // kept in registers.
+    template<t_uint32 t_input_count, t_uint32 t_output_count>
+    void mix_template(const audio_sample * samples, t_uint32 sample_count, const float * weights, audio_sample * out) {
+        float weight[t_output_count][t_input_count];
+        for (t_uint32 output = 0; output < t_output_count; ++output) {
+            for (t_uint32 input = 0; input < t_input_count; ++input) {
+                weight[output][input] = weights[output * t_input_count + input];
+            }
+        }
+
+        for (t_uint32 sample_index = 0; sample_index < sample_count; ++sample_index) {
+            const audio_sample * frame = samples + (t_size) sample_index * t_input_count;
+            audio_sample * out_frame = out + (t_size) sample_index * t_output_count;
+            for (t_uint32 output = 0; output < t_output_count; ++output) {
+                float sum = 0.0f;
+                for (t_uint32 input = 0; input < t_input_count; ++input) {
+                    sum += weight[output][input] * (float) frame[input];
+                }
+                out_frame[output] = (audio_sample) sum;
+            }
+        }
+    }
+
+#if OSCILLOSCOPE_HAVE_SSE2
+    // Each iteration loads four stereo frames into two vectors and splits them into a vector of
+    // left and a vector of right samples with shuffles, which makes four output samples.
+    void mix_stereo_to_mono(const float * samples, t_uint32 sample_count, const float * weights, float * out) {
+        __m128 left_weight = _mm_set1_ps(weights[0]);
+        __m128 right_weight = _mm_set1_ps(weights[1]);
+
+        t_uint32 sample_index = 0;
+        for (; sample_index + 4 <= sample_count; sample_index += 4) {
+            __m128 frames_01 = _mm_loadu_ps(samples + sample_index * 2);
+            __m128 frames_23 = _mm_loadu_ps(samples + sample_index * 2 + 4);
+            __m128 left = _mm_shuffle_ps(frames_01, frames_23, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 right = _mm_shuffle_ps(frames_01, frames_23, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(out + sample_index, _mm_add_ps(_mm_mul_ps(left, left_weight), _mm_mul_ps(right, right_weight)));
+        }
+
+        for (; sample_index < sample_count; ++sample_index) {
+            out[sample_index] = weights[0] * samples[sample_index * 2] + weights[1] * samples[sample_index * 2 + 1];
+        }
+    }
+
+    // Each iteration loads two stereo frames (L0 R0 L1 R1) and the same frames with the channels
+    // swapped (R0 L0 R1 L1), so that both outputs of both frames are two products and a sum.
+    void mix_stereo_to_stereo(const float * samples, t_uint32 sample_count, const float * weights, float * out) {
+        __m128 same_weight = _mm_setr_ps(weights[0], weights[3], weights[0], weights[3]);
+        __m128 swapped_weight = _mm_setr_ps(weights[1], weights[2], weights[1], weights[2]);
+
+        t_uint32 sample_index = 0;
+        for (; sample_index + 2 <= sample_count; sample_index += 2) {
+            __m128 frames = _mm_loadu_ps(samples + sample_index * 2);
+            __m128 swapped = _mm_shuffle_ps(frames, frames, _MM_SHUFFLE(2, 3, 0, 1));
+            _mm_storeu_ps(out + sample_index * 2, _mm_add_ps(_mm_mul_ps(frames, same_weight), _mm_mul_ps(swapped, swapped_weight)));
+        }
+
+        if (sample_index < sample_count) {
+            float left = samples[sample_index * 2];
+            float right = samples[sample_index * 2 + 1];
+            out[sample_index * 2] = weights[0] * left + weights[1] * right;
+            out[sample_index * 2 + 1] = weights[2] * left + weights[3] * right;
+        }
+    }
+#endif
+
+    void mix_generic(const audio_sample * samples, t_uint32 input_count, t_uint32 sample_count, const float * weights, t_uint32 output_count, audio_sample * out) {
+        for (t_uint32 sample_index = 0; sample_index < sample_count; ++sample_index) {
+            const audio_sample * frame = samples + (t_size) sample_index * input_count;
+            audio_sample * out_frame = out + (t_size) sample_index * output_count;
+            for (t_uint32 output = 0; output < output_count; ++output) {
+                const float * row = weights + output * input_count;
+                float sum = 0.0f;
+                for (t_uint32 input = 0; input < input_count; ++input) {
+                    sum += row[input] * (float) frame[input];
+                }
+                out_frame[output] = (audio_sample) sum;
+            }
+        }
+    }
+}
+
+oscilloscope_channel_matrix::oscilloscope_channel_matrix()
+    : m_mode(mode_none)
+    , m_input_count(0)
+    , m_output_count(0)
+    , m_custom_input_count(0)
+    , m_custom_output_count(0)
+{
+}
+
+void oscilloscope_channel_matrix::set_mode(t_uint32 mode) {
+    if (mode != m_mode) {
+        m_mode = mode;
+        m_input_count = 0;
+        m_output_count = 0;
+    }
+}
+
+void oscilloscope_channel_matrix::set_custom_weights(const float * weights, t_uint32 input_count, t_uint32 output_count) {
+    if (!g_is_valid_custom_weights(weights, input_count, output_count)) {
+        input_count = output_count = 0;
+    }
+    t_size size = (t_size) input_count * output_count;
+    if (input_count == m_custom_input_count && output_count == m_custom_output_count && (size == 0 || memcmp(weights, m_custom_weights.get_ptr(), size * sizeof(float)) == 0)) {
+        return;
+    }
+
+    m_custom_weights.set_data_fromptr(weights, size);
+    m_custom_input_count = input_count;
+    m_custom_output_count = output_count;
+    if (m_mode == mode_custom) {
+        m_input_count = 0;
+        m_output_count = 0;
+    }
+}
+
+bool oscilloscope_channel_matrix::g_is_valid_custom_weights(const float * weights, t_uint32 input_count, t_uint32 output_count) {
+    if (input_count == 0 || input_count > custom_max_channels || output_count == 0 || output_count > custom_max_channels) {
+        return false;
+    }
+    for (t_size index = 0; index < (t_size) input_count * output_count; ++index) {
+        // Written so that NaN fails as well.
+        if (!(weights[index] >= -(float) custom_max_weight && weights[index] <= (float) custom_max_weight)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool oscilloscope_channel_matrix::g_parse_custom_weights(const char * text, float * weights, t_uint32 & input_count, t_uint32 & output_count) {
+    input_count = output_count = 0;
+    t_uint32 row_length = 0;
+    for (const char * walk = text;;) {
+        while (*walk == ' ' || *walk == '\t') {
+            ++walk;
+        }
+
+        if (*walk == 0 || *walk == ';' || *walk == '\r' || *walk == '\n') {
+            // Blank lines, and a separator at the end, do not make rows.
+            if (row_length > 0) {
+                if (output_count == 0) {
+                    input_count = row_length;
+                } else if (row_length != input_count) {
+                    return false;
+                }
+                ++output_count;
+                row_length = 0;
+            }
+            if (*walk == 0) {
+                break;
+            }
+            ++walk;
+            continue;
+        }
+
+        const char * token = walk;
+        while (*walk != 0 && *walk != ' ' && *walk != '\t' && *walk != ';' && *walk != '\r' && *walk != '\n') {
+            ++walk;
+        }
+        t_size length = walk - token;
+        bool has_digit = false;
+        for (t_size index = 0; index < length; ++index) {
+            char c = token[index];
+            if (c >= '0' && c <= '9') {
+                has_digit = true;
+            } else if (c != '+' && c != '-' && c != '.' && c != 'e' && c != 'E') {
+                return false;
+            }
+        }
+        if (!has_digit || row_length == custom_max_channels || output_count == custom_max_channels) {
+            return false;
+        }
+        weights[output_count * custom_max_channels + row_length++] = (float) pfc::string_to_float(token, length);
+    }
+
+    // The rows were stored custom_max_channels apart; pack them.
+    for (t_uint32 output = 1; output < output_count; ++output) {
+        memmove(weights + output * input_count, weights + output * custom_max_channels, input_count * sizeof(float));
+    }
+    return g_is_valid_custom_weights(weights, input_count, output_count);
+}
+
+void oscilloscope_channel_matrix::build(t_uint32 input_count) {
+    m_input_count = input_count;
+    m_output_count = 0;
+
+    if (input_count == 2 && m_mode == mode_mid_side) {
+        static const float weights[] = {0.5f, 0.5f, 0.5f, -0.5f};
+        m_weights.set_data_fromptr(weights, 4);
+        m_output_count = 2;
+    } else if (input_count == 2 && m_mode == mode_difference) {
+        static const float weights[] = {1.0f, -1.0f};
+        m_weights.set_data_fromptr(weights, 2);
+        m_output_count = 1;
+    } else if (input_count > 2 && m_mode == mode_fold_down) {
+        m_weights.set_size(2 * input_count);
+        float * left = m_weights.get_ptr();
+        float * right = left + input_count;
+        const char * roles = get_fold_down_roles(input_count);
+        for (t_uint32 input = 0; input < input_count; ++input) {
+            left[input] = right[input] = 0.0f;
+            switch (roles != nullptr ? roles[input] : 'C') {
+            case 'L':
+                left[input] = 1.0f;
+                break;
+            case 'R':
+                right[input] = 1.0f;
+                break;
+            case 'l':
+                left[input] = g_minus_3db;
+                break;
+            case 'r':
+                right[input] = g_minus_3db;
+                break;
+            case '-':
+                break;
+            default:
+                left[input] = right[input] = g_minus_3db;
+                break;
+            }
+        }
+
+        float left_sum = 0.0f, right_sum = 0.0f;
+        for (t_uint32 input = 0; input < input_count; ++input) {
+            left_sum += left[input];
+            right_sum += right[input];
+        }
+        for (t_uint32 input = 0; input < input_count; ++input) {
+            left[input] = (left_sum > 0.0f) ? left[input] / left_sum : 0.0f;
+            right[input] = (right_sum > 0.0f) ? right[input] / right_sum : 0.0f;
+        }
+        m_output_count = 2;
+    } else if (input_count == m_custom_input_count && m_mode == mode_custom) {
+        m_weights = m_custom_weights;
+        m_output_count = m_custom_output_count;
+    }
+}
+
+oscilloscope_sample_window_view oscilloscope_channel_matrix::apply(const oscilloscope_sample_window_view & window) {
+    if (m_mode == mode_none || window.is_empty()) {
+        return window;
+    }
+
+    if (window.m_channel_count != m_input_count) {
+        build(window.m_channel_count);
+    }
+    if (m_output_count == 0) {
+        return window;
+    }
+
+    t_size size = (t_size) window.m_sample_count * m_output_count;
+    if (m_output.get_size() < size) {
+        m_output.set_size(size);
+    }
+
+    const audio_sample * samples = window.m_samples;
+    t_uint32 sample_count = window.m_sample_count;
+    const float * weights = m_weights.get_ptr();
+    audio_sample * out = m_output.get_ptr();
+    switch (m_input_count * 16 + m_output_count) {
+    case 2 * 16 + 1:
+#if OSCILLOSCOPE_HAVE_SSE2
+        if (audio_sample_size == 32) {
+            mix_stereo_to_mono((const float *) samples, sample_count, weights, (float *) out);
+            break;
+        }
+#endif
+        mix_template<2, 1>(samples, sample_count, weights, out);
+        break;
+    case 2 * 16 + 2:
+#if OSCILLOSCOPE_HAVE_SSE2
+        if (audio_sample_size == 32) {
+            mix_stereo_to_stereo((const float *) samples, sample_count, weights, (float *) out);
+            break;
+        }
+#endif
+        mix_template<2, 2>(samples, sample_count, weights, out);
+        break;
+    case 6 * 16 + 2:
+        mix_template<6, 2>(samples, sample_count, weights, out);
+        break;
+    case 8 * 16 + 2:
+        mix_template<8, 2>(samples, sample_count, weights, out);
+        break;
+    default:
+        mix_generic(samples, m_input_count, sample_count, weights, m_output_count, out);
+        break;
+    }
+
+    return oscilloscope_sample_window_view(out, m_output_count, sample_count, window.m_sample_rate);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "oscilloscope_sample_window.h"
+
+// Mixes the channels of a window into new channels, each a weighted sum of the input channels, in
+// a single pass over the interleaved frames. The matrix is rebuilt from the mode whenever the
+// channel count of the input changes. The stereo matrices have kernels of their own; any other
+// matrix is applied by a kernel specialized for its shape at compile time where there is one.
+class oscilloscope_channel_matrix {
+public:
+    enum {
+        // Windows are passed through as they are.
+        mode_none = 0,
+        // Stereo to mid (L + R) / 2 and side (L - R) / 2.
+        mode_mid_side,
+        // Stereo to the single channel L - R.
+        mode_difference,
+        // Any layout of more than two channels to stereo. Centre channels go to both sides at
+        // -3 dB, the LFE is left out, and each side is scaled so that its weights add up to one.
+        mode_fold_down,
+        // The weights set by set_custom_weights(), for windows with as many channels as they have inputs.
+        mode_custom,
+        mode_count
+    };
+
+    enum {
+        custom_max_channels = 8,
+        // Larger weights are rejected, since a matrix that needs them is most likely a typo.
+        custom_max_weight = 16
+    };
+
+    oscilloscope_channel_matrix();
+
+    // Sets the mode. Windows that the mode does not apply to, such as mono windows in mid/side
+    // mode, are passed through.
+    void set_mode(t_uint32 mode);
+
+    // Sets the weights of mode_custom: output_count rows of input_count weights, each row making one
+    // output channel. Weights that g_is_valid_custom_weights() rejects leave the matrix empty.
+    void set_custom_weights(const float * weights, t_uint32 input_count, t_uint32 output_count);
+
+    // Returns window mixed by the matrix, or window itself. The view stays valid until the next call.
+    oscilloscope_sample_window_view apply(const oscilloscope_sample_window_view & window);
+
+    static bool g_is_valid_custom_weights(const float * weights, t_uint32 input_count, t_uint32 output_count);
+
+    // Parses a matrix written as rows separated by ';' or line breaks, with the weights of a row
+    // separated by blanks, such as "0.5 0.5; 0.5 -0.5". weights must have room for
+    // custom_max_channels * custom_max_channels weights. Returns false if the text is not a valid
+    // matrix, or has more channels than custom_max_channels.
+    static bool g_parse_custom_weights(const char * text, float * weights, t_uint32 & input_count, t_uint32 & output_count);
+
+private:
+    void build(t_uint32 input_count);
+
+    t_uint32 m_mode;
+    t_uint32 m_input_count;
+    // 0 if the matrix does not apply to windows of m_input_count channels.
+    t_uint32 m_output_count;
+    // Weight of input channel i in output channel o at o * m_input_count + i.
+    pfc::array_t<float> m_weights;
+    t_uint32 m_custom_input_count;
+    t_uint32 m_custom_output_count;
+    pfc::array_t<float> m_custom_weights;
+    pfc::array_t<audio_sample> m_output;
+};
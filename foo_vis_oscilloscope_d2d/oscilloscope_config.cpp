@@ -1,9 +1,10 @@
 #include "stdafx.h"
 
 #include "oscilloscope_config.h"
+#include "oscilloscope_channel_matrix.h"
 
 t_uint32 oscilloscope_config::g_get_version() {
-    return 6;
+    return 23;
 }
 
 oscilloscope_config::oscilloscope_config() {
@@ -14,12 +15,42 @@ void oscilloscope_config::reset() {
     m_hw_rendering_enabled = true;
     m_downmix_enabled = false;
     m_trigger_enabled = true;
+    m_trigger_predictive_enabled = true;
+    m_trigger_mode = trigger_mode_zero_crossing;
+    m_trigger_level_percent = 0;
+    m_trigger_slope = trigger_slope_rising;
+    m_trigger_hysteresis_percent = 0;
+    m_trigger_holdoff_millis = 0;
+    m_trigger_source = trigger_source_any;
+    m_channel_layout = channel_layout_stacked;
+    m_channel_mask = 0xffffffff;
+    m_channel_order = default_channel_order;
     m_resample_enabled = false;
     m_low_quality_enabled = false;
     m_window_duration_millis = 17;
     m_zoom_percent = 98;
     m_refresh_rate_limit_hz = 60;
     m_line_stroke_width = 17;
+    m_export_frame_rate_hz = 60;
+    m_export_resolution = export_resolution_1080p;
+    m_export_format = export_format_png;
+    m_overview_enabled = false;
+    m_roll_enabled = false;
+    m_roll_duration_seconds = 5;
+    m_average_mode = average_mode_exponential;
+    m_average_count = 1;
+    m_auto_gain_enabled = false;
+    m_auto_gain_window_millis = 1000;
+    m_spectrum_enabled = false;
+    m_tuner_enabled = false;
+    m_timebase_periods = 0;
+    m_band_split_enabled = false;
+    m_channel_matrix = channel_matrix_none;
+    m_custom_matrix_input_count = 0;
+    m_custom_matrix_output_count = 0;
+    pfc::fill_array_t(m_custom_matrix_weights, 0.0f);
+    m_color_mode = color_mode_solid;
+    m_glow_enabled = false;
 }
 
 void oscilloscope_config::parse(ui_element_config_parser & parser) {
@@ -29,6 +60,121 @@ void oscilloscope_config::parse(ui_element_config_parser & parser) {
         t_uint32 version;
         parser >> version;
         switch (version) {
+        case 23:
+            PFC_STATIC_ASSERT((t_uint32) custom_matrix_max_channels == (t_uint32) oscilloscope_channel_matrix::custom_max_channels);
+            parser >> m_custom_matrix_input_count;
+            parser >> m_custom_matrix_output_count;
+            if (m_custom_matrix_input_count > custom_matrix_max_channels || m_custom_matrix_output_count > custom_matrix_max_channels) {
+                // The number of weights that follow is unknown, so nothing after them can be read either.
+                m_custom_matrix_input_count = 0;
+                m_custom_matrix_output_count = 0;
+                throw exception_io_data("invalid custom channel matrix size");
+            }
+            for (t_uint32 index = 0; index < m_custom_matrix_input_count * m_custom_matrix_output_count; ++index) {
+                parser >> m_custom_matrix_weights[index];
+            }
+            if (!oscilloscope_channel_matrix::g_is_valid_custom_weights(m_custom_matrix_weights, m_custom_matrix_input_count, m_custom_matrix_output_count)) {
+                m_custom_matrix_input_count = 0;
+                m_custom_matrix_output_count = 0;
+            }
+            // fall through
+        case 22:
+            parser >> m_glow_enabled;
+            // fall through
+        case 21:
+            parser >> m_color_mode;
+            if (m_color_mode >= color_mode_count) {
+                m_color_mode = color_mode_solid;
+            }
+            // fall through
+        case 20:
+            parser >> m_channel_matrix;
+            if (m_channel_matrix >= channel_matrix_count || (m_channel_matrix == channel_matrix_custom && m_custom_matrix_input_count == 0)) {
+                m_channel_matrix = channel_matrix_none;
+            }
+            // fall through
+        case 19:
+            parser >> m_band_split_enabled;
+            // fall through
+        case 18:
+            parser >> m_timebase_periods;
+            m_timebase_periods = pfc::clip_t<t_uint32>(m_timebase_periods, 0, 8);
+            // fall through
+        case 17:
+            parser >> m_tuner_enabled;
+            // fall through
+        case 16:
+            parser >> m_spectrum_enabled;
+            // fall through
+        case 15:
+            parser >> m_auto_gain_enabled;
+            parser >> m_auto_gain_window_millis;
+            m_auto_gain_window_millis = pfc::clip_t<t_uint32>(m_auto_gain_window_millis, 100, 10000);
+            // fall through
+        case 14:
+            parser >> m_average_mode;
+            if (m_average_mode >= average_mode_count) {
+                m_average_mode = average_mode_exponential;
+            }
+            parser >> m_average_count;
+            m_average_count = pfc::clip_t<t_uint32>(m_average_count, 1, 64);
+            // fall through
+        case 13:
+            parser >> m_roll_enabled;
+            parser >> m_roll_duration_seconds;
+            m_roll_duration_seconds = pfc::clip_t<t_uint32>(m_roll_duration_seconds, 1, 60);
+            // fall through
+        case 12:
+            parser >> m_overview_enabled;
+            // fall through
+        case 11:
+            parser >> m_export_frame_rate_hz;
+            m_export_frame_rate_hz = pfc::clip_t<t_uint32>(m_export_frame_rate_hz, 1, 240);
+            parser >> m_export_resolution;
+            if (m_export_resolution >= export_resolution_count) {
+                m_export_resolution = export_resolution_1080p;
+            }
+            parser >> m_export_format;
+            if (m_export_format >= export_format_count) {
+                m_export_format = export_format_png;
+            }
+            // fall through
+        case 10:
+            parser >> m_channel_layout;
+            if (m_channel_layout >= channel_layout_count) {
+                m_channel_layout = channel_layout_stacked;
+            }
+            parser >> m_channel_mask;
+            parser >> m_channel_order;
+            if (!g_is_valid_channel_order(m_channel_order)) {
+                m_channel_order = default_channel_order;
+            }
+            // fall through
+        case 9:
+            parser >> m_trigger_level_percent;
+            m_trigger_level_percent = pfc::clip_t<t_int32>(m_trigger_level_percent, -100, 100);
+            parser >> m_trigger_slope;
+            if (m_trigger_slope >= trigger_slope_count) {
+                m_trigger_slope = trigger_slope_rising;
+            }
+            parser >> m_trigger_hysteresis_percent;
+            m_trigger_hysteresis_percent = pfc::clip_t<t_uint32>(m_trigger_hysteresis_percent, 0, 100);
+            parser >> m_trigger_holdoff_millis;
+            m_trigger_holdoff_millis = pfc::clip_t<t_uint32>(m_trigger_holdoff_millis, 0, 1000);
+            parser >> m_trigger_source;
+            if (m_trigger_source > trigger_source_channel_8) {
+                m_trigger_source = trigger_source_any;
+            }
+            // fall through
+        case 8:
+            parser >> m_trigger_mode;
+            if (m_trigger_mode >= trigger_mode_count) {
+                m_trigger_mode = trigger_mode_zero_crossing;
+            }
+            // fall through
+        case 7:
+            parser >> m_trigger_predictive_enabled;
+            // fall through
         case 6:
             parser >> m_line_stroke_width;
             m_line_stroke_width = pfc::clip_t<t_uint32>(m_line_stroke_width, 1, 30);
@@ -64,6 +210,38 @@ void oscilloscope_config::parse(ui_element_config_parser & parser) {
 
 void oscilloscope_config::build(ui_element_config_builder & builder) {
     builder << g_get_version();
+    builder << m_custom_matrix_input_count;
+    builder << m_custom_matrix_output_count;
+    for (t_uint32 index = 0; index < m_custom_matrix_input_count * m_custom_matrix_output_count; ++index) {
+        builder << m_custom_matrix_weights[index];
+    }
+    builder << m_glow_enabled;
+    builder << m_color_mode;
+    builder << m_channel_matrix;
+    builder << m_band_split_enabled;
+    builder << m_timebase_periods;
+    builder << m_tuner_enabled;
+    builder << m_spectrum_enabled;
+    builder << m_auto_gain_enabled;
+    builder << m_auto_gain_window_millis;
+    builder << m_average_mode;
+    builder << m_average_count;
+    builder << m_roll_enabled;
+    builder << m_roll_duration_seconds;
+    builder << m_overview_enabled;
+    builder << m_export_frame_rate_hz;
+    builder << m_export_resolution;
+    builder << m_export_format;
+    builder << m_channel_layout;
+    builder << m_channel_mask;
+    builder << m_channel_order;
+    builder << m_trigger_level_percent;
+    builder << m_trigger_slope;
+    builder << m_trigger_hysteresis_percent;
+    builder << m_trigger_holdoff_millis;
+    builder << m_trigger_source;
+    builder << m_trigger_mode;
+    builder << m_trigger_predictive_enabled;
     builder << m_line_stroke_width;
     builder << m_low_quality_enabled;
     builder << m_resample_enabled;
@@ -74,3 +252,63 @@ void oscilloscope_config::build(ui_element_config_builder & builder) {
     builder << m_window_duration_millis;
     builder << m_zoom_percent;
 }
+
+bool oscilloscope_config::get_export_size(t_uint32 & width, t_uint32 & height) const {
+    switch (m_export_resolution) {
+    case export_resolution_720p:
+        width = 1280;
+        height = 720;
+        return true;
+    case export_resolution_1080p:
+        width = 1920;
+        height = 1080;
+        return true;
+    case export_resolution_1440p:
+        width = 2560;
+        height = 1440;
+        return true;
+    case export_resolution_2160p:
+        width = 3840;
+        height = 2160;
+        return true;
+    default:
+        return false;
+    }
+}
+
+t_uint32 oscilloscope_config::get_channel_position(t_uint32 channel_index) {
+    for (t_uint32 position = 0; position < channel_order_count; ++position) {
+        if (get_channel_at(position) == channel_index) {
+            return position;
+        }
+    }
+    return channel_index;
+}
+
+void oscilloscope_config::move_channel_up(t_uint32 channel_index) {
+    t_uint32 position = get_channel_position(channel_index);
+    if (position == 0 || position >= channel_order_count) {
+        return;
+    }
+
+    t_uint32 shift = position * 4;
+    t_uint32 previous_channel_index = get_channel_at(position - 1);
+    m_channel_order &= ~(0xffu << (shift - 4));
+    m_channel_order |= (channel_index << (shift - 4)) | (previous_channel_index << shift);
+}
+
+void oscilloscope_config::reverse_channel_order() {
+    t_uint32 order = 0;
+    for (t_uint32 position = 0; position < channel_order_count; ++position) {
+        order |= get_channel_at(position) << ((channel_order_count - 1 - position) * 4);
+    }
+    m_channel_order = order;
+}
+
+bool oscilloscope_config::g_is_valid_channel_order(t_uint32 order) {
+    t_uint32 seen = 0;
+    for (t_uint32 position = 0; position < channel_order_count; ++position) {
+        seen |= 1u << ((order >> (position * 4)) & 0xf);
+    }
+    return seen == (1u << channel_order_count) - 1;
+}
@@ -2,6 +2,81 @@
 
 class oscilloscope_config {
 public:
+    enum {
+        trigger_mode_zero_crossing = 0,
+        trigger_mode_correlation,
+        trigger_mode_count
+    };
+
+    enum {
+        trigger_slope_rising = 0,
+        trigger_slope_falling,
+        trigger_slope_count
+    };
+
+    enum {
+        trigger_source_any = 0,
+        trigger_source_sum,
+        trigger_source_channel_1,
+        trigger_source_channel_8 = trigger_source_channel_1 + 7
+    };
+
+    enum {
+        channel_layout_stacked = 0,
+        channel_layout_overlay,
+        channel_layout_grid,
+        channel_layout_count
+    };
+
+    enum {
+        export_resolution_window = 0,
+        export_resolution_720p,
+        export_resolution_1080p,
+        export_resolution_1440p,
+        export_resolution_2160p,
+        export_resolution_count
+    };
+
+    enum {
+        average_mode_exponential = 0,
+        average_mode_boxcar,
+        average_mode_count
+    };
+
+    enum {
+        channel_matrix_none = 0,
+        channel_matrix_mid_side,
+        channel_matrix_difference,
+        channel_matrix_fold_down,
+        channel_matrix_custom,
+        channel_matrix_count
+    };
+
+    enum {
+        custom_matrix_max_channels = 8
+    };
+
+    enum {
+        color_mode_solid = 0,
+        color_mode_amplitude,
+        color_mode_slope,
+        color_mode_time,
+        color_mode_count
+    };
+
+    enum {
+        export_format_png = 0,
+        export_format_ppm,
+        export_format_count
+    };
+
+    // The display order of the first channel_order_count channels is packed into m_channel_order,
+    // four bits per position; further channels follow in their natural order.
+    enum {
+        channel_order_count = 8,
+        default_channel_order = 0x76543210
+    };
+
     t_uint32 g_get_version();
 
     oscilloscope_config();
@@ -13,14 +88,62 @@ public:
     bool m_hw_rendering_enabled;
     bool m_downmix_enabled;
     bool m_trigger_enabled;
+    bool m_trigger_predictive_enabled;
+    t_uint32 m_trigger_mode;
+    t_int32 m_trigger_level_percent;
+    t_uint32 m_trigger_slope;
+    t_uint32 m_trigger_hysteresis_percent;
+    t_uint32 m_trigger_holdoff_millis;
+    t_uint32 m_trigger_source;
+    t_uint32 m_channel_layout;
+    t_uint32 m_channel_mask;
+    t_uint32 m_channel_order;
     bool m_resample_enabled;
     bool m_low_quality_enabled;
     t_uint32 m_window_duration_millis;
     t_uint32 m_zoom_percent;
     t_uint32 m_refresh_rate_limit_hz;
     t_uint32 m_line_stroke_width;
+    t_uint32 m_export_frame_rate_hz;
+    t_uint32 m_export_resolution;
+    t_uint32 m_export_format;
+    bool m_overview_enabled;
+    bool m_roll_enabled;
+    t_uint32 m_roll_duration_seconds;
+    t_uint32 m_average_mode;
+    t_uint32 m_average_count;
+    bool m_auto_gain_enabled;
+    t_uint32 m_auto_gain_window_millis;
+    bool m_spectrum_enabled;
+    bool m_tuner_enabled;
+    t_uint32 m_timebase_periods;
+    bool m_band_split_enabled;
+    t_uint32 m_channel_matrix;
+    // The weights of channel_matrix_custom, m_custom_matrix_output_count rows of
+    // m_custom_matrix_input_count weights. Both counts are 0 if no custom matrix has been set.
+    t_uint32 m_custom_matrix_input_count;
+    t_uint32 m_custom_matrix_output_count;
+    float m_custom_matrix_weights[custom_matrix_max_channels * custom_matrix_max_channels];
+    t_uint32 m_color_mode;
+    bool m_glow_enabled;
+
+    double get_zoom_factor() const {return (double) m_zoom_percent * 0.01;}
+    double get_window_duration() const {return (double) m_window_duration_millis * 0.001;}
+    double get_auto_gain_window() const {return (double) m_auto_gain_window_millis * 0.001;}
+    double get_roll_duration() const {return (double) m_roll_duration_seconds;}
+    double get_line_stroke_width() const {return (double) m_line_stroke_width * 0.1;}
+    double get_trigger_level() const {return (double) m_trigger_level_percent * 0.01;}
+    double get_trigger_hysteresis() const {return (double) m_trigger_hysteresis_percent * 0.01;}
+    double get_trigger_holdoff() const {return (double) m_trigger_holdoff_millis * 0.001;}
+
+    // Returns false for export_resolution_window, whose size is that of the window.
+    bool get_export_size(t_uint32 & width, t_uint32 & height) const;
+
+    bool is_channel_visible(t_uint32 channel_index) const {return channel_index >= 32 || (m_channel_mask & (1u << channel_index)) != 0;}
+    t_uint32 get_channel_at(t_uint32 position) const {return position < channel_order_count ? (m_channel_order >> (position * 4)) & 0xf : position;}
+    t_uint32 get_channel_position(t_uint32 channel_index);
+    void move_channel_up(t_uint32 channel_index);
+    void reverse_channel_order();
 
-    double get_zoom_factor() {return (double) m_zoom_percent * 0.01;}
-    double get_window_duration() {return (double) m_window_duration_millis * 0.001;}
-    double get_line_stroke_width() {return (double) m_line_stroke_width * 0.1;}
+    static bool g_is_valid_channel_order(t_uint32 order);
 };
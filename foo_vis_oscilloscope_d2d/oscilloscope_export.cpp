@@ -0,0 +1,513 @@
+#include "stdafx.h"
+
+#include <wincodec.h>
+
+#include "oscilloscope_export.h"
+#include "oscilloscope_renderer.h"
+#include "oscilloscope_sample_buffer.h"
+
+namespace {
+    void check_hresult(HRESULT hr, const char * what) {
+        if (FAILED(hr)) {
+            throw exception_com(hr, pfc::string_formatter() << what << " failed");
+        }
+    }
+
+    D2D1::ColorF get_color(t_ui_color color) {
+        return D2D1::ColorF(GetRValue(color) / 255.0f, GetGValue(color) / 255.0f, GetBValue(color) / 255.0f);
+    }
+
+    // Interleaved samples of a track, decoded on demand for windows that only move forward in
+    // time. Times before the start or after the end of the track read as silence.
+    class export_source {
+    public:
+        export_source(metadb_handle_ptr track, double start_time, bool downmix, abort_callback & abort);
+
+        // Returns the samples of [time, time + duration), valid until the next call.
+        oscilloscope_sample_window_view get_window(double time, double duration);
+
+    private:
+        bool decode();
+
+        input_helper m_decoder;
+        abort_callback & m_abort;
+        audio_chunk_impl m_decoded;
+        bool m_downmix;
+        bool m_eof;
+        oscilloscope_sample_buffer m_buffer;
+    };
+
+    export_source::export_source(metadb_handle_ptr track, double start_time, bool downmix, abort_callback & abort)
+        : m_abort(abort)
+        , m_downmix(downmix)
+        , m_eof(false)
+    {
+        m_decoder.open(service_ptr_t<file>(), track, input_flag_simpledecode, abort);
+
+        double seek_time = pfc::max_t<double>(start_time, 0.0);
+        if (seek_time > 0.0) {
+            m_decoder.seek(seek_time, abort);
+        }
+
+        if (m_decoder.run(m_decoded, abort)) {
+            m_buffer.reset(m_decoded.get_sample_rate(), m_decoded.get_channel_count(), (t_int64) (seek_time * m_decoded.get_sample_rate() + 0.5));
+            m_buffer.append(m_decoded.get_data(), m_decoded.get_sample_count());
+        } else {
+            m_eof = true;
+        }
+    }
+
+    bool export_source::decode() {
+        if (m_eof) {
+            return false;
+        }
+
+        // A change of format within the track is treated as its end.
+        if (!m_decoder.run(m_decoded, m_abort) || m_decoded.get_sample_rate() != m_buffer.get_sample_rate() || m_decoded.get_channel_count() != m_buffer.get_channel_count()) {
+            m_eof = true;
+            return false;
+        }
+
+        m_buffer.append(m_decoded.get_data(), m_decoded.get_sample_count());
+        return true;
+    }
+
+    oscilloscope_sample_window_view export_source::get_window(double time, double duration) {
+        t_uint32 sample_rate = m_buffer.get_sample_rate();
+        t_int64 first = (t_int64) floor(time * sample_rate + 0.5);
+        t_size count = (t_size) (duration * sample_rate + 0.5);
+
+        m_buffer.discard(first);
+        while (m_buffer.get_end() < first + (t_int64) count && decode()) {}
+        return m_buffer.get_window(first, count, m_downmix);
+    }
+
+    struct export_frame {
+        t_uint32 m_index;
+        // Rows of premultiplied BGRA pixels, without padding.
+        pfc::array_t<t_uint8> m_pixels;
+    };
+
+    // Frames in flight between the renderers, which fill them, and the writers, which hand them
+    // back once written. The fixed number of frames bounds the memory a renderer can get ahead by.
+    class export_frame_pool {
+    public:
+        export_frame_pool() : m_free_count(0) {}
+
+        void initialize(t_size count, t_size bytes) {
+            m_frames.set_size_discard(count);
+            m_free.set_size(count);
+            for (t_size frame_index = 0; frame_index < count; ++frame_index) {
+                m_frames[frame_index].m_pixels.set_size(bytes);
+                m_free[frame_index] = &m_frames[frame_index];
+            }
+            m_free_count = count;
+        }
+
+        // Waits until a frame is free.
+        export_frame * acquire() {
+            for (;;) {
+                {
+                    pfc::mutexScope scope(m_lock);
+                    if (m_free_count > 0) {
+                        return m_free[--m_free_count];
+                    }
+                    m_available.set_state(false);
+                }
+                m_available.wait_for(-1);
+            }
+        }
+
+        void release(export_frame * frame) {
+            pfc::mutexScope scope(m_lock);
+            m_free[m_free_count++] = frame;
+            m_available.set_state(true);
+        }
+
+    private:
+        pfc::mutex m_lock;
+        pfc::event m_available;
+        pfc::array_staticsize_t<export_frame> m_frames;
+        pfc::array_t<export_frame *> m_free;
+        t_size m_free_count;
+    };
+
+    class export_process;
+
+    // Encodes and writes the frames queued by the renderers, in the order they arrive. Any number
+    // of renderers can queue frames; a null frame stops the writer.
+    class export_writer : public pfc::thread {
+    public:
+        export_writer() : m_process(nullptr) {}
+        ~export_writer() {stop();}
+
+        void start(export_process * process, t_size queue_capacity);
+        void stop();
+        void push(export_frame * frame);
+
+    protected:
+        void threadProc();
+
+    private:
+        export_process * m_process;
+        pfc::mpscRing<export_frame *> m_queue;
+        pfc::event m_wake;
+    };
+
+    class export_process : public threaded_process_callback {
+    public:
+        export_process(metadb_handle_ptr track, const oscilloscope_config & config, t_ui_color background_color, t_ui_color stroke_color, t_uint32 width, t_uint32 height, const char * directory);
+
+        void run(threaded_process_status & p_status, abort_callback & p_abort);
+        void on_done(HWND p_wnd, bool p_was_aborted);
+
+        bool should_stop() const {return m_failed != 0 || m_abort->is_aborting();}
+        void fail(const char * message);
+
+        void render_range(t_uint32 begin, t_uint32 end);
+        void write_frame(const export_frame & frame, pfc::array_t<t_uint8> & encoded, CComPtr<IWICImagingFactory> & wic);
+        void release_frame(export_frame * frame);
+
+    private:
+        double get_frame_time(t_uint32 frame_index) const {return (double) frame_index / (double) m_config.m_export_frame_rate_hz;}
+
+        const metadb_handle_ptr m_track;
+        const oscilloscope_config m_config;
+        const t_ui_color m_background_color;
+        const t_ui_color m_stroke_color;
+        const t_uint32 m_width;
+        const t_uint32 m_height;
+        const pfc::string8 m_directory;
+
+        abort_callback * m_abort;
+        t_uint32 m_frame_count;
+        unsigned m_frame_digits;
+
+        export_frame_pool m_frames;
+        pfc::array_staticsize_t<export_writer> m_writers;
+        // Frames written, or skipped after a failure.
+        volatile LONG m_finished_count;
+
+        pfc::mutex m_error_lock;
+        pfc::string8 m_error;
+        volatile LONG m_failed;
+    };
+
+    // A contiguous range of frames, rendered in order by one task.
+    struct export_range {
+        export_process * m_process;
+        t_uint32 m_begin;
+        t_uint32 m_end;
+
+        void operator()() const {
+            m_process->render_range(m_begin, m_end);
+        }
+    };
+
+    void export_writer::start(export_process * process, t_size queue_capacity) {
+        m_process = process;
+        m_queue.setCapacity(queue_capacity);
+        pfc::thread::start();
+    }
+
+    void export_writer::stop() {
+        if (isActive()) {
+            push(nullptr);
+            waitTillDone();
+        }
+    }
+
+    void export_writer::push(export_frame * frame) {
+        // The queue has room for every frame of the pool and the final null frame.
+        bool queued = m_queue.push(frame);
+        PFC_ASSERT(queued); (void) queued;
+        m_wake.set_state(true);
+    }
+
+    void export_writer::threadProc() {
+        HRESULT hr_com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        {
+            CComPtr<IWICImagingFactory> wic;
+            pfc::array_t<t_uint8> encoded;
+            for (;;) {
+                export_frame * frame;
+                if (!m_queue.pop(frame)) {
+                    m_wake.set_state(false);
+                    if (!m_queue.pop(frame)) {
+                        m_wake.wait_for(-1);
+                        continue;
+                    }
+                }
+                if (frame == nullptr) {
+                    break;
+                }
+
+                if (!m_process->should_stop()) {
+                    try {
+                        m_process->write_frame(*frame, encoded, wic);
+                    } catch (std::exception & exc) {
+                        m_process->fail(exc.what());
+                    }
+                }
+                m_process->release_frame(frame);
+            }
+        }
+        if (SUCCEEDED(hr_com)) {
+            CoUninitialize();
+        }
+    }
+
+    export_process::export_process(metadb_handle_ptr track, const oscilloscope_config & config, t_ui_color background_color, t_ui_color stroke_color, t_uint32 width, t_uint32 height, const char * directory)
+        : m_track(track)
+        , m_config(config)
+        , m_background_color(background_color)
+        , m_stroke_color(stroke_color)
+        , m_width(width)
+        , m_height(height)
+        , m_directory(directory)
+        , m_abort(nullptr)
+        , m_frame_count(0)
+        , m_frame_digits(6)
+        , m_finished_count(0)
+        , m_failed(0)
+    {
+    }
+
+    void export_process::fail(const char * message) {
+        pfc::mutexScope scope(m_error_lock);
+        if (m_failed == 0) {
+            m_error = message;
+            InterlockedExchange(&m_failed, 1);
+        }
+    }
+
+    void export_process::release_frame(export_frame * frame) {
+        m_frames.release(frame);
+        InterlockedIncrement(&m_finished_count);
+    }
+
+    void export_process::run(threaded_process_status & p_status, abort_callback & p_abort) {
+        m_abort = &p_abort;
+
+        try {
+            double length = m_track->get_length();
+            if (!(length > 0.0)) {
+                throw pfc::exception("the length of the track is unknown");
+            }
+            m_frame_count = (t_uint32) ceil(length * m_config.m_export_frame_rate_hz);
+            m_frame_digits = pfc::max_t<unsigned>(6, (unsigned) strlen(pfc::format_uint(m_frame_count - 1)));
+
+            // PNG compression takes longer than rendering a frame, so it gets more writers than PPM,
+            // which only waits on the disk.
+            t_size render_thread_count = pfc::getOptimalWorkerThreadCount();
+            t_size writer_count = (m_config.m_export_format == oscilloscope_config::export_format_png) ? pfc::max_t<t_size>(render_thread_count / 2, 1) : 1;
+            t_size frame_count_in_flight = render_thread_count + 2 * writer_count;
+            m_frames.initialize(frame_count_in_flight, (t_size) m_width * m_height * 4);
+            m_writers.set_size_discard(writer_count);
+            for (t_size writer_index = 0; writer_index < writer_count; ++writer_index) {
+                m_writers[writer_index].start(this, frame_count_in_flight + 1);
+            }
+
+            {
+                // Twice as many ranges as threads, so that a thread that finishes early takes over
+                // work that would otherwise have been left to the slowest one.
+                pfc::threadPool pool(render_thread_count);
+                t_size range_count = pfc::min_t<t_size>(m_frame_count, render_thread_count * 2);
+                pfc::array_staticsize_t<export_range> ranges(range_count);
+                pfc::array_staticsize_t<pfc::threadPool::future> futures(range_count);
+                for (t_size range_index = 0; range_index < range_count; ++range_index) {
+                    export_range & range = ranges[range_index];
+                    range.m_process = this;
+                    range.m_begin = (t_uint32) ((t_uint64) m_frame_count * range_index / range_count);
+                    range.m_end = (t_uint32) ((t_uint64) m_frame_count * (range_index + 1) / range_count);
+                    pool.submit(futures[range_index], range);
+                }
+
+                for (;;) {
+                    bool done = true;
+                    for (t_size range_index = 0; range_index < range_count && done; ++range_index) {
+                        done = futures[range_index].isDone();
+                    }
+                    p_status.set_progress(m_finished_count, m_frame_count);
+                    if (done) {
+                        break;
+                    }
+                    Sleep(100);
+                }
+            }
+        } catch (std::exception & exc) {
+            fail(exc.what());
+        }
+
+        for (t_size writer_index = 0; writer_index < m_writers.get_size(); ++writer_index) {
+            m_writers[writer_index].stop();
+        }
+
+        if (m_failed != 0) {
+            console::formatter() << core_api::get_my_file_name() << ": frame export failed: " << m_error;
+        } else if (!p_abort.is_aborting()) {
+            p_status.set_progress(m_frame_count, m_frame_count);
+            console::formatter() << core_api::get_my_file_name() << ": " << m_frame_count << " frames exported to " << m_directory;
+        }
+    }
+
+    void export_process::on_done(HWND p_wnd, bool p_was_aborted) {
+        if (m_failed != 0) {
+            popup_message::g_show(pfc::string_formatter() << "Frame export failed: " << m_error, "Oscilloscope", popup_message::icon_error);
+        }
+    }
+
+    void export_process::render_range(t_uint32 begin, t_uint32 end) {
+        HRESULT hr_com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        try {
+            CComPtr<ID2D1Factory> factory;
+            check_hresult(D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &factory), "creating the Direct2D factory");
+
+            CComPtr<IWICImagingFactory> wic;
+            check_hresult(wic.CoCreateInstance(CLSID_WICImagingFactory), "creating the WIC imaging factory");
+
+            CComPtr<IWICBitmap> bitmap;
+            check_hresult(wic->CreateBitmap(m_width, m_height, GUID_WICPixelFormat32bppPBGRA, WICBitmapCacheOnLoad, &bitmap), "creating the frame bitmap");
+
+            CComPtr<ID2D1RenderTarget> target;
+            check_hresult(factory->CreateWicBitmapRenderTarget(bitmap, D2D1::RenderTargetProperties(D2D1_RENDER_TARGET_TYPE_SOFTWARE), &target), "creating the frame render target");
+
+            CComPtr<ID2D1SolidColorBrush> brush;
+            check_hresult(target->CreateSolidColorBrush(get_color(m_stroke_color), &brush), "creating the stroke brush");
+
+            oscilloscope_renderer renderer;
+            renderer.set_config(m_config);
+
+            double window_duration = m_config.get_window_duration();
+            double chunk_duration = window_duration * (m_config.m_trigger_enabled ? 2 : 1);
+
+            // The frame before the range is rendered but not written, so that the trigger has
+            // locked on by the first frame of the range, as it would have in a single pass.
+            t_uint32 first = begin > 0 ? begin - 1 : begin;
+            export_source source(m_track, get_frame_time(first) - window_duration / 2, m_config.m_downmix_enabled, *m_abort);
+
+            for (t_uint32 frame_index = first; frame_index < end && !should_stop(); ++frame_index) {
+                PFC_TRACE_SCOPE(export_frame);
+                double chunk_time = get_frame_time(frame_index) - window_duration / 2;
+                oscilloscope_sample_window_view window = source.get_window(chunk_time, chunk_duration);
+
+                target->BeginDraw();
+                target->SetTransform(D2D1::Matrix3x2F::Identity());
+                target->Clear(get_color(m_background_color));
+                HRESULT hr = renderer.render(factory, target, brush, window, chunk_time, nullptr);
+                HRESULT hr_end = target->EndDraw();
+                check_hresult(FAILED(hr) ? hr : hr_end, "rendering a frame");
+
+                if (frame_index < begin) {
+                    continue;
+                }
+
+                export_frame * frame = m_frames.acquire();
+                frame->m_index = frame_index;
+
+                WICRect rect = {0, 0, (INT) m_width, (INT) m_height};
+                CComPtr<IWICBitmapLock> lock;
+                UINT stride = 0, size = 0;
+                BYTE * pixels = nullptr;
+                hr = bitmap->Lock(&rect, WICBitmapLockRead, &lock);
+                if (SUCCEEDED(hr)) {
+                    hr = lock->GetStride(&stride);
+                }
+                if (SUCCEEDED(hr)) {
+                    hr = lock->GetDataPointer(&size, &pixels);
+                }
+                if (FAILED(hr)) {
+                    m_frames.release(frame);
+                    check_hresult(hr, "reading back a frame");
+                }
+                for (t_uint32 row = 0; row < m_height; ++row) {
+                    memcpy(frame->m_pixels.get_ptr() + (t_size) row * m_width * 4, pixels + (t_size) row * stride, m_width * 4);
+                }
+                lock.Release();
+
+                m_writers[frame_index % m_writers.get_size()].push(frame);
+            }
+        } catch (exception_aborted &) {
+        } catch (std::exception & exc) {
+            fail(exc.what());
+        }
+        if (SUCCEEDED(hr_com)) {
+            CoUninitialize();
+        }
+    }
+
+    void export_process::write_frame(const export_frame & frame, pfc::array_t<t_uint8> & encoded, CComPtr<IWICImagingFactory> & wic) {
+        PFC_TRACE_SCOPE(write_frame);
+        bool png = m_config.m_export_format == oscilloscope_config::export_format_png;
+        t_size pixel_count = (t_size) m_width * m_height;
+        const t_uint8 * pixels = frame.m_pixels.get_ptr();
+
+        // The background is opaque, so dropping the alpha channel loses nothing. PPM wants RGB and
+        // the PNG encoder takes BGR.
+        pfc::string_formatter header;
+        if (!png) {
+            header << "P6\n" << m_width << " " << m_height << "\n255\n";
+        }
+        encoded.set_size(header.length() + pixel_count * 3);
+        memcpy(encoded.get_ptr(), header.get_ptr(), header.length());
+        t_uint8 * out = encoded.get_ptr() + header.length();
+        for (t_size pixel_index = 0; pixel_index < pixel_count; ++pixel_index) {
+            const t_uint8 * in = pixels + pixel_index * 4;
+            out[pixel_index * 3 + 0] = png ? in[0] : in[2];
+            out[pixel_index * 3 + 1] = in[1];
+            out[pixel_index * 3 + 2] = png ? in[2] : in[0];
+        }
+
+        pfc::string8 path = m_directory;
+        path.add_filename(pfc::string_formatter() << "frame_" << pfc::format_uint(frame.m_index, m_frame_digits) << (png ? ".png" : ".ppm"));
+
+        abort_callback_dummy abort;
+        file::ptr f;
+        filesystem::g_open_write_new(f, path, abort);
+
+        if (!png) {
+            f->write(encoded.get_ptr(), encoded.get_size(), abort);
+            return;
+        }
+
+        if (!wic) {
+            check_hresult(wic.CoCreateInstance(CLSID_WICImagingFactory), "creating the WIC imaging factory");
+        }
+
+        CComPtr<IStream> stream;
+        check_hresult(CreateStreamOnHGlobal(nullptr, TRUE, &stream), "creating the PNG stream");
+        CComPtr<IWICBitmapEncoder> encoder;
+        check_hresult(wic->CreateEncoder(GUID_ContainerFormatPng, nullptr, &encoder), "creating the PNG encoder");
+        check_hresult(encoder->Initialize(stream, WICBitmapEncoderNoCache), "initializing the PNG encoder");
+        CComPtr<IWICBitmapFrameEncode> target;
+        check_hresult(encoder->CreateNewFrame(&target, nullptr), "creating the PNG frame");
+        check_hresult(target->Initialize(nullptr), "initializing the PNG frame");
+        check_hresult(target->SetSize(m_width, m_height), "setting the PNG size");
+        WICPixelFormatGUID format = GUID_WICPixelFormat24bppBGR;
+        check_hresult(target->SetPixelFormat(&format), "setting the PNG pixel format");
+        if (format != GUID_WICPixelFormat24bppBGR) {
+            throw pfc::exception("the PNG encoder does not accept 24-bit BGR pixels");
+        }
+        check_hresult(target->WritePixels(m_height, m_width * 3, (UINT) (pixel_count * 3), out), "encoding the PNG");
+        check_hresult(target->Commit(), "encoding the PNG");
+        check_hresult(encoder->Commit(), "encoding the PNG");
+
+        HGLOBAL memory = nullptr;
+        STATSTG stat;
+        check_hresult(GetHGlobalFromStream(stream, &memory), "reading the PNG stream");
+        check_hresult(stream->Stat(&stat, STATFLAG_NONAME), "reading the PNG stream");
+        const void * data = GlobalLock(memory);
+        try {
+            f->write(data, (t_size) stat.cbSize.QuadPart, abort);
+        } catch (...) {
+            GlobalUnlock(memory);
+            throw;
+        }
+        GlobalUnlock(memory);
+    }
+}
+
+void oscilloscope_export_frames(HWND parent, metadb_handle_ptr track, const oscilloscope_config & config, t_ui_color background_color, t_ui_color stroke_color, t_uint32 width, t_uint32 height, const char * directory) {
+    service_ptr_t<threaded_process_callback> callback = new service_impl_t<export_process>(track, config, background_color, stroke_color, width, height, directory);
+    threaded_process::g_run_modeless(callback, threaded_process::flag_show_progress | threaded_process::flag_show_abort | threaded_process::flag_show_minimize, parent, "Exporting Oscilloscope Frames");
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "oscilloscope_config.h"
+
+// Renders a track offline, faster than real time, into numbered image files in directory, for
+// video production. Frame rate, format and - unless it follows the window - resolution come from
+// the export settings of config. Disjoint ranges of frames are decoded and rendered in parallel,
+// each with its own decoder, renderer and offscreen target; encoding and writing the files is left
+// to background writer threads, so that rendering never waits on the disk. Runs in the background
+// with a progress dialog.
+void oscilloscope_export_frames(HWND parent, metadb_handle_ptr track, const oscilloscope_config & config, t_ui_color background_color, t_ui_color stroke_color, t_uint32 width, t_uint32 height, const char * directory);
@@ -0,0 +1,273 @@
+#include "stdafx.h"
+
+#include "oscilloscope_fft.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    const double g_pi = 3.14159265358979323846;
+}
+
+// The real transform of size N is computed as a complex transform of size M = N / 2 over the
+// even/odd sample pairs, followed by a split step that separates the two interleaved spectra.
+oscilloscope_fft_plan::oscilloscope_fft_plan(t_size size) : m_size(size) {
+    PFC_ASSERT(size >= 4 && (size & (size - 1)) == 0);
+
+    t_size half_size = size / 2;
+
+    t_uint32 bits = 0;
+    while (((t_size) 1 << bits) < half_size) {
+        ++bits;
+    }
+    m_bit_reverse.set_size(half_size);
+    for (t_size index = 0; index < half_size; ++index) {
+        t_uint32 reversed = 0;
+        for (t_uint32 bit = 0; bit < bits; ++bit) {
+            if (index & ((t_size) 1 << bit)) {
+                reversed |= 1 << (bits - 1 - bit);
+            }
+        }
+        m_bit_reverse[index] = reversed;
+    }
+
+    // Twiddle factors of the stage with half-span m are stored at [m, 2m) so that each stage
+    // reads a contiguous, aligned run.
+    m_twiddle_re.set_size(pfc::max_t<t_size>(half_size, 4));
+    m_twiddle_im.set_size(pfc::max_t<t_size>(half_size, 4));
+    m_twiddle_re.get_ptr()[0] = 1.0f;
+    m_twiddle_im.get_ptr()[0] = 0.0f;
+    for (t_size span = 1; span < half_size; span *= 2) {
+        for (t_size index = 0; index < span; ++index) {
+            double angle = -g_pi * (double) index / (double) span;
+            m_twiddle_re.get_ptr()[span + index] = (float) cos(angle);
+            m_twiddle_im.get_ptr()[span + index] = (float) sin(angle);
+        }
+    }
+
+    m_real_twiddle_re.set_size(half_size / 2 + 1);
+    m_real_twiddle_im.set_size(half_size / 2 + 1);
+    for (t_size index = 0; index <= half_size / 2; ++index) {
+        double angle = -2.0 * g_pi * (double) index / (double) size;
+        m_real_twiddle_re[index] = (float) cos(angle);
+        m_real_twiddle_im[index] = (float) sin(angle);
+    }
+
+    m_window.set_size(size);
+    for (t_size index = 0; index < size; ++index) {
+        m_window.get_ptr()[index] = (float) (0.5 - 0.5 * cos(2.0 * g_pi * (double) index / (double) size));
+    }
+}
+
+const oscilloscope_fft_plan & oscilloscope_fft_plan::g_get_plan(t_size size) {
+    static pfc::mutex g_lock;
+    static pfc::map_t<t_size, pfc::rcptr_t<oscilloscope_fft_plan> > g_plans;
+
+    pfc::mutexScope scope(g_lock);
+    pfc::rcptr_t<oscilloscope_fft_plan> & plan = g_plans.find_or_add(size);
+    if (plan.is_empty()) {
+        plan = pfc::rcnew_t<oscilloscope_fft_plan>(size);
+    }
+    return *plan;
+}
+
+// In-place complex radix-2 decimation-in-time transform of size N / 2 on split real/imaginary arrays.
+void oscilloscope_fft_plan::transform(float * re, float * im) const {
+    t_size half_size = m_size / 2;
+
+    for (t_size index = 0; index < half_size; ++index) {
+        t_size reversed = m_bit_reverse[index];
+        if (index < reversed) {
+            pfc::swap_t(re[index], re[reversed]);
+            pfc::swap_t(im[index], im[reversed]);
+        }
+    }
+
+    const float * twiddle_re = m_twiddle_re.get_ptr();
+    const float * twiddle_im = m_twiddle_im.get_ptr();
+
+    t_size span = 1;
+#if OSCILLOSCOPE_HAVE_SSE2
+    for (; span < half_size && span < 4; span *= 2) {
+#else
+    for (; span < half_size; span *= 2) {
+#endif
+        for (t_size base = 0; base < half_size; base += 2 * span) {
+            for (t_size index = 0; index < span; ++index) {
+                float wr = twiddle_re[span + index];
+                float wi = twiddle_im[span + index];
+                float * ar = re + base + index;
+                float * ai = im + base + index;
+                float * br = ar + span;
+                float * bi = ai + span;
+                float tr = *br * wr - *bi * wi;
+                float ti = *br * wi + *bi * wr;
+                *br = *ar - tr;
+                *bi = *ai - ti;
+                *ar += tr;
+                *ai += ti;
+            }
+        }
+    }
+
+#if OSCILLOSCOPE_HAVE_SSE2
+    // Two stages at a time as radix-4 butterflies, so the data is swept half as often; spans from
+    // 4 upwards keep every access 16-byte aligned. Each butterfly combines a, b, c, d at offsets 0,
+    // span, 2 span and 3 span: the first stage pairs (a, b) and (c, d) with the twiddles of span,
+    // the second pairs (a, c) and (b, d) with those of 2 span, where the twiddle of (b, d) is that
+    // of (a, c) times -i, so it needs no table of its own.
+    for (; 4 * span <= half_size; span *= 4) {
+        for (t_size base = 0; base < half_size; base += 4 * span) {
+            for (t_size index = 0; index < span; index += 4) {
+                __m128 w1r = _mm_load_ps(twiddle_re + span + index);
+                __m128 w1i = _mm_load_ps(twiddle_im + span + index);
+                __m128 w2r = _mm_load_ps(twiddle_re + 2 * span + index);
+                __m128 w2i = _mm_load_ps(twiddle_im + 2 * span + index);
+                float * ar = re + base + index;
+                float * ai = im + base + index;
+
+                __m128 xr = _mm_load_ps(ar + span);
+                __m128 xi = _mm_load_ps(ai + span);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, w1r), _mm_mul_ps(xi, w1i));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(xr, w1i), _mm_mul_ps(xi, w1r));
+                __m128 yr = _mm_load_ps(ar);
+                __m128 yi = _mm_load_ps(ai);
+                __m128 br = _mm_sub_ps(yr, tr);
+                __m128 bi = _mm_sub_ps(yi, ti);
+                __m128 a_r = _mm_add_ps(yr, tr);
+                __m128 a_i = _mm_add_ps(yi, ti);
+
+                xr = _mm_load_ps(ar + 3 * span);
+                xi = _mm_load_ps(ai + 3 * span);
+                tr = _mm_sub_ps(_mm_mul_ps(xr, w1r), _mm_mul_ps(xi, w1i));
+                ti = _mm_add_ps(_mm_mul_ps(xr, w1i), _mm_mul_ps(xi, w1r));
+                yr = _mm_load_ps(ar + 2 * span);
+                yi = _mm_load_ps(ai + 2 * span);
+                __m128 dr = _mm_sub_ps(yr, tr);
+                __m128 di = _mm_sub_ps(yi, ti);
+                __m128 cr = _mm_add_ps(yr, tr);
+                __m128 ci = _mm_add_ps(yi, ti);
+
+                tr = _mm_sub_ps(_mm_mul_ps(cr, w2r), _mm_mul_ps(ci, w2i));
+                ti = _mm_add_ps(_mm_mul_ps(cr, w2i), _mm_mul_ps(ci, w2r));
+                _mm_store_ps(ar, _mm_add_ps(a_r, tr));
+                _mm_store_ps(ai, _mm_add_ps(a_i, ti));
+                _mm_store_ps(ar + 2 * span, _mm_sub_ps(a_r, tr));
+                _mm_store_ps(ai + 2 * span, _mm_sub_ps(a_i, ti));
+
+                // d times the twiddle of (b, d), which is (w2i, -w2r).
+                tr = _mm_add_ps(_mm_mul_ps(dr, w2i), _mm_mul_ps(di, w2r));
+                ti = _mm_sub_ps(_mm_mul_ps(di, w2i), _mm_mul_ps(dr, w2r));
+                _mm_store_ps(ar + span, _mm_add_ps(br, tr));
+                _mm_store_ps(ai + span, _mm_add_ps(bi, ti));
+                _mm_store_ps(ar + 3 * span, _mm_sub_ps(br, tr));
+                _mm_store_ps(ai + 3 * span, _mm_sub_ps(bi, ti));
+            }
+        }
+    }
+
+    // An odd number of stages leaves a last radix-2 stage.
+    if (span < half_size) {
+        for (t_size index = 0; index < span; index += 4) {
+            __m128 wr = _mm_load_ps(twiddle_re + span + index);
+            __m128 wi = _mm_load_ps(twiddle_im + span + index);
+            float * ar = re + index;
+            float * ai = im + index;
+            float * br = ar + span;
+            float * bi = ai + span;
+            __m128 xr = _mm_load_ps(br);
+            __m128 xi = _mm_load_ps(bi);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+            __m128 yr = _mm_load_ps(ar);
+            __m128 yi = _mm_load_ps(ai);
+            _mm_store_ps(br, _mm_sub_ps(yr, tr));
+            _mm_store_ps(bi, _mm_sub_ps(yi, ti));
+            _mm_store_ps(ar, _mm_add_ps(yr, tr));
+            _mm_store_ps(ai, _mm_add_ps(yi, ti));
+        }
+    }
+#endif
+}
+
+void oscilloscope_fft_plan::forward(const float * input, float * out_re, float * out_im) const {
+    t_size half_size = m_size / 2;
+
+    for (t_size index = 0; index < half_size; ++index) {
+        out_re[index] = input[2 * index];
+        out_im[index] = input[2 * index + 1];
+    }
+
+    transform(out_re, out_im);
+
+    // Split the spectra of the even and odd samples and combine them, processing bins k and M - k together.
+    float z0_re = out_re[0];
+    float z0_im = out_im[0];
+    out_re[0] = z0_re + z0_im;
+    out_im[0] = 0.0f;
+    out_re[half_size] = z0_re - z0_im;
+    out_im[half_size] = 0.0f;
+
+    for (t_size index = 1; index <= half_size / 2; ++index) {
+        t_size mirror = half_size - index;
+        float a_re = out_re[index];
+        float a_im = out_im[index];
+        float b_re = out_re[mirror];
+        float b_im = -out_im[mirror];
+
+        float even_re = 0.5f * (a_re + b_re);
+        float even_im = 0.5f * (a_im + b_im);
+        float odd_re = 0.5f * (a_im - b_im);
+        float odd_im = -0.5f * (a_re - b_re);
+
+        float wr = m_real_twiddle_re[index];
+        float wi = m_real_twiddle_im[index];
+        float t_re = odd_re * wr - odd_im * wi;
+        float t_im = odd_re * wi + odd_im * wr;
+
+        out_re[index] = even_re + t_re;
+        out_im[index] = even_im + t_im;
+        out_re[mirror] = even_re - t_re;
+        out_im[mirror] = -(even_im - t_im);
+    }
+}
+
+void oscilloscope_fft_plan::inverse(float * in_re, float * in_im, float * output) const {
+    t_size half_size = m_size / 2;
+
+    // Undo the split step; the spectrum is conjugated on the way so that the forward transform can be reused.
+    float x0 = in_re[0];
+    float xm = in_re[half_size];
+    in_re[0] = 0.5f * (x0 + xm);
+    in_im[0] = -0.5f * (x0 - xm);
+
+    for (t_size index = 1; index <= half_size / 2; ++index) {
+        t_size mirror = half_size - index;
+        float a_re = in_re[index];
+        float a_im = in_im[index];
+        float b_re = in_re[mirror];
+        float b_im = -in_im[mirror];
+
+        float even_re = 0.5f * (a_re + b_re);
+        float even_im = 0.5f * (a_im + b_im);
+        float diff_re = 0.5f * (a_re - b_re);
+        float diff_im = 0.5f * (a_im - b_im);
+
+        float wr = m_real_twiddle_re[index];
+        float wi = -m_real_twiddle_im[index];
+        float odd_re = diff_re * wr - diff_im * wi;
+        float odd_im = diff_re * wi + diff_im * wr;
+
+        // Z[k] = E + iO and Z[M - k] = conj(E) + i conj(O), both stored conjugated.
+        in_re[index] = even_re - odd_im;
+        in_im[index] = -(even_im + odd_re);
+        in_re[mirror] = even_re + odd_im;
+        in_im[mirror] = -(-even_im + odd_re);
+    }
+
+    transform(in_re, in_im);
+
+    float scale = 1.0f / (float) half_size;
+    for (t_size index = 0; index < half_size; ++index) {
+        output[2 * index] = in_re[index] * scale;
+        output[2 * index + 1] = -in_im[index] * scale;
+    }
+}
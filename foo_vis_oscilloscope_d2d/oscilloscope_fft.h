@@ -0,0 +1,38 @@
+#pragma once
+
+// Real-valued FFT of a power-of-two size. A plan holds the precomputed twiddle factors, bit-reversal
+// table and analysis window for one size and is immutable after construction, so a single plan can be
+// shared by all callers. Use g_get_plan() to obtain a cached plan.
+class oscilloscope_fft_plan {
+public:
+    explicit oscilloscope_fft_plan(t_size size);
+
+    static const oscilloscope_fft_plan & g_get_plan(t_size size);
+
+    t_size get_size() const {return m_size;}
+    t_size get_bin_count() const {return m_size / 2 + 1;}
+
+    // Periodic Hann window of get_size() values, whose sum is get_size() / 2.
+    const float * get_window() const {return m_window.get_ptr();}
+
+    // Transforms get_size() real samples into get_bin_count() complex bins.
+    // out_re and out_im must hold get_bin_count() values and be 16-byte aligned.
+    void forward(const float * input, float * out_re, float * out_im) const;
+
+    // Transforms get_bin_count() complex bins back into get_size() real samples, including the 1/N scaling.
+    // in_re and in_im are used as scratch space and must be 16-byte aligned.
+    void inverse(float * in_re, float * in_im, float * output) const;
+
+private:
+    void transform(float * re, float * im) const;
+
+    t_size m_size;
+    pfc::array_t<t_uint32> m_bit_reverse;
+    pfc::mem_block_aligned_t<float> m_twiddle_re;
+    pfc::mem_block_aligned_t<float> m_twiddle_im;
+    pfc::array_t<float> m_real_twiddle_re;
+    pfc::array_t<float> m_real_twiddle_im;
+    pfc::mem_block_aligned_t<float> m_window;
+
+    PFC_CLASS_NOT_COPYABLE_EX(oscilloscope_fft_plan)
+};
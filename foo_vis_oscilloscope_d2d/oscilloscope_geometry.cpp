@@ -0,0 +1,207 @@
+#include "stdafx.h"
+
+#include "oscilloscope_geometry.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    // With the channel count known at compile time the channel loop is unrolled and the
+    // interleaved samples are read with constant strides.
+    template<t_uint32 t_channel_count>
+    void generate_vertices_template(const audio_sample * samples, t_uint32 sample_count, t_uint32 begin, t_uint32 end, const oscilloscope_channel_transform * transforms, oscilloscope_point * points) {
+        oscilloscope_channel_transform transform[t_channel_count];
+        for (t_uint32 channel_index = 0; channel_index < t_channel_count; ++channel_index) {
+            transform[channel_index] = transforms[channel_index];
+        }
+
+        for (t_uint32 sample_index = begin; sample_index < end; ++sample_index) {
+            const audio_sample * frame = samples + sample_index * t_channel_count;
+            for (t_uint32 channel_index = 0; channel_index < t_channel_count; ++channel_index) {
+                oscilloscope_point & point = points[channel_index * sample_count + sample_index];
+                point.x = transform[channel_index].m_x_offset + (float) sample_index * transform[channel_index].m_x_scale;
+                point.y = transform[channel_index].m_y_offset - (float) frame[channel_index] * transform[channel_index].m_y_scale;
+            }
+        }
+    }
+
+#if OSCILLOSCOPE_HAVE_SSE2
+    // Each iteration loads two stereo frames (L0 R0 L1 R1) into one vector, so both channels are
+    // transformed in parallel lanes and the results are split into the two traces with shuffles.
+    void generate_vertices_stereo(const float * samples, t_uint32 sample_count, t_uint32 begin, t_uint32 end, const oscilloscope_channel_transform * transforms, oscilloscope_point * points) {
+        const oscilloscope_channel_transform & left = transforms[0];
+        const oscilloscope_channel_transform & right = transforms[1];
+
+        __m128 x_scale = _mm_setr_ps(left.m_x_scale, left.m_x_scale, right.m_x_scale, right.m_x_scale);
+        __m128 x_offset = _mm_setr_ps(left.m_x_offset, left.m_x_offset, right.m_x_offset, right.m_x_offset);
+        __m128 y_scale = _mm_setr_ps(left.m_y_scale, right.m_y_scale, left.m_y_scale, right.m_y_scale);
+        __m128 y_offset = _mm_setr_ps(left.m_y_offset, right.m_y_offset, left.m_y_offset, right.m_y_offset);
+        __m128 index = _mm_setr_ps((float) begin, (float) (begin + 1), (float) begin, (float) (begin + 1));
+        __m128 index_step = _mm_set1_ps(2.0f);
+
+        oscilloscope_point * left_points = points;
+        oscilloscope_point * right_points = points + sample_count;
+
+        t_uint32 sample_index = begin;
+        for (; sample_index + 2 <= end; sample_index += 2) {
+            __m128 value = _mm_loadu_ps(samples + sample_index * 2);
+            __m128 x = _mm_add_ps(_mm_mul_ps(index, x_scale), x_offset);
+            __m128 y = _mm_sub_ps(y_offset, _mm_mul_ps(value, y_scale));
+
+            __m128 left_y = _mm_shuffle_ps(y, y, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 right_y = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 right_x = _mm_movehl_ps(x, x);
+
+            _mm_storeu_ps((float *) (left_points + sample_index), _mm_unpacklo_ps(x, left_y));
+            _mm_storeu_ps((float *) (right_points + sample_index), _mm_unpacklo_ps(right_x, right_y));
+
+            index = _mm_add_ps(index, index_step);
+        }
+
+        if (sample_index < end) {
+            left_points[sample_index].x = left.m_x_offset + (float) sample_index * left.m_x_scale;
+            left_points[sample_index].y = left.m_y_offset - (float) samples[sample_index * 2] * left.m_y_scale;
+            right_points[sample_index].x = right.m_x_offset + (float) sample_index * right.m_x_scale;
+            right_points[sample_index].y = right.m_y_offset - (float) samples[sample_index * 2 + 1] * right.m_y_scale;
+        }
+    }
+#endif
+
+    void generate_vertices_generic(const audio_sample * samples, t_uint32 channel_count, t_uint32 sample_count, t_uint32 begin, t_uint32 end, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, oscilloscope_point * points) {
+        for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+            const oscilloscope_channel_transform & transform = transforms[trace_index];
+            const audio_sample * channel_samples = samples + transform.m_channel_index;
+            oscilloscope_point * trace_points = points + trace_index * sample_count;
+            for (t_uint32 sample_index = begin; sample_index < end; ++sample_index) {
+                trace_points[sample_index].x = transform.m_x_offset + (float) sample_index * transform.m_x_scale;
+                trace_points[sample_index].y = transform.m_y_offset - (float) channel_samples[sample_index * channel_count] * transform.m_y_scale;
+            }
+        }
+    }
+
+    t_uint8 get_bucket(float value) {
+        float bucket = value * (float) oscilloscope_color_bucket_count;
+        return (t_uint8) pfc::clip_t<float>(bucket, 0.0f, (float) (oscilloscope_color_bucket_count - 1));
+    }
+
+    float get_slope(const oscilloscope_point & from, const oscilloscope_point & to) {
+        float dx = fabs(to.x - from.x);
+        float dy = fabs(to.y - from.y);
+        return dy / (dx + dy + FLT_MIN);
+    }
+
+    bool is_identity_mapping(t_uint32 channel_count, const oscilloscope_channel_transform * transforms, t_uint32 trace_count) {
+        if (trace_count != channel_count) {
+            return false;
+        }
+        for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+            if (transforms[trace_index].m_channel_index != trace_index) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void oscilloscope_generate_vertices(const oscilloscope_sample_window_view & window, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, oscilloscope_point * points) {
+    oscilloscope_generate_vertices(window, 0, window.m_sample_count, transforms, trace_count, points);
+}
+
+void oscilloscope_generate_vertices(const oscilloscope_sample_window_view & window, t_uint32 begin, t_uint32 end, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, oscilloscope_point * points) {
+    const audio_sample * samples = window.m_samples;
+    t_uint32 channel_count = window.m_channel_count;
+    t_uint32 sample_count = window.m_sample_count;
+
+    if (!is_identity_mapping(channel_count, transforms, trace_count)) {
+        generate_vertices_generic(samples, channel_count, sample_count, begin, end, transforms, trace_count, points);
+        return;
+    }
+
+    switch (channel_count) {
+    case 1:
+        generate_vertices_template<1>(samples, sample_count, begin, end, transforms, points);
+        break;
+    case 2:
+#if OSCILLOSCOPE_HAVE_SSE2
+        if (audio_sample_size == 32) {
+            generate_vertices_stereo((const float *) samples, sample_count, begin, end, transforms, points);
+            break;
+        }
+#endif
+        generate_vertices_template<2>(samples, sample_count, begin, end, transforms, points);
+        break;
+    case 6:
+        generate_vertices_template<6>(samples, sample_count, begin, end, transforms, points);
+        break;
+    case 8:
+        generate_vertices_template<8>(samples, sample_count, begin, end, transforms, points);
+        break;
+    default:
+        generate_vertices_generic(samples, channel_count, sample_count, begin, end, transforms, trace_count, points);
+        break;
+    }
+}
+
+void oscilloscope_generate_vertices_generic(const oscilloscope_sample_window_view & window, t_uint32 begin, t_uint32 end, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, oscilloscope_point * points) {
+    generate_vertices_generic(window.m_samples, window.m_channel_count, window.m_sample_count, begin, end, transforms, trace_count, points);
+}
+
+void oscilloscope_classify_vertices(const oscilloscope_point * points, t_uint32 sample_count, const oscilloscope_channel_transform & transform, t_uint32 source, t_uint8 * buckets) {
+    if (sample_count == 0) {
+        return;
+    }
+
+    float amplitude_scale = (transform.m_y_scale != 0.0f) ? 1.0f / transform.m_y_scale : 0.0f;
+    float time_scale = (sample_count > 1) ? 1.0f / (float) (sample_count - 1) : 0.0f;
+
+    t_uint32 sample_index = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+    // Four vertices at a time: their values are computed from the interleaved points, scaled to
+    // bucket indices, converted to integers and narrowed to bytes.
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    const __m128 bucket_scale = _mm_set1_ps((float) oscilloscope_color_bucket_count);
+    const __m128 max_bucket = _mm_set1_ps((float) (oscilloscope_color_bucket_count - 1));
+    const __m128 min_value = _mm_set1_ps(FLT_MIN);
+    __m128 y_offset = _mm_set1_ps(transform.m_y_offset);
+    __m128 y_scale = _mm_set1_ps(amplitude_scale);
+    __m128 time_scale_4 = _mm_set1_ps(time_scale);
+    __m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 index_step = _mm_set1_ps(4.0f);
+
+    // Slopes look one vertex ahead.
+    t_uint32 simd_end = (source == oscilloscope_color_source_slope) ? (sample_count > 4 ? sample_count - 4 : 0) : sample_count;
+    for (; sample_index + 4 <= simd_end; sample_index += 4) {
+        const float * p = (const float *) (points + sample_index);
+        __m128 value;
+        if (source == oscilloscope_color_source_amplitude) {
+            __m128 y = _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _MM_SHUFFLE(3, 1, 3, 1));
+            value = _mm_mul_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(y_offset, y)), y_scale);
+        } else if (source == oscilloscope_color_source_slope) {
+            __m128 d01 = _mm_sub_ps(_mm_loadu_ps(p + 2), _mm_loadu_ps(p));
+            __m128 d23 = _mm_sub_ps(_mm_loadu_ps(p + 6), _mm_loadu_ps(p + 4));
+            __m128 dx = _mm_andnot_ps(sign_mask, _mm_shuffle_ps(d01, d23, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128 dy = _mm_andnot_ps(sign_mask, _mm_shuffle_ps(d01, d23, _MM_SHUFFLE(3, 1, 3, 1)));
+            value = _mm_div_ps(dy, _mm_add_ps(_mm_add_ps(dx, dy), min_value));
+        } else {
+            value = _mm_mul_ps(index, time_scale_4);
+            index = _mm_add_ps(index, index_step);
+        }
+        __m128 bucket = _mm_min_ps(_mm_max_ps(_mm_mul_ps(value, bucket_scale), _mm_setzero_ps()), max_bucket);
+        __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(bucket), _mm_setzero_si128());
+        int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+        memcpy(buckets + sample_index, &bytes, 4);
+    }
+#endif
+    for (; sample_index < sample_count; ++sample_index) {
+        float value;
+        if (source == oscilloscope_color_source_amplitude) {
+            value = fabs(transform.m_y_offset - points[sample_index].y) * amplitude_scale;
+        } else if (source == oscilloscope_color_source_slope) {
+            // The last vertex starts no segment and takes the slope of the one before it.
+            t_uint32 from = (sample_index + 1 < sample_count) ? sample_index : sample_index - pfc::min_t<t_uint32>(sample_index, 1);
+            t_uint32 to = pfc::min_t<t_uint32>(from + 1, sample_count - 1);
+            value = get_slope(points[from], points[to]);
+        } else {
+            value = (float) sample_index * time_scale;
+        }
+        buckets[sample_index] = get_bucket(value);
+    }
+}
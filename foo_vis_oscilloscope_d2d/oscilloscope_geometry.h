@@ -0,0 +1,45 @@
+#pragma once
+
+#include "oscilloscope_sample_window.h"
+#include "oscilloscope_types.h"
+
+// Maps sample index i and sample value s of channel m_channel_index to the point
+// (m_x_offset + i * m_x_scale, m_y_offset - s * m_y_scale).
+struct oscilloscope_channel_transform {
+    t_uint32 m_channel_index;
+    float m_x_offset;
+    float m_x_scale;
+    float m_y_offset;
+    float m_y_scale;
+};
+
+// Computes the vertices of trace_count traces from the samples of window; trace n is drawn from
+// channel transforms[n].m_channel_index and written to points + n * window.m_sample_count. When
+// every channel is drawn once in its natural order, kernels specialized for 1, 2, 6 and 8 channels
+// are selected at run time; otherwise only the channels that are drawn are read.
+void oscilloscope_generate_vertices(const oscilloscope_sample_window_view & window, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, oscilloscope_point * points);
+
+// Computes the vertices of samples [begin, end) only. The output layout is that of the whole window,
+// so disjoint ranges can be generated independently and give the same result as a single call.
+void oscilloscope_generate_vertices(const oscilloscope_sample_window_view & window, t_uint32 begin, t_uint32 end, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, oscilloscope_point * points);
+
+// Computes the same vertices as oscilloscope_generate_vertices() with the kernel that serves any
+// mapping of channels to traces; the specialized kernels are tested and benchmarked against it.
+void oscilloscope_generate_vertices_generic(const oscilloscope_sample_window_view & window, t_uint32 begin, t_uint32 end, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, oscilloscope_point * points);
+
+// Values that the color of a trace can follow, each mapped to [0, 1] per vertex: the magnitude of
+// the sample, the steepness of the segment that starts at the vertex (0 when flat, 1 when
+// vertical), and the position of the vertex in the window.
+enum {
+    oscilloscope_color_source_amplitude = 0,
+    oscilloscope_color_source_slope,
+    oscilloscope_color_source_time,
+    oscilloscope_color_source_count
+};
+
+// Number of colors that a trace is drawn in; the value of a vertex is quantized to one of them.
+const t_uint32 oscilloscope_color_bucket_count = 16;
+
+// Computes the color bucket of each of the sample_count vertices of one trace, which were
+// generated with transform, and writes them to buckets.
+void oscilloscope_classify_vertices(const oscilloscope_point * points, t_uint32 sample_count, const oscilloscope_channel_transform & transform, t_uint32 source, t_uint8 * buckets);
@@ -0,0 +1,314 @@
+#include "stdafx.h"
+
+#include "oscilloscope_glow.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    const t_int32 g_box_pass_count = 3;
+    // Rows per band of the blur. Each band starts its running sums over, which costs another
+    // 3 radius rows at either end, so that the bands are independent of each other.
+    const t_uint32 g_band_length = 128;
+    // Rows per tile of the transpose and the conversion, and columns per block of the transpose.
+    const t_uint32 g_row_tile_length = 32;
+    // A lone trace glows with about this intensity at its center.
+    const float g_intensity = 0.8f;
+
+    // Floats of scratch for each band: a row of sums for every pass, a row of zeros, a row that
+    // takes the output of passes that have none, and the last 2 radius + 1 rows put out by every
+    // pass but the last.
+    t_size get_band_scratch_size(t_uint32 width, t_uint32 radius) {
+        return (t_size) width * (g_box_pass_count + 2 + (g_box_pass_count - 1) * (2 * radius + 1));
+    }
+
+    // Blurs rows [begin, end) of a width x height buffer, where width is a multiple of four, with
+    // g_box_pass_count box filters down the columns: each pass puts out the mean of its input from
+    // y - radius to y + radius as row y. The passes run together in a single sweep down each band.
+    // Each keeps a running sum for every column and takes in whole rows, adding the row entering
+    // the box and taking out the one leaving it, so that the buffer is read and written only once
+    // however many passes there are. The bands start at multiples of g_band_length whether or not
+    // they run in parallel, which makes the result the same.
+    struct blur_columns {
+        const float * m_in;
+        float * m_out;
+        float * m_scratch;
+        t_uint32 m_width;
+        t_uint32 m_height;
+        t_uint32 m_radius;
+
+        void operator()(t_size begin, t_size end) const {
+            PFC_TRACE_SCOPE(glow_blur);
+            for (t_size band = begin; band < end; band += g_band_length) {
+                float * scratch = m_scratch + band / g_band_length * get_band_scratch_size(m_width, m_radius);
+                blur_band((t_int32) band, (t_int32) pfc::min_t<t_size>(band + g_band_length, end), scratch);
+            }
+        }
+
+        // Pass p takes in row i at step i + p radius, and puts out row i - radius, which the next
+        // pass takes in at the same step, from a ring of the rows that are still in its box. Rows
+        // beyond the edges count as zero, at every pass. A pass with no row to take in or to put
+        // out at a step gets the row of zeros instead, so that every step is the same sweep.
+        void blur_band(t_int32 begin, t_int32 end, float * scratch) const {
+            t_uint32 width = m_width;
+            t_int32 height = (t_int32) m_height;
+            t_int32 radius = (t_int32) m_radius;
+            float * sums = scratch;
+            float * zeros = sums + (t_size) g_box_pass_count * width;
+            float * discard = zeros + width;
+            float * rings = discard + width;
+            pfc::memset_t(sums, 0.0f, (t_size) (g_box_pass_count + 1) * width);
+
+            for (t_int32 step = begin - g_box_pass_count * radius; step < end + g_box_pass_count * radius; ++step) {
+                const float * leads[g_box_pass_count];
+                const float * trails[g_box_pass_count];
+                float * outs[g_box_pass_count];
+                for (t_int32 pass = 0; pass < g_box_pass_count; ++pass) {
+                    // The first row that pass takes in is in the box of row begin when that comes
+                    // out of the last pass.
+                    t_int32 row = step - pass * radius;
+                    t_int32 first = begin - (g_box_pass_count - pass) * radius;
+                    bool running = row >= first + 2 * radius;
+                    t_int32 out_row = row - radius;
+                    t_int32 trail_row = row - 2 * radius;
+                    leads[pass] = (row >= first && row >= 0 && row < height) ? get_input(pass, row, rings) : zeros;
+                    trails[pass] = (running && trail_row >= 0 && trail_row < height) ? get_input(pass, trail_row, rings) : zeros;
+                    outs[pass] = discard;
+                    if (running && out_row >= 0 && out_row < height) {
+                        outs[pass] = (pass + 1 < g_box_pass_count) ? get_ring_row(pass, out_row, rings) : m_out + (t_size) out_row * width;
+                    }
+                }
+                blur_row(sums, leads, trails, outs);
+            }
+        }
+
+        // Runs one step of every pass, a vector of columns at a time, in order, as each pass takes
+        // in what the one before has just put out.
+        void blur_row(float * sums, const float * const * leads, const float * const * trails, float * const * outs) const {
+            t_uint32 width = m_width;
+            float scale = 1.0f / (float) (2 * m_radius + 1);
+            t_uint32 x = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+            __m128 k = _mm_set1_ps(scale);
+            for (; x < width; x += 4) {
+                for (t_int32 pass = 0; pass < g_box_pass_count; ++pass) {
+                    float * sum = sums + (t_size) pass * width + x;
+                    __m128 value = _mm_add_ps(_mm_load_ps(sum), _mm_load_ps(leads[pass] + x));
+                    _mm_store_ps(outs[pass] + x, _mm_mul_ps(value, k));
+                    _mm_store_ps(sum, _mm_sub_ps(value, _mm_load_ps(trails[pass] + x)));
+                }
+            }
+#endif
+            for (; x < width; ++x) {
+                for (t_int32 pass = 0; pass < g_box_pass_count; ++pass) {
+                    float * sum = sums + (t_size) pass * width + x;
+                    float value = *sum + leads[pass][x];
+                    outs[pass][x] = value * scale;
+                    *sum = value - trails[pass][x];
+                }
+            }
+        }
+
+        const float * get_input(t_int32 pass, t_int32 row, float * rings) const {
+            return (pass == 0) ? m_in + (t_size) row * m_width : get_ring_row(pass - 1, row, rings);
+        }
+
+        float * get_ring_row(t_int32 pass, t_int32 row, float * rings) const {
+            t_int32 span = 2 * (t_int32) m_radius + 1;
+            return rings + ((t_size) pass * span + row % span) * m_width;
+        }
+    };
+
+    // Transposes rows [begin, end) of a width x height buffer into a height x width one, in
+    // blocks of 4 x 4; both sizes are multiples of four. The blocks are taken g_row_tile_length
+    // columns at a time, so that the rows being written stay in the cache.
+    struct transpose_rows {
+        const float * m_in;
+        float * m_out;
+        t_uint32 m_width;
+        t_uint32 m_height;
+
+        void operator()(t_size begin, t_size end) const {
+            PFC_TRACE_SCOPE(glow_transpose);
+            t_uint32 width = m_width;
+            t_uint32 height = m_height;
+            for (t_uint32 column = 0; column < width; column += g_row_tile_length) {
+                t_uint32 column_end = pfc::min_t<t_uint32>(column + g_row_tile_length, width);
+                for (t_uint32 y = (t_uint32) begin; y < (t_uint32) end; y += 4) {
+                    for (t_uint32 x = column; x < column_end; x += 4) {
+                        transpose_block(m_in + (t_size) y * width + x, m_out + (t_size) x * height + y);
+                    }
+                }
+            }
+        }
+
+        void transpose_block(const float * in, float * out) const {
+            t_uint32 width = m_width;
+            t_uint32 height = m_height;
+#if OSCILLOSCOPE_HAVE_SSE2
+            __m128 row0 = _mm_load_ps(in);
+            __m128 row1 = _mm_load_ps(in + width);
+            __m128 row2 = _mm_load_ps(in + 2 * width);
+            __m128 row3 = _mm_load_ps(in + 3 * width);
+            _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+            _mm_store_ps(out, row0);
+            _mm_store_ps(out + height, row1);
+            _mm_store_ps(out + 2 * height, row2);
+            _mm_store_ps(out + 3 * height, row3);
+#else
+            for (t_uint32 row = 0; row < 4; ++row) {
+                for (t_uint32 column = 0; column < 4; ++column) {
+                    out[(t_size) column * height + row] = in[(t_size) row * width + column];
+                }
+            }
+#endif
+        }
+    };
+
+    // Turns the intensities of rows [begin, end) into premultiplied BGRA pixels of color. The
+    // running sums can leave intensities a rounding error below zero.
+    struct convert_rows {
+        const float * m_in;
+        t_uint32 * m_out;
+        t_uint32 m_width;
+        float m_gain;
+        D2D1_COLOR_F m_color;
+
+        void operator()(t_size begin, t_size end) const {
+            PFC_TRACE_SCOPE(glow_convert);
+            t_size first = begin * m_width;
+            t_size last = end * m_width;
+            t_size index = first;
+#if OSCILLOSCOPE_HAVE_SSE2
+            __m128 gain = _mm_set1_ps(m_gain);
+            __m128 zero = _mm_setzero_ps();
+            __m128 one = _mm_set1_ps(1.0f);
+            __m128 blue = _mm_set1_ps(m_color.b * 255.0f);
+            __m128 green = _mm_set1_ps(m_color.g * 255.0f);
+            __m128 red = _mm_set1_ps(m_color.r * 255.0f);
+            __m128 alpha = _mm_set1_ps(255.0f);
+            __m128 half = _mm_set1_ps(0.5f);
+            for (; index < last; index += 4) {
+                __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_load_ps(m_in + index), gain), zero), one);
+                __m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, blue), half));
+                __m128i g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, green), half));
+                __m128i r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, red), half));
+                __m128i w = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, alpha), half));
+                __m128i pixel = _mm_or_si128(_mm_or_si128(b, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(w, 24)));
+                _mm_store_si128((__m128i *) (m_out + index), pixel);
+            }
+#endif
+            for (; index < last; ++index) {
+                float a = pfc::min_t<float>(pfc::max_t<float>(m_in[index] * m_gain, 0.0f), 1.0f);
+                t_uint32 b = (t_uint32) (a * m_color.b * 255.0f + 0.5f);
+                t_uint32 g = (t_uint32) (a * m_color.g * 255.0f + 0.5f);
+                t_uint32 r = (t_uint32) (a * m_color.r * 255.0f + 0.5f);
+                t_uint32 w = (t_uint32) (a * 255.0f + 0.5f);
+                m_out[index] = b | (g << 8) | (r << 16) | (w << 24);
+            }
+        }
+    };
+
+    template<typename t_func>
+    void run_tiles(pfc::threadPool * pool, t_size end, t_size tile_length, const t_func & func) {
+        if (pool != nullptr) {
+            pool->parallelFor(0, end, tile_length, func);
+        } else {
+            func(0, end);
+        }
+    }
+}
+
+oscilloscope_glow::oscilloscope_glow()
+    : m_width(0)
+    , m_height(0)
+    , m_padded_width(0)
+    , m_padded_height(0)
+{
+}
+
+void oscilloscope_glow::render(const D2D1_POINT_2F * points, t_uint32 trace_count, t_uint32 sample_count, D2D1_SIZE_U size, float radius, const D2D1_COLOR_F & color, pfc::threadPool * pool) {
+    PFC_TRACE_SCOPE(glow);
+    m_width = (size.width + 1) / 2;
+    m_height = (size.height + 1) / 2;
+    m_padded_width = (m_width + 3) & ~3u;
+    m_padded_height = (m_height + 3) & ~3u;
+    t_size buffer_size = (t_size) m_padded_width * m_padded_height;
+    if (m_buffer.get_size() < buffer_size) {
+        m_buffer.set_size(buffer_size);
+        m_scratch.set_size(buffer_size);
+        m_pixels.set_size(buffer_size);
+    }
+    if (buffer_size == 0) {
+        return;
+    }
+
+    splat(points, trace_count, sample_count);
+
+    // The width of three boxes of 2 r + 1 pixels whose variance adds up to that of the Gaussian.
+    float sigma = radius / 2.0f;
+    t_uint32 box_radius = pfc::max_t<t_uint32>((t_uint32) ((sqrt(4.0f * sigma * sigma + 1.0f) - 1.0f) / 2.0f + 0.5f), 1);
+
+    // Scratch for every band, whichever way the buffer is turned.
+    t_uint32 longer = pfc::max_t<t_uint32>(m_padded_width, m_padded_height);
+    t_size band_scratch_size = get_band_scratch_size(longer, box_radius) * ((longer + g_band_length - 1) / g_band_length);
+    if (m_band_scratch.get_size() < band_scratch_size) {
+        m_band_scratch.set_size(band_scratch_size);
+    }
+
+    // The columns are blurred from m_buffer into m_scratch and turned back into m_buffer, and then
+    // the rows, as the columns of the transposed buffer.
+    float * buffer = m_buffer.get_ptr();
+    float * scratch = m_scratch.get_ptr();
+    for (t_uint32 direction = 0; direction < 2; ++direction) {
+        t_uint32 width = direction == 0 ? m_padded_width : m_padded_height;
+        t_uint32 height = direction == 0 ? m_padded_height : m_padded_width;
+        blur_columns blur = {buffer, scratch, m_band_scratch.get_ptr(), width, height, box_radius};
+        run_tiles(pool, height, g_band_length, blur);
+        transpose_rows transpose = {scratch, buffer, width, height};
+        run_tiles(pool, height, g_row_tile_length, transpose);
+    }
+
+    // The peak of a blurred line of unit intensity is about 1 / (sigma sqrt(2 pi)).
+    convert_rows convert = {buffer, m_pixels.get_ptr(), m_padded_width, g_intensity * pfc::max_t<float>(sigma, 0.5f) * 2.5066283f, color};
+    run_tiles(pool, m_padded_height, g_row_tile_length, convert);
+}
+
+// Draws each segment into the intensity buffer as dots about a pixel apart, each weighing the
+// length of the segment that it stands for.
+void oscilloscope_glow::splat(const D2D1_POINT_2F * points, t_uint32 trace_count, t_uint32 sample_count) {
+    PFC_TRACE_SCOPE(glow_splat);
+    float * buffer = m_buffer.get_ptr();
+    pfc::memset_t(buffer, 0.0f, (t_size) m_padded_width * m_padded_height);
+    if (sample_count == 0) {
+        return;
+    }
+
+    float width = (float) m_width;
+    float height = (float) m_height;
+    for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+        const D2D1_POINT_2F * trace = points + (t_size) trace_index * sample_count;
+        float x0 = trace[0].x * 0.5f;
+        float y0 = trace[0].y * 0.5f;
+        for (t_uint32 sample_index = 1; sample_index < sample_count; ++sample_index) {
+            float x1 = trace[sample_index].x * 0.5f;
+            float y1 = trace[sample_index].y * 0.5f;
+            float dx = x1 - x0;
+            float dy = y1 - y0;
+            float length = sqrt(dx * dx + dy * dy);
+            // Segments that reach far beyond the buffer, such as from clipped samples at a high
+            // zoom, are stepped no more finely than it takes to cross the buffer.
+            float extent = pfc::min_t<float>(pfc::max_t<float>(fabs(dx), fabs(dy)), width + height);
+            t_uint32 step_count = pfc::max_t<t_uint32>((t_uint32) extent, 1);
+            float weight = length / (float) step_count;
+            for (t_uint32 step = 0; step < step_count; ++step) {
+                float t = ((float) step + 0.5f) / (float) step_count;
+                float x = x0 + dx * t;
+                float y = y0 + dy * t;
+                if (x >= 0.0f && x < width && y >= 0.0f && y < height) {
+                    buffer[(t_size) y * m_padded_width + (t_size) x] += weight;
+                }
+            }
+            x0 = x1;
+            y0 = y1;
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Glow around the traces, as of the phosphor of an analog scope. The traces are drawn into an
+// intensity buffer at half the resolution of the target, which is blurred with three box filters
+// in each direction, close to a Gaussian, and turned into premultiplied BGRA pixels of one color to
+// be drawn under the traces. Each box filter is a running sum, so its cost per pixel does not
+// depend on the radius. The three filters down the columns run together in one sweep over bands of
+// whole rows, four columns to a vector; the rows are filtered as the columns of the transposed
+// buffer. Every step is split into tiles that run on a thread pool.
+class oscilloscope_glow {
+public:
+    oscilloscope_glow();
+
+    // Draws the glow of trace_count traces of sample_count vertices each, which follow each other
+    // in points, for a target of size. radius is the standard deviation of the blur in pixels of
+    // the target. The tiles run on pool, if not null.
+    void render(const D2D1_POINT_2F * points, t_uint32 trace_count, t_uint32 sample_count, D2D1_SIZE_U size, float radius, const D2D1_COLOR_F & color, pfc::threadPool * pool);
+
+    // Returns the pixels of the last render(), get_stride() apart from one row to the next.
+    const t_uint32 * get_pixels() const {return m_pixels.get_ptr();}
+    t_uint32 get_width() const {return m_width;}
+    t_uint32 get_height() const {return m_height;}
+    t_uint32 get_stride() const {return m_padded_width;}
+
+private:
+    void splat(const D2D1_POINT_2F * points, t_uint32 trace_count, t_uint32 sample_count);
+
+    // Size of the intensity buffer, and the same rounded up to multiples of four. The padding is
+    // zero, like everything beyond the edges.
+    t_uint32 m_width;
+    t_uint32 m_height;
+    t_uint32 m_padded_width;
+    t_uint32 m_padded_height;
+
+    // The passes go back and forth between the two buffers.
+    pfc::mem_block_aligned_t<float> m_buffer;
+    pfc::mem_block_aligned_t<float> m_scratch;
+    pfc::mem_block_aligned_t<float> m_band_scratch;
+    pfc::mem_block_aligned_t<t_uint32> m_pixels;
+};
@@ -0,0 +1,359 @@
+#include "stdafx.h"
+
+#include "oscilloscope_overview.h"
+
+namespace {
+    t_uint32 read_le16(const t_uint8 * p) {
+        return (t_uint32) p[0] | ((t_uint32) p[1] << 8);
+    }
+
+    t_uint32 read_le32(const t_uint8 * p) {
+        return (t_uint32) p[0] | ((t_uint32) p[1] << 8) | ((t_uint32) p[2] << 16) | ((t_uint32) p[3] << 24);
+    }
+
+    // Cache files are only ever read on the machine that wrote them, so they are stored in native
+    // byte order. The magic number is written last, so that a partially written file is rejected.
+    const t_uint32 g_cache_magic = 0x5643534f; // "OSCV"
+    const t_uint32 g_cache_version = 1;
+    const t_uint32 g_max_channel_count = 256;
+
+    struct cache_header {
+        t_uint32 m_magic;
+        t_uint32 m_version;
+        t_uint32 m_channel_count;
+        t_uint32 m_sample_rate;
+        t_uint64 m_sample_count;
+        t_uint64 m_key_timestamp;
+        t_uint32 m_key_path_length;
+        t_uint32 m_reserved;
+    };
+
+    // The header is followed by the key path, padded to 8 bytes, and then by the levels, each
+    // holding the buckets of all channels of one block after another.
+    t_size get_cache_layout(t_uint64 sample_count, t_uint32 channel_count, t_size key_path_length, pfc::array_t<t_size> & level_offsets) {
+        t_size offset = (sizeof(cache_header) + key_path_length + 7) & ~(t_size) 7;
+        t_uint64 bucket_count = (sample_count + oscilloscope_overview::block_length - 1) / oscilloscope_overview::block_length;
+        t_uint32 level_count = 1;
+        for (t_uint64 count = bucket_count; count > 1; count = (count + 1) / 2) {
+            ++level_count;
+        }
+
+        level_offsets.set_size(level_count);
+        for (t_uint32 level = 0; level < level_count; ++level) {
+            level_offsets[level] = offset;
+            offset += (t_size) bucket_count * channel_count * 4;
+            bucket_count = (bucket_count + 1) / 2;
+        }
+        return offset;
+    }
+
+    // Rounds outwards, so that the stored envelope never hides a peak.
+    t_int16 quantize_min(audio_sample value) {
+        return (t_int16) floor(pfc::clip_t<audio_sample>(value, -1, 1) * 32767);
+    }
+
+    t_int16 quantize_max(audio_sample value) {
+        return (t_int16) ceil(pfc::clip_t<audio_sample>(value, -1, 1) * 32767);
+    }
+}
+
+oscilloscope_overview_wav_source::oscilloscope_overview_wav_source()
+    : m_data(nullptr)
+    , m_frame_count(0)
+    , m_position(0)
+    , m_channel_count(0)
+    , m_sample_rate(0)
+    , m_bits_per_sample(0)
+    , m_float(false)
+{
+}
+
+bool oscilloscope_overview_wav_source::open(const char * path) {
+    m_data = nullptr;
+    if (!m_file.open(path)) {
+        return false;
+    }
+
+    const t_uint8 * file = static_cast<const t_uint8 *>(m_file.data());
+    t_size size = m_file.size();
+    if (size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    bool have_format = false;
+    t_uint32 format_tag = 0;
+    t_uint32 block_align = 0;
+    for (t_size offset = 12; offset + 8 <= size;) {
+        const t_uint8 * chunk = file + offset;
+        t_size chunk_size = pfc::min_t<t_size>(read_le32(chunk + 4), size - offset - 8);
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16) {
+            format_tag = read_le16(chunk + 8);
+            m_channel_count = read_le16(chunk + 10);
+            m_sample_rate = read_le32(chunk + 12);
+            block_align = read_le16(chunk + 20);
+            m_bits_per_sample = read_le16(chunk + 22);
+            // WAVE_FORMAT_EXTENSIBLE keeps the actual format tag in the first bytes of its subformat GUID.
+            if (format_tag == 0xfffe && chunk_size >= 40) {
+                format_tag = read_le16(chunk + 32);
+            }
+            have_format = true;
+        } else if (memcmp(chunk, "data", 4) == 0 && have_format) {
+            m_float = format_tag == 3;
+            bool supported = (format_tag == 1 && (m_bits_per_sample == 8 || m_bits_per_sample == 16 || m_bits_per_sample == 24 || m_bits_per_sample == 32))
+                || (m_float && m_bits_per_sample == 32);
+            if (!supported || m_channel_count == 0 || block_align != m_channel_count * (m_bits_per_sample / 8)) {
+                return false;
+            }
+            m_data = chunk + 8;
+            m_frame_count = chunk_size / block_align;
+            m_position = 0;
+            return true;
+        }
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+    return false;
+}
+
+t_size oscilloscope_overview_wav_source::read(audio_sample * out, t_size max_frame_count) {
+    t_size frame_count = pfc::min_t<t_size>(max_frame_count, m_frame_count - m_position);
+    t_size bytes_per_sample = m_bits_per_sample / 8;
+    const t_uint8 * in = m_data + m_position * m_channel_count * bytes_per_sample;
+    t_size sample_count = frame_count * m_channel_count;
+
+    for (t_size index = 0; index < sample_count; ++index, in += bytes_per_sample) {
+        switch (m_bits_per_sample) {
+        case 8:
+            out[index] = (audio_sample) ((int) in[0] - 128) * (audio_sample) (1.0 / 128);
+            break;
+        case 16:
+            out[index] = (audio_sample) (t_int16) read_le16(in) * (audio_sample) (1.0 / 32768);
+            break;
+        case 24:
+            out[index] = (audio_sample) ((t_int32) (((t_uint32) in[0] << 8) | ((t_uint32) in[1] << 16) | ((t_uint32) in[2] << 24)) >> 8) * (audio_sample) (1.0 / 8388608);
+            break;
+        default:
+            if (m_float) {
+                t_uint32 bits = read_le32(in);
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                out[index] = (audio_sample) value;
+            } else {
+                out[index] = (audio_sample) (t_int32) read_le32(in) * (audio_sample) (1.0 / 2147483648.0);
+            }
+            break;
+        }
+    }
+
+    m_position += frame_count;
+    return frame_count;
+}
+
+oscilloscope_overview::oscilloscope_overview()
+    : m_data(nullptr)
+    , m_channel_count(0)
+    , m_sample_rate(0)
+    , m_sample_count(0)
+{
+}
+
+void oscilloscope_overview::reset() {
+    m_data = nullptr;
+    m_file.close();
+    m_memory.set_size(0);
+}
+
+bool oscilloscope_overview::open(const char * path, const char * key_path, t_uint64 key_timestamp) {
+    reset();
+    if (m_file.open(path) && attach(static_cast<const t_uint8 *>(m_file.data()), m_file.size(), key_path, key_timestamp)) {
+        return true;
+    }
+    m_file.close();
+    return false;
+}
+
+bool oscilloscope_overview::build(oscilloscope_overview_source & source, const char * path, const char * key_path, t_uint64 key_timestamp) {
+    reset();
+
+    t_uint32 channel_count = source.get_channel_count();
+    if (channel_count == 0 || channel_count > g_max_channel_count) {
+        return false;
+    }
+
+    // Level 0 is collected while decoding, as the length of the track is not known up front.
+    pfc::array_t<bucket, pfc::alloc_fast_aggressive> blocks;
+    pfc::array_t<audio_sample> block_min, block_max;
+    block_min.set_size(channel_count);
+    block_max.set_size(channel_count);
+    t_size block_fill = 0;
+    t_uint64 sample_count = 0;
+
+    const t_size read_length = 16 * block_length;
+    pfc::array_t<audio_sample> buffer;
+    buffer.set_size(read_length * channel_count);
+
+    for (;;) {
+        t_size frame_count = source.read(buffer.get_ptr(), read_length);
+        if (frame_count == 0) {
+            break;
+        }
+        sample_count += frame_count;
+
+        const audio_sample * in = buffer.get_ptr();
+        for (t_size frame_index = 0; frame_index < frame_count; ++frame_index, in += channel_count) {
+            if (block_fill == 0) {
+                for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+                    block_min[channel] = block_max[channel] = in[channel];
+                }
+            } else {
+                for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+                    block_min[channel] = pfc::min_t(block_min[channel], in[channel]);
+                    block_max[channel] = pfc::max_t(block_max[channel], in[channel]);
+                }
+            }
+
+            if (++block_fill == block_length) {
+                t_size offset = blocks.get_size();
+                blocks.set_size(offset + channel_count);
+                for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+                    blocks[offset + channel].m_min = quantize_min(block_min[channel]);
+                    blocks[offset + channel].m_max = quantize_max(block_max[channel]);
+                }
+                block_fill = 0;
+            }
+        }
+    }
+
+    if (block_fill > 0) {
+        t_size offset = blocks.get_size();
+        blocks.set_size(offset + channel_count);
+        for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+            blocks[offset + channel].m_min = quantize_min(block_min[channel]);
+            blocks[offset + channel].m_max = quantize_max(block_max[channel]);
+        }
+    }
+
+    if (sample_count == 0) {
+        return false;
+    }
+
+    t_size key_path_length = strlen(key_path);
+    pfc::array_t<t_size> level_offsets;
+    t_size size = get_cache_layout(sample_count, channel_count, key_path_length, level_offsets);
+
+    m_memory.set_size(size);
+    t_uint8 * image = m_memory.get_ptr();
+    memset(image, 0, size);
+
+    cache_header header = {};
+    header.m_version = g_cache_version;
+    header.m_channel_count = channel_count;
+    header.m_sample_rate = source.get_sample_rate();
+    header.m_sample_count = sample_count;
+    header.m_key_timestamp = key_timestamp;
+    header.m_key_path_length = (t_uint32) key_path_length;
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), key_path, key_path_length);
+
+    memcpy(image + level_offsets[0], blocks.get_ptr(), blocks.get_size() * sizeof(bucket));
+    t_size bucket_count = blocks.get_size() / channel_count;
+    for (t_size level = 1; level < level_offsets.get_size(); ++level) {
+        const bucket * in = reinterpret_cast<const bucket *>(image + level_offsets[level - 1]);
+        bucket * out = reinterpret_cast<bucket *>(image + level_offsets[level]);
+        for (t_size index = 0; index < bucket_count; index += 2) {
+            const bucket * first = in + index * channel_count;
+            const bucket * second = (index + 1 < bucket_count) ? first + channel_count : first;
+            for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+                out->m_min = pfc::min_t(first[channel].m_min, second[channel].m_min);
+                out->m_max = pfc::max_t(first[channel].m_max, second[channel].m_max);
+                ++out;
+            }
+        }
+        bucket_count = (bucket_count + 1) / 2;
+    }
+
+    header.m_magic = g_cache_magic;
+    if (path != nullptr) {
+        pfc::fileMapping file;
+        if (file.create(path, size)) {
+            memcpy(file.data(), image, size);
+            if (file.flush()) {
+                memcpy(file.data(), &header, sizeof(header));
+                file.flush();
+            }
+        }
+    }
+    memcpy(image, &header, sizeof(header));
+
+    return attach(image, size, key_path, key_timestamp);
+}
+
+bool oscilloscope_overview::attach(const t_uint8 * data, t_size size, const char * key_path, t_uint64 key_timestamp) {
+    cache_header header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    t_size key_path_length = strlen(key_path);
+    if (header.m_magic != g_cache_magic || header.m_version != g_cache_version
+        || header.m_key_timestamp != key_timestamp || header.m_key_path_length != key_path_length
+        || header.m_channel_count == 0 || header.m_channel_count > g_max_channel_count || header.m_sample_count == 0
+        || size < sizeof(header) + key_path_length || memcmp(data + sizeof(header), key_path, key_path_length) != 0) {
+        return false;
+    }
+
+    if (get_cache_layout(header.m_sample_count, header.m_channel_count, key_path_length, m_level_offsets) != size) {
+        return false;
+    }
+
+    m_data = data;
+    m_channel_count = header.m_channel_count;
+    m_sample_rate = header.m_sample_rate;
+    m_sample_count = header.m_sample_count;
+    return true;
+}
+
+t_uint64 oscilloscope_overview::get_bucket_count(t_uint32 level) const {
+    t_uint64 block_count = (m_sample_count + block_length - 1) / block_length;
+    return (block_count + ((t_uint64) 1 << level) - 1) >> level;
+}
+
+bool oscilloscope_overview::get_range(t_uint32 channel, t_uint64 begin, t_uint64 end, float & out_min, float & out_max) const {
+    end = pfc::min_t(end, m_sample_count);
+    if (m_data == nullptr || channel >= m_channel_count || begin >= end) {
+        return false;
+    }
+
+    // The range spans at most three buckets of the chosen level.
+    t_uint32 level = 0;
+    while (level + 1 < m_level_offsets.get_size() && ((t_uint64) block_length << (level + 1)) <= end - begin) {
+        ++level;
+    }
+
+    t_uint64 bucket_length = (t_uint64) block_length << level;
+    t_uint64 first = begin / bucket_length;
+    t_uint64 last = pfc::min_t(get_bucket_count(level), (end - 1) / bucket_length + 1);
+
+    const bucket * buckets = get_level(level);
+    int range_min = 32767;
+    int range_max = -32767;
+    for (t_uint64 index = first; index < last; ++index) {
+        const bucket & b = buckets[(t_size) index * m_channel_count + channel];
+        range_min = pfc::min_t<int>(range_min, b.m_min);
+        range_max = pfc::max_t<int>(range_max, b.m_max);
+    }
+
+    out_min = (float) range_min * (1.0f / 32767);
+    out_max = (float) range_max * (1.0f / 32767);
+    return true;
+}
+
+void oscilloscope_overview::g_get_cache_file_name(const char * key_path, pfc::string_base & out) {
+    // 64-bit FNV-1a; collisions are caught by the key stored in the file.
+    t_uint64 hash = 0xcbf29ce484222325ull;
+    for (const char * p = key_path; *p != 0; ++p) {
+        hash = (hash ^ (t_uint8) *p) * 0x100000001b3ull;
+    }
+    out.reset();
+    out << pfc::format_hex(hash, 16) << ".overview";
+}
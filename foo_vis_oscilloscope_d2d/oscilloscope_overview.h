@@ -0,0 +1,99 @@
+#pragma once
+
+// Decoded audio of a whole track, read once from start to end to build its overview.
+class oscilloscope_overview_source {
+public:
+    virtual ~oscilloscope_overview_source() {}
+
+    virtual t_uint32 get_channel_count() = 0;
+    virtual t_uint32 get_sample_rate() = 0;
+
+    // Reads up to max_frame_count frames of interleaved samples into out. Returns the number of
+    // frames read, 0 at the end of the track. May throw to abort the build.
+    virtual t_size read(audio_sample * out, t_size max_frame_count) = 0;
+};
+
+// Reads 8, 16, 24 and 32 bit integer or 32 bit float PCM WAV files directly, without going through
+// the decoders of foobar2000, for tools and tests.
+class oscilloscope_overview_wav_source : public oscilloscope_overview_source {
+public:
+    oscilloscope_overview_wav_source();
+
+    // Returns false if path is not a WAV file of a supported format.
+    bool open(const char * path);
+
+    virtual t_uint32 get_channel_count() {return m_channel_count;}
+    virtual t_uint32 get_sample_rate() {return m_sample_rate;}
+    virtual t_size read(audio_sample * out, t_size max_frame_count);
+
+private:
+    pfc::fileMapping m_file;
+    const t_uint8 * m_data;
+    t_size m_frame_count;
+    t_size m_position;
+    t_uint32 m_channel_count;
+    t_uint32 m_sample_rate;
+    t_uint32 m_bits_per_sample;
+    bool m_float;
+};
+
+// Minimum and maximum envelope of every channel of a track, as a pyramid of levels: level 0
+// summarizes blocks of block_length samples, and each further level pairs of buckets of the level
+// below, up to a single bucket for the whole track.
+//
+// The pyramid is stored in a compact cache file, keyed by the path and modification time of the
+// track, and laid out so that it can be used directly from a memory mapping of that file.
+class oscilloscope_overview {
+public:
+    enum {
+        block_length = 256
+    };
+
+    oscilloscope_overview();
+
+    // Maps the cache file at path, if it holds the overview of key_path as of key_timestamp.
+    bool open(const char * path, const char * key_path, t_uint64 key_timestamp);
+
+    // Reads source to the end and builds the overview. If path is not null the result is also
+    // stored there, for open(); failing to do so only costs the next build. Returns false for a
+    // source without samples.
+    bool build(oscilloscope_overview_source & source, const char * path, const char * key_path, t_uint64 key_timestamp);
+
+    // Unmaps or frees the overview.
+    void reset();
+
+    bool is_valid() const {return m_data != nullptr;}
+
+    t_uint32 get_channel_count() const {return m_channel_count;}
+    t_uint32 get_sample_rate() const {return m_sample_rate;}
+    t_uint64 get_sample_count() const {return m_sample_count;}
+
+    // Finds the minimum and maximum of channel over samples [begin, end), from the coarsest level
+    // that still resolves the range. Returns false for an empty range.
+    bool get_range(t_uint32 channel, t_uint64 begin, t_uint64 end, float & out_min, float & out_max) const;
+
+    // Name of the cache file of key_path within the cache folder. Tracks that change keep their
+    // name, so that the new overview replaces the old one.
+    static void g_get_cache_file_name(const char * key_path, pfc::string_base & out);
+
+private:
+    struct bucket {
+        t_int16 m_min;
+        t_int16 m_max;
+    };
+
+    bool attach(const t_uint8 * data, t_size size, const char * key_path, t_uint64 key_timestamp);
+    const bucket * get_level(t_uint32 level) const {return reinterpret_cast<const bucket *>(m_data + m_level_offsets[level]);}
+    t_uint64 get_bucket_count(t_uint32 level) const;
+
+    pfc::fileMapping m_file;
+    pfc::array_t<t_uint8> m_memory;
+
+    const t_uint8 * m_data;
+    t_uint32 m_channel_count;
+    t_uint32 m_sample_rate;
+    t_uint64 m_sample_count;
+    pfc::array_t<t_size> m_level_offsets;
+
+    PFC_CLASS_NOT_COPYABLE_EX(oscilloscope_overview)
+};
@@ -0,0 +1,136 @@
+#include "stdafx.h"
+
+#include "oscilloscope_overview_loader.h"
+
+namespace {
+    // Decodes a track from start to end. A change of format within the track is treated as its end.
+    class overview_input_source : public oscilloscope_overview_source {
+    public:
+        overview_input_source(const metadb_handle_ptr & track, abort_callback & abort);
+
+        virtual t_uint32 get_channel_count() {return m_channel_count;}
+        virtual t_uint32 get_sample_rate() {return m_sample_rate;}
+        virtual t_size read(audio_sample * out, t_size max_frame_count);
+
+    private:
+        input_helper m_decoder;
+        abort_callback & m_abort;
+        audio_chunk_impl m_decoded;
+        t_size m_decoded_position;
+        t_uint32 m_channel_count;
+        t_uint32 m_sample_rate;
+    };
+
+    overview_input_source::overview_input_source(const metadb_handle_ptr & track, abort_callback & abort)
+        : m_abort(abort)
+        , m_decoded_position(0)
+        , m_channel_count(0)
+        , m_sample_rate(0)
+    {
+        m_decoder.open(service_ptr_t<file>(), track, input_flag_simpledecode, abort);
+        if (m_decoder.run(m_decoded, abort)) {
+            m_channel_count = m_decoded.get_channel_count();
+            m_sample_rate = m_decoded.get_sample_rate();
+        }
+    }
+
+    t_size overview_input_source::read(audio_sample * out, t_size max_frame_count) {
+        while (m_channel_count > 0 && m_decoded_position >= m_decoded.get_sample_count()) {
+            if (!m_decoder.run(m_decoded, m_abort) || m_decoded.get_channel_count() != m_channel_count || m_decoded.get_sample_rate() != m_sample_rate) {
+                m_channel_count = 0;
+            }
+            m_decoded_position = 0;
+        }
+        if (m_channel_count == 0) {
+            return 0;
+        }
+
+        t_size frame_count = pfc::min_t<t_size>(max_frame_count, m_decoded.get_sample_count() - m_decoded_position);
+        memcpy(out, m_decoded.get_data() + m_decoded_position * m_channel_count, frame_count * m_channel_count * sizeof(audio_sample));
+        m_decoded_position += frame_count;
+        return frame_count;
+    }
+}
+
+oscilloscope_overview_loader::oscilloscope_overview_loader() : m_ready(false) {}
+
+oscilloscope_overview_loader::~oscilloscope_overview_loader() {
+    reset();
+}
+
+void oscilloscope_overview_loader::request(const metadb_handle_ptr & track) {
+    if (track == m_track) {
+        return;
+    }
+
+    reset();
+
+    // Streams have no end to decode to.
+    if (track->get_length() <= 0 || filesystem::g_is_remote_or_unrecognized(track->get_path())) {
+        return;
+    }
+
+    m_track = track;
+    m_abort.reset();
+    start();
+}
+
+void oscilloscope_overview_loader::reset() {
+    if (m_track.is_empty()) {
+        return;
+    }
+
+    m_abort.abort();
+    waitTillDone();
+    m_track.release();
+    m_overview.reset();
+    m_ready = false;
+}
+
+const oscilloscope_overview * oscilloscope_overview_loader::get_overview() {
+    pfc::mutexScope scope(m_lock);
+    return m_ready ? &m_overview : nullptr;
+}
+
+void oscilloscope_overview_loader::threadProc() {
+    try {
+        // Tracks of one file, as in cue sheets, are told apart by their subsong index.
+        pfc::string8 key_path;
+        key_path << m_track->get_path() << "|" << m_track->get_subsong_index();
+
+        t_filestats stats = m_track->get_filestats();
+        if (stats.m_timestamp == filetimestamp_invalid) {
+            bool is_writeable;
+            filesystem::g_get_stats(m_track->get_path(), stats, is_writeable, m_abort);
+        }
+
+        // Cache files can only be mapped if the profile folder is on a local disk.
+        pfc::string8 cache_path;
+        pfc::string8 folder = core_api::pathInProfile("foo_vis_oscilloscope_d2d-overview");
+        if (filesystem::g_get_native_path(folder, cache_path)) {
+            try {
+                filesystem::g_create_directory(folder, m_abort);
+            } catch (exception_io_already_exists) {
+            }
+            pfc::string8 file_name;
+            oscilloscope_overview::g_get_cache_file_name(key_path, file_name);
+            cache_path.add_filename(file_name);
+        } else {
+            cache_path.reset();
+        }
+
+        bool loaded = !cache_path.is_empty() && m_overview.open(cache_path, key_path, stats.m_timestamp);
+        if (!loaded) {
+            overview_input_source source(m_track, m_abort);
+            loaded = m_overview.build(source, cache_path.is_empty() ? nullptr : cache_path.get_ptr(), key_path, stats.m_timestamp);
+        }
+
+        if (loaded) {
+            pfc::mutexScope scope(m_lock);
+            m_ready = true;
+        }
+    } catch (exception_aborted) {
+    } catch (std::exception & exc) {
+        console::formatter() << core_api::get_my_file_name() << ": exception while building track overview: " << exc;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "oscilloscope_overview.h"
+
+// Provides the overview of one track at a time. A current cache file in the profile folder is
+// simply mapped; otherwise the track is decoded and its overview built on a background thread,
+// which is abandoned when another track is requested.
+class oscilloscope_overview_loader : private pfc::thread {
+public:
+    oscilloscope_overview_loader();
+    ~oscilloscope_overview_loader();
+
+    // Starts loading the overview of track, unless it is already loaded or loading.
+    void request(const metadb_handle_ptr & track);
+
+    // Stops loading and releases the overview.
+    void reset();
+
+    // Returns the overview of the requested track, or null while it is loading or if it could
+    // not be built.
+    const oscilloscope_overview * get_overview();
+
+private:
+    virtual void threadProc();
+
+    metadb_handle_ptr m_track;
+    abort_callback_impl m_abort;
+    oscilloscope_overview m_overview;
+
+    pfc::mutex m_lock;
+    bool m_ready;
+};
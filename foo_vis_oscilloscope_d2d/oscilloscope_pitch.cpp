@@ -0,0 +1,234 @@
+#include "stdafx.h"
+
+#include "oscilloscope_pitch.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    const double g_window_duration = 0.04;
+    // Enough to fill the analysis window and the lags it is compared with in one go.
+    const double g_lookback = 0.1;
+    // Frequencies above this are not reported.
+    const double g_max_frequency = 4000.0;
+    // The first dip of the normalized difference below this is taken as the period.
+    const float g_threshold = 0.15f;
+}
+
+oscilloscope_pitch::oscilloscope_pitch()
+    : m_sample_rate(0)
+    , m_window_block_count(0)
+    , m_max_lag(0)
+    , m_lag_count(0)
+    , m_have_position(false)
+    , m_next_sample(0)
+    , m_sample_count(0)
+    , m_block_position(0)
+    , m_block_count(0)
+    , m_frequency(0.0)
+{
+}
+
+void oscilloscope_pitch::reset() {
+    m_sample_rate = 0;
+    m_have_position = false;
+    m_frequency = 0.0;
+}
+
+double oscilloscope_pitch::get_next_time(double now) {
+    if (m_have_position && m_sample_rate > 0) {
+        double next = (double) m_next_sample / (double) m_sample_rate;
+        // Stream time only runs backwards after a seek.
+        if (next < now + 0.1 && now - next < 0.5) {
+            return next;
+        }
+    }
+    m_have_position = false;
+    return now - g_lookback;
+}
+
+void oscilloscope_pitch::prepare(t_uint32 sample_rate) {
+    m_sample_rate = sample_rate;
+    m_window_block_count = pfc::max_t<t_uint32>((t_uint32) ceil(g_window_duration * sample_rate / block_length), 2);
+    m_max_lag = m_window_block_count * block_length / 2;
+    m_lag_count = (m_max_lag + 1 + 3) & ~3u;
+
+    m_partials.set_size((t_size) m_window_block_count * m_lag_count);
+    m_sum.set_size(m_lag_count);
+    m_normalized.set_size(m_max_lag + 1);
+}
+
+void oscilloscope_pitch::restart(t_int64 position) {
+    m_have_position = true;
+    m_next_sample = position;
+    m_sample_count = 0;
+    m_block_position = 0;
+    m_block_count = 0;
+    pfc::memset_null_t(m_partials.get_ptr(), m_partials.get_size());
+    pfc::memset_null_t(m_sum.get_ptr(), m_sum.get_size());
+    m_frequency = 0.0;
+}
+
+void oscilloscope_pitch::analyze(const oscilloscope_sample_window_view & window, double window_time, t_uint32 channel_index) {
+    if (window.is_empty()) {
+        return;
+    }
+
+    if (window.m_sample_rate != m_sample_rate) {
+        prepare(window.m_sample_rate);
+        m_have_position = false;
+    }
+
+    t_int64 window_start = (t_int64) floor(window_time * m_sample_rate + 0.5);
+    t_int64 window_end = window_start + window.m_sample_count;
+    if (!m_have_position || m_next_sample < window_start || m_next_sample > window_end) {
+        restart(window_start);
+    }
+
+    t_uint32 begin = (t_uint32) (m_next_sample - window_start);
+    t_uint32 count = window.m_sample_count - begin;
+    m_next_sample = window_end;
+
+    if (m_samples.get_size() < m_sample_count + count) {
+        m_samples.set_size(pfc::max_t<t_size>(m_sample_count + count, block_length + m_lag_count + count));
+    }
+    float * samples = m_samples.get_ptr();
+    float * out = samples + m_sample_count;
+    t_uint32 channel_count = window.m_channel_count;
+    if (channel_index == source_downmix) {
+        float scale = 1.0f / (float) channel_count;
+        for (t_uint32 index = 0; index < count; ++index) {
+            const audio_sample * frame = window.get_frame(begin + index);
+            audio_sample sum = 0;
+            for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+                sum += frame[channel];
+            }
+            out[index] = (float) sum * scale;
+        }
+    } else {
+        const audio_sample * in = window.get_frame(begin) + pfc::min_t<t_uint32>(channel_index, channel_count - 1);
+        for (t_uint32 index = 0; index < count; ++index) {
+            out[index] = (float) in[(t_size) index * channel_count];
+        }
+    }
+    m_sample_count += count;
+
+    t_size offset = 0;
+    bool added = false;
+    while (m_sample_count - offset >= block_length + m_lag_count) {
+        add_block(samples + offset);
+        offset += block_length;
+        added = true;
+    }
+    if (offset > 0) {
+        memmove(samples, samples + offset, (m_sample_count - offset) * sizeof(float));
+        m_sample_count -= offset;
+    }
+
+    if (added && m_block_count == m_window_block_count) {
+        estimate();
+    }
+}
+
+// Computes the partial sum of block_length samples over all lags, with the sums of four lags per
+// register, and moves it into the window sum. Sixteen lags are summed side by side, so that the
+// additions into each register do not wait on each other.
+void oscilloscope_pitch::add_block(const float * samples) {
+    float * partial = m_partials.get_ptr() + (t_size) m_block_position * m_lag_count;
+    float * sum = m_sum.get_ptr();
+
+    t_uint32 lag = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+    for (; lag + 16 <= m_lag_count; lag += 16) {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+        for (t_uint32 index = 0; index < block_length; ++index) {
+            __m128 x = _mm_set1_ps(samples[index]);
+            const float * lagged = samples + index + lag;
+            __m128 diff0 = _mm_sub_ps(x, _mm_loadu_ps(lagged));
+            __m128 diff1 = _mm_sub_ps(x, _mm_loadu_ps(lagged + 4));
+            __m128 diff2 = _mm_sub_ps(x, _mm_loadu_ps(lagged + 8));
+            __m128 diff3 = _mm_sub_ps(x, _mm_loadu_ps(lagged + 12));
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(diff0, diff0));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(diff1, diff1));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(diff2, diff2));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(diff3, diff3));
+        }
+        __m128 acc[4] = {acc0, acc1, acc2, acc3};
+        for (t_uint32 group = 0; group < 4; ++group) {
+            float * group_partial = partial + lag + 4 * group;
+            float * group_sum = sum + lag + 4 * group;
+            __m128 old = _mm_load_ps(group_partial);
+            _mm_store_ps(group_partial, acc[group]);
+            _mm_store_ps(group_sum, _mm_add_ps(_mm_load_ps(group_sum), _mm_sub_ps(acc[group], old)));
+        }
+    }
+    for (; lag < m_lag_count; lag += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (t_uint32 index = 0; index < block_length; ++index) {
+            __m128 diff = _mm_sub_ps(_mm_set1_ps(samples[index]), _mm_loadu_ps(samples + index + lag));
+            acc = _mm_add_ps(acc, _mm_mul_ps(diff, diff));
+        }
+        __m128 old = _mm_load_ps(partial + lag);
+        _mm_store_ps(partial + lag, acc);
+        _mm_store_ps(sum + lag, _mm_add_ps(_mm_load_ps(sum + lag), _mm_sub_ps(acc, old)));
+    }
+#endif
+    for (; lag < m_lag_count; ++lag) {
+        float acc = 0.0f;
+        for (t_uint32 index = 0; index < block_length; ++index) {
+            float diff = samples[index] - samples[index + lag];
+            acc += diff * diff;
+        }
+        sum[lag] += acc - partial[lag];
+        partial[lag] = acc;
+    }
+
+    if (m_block_count < m_window_block_count) {
+        ++m_block_count;
+    }
+    if (++m_block_position == m_window_block_count) {
+        m_block_position = 0;
+
+        const float * partials = m_partials.get_ptr();
+        pfc::memcpy_t(sum, partials, m_lag_count);
+        for (t_uint32 block = 1; block < m_window_block_count; ++block) {
+            const float * block_partial = partials + (t_size) block * m_lag_count;
+            for (lag = 0; lag < m_lag_count; ++lag) {
+                sum[lag] += block_partial[lag];
+            }
+        }
+    }
+}
+
+void oscilloscope_pitch::estimate() {
+    const float * difference = m_sum.get_ptr();
+    float * normalized = m_normalized.get_ptr();
+
+    // Cumulative mean normalized difference: d(lag) divided by the mean of d over lags 1 to lag.
+    normalized[0] = 1.0f;
+    double running = 0.0;
+    for (t_uint32 lag = 1; lag <= m_max_lag; ++lag) {
+        running += difference[lag];
+        normalized[lag] = running > 0.0 ? (float) (difference[lag] * lag / running) : 1.0f;
+    }
+
+    t_uint32 min_lag = pfc::max_t<t_uint32>((t_uint32) (m_sample_rate / g_max_frequency), 2);
+    t_uint32 lag = min_lag;
+    while (lag < m_max_lag && normalized[lag] >= g_threshold) {
+        ++lag;
+    }
+    if (lag >= m_max_lag) {
+        m_frequency = 0.0;
+        return;
+    }
+    while (lag + 1 < m_max_lag && normalized[lag + 1] < normalized[lag]) {
+        ++lag;
+    }
+
+    // The dip lies between sample lags; a parabola through its neighbors places it.
+    double a = normalized[lag - 1], b = normalized[lag], c = normalized[lag + 1];
+    double curvature = a - 2.0 * b + c;
+    double shift = curvature > 0.0 ? pfc::clip_t<double>(0.5 * (a - c) / curvature, -1.0, 1.0) : 0.0;
+    m_frequency = (double) m_sample_rate / ((double) lag + shift);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "oscilloscope_sample_window.h"
+
+// Fundamental frequency estimation with YIN over a 40 ms analysis window, for a continuous stream
+// of samples. The difference function d(lag) = sum of (x(j) - x(j + lag))^2 over the window is
+// kept up to date incrementally: the samples are taken in blocks of block_length, the partial sum
+// of each block over all lags is computed once, with four lags per instruction, and the window sum
+// adds the newest block and drops the oldest. Only the cumulative mean normalization and the search
+// for the first dip run over the whole lag range each time.
+class oscilloscope_pitch {
+public:
+    enum {
+        // Pass as the channel index to follow the downmix of all channels.
+        source_downmix = 0xffffffff
+    };
+
+    oscilloscope_pitch();
+
+    void reset();
+
+    // Returns the stream time from which the samples should be passed to analyze() next, given the
+    // current stream time. After a seek or a long gap, analysis starts over with one window of
+    // samples before now.
+    double get_next_time(double now);
+
+    // Adds the samples of channel channel_index of window, which starts at window_time, and updates
+    // the estimate. A window that does not continue the previous one starts the analysis over.
+    void analyze(const oscilloscope_sample_window_view & window, double window_time, t_uint32 channel_index);
+
+    // Returns the fundamental frequency in Hz, or 0 if the signal is not periodic.
+    double get_frequency() const {return m_frequency;}
+
+private:
+    enum {
+        block_length = 64
+    };
+
+    void prepare(t_uint32 sample_rate);
+    void restart(t_int64 position);
+    void add_block(const float * samples);
+    void estimate();
+
+    t_uint32 m_sample_rate;
+    t_uint32 m_window_block_count;
+    // Lags 0 to m_max_lag are analyzed; m_lag_count is that many rounded up to a multiple of four.
+    t_uint32 m_max_lag;
+    t_uint32 m_lag_count;
+
+    // Stream position of the next sample to add. m_samples holds the samples from the start of the
+    // next block on; a block is added once the samples it is compared with, up to m_lag_count
+    // later, have arrived.
+    bool m_have_position;
+    t_int64 m_next_sample;
+    pfc::array_t<float> m_samples;
+    t_size m_sample_count;
+
+    // Partial difference sums of the last m_window_block_count blocks in a ring, and their sum,
+    // which is recomputed from the ring each time the ring wraps so that rounding errors do not
+    // build up.
+    pfc::mem_block_aligned_t<float> m_partials;
+    pfc::mem_block_aligned_t<float> m_sum;
+    t_uint32 m_block_position;
+    t_uint32 m_block_count;
+
+    pfc::array_t<float> m_normalized;
+    double m_frequency;
+};
@@ -0,0 +1,296 @@
+#include "stdafx.h"
+
+#include "oscilloscope_rasterizer.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    // Rows per tile.
+    const t_uint32 g_tile_length = 16;
+    // Triangles per chunk of the binning.
+    const t_uint32 g_chunk_length = 16384;
+    // Tile range of a triangle that is in no tile.
+    const t_uint32 g_no_tiles = 1;
+
+    // Finds the rows and columns of a width x height image whose pixel centers the bounding box
+    // of the triangle at v reaches. Returns false for a triangle of no area or outside the image.
+    bool get_pixel_bounds(const oscilloscope_point * v, t_uint32 width, t_uint32 height, t_uint32 & first_row, t_uint32 & last_row, t_uint32 & first_column, t_uint32 & last_column) {
+        if ((v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x) == 0.0f) {
+            return false;
+        }
+
+        float top = pfc::min_t<float>(v[0].y, pfc::min_t<float>(v[1].y, v[2].y)) - 0.5f;
+        float bottom = pfc::max_t<float>(v[0].y, pfc::max_t<float>(v[1].y, v[2].y)) - 0.5f;
+        float left = pfc::min_t<float>(v[0].x, pfc::min_t<float>(v[1].x, v[2].x)) - 0.5f;
+        float right = pfc::max_t<float>(v[0].x, pfc::max_t<float>(v[1].x, v[2].x)) - 0.5f;
+        if (!(bottom >= 0.0f && top <= (float) height - 1.0f && right >= 0.0f && left <= (float) width - 1.0f)) {
+            return false;
+        }
+
+        // Rounded towards zero, which is down, as the bounds are no longer negative.
+        top = pfc::max_t<float>(top, 0.0f);
+        left = pfc::max_t<float>(left, 0.0f);
+        first_row = (t_uint32) top + ((float) (t_uint32) top < top ? 1 : 0);
+        last_row = (t_uint32) pfc::min_t<float>(bottom, (float) height - 1.0f);
+        first_column = (t_uint32) left + ((float) (t_uint32) left < left ? 1 : 0);
+        last_column = (t_uint32) pfc::min_t<float>(right, (float) width - 1.0f);
+        return first_row <= last_row && first_column <= last_column;
+    }
+
+    // Bins the triangles of chunks [begin / g_chunk_length, end / g_chunk_length). The first pass
+    // finds the tiles of every triangle and counts the triangles of each chunk in each tile, and
+    // the second writes the offset in the strips of the first vertex of every triangle to the bins
+    // of its tiles.
+    struct bin_triangles {
+        const oscilloscope_point * m_strip;
+        t_uint32 m_strip_length;
+        t_uint32 m_width;
+        t_uint32 m_height;
+        t_uint32 m_tile_count;
+        // First tile of each triangle in the low half, last tile in the high half.
+        t_uint32 * m_tile_ranges;
+        t_uint32 * m_counts;
+        t_uint32 * m_offsets;
+        t_uint32 * m_bins;
+        bool m_fill;
+
+        void operator()(t_size begin, t_size end) const {
+            PFC_TRACE_SCOPE(raster_bin);
+            for (t_size chunk_begin = begin; chunk_begin < end; chunk_begin += g_chunk_length) {
+                t_uint32 chunk_end = (t_uint32) pfc::min_t<t_size>(chunk_begin + g_chunk_length, end);
+                t_size chunk = chunk_begin / g_chunk_length;
+                if (m_fill) {
+                    fill((t_uint32) chunk_begin, chunk_end, m_offsets + chunk * m_tile_count);
+                } else {
+                    count((t_uint32) chunk_begin, chunk_end, m_counts + chunk * m_tile_count);
+                }
+            }
+        }
+
+        void count(t_uint32 begin, t_uint32 end, t_uint32 * counts) const {
+            pfc::memset_t(counts, 0u, m_tile_count);
+
+            // Triangle n of a strip has vertices n to n + 2, and the last two vertices of a strip
+            // begin no triangle.
+            t_uint32 triangles_per_strip = m_strip_length - 2;
+            t_uint32 strip_index = begin / triangles_per_strip;
+            t_uint32 strip_triangle = begin - strip_index * triangles_per_strip;
+            const oscilloscope_point * vertices = m_strip + (t_size) strip_index * m_strip_length + strip_triangle;
+            for (t_uint32 triangle = begin; triangle < end; ++triangle) {
+                t_uint32 first_row, last_row, first_column, last_column;
+                if (get_pixel_bounds(vertices, m_width, m_height, first_row, last_row, first_column, last_column)) {
+                    t_uint32 first_tile = first_row / g_tile_length;
+                    t_uint32 last_tile = last_row / g_tile_length;
+                    m_tile_ranges[triangle] = first_tile | (last_tile << 16);
+                    for (t_uint32 tile = first_tile; tile <= last_tile; ++tile) {
+                        ++counts[tile];
+                    }
+                } else {
+                    m_tile_ranges[triangle] = g_no_tiles;
+                }
+
+                ++vertices;
+                if (++strip_triangle == triangles_per_strip) {
+                    strip_triangle = 0;
+                    vertices += 2;
+                }
+            }
+        }
+
+        void fill(t_uint32 begin, t_uint32 end, t_uint32 * offsets) const {
+            t_uint32 triangles_per_strip = m_strip_length - 2;
+            t_uint32 strip_index = begin / triangles_per_strip;
+            t_uint32 strip_triangle = begin - strip_index * triangles_per_strip;
+            t_uint32 vertex = strip_index * m_strip_length + strip_triangle;
+            for (t_uint32 triangle = begin; triangle < end; ++triangle) {
+                t_uint32 range = m_tile_ranges[triangle];
+                for (t_uint32 tile = range & 0xffff; tile <= range >> 16; ++tile) {
+                    m_bins[offsets[tile]++] = vertex;
+                }
+
+                ++vertex;
+                if (++strip_triangle == triangles_per_strip) {
+                    strip_triangle = 0;
+                    vertex += 2;
+                }
+            }
+        }
+    };
+
+    // Clears rows [begin, end) and draws the triangles of their tiles.
+    struct draw_tiles {
+        const oscilloscope_point * m_strip;
+        // Vertices of the strips of each layer.
+        t_uint32 m_layer_length;
+        const t_uint32 * m_colors;
+        const t_uint32 * m_tile_offsets;
+        const t_uint32 * m_bins;
+        t_uint32 m_width;
+        t_uint32 m_height;
+        t_uint32 m_stride;
+        t_uint32 * m_pixels;
+
+        void operator()(t_size begin, t_size end) const {
+            PFC_TRACE_SCOPE(raster_tile);
+            pfc::memset_t(m_pixels + begin * m_stride, 0u, (end - begin) * m_stride);
+            for (t_size tile_begin = begin; tile_begin < end; tile_begin += g_tile_length) {
+                t_uint32 tile_end = (t_uint32) pfc::min_t<t_size>(tile_begin + g_tile_length, end);
+                t_size tile = tile_begin / g_tile_length;
+                // The triangles come in the order of the strips, so the layers only go up.
+                t_uint32 layer = 0;
+                t_uint32 layer_end = m_layer_length;
+                for (t_uint32 bin_index = m_tile_offsets[tile]; bin_index < m_tile_offsets[tile + 1]; ++bin_index) {
+                    t_uint32 vertex = m_bins[bin_index];
+                    while (vertex >= layer_end) {
+                        ++layer;
+                        layer_end += m_layer_length;
+                    }
+                    draw_triangle(m_strip + vertex, m_colors[layer], (t_uint32) tile_begin, tile_end);
+                }
+            }
+        }
+
+        // Each edge function is worked out anew at every pixel center rather than stepped from
+        // one pixel to the next, so that a pixel is covered or not whichever tile it is in. With
+        // SSE2, four pixels at a time, with those outside the bounds left as they are.
+        void draw_triangle(const oscilloscope_point * v, t_uint32 color, t_uint32 tile_begin, t_uint32 tile_end) const {
+            t_uint32 first_row, last_row, first_column, last_column;
+            if (!get_pixel_bounds(v, m_width, m_height, first_row, last_row, first_column, last_column)) {
+                return;
+            }
+            first_row = pfc::max_t<t_uint32>(first_row, tile_begin);
+            last_row = pfc::min_t<t_uint32>(last_row, tile_end - 1);
+
+            // With b and c in the order that makes the area positive, the inside is where all three
+            // edge functions are.
+            oscilloscope_point a = v[0];
+            oscilloscope_point b = v[1];
+            oscilloscope_point c = v[2];
+            if ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) < 0.0f) {
+                pfc::swap_t(b, c);
+            }
+
+#if OSCILLOSCOPE_HAVE_SSE2
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 ab_dy = _mm_set1_ps(b.y - a.y);
+            const __m128 bc_dy = _mm_set1_ps(c.y - b.y);
+            const __m128 ca_dy = _mm_set1_ps(a.y - c.y);
+            const __m128 ax = _mm_set1_ps(a.x);
+            const __m128 bx = _mm_set1_ps(b.x);
+            const __m128 cx = _mm_set1_ps(c.x);
+            const __m128i before = _mm_set1_epi32((int) first_column - 1);
+            const __m128i after = _mm_set1_epi32((int) last_column + 1);
+            const __m128i colors = _mm_set1_epi32((int) color);
+            t_uint32 first_group = first_column & ~3u;
+#endif
+            for (t_uint32 row = first_row; row <= last_row; ++row) {
+                float y = (float) row + 0.5f;
+                float row_ab = (b.x - a.x) * (y - a.y);
+                float row_bc = (c.x - b.x) * (y - b.y);
+                float row_ca = (a.x - c.x) * (y - c.y);
+                t_uint32 * pixels = m_pixels + (t_size) row * m_stride;
+#if OSCILLOSCOPE_HAVE_SSE2
+                __m128 ab = _mm_set1_ps(row_ab);
+                __m128 bc = _mm_set1_ps(row_bc);
+                __m128 ca = _mm_set1_ps(row_ca);
+                for (t_uint32 group = first_group; group <= last_column; group += 4) {
+                    __m128i columns = _mm_add_epi32(_mm_set1_epi32((int) group), _mm_set_epi32(3, 2, 1, 0));
+                    __m128 x = _mm_add_ps(_mm_cvtepi32_ps(columns), _mm_set1_ps(0.5f));
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_sub_ps(ab, _mm_mul_ps(ab_dy, _mm_sub_ps(x, ax))), zero), _mm_cmpge_ps(_mm_sub_ps(bc, _mm_mul_ps(bc_dy, _mm_sub_ps(x, bx))), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_sub_ps(ca, _mm_mul_ps(ca_dy, _mm_sub_ps(x, cx))), zero));
+                    __m128i mask = _mm_and_si128(_mm_castps_si128(inside), _mm_and_si128(_mm_cmpgt_epi32(columns, before), _mm_cmplt_epi32(columns, after)));
+                    __m128i * out = (__m128i *) (pixels + group);
+                    _mm_store_si128(out, _mm_or_si128(_mm_and_si128(mask, colors), _mm_andnot_si128(mask, _mm_load_si128(out))));
+                }
+#else
+                for (t_uint32 column = first_column; column <= last_column; ++column) {
+                    float x = (float) column + 0.5f;
+                    // Whether a pixel is inside is hard to predict along the thin triangles of
+                    // a trace, so every pixel of the bounds is written.
+                    t_uint32 inside = (row_ab - (b.y - a.y) * (x - a.x) >= 0.0f) & (row_bc - (c.y - b.y) * (x - b.x) >= 0.0f) & (row_ca - (a.y - c.y) * (x - c.x) >= 0.0f);
+                    pixels[column] ^= (pixels[column] ^ color) & (0 - inside);
+                }
+#endif
+            }
+        }
+    };
+
+    template<typename t_func>
+    void run_tiles(pfc::threadPool * pool, t_size end, t_size tile_length, const t_func & func) {
+        if (pool != nullptr) {
+            pool->parallelFor(0, end, tile_length, func);
+        } else {
+            func(0, end);
+        }
+    }
+
+    t_uint32 get_premultiplied_color(const oscilloscope_color & color, float opacity) {
+        float a = pfc::min_t<float>(pfc::max_t<float>(color.a * opacity, 0.0f), 1.0f);
+        t_uint32 b = (t_uint32) (a * pfc::min_t<float>(pfc::max_t<float>(color.b, 0.0f), 1.0f) * 255.0f + 0.5f);
+        t_uint32 g = (t_uint32) (a * pfc::min_t<float>(pfc::max_t<float>(color.g, 0.0f), 1.0f) * 255.0f + 0.5f);
+        t_uint32 r = (t_uint32) (a * pfc::min_t<float>(pfc::max_t<float>(color.r, 0.0f), 1.0f) * 255.0f + 0.5f);
+        t_uint32 w = (t_uint32) (a * 255.0f + 0.5f);
+        return b | (g << 8) | (r << 16) | (w << 24);
+    }
+}
+
+oscilloscope_rasterizer::oscilloscope_rasterizer()
+    : m_width(0)
+    , m_height(0)
+    , m_stride(0)
+{
+}
+
+void oscilloscope_rasterizer::render(const oscilloscope_point * strip, t_uint32 layer_count, t_uint32 trace_count, t_uint32 strip_length, const oscilloscope_color * colors, float opacity, oscilloscope_size size, pfc::threadPool * pool) {
+    PFC_TRACE_SCOPE(raster);
+    // The tile ranges have room for 65536 tiles.
+    m_width = size.width;
+    m_height = pfc::min_t<t_uint32>(size.height, g_tile_length << 16);
+    m_stride = (m_width + 3) & ~3u;
+    t_size pixel_count = (t_size) m_stride * m_height;
+    if (m_pixels.get_size() < pixel_count) {
+        m_pixels.set_size(pixel_count);
+    }
+    if (pixel_count == 0) {
+        return;
+    }
+
+    m_colors.set_size(layer_count);
+    for (t_uint32 layer = 0; layer < layer_count; ++layer) {
+        m_colors[layer] = get_premultiplied_color(colors[layer], opacity);
+    }
+
+    t_uint32 triangle_count = strip_length < 3 ? 0 : layer_count * trace_count * (strip_length - 2);
+    t_uint32 tile_count = (m_height + g_tile_length - 1) / g_tile_length;
+    t_uint32 chunk_count = (triangle_count + g_chunk_length - 1) / g_chunk_length;
+    t_size bin_table_size = (t_size) chunk_count * tile_count;
+    if (m_bin_counts.get_size() < bin_table_size) {
+        m_bin_counts.set_size(bin_table_size);
+        m_bin_offsets.set_size(bin_table_size);
+    }
+    if (m_tile_ranges.get_size() < triangle_count) {
+        m_tile_ranges.set_size(triangle_count);
+    }
+    m_tile_offsets.set_size(tile_count + 1);
+
+    // The bins of a tile follow each other chunk by chunk, so every tile reads one run of m_bins.
+    bin_triangles bin = {strip, strip_length, m_width, m_height, tile_count, m_tile_ranges.get_ptr(), m_bin_counts.get_ptr(), m_bin_offsets.get_ptr(), nullptr, false};
+    run_tiles(pool, triangle_count, g_chunk_length, bin);
+    t_uint32 offset = 0;
+    for (t_uint32 tile = 0; tile < tile_count; ++tile) {
+        m_tile_offsets[tile] = offset;
+        for (t_uint32 chunk = 0; chunk < chunk_count; ++chunk) {
+            m_bin_offsets[chunk * tile_count + tile] = offset;
+            offset += m_bin_counts[chunk * tile_count + tile];
+        }
+    }
+    m_tile_offsets[tile_count] = offset;
+    if (m_bins.get_size() < offset) {
+        m_bins.set_size(offset);
+    }
+    bin.m_bins = m_bins.get_ptr();
+    bin.m_fill = true;
+    run_tiles(pool, triangle_count, g_chunk_length, bin);
+
+    draw_tiles draw = {strip, trace_count * strip_length, m_colors.get_ptr(), m_tile_offsets.get_ptr(), m_bins.get_ptr(), m_width, m_height, m_stride, m_pixels.get_ptr()};
+    run_tiles(pool, m_height, g_tile_length, draw);
+}
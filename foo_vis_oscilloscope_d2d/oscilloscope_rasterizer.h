@@ -0,0 +1,44 @@
+#pragma once
+
+#include "oscilloscope_types.h"
+
+// Draws the triangle strips of oscilloscope_tessellate_traces() on the CPU, into premultiplied BGRA
+// pixels, without anti-aliasing: a triangle covers the pixels whose centers are inside it or on
+// its edges. The pixels are split into tiles of whole rows. The triangles are binned into the tiles
+// that their bounding boxes reach, chunk by chunk, with the chunks binned in parallel, and then
+// the tiles are drawn in parallel, each from its own bins. A pixel takes the color of the last
+// triangle that covers it, whichever tile it is in and whichever thread draws it, so the pixels
+// are the same with or without a thread pool.
+class oscilloscope_rasterizer {
+public:
+    oscilloscope_rasterizer();
+
+    // Draws layer_count layers of trace_count strips of strip_length vertices each, which follow
+    // each other in strip, over transparent pixels of size. The strips of layer n are drawn in
+    // colors[n] with opacity, over those of the layers before. The work runs on pool, if not null.
+    void render(const oscilloscope_point * strip, t_uint32 layer_count, t_uint32 trace_count, t_uint32 strip_length, const oscilloscope_color * colors, float opacity, oscilloscope_size size, pfc::threadPool * pool);
+
+    // Returns the pixels of the last render(), get_stride() apart from one row to the next.
+    const t_uint32 * get_pixels() const {return m_pixels.get_ptr();}
+    t_uint32 get_width() const {return m_width;}
+    t_uint32 get_height() const {return m_height;}
+    t_uint32 get_stride() const {return m_stride;}
+
+private:
+    // The rows are padded to multiples of four pixels.
+    t_uint32 m_width;
+    t_uint32 m_height;
+    t_uint32 m_stride;
+
+    // The tiles of each triangle, the number of triangles of each chunk in each tile, chunk by
+    // chunk, and where they go in m_bins, where the bins are tile by tile and, within a tile,
+    // chunk by chunk. Each bin lists its triangles in order, so every tile sees its triangles in
+    // the order of the strips.
+    pfc::array_t<t_uint32> m_tile_ranges;
+    pfc::array_t<t_uint32> m_bin_counts;
+    pfc::array_t<t_uint32> m_bin_offsets;
+    pfc::array_t<t_uint32> m_tile_offsets;
+    pfc::array_t<t_uint32> m_bins;
+    pfc::array_t<t_uint32> m_colors;
+    pfc::mem_block_aligned_t<t_uint32> m_pixels;
+};
@@ -0,0 +1,733 @@
+#include "stdafx.h"
+
+#include "oscilloscope_renderer.h"
+
+namespace {
+    // Frames with fewer vertices than this are generated inline, as dispatching them to the
+    // thread pool would cost more than it saves.
+    const t_uint32 g_parallel_vertex_threshold = 32768;
+    const t_uint32 g_vertex_tile_length = 4096;
+
+    // Standard deviation of the glow, in pixels.
+    const float g_glow_radius = 12.0f;
+
+    // Color of each bucket of the color modes, from low to high values.
+    D2D1_COLOR_F get_bucket_color(t_uint32 bucket) {
+        static const D2D1_COLOR_F stops[] = {
+            {0.2f, 0.3f, 1.0f, 1.0f},
+            {0.0f, 0.8f, 1.0f, 1.0f},
+            {0.2f, 1.0f, 0.3f, 1.0f},
+            {1.0f, 0.9f, 0.1f, 1.0f},
+            {1.0f, 0.25f, 0.1f, 1.0f},
+        };
+        const t_uint32 stop_count = PFC_TABSIZE(stops);
+        float position = (float) bucket * (float) (stop_count - 1) / (float) (oscilloscope_color_bucket_count - 1);
+        t_uint32 stop = pfc::min_t<t_uint32>((t_uint32) position, stop_count - 2);
+        float fraction = position - (float) stop;
+        const D2D1_COLOR_F & from = stops[stop];
+        const D2D1_COLOR_F & to = stops[stop + 1];
+        return D2D1::ColorF(from.r + (to.r - from.r) * fraction, from.g + (to.g - from.g) * fraction, from.b + (to.b - from.b) * fraction);
+    }
+
+    // Colors of the low, mid and high band.
+    const D2D1_COLOR_F g_band_colors[oscilloscope_band_split::band_count] = {
+        {1.0f, 0.45f, 0.25f, 1.0f},
+        {0.4f, 0.85f, 0.35f, 1.0f},
+        {0.35f, 0.6f, 1.0f, 1.0f},
+    };
+
+    struct vertex_tiles {
+        oscilloscope_sample_window_view m_window;
+        const oscilloscope_channel_transform * m_transforms;
+        t_uint32 m_trace_count;
+        D2D1_POINT_2F * m_points;
+
+        void operator()(t_size begin, t_size end) const {
+            PFC_TRACE_SCOPE(vertex_tile);
+            oscilloscope_generate_vertices(m_window, (t_uint32) begin, (t_uint32) end, m_transforms, m_trace_count, m_points);
+        }
+    };
+
+    // Copies the pixels of size, stride apart from one row to the next, into bitmap, which is
+    // created first if it is missing or of another size.
+    HRESULT update_bitmap(ID2D1RenderTarget * target, D2D1_SIZE_U size, const t_uint32 * pixels, t_uint32 stride, CComPtr<ID2D1Bitmap> & bitmap) {
+        if (bitmap) {
+            D2D1_SIZE_U bitmap_size = bitmap->GetPixelSize();
+            if (bitmap_size.width != size.width || bitmap_size.height != size.height) {
+                bitmap.Release();
+            }
+        }
+
+        HRESULT hr = S_OK;
+        if (!bitmap) {
+            hr = target->CreateBitmap(size, D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)), &bitmap);
+        }
+
+        if (SUCCEEDED(hr)) {
+            hr = bitmap->CopyFromMemory(nullptr, pixels, stride * sizeof(t_uint32));
+        }
+
+        return hr;
+    }
+
+    struct strip_tiles {
+        const D2D1_POINT_2F * m_points;
+        t_uint32 m_trace_count;
+        t_uint32 m_sample_count;
+        float m_stroke_width;
+        D2D1_POINT_2F * m_strip;
+
+        void operator()(t_size begin, t_size end) const {
+            PFC_TRACE_SCOPE(strip_tile);
+            oscilloscope_tessellate_traces(m_points, m_trace_count, m_sample_count, (t_uint32) begin, (t_uint32) end, m_stroke_width, oscilloscope_join_bevel, 0.0f, m_strip);
+        }
+    };
+}
+
+oscilloscope_renderer::oscilloscope_renderer() : m_timebase_period(0.0) {
+    update_trigger_parameters();
+}
+
+void oscilloscope_renderer::set_config(const oscilloscope_config & config) {
+    if (config.m_trigger_enabled != m_config.m_trigger_enabled || config.m_trigger_mode != m_config.m_trigger_mode) {
+        m_trigger.reset();
+        m_correlation_trigger.reset();
+        m_average.reset();
+    } else if (config.m_trigger_predictive_enabled != m_config.m_trigger_predictive_enabled) {
+        m_trigger.reset();
+    }
+
+    if (!config.m_auto_gain_enabled) {
+        m_auto_gain.reset();
+    }
+    if (!config.m_tuner_enabled) {
+        m_tuner.reset();
+        m_trigger.set_period_hint(0.0);
+    }
+    if (config.m_timebase_periods == 0) {
+        m_pitch.reset();
+        m_timebase_period = 0.0;
+    }
+    if (!config.m_band_split_enabled) {
+        m_band_split.reset();
+    }
+
+    m_config = config;
+    update_trigger_parameters();
+    switch (m_config.m_channel_matrix) {
+    case oscilloscope_config::channel_matrix_mid_side:
+        m_channel_matrix.set_mode(oscilloscope_channel_matrix::mode_mid_side);
+        break;
+    case oscilloscope_config::channel_matrix_difference:
+        m_channel_matrix.set_mode(oscilloscope_channel_matrix::mode_difference);
+        break;
+    case oscilloscope_config::channel_matrix_fold_down:
+        m_channel_matrix.set_mode(oscilloscope_channel_matrix::mode_fold_down);
+        break;
+    case oscilloscope_config::channel_matrix_custom:
+        m_channel_matrix.set_custom_weights(m_config.m_custom_matrix_weights, m_config.m_custom_matrix_input_count, m_config.m_custom_matrix_output_count);
+        m_channel_matrix.set_mode(oscilloscope_channel_matrix::mode_custom);
+        break;
+    default:
+        m_channel_matrix.set_mode(oscilloscope_channel_matrix::mode_none);
+        break;
+    }
+    m_auto_gain.set_window_duration(m_config.get_auto_gain_window());
+    // Windows that are not aligned by the trigger would only average into a blur.
+    m_average.set_parameters(m_config.m_average_mode == oscilloscope_config::average_mode_boxcar ? oscilloscope_average::mode_boxcar : oscilloscope_average::mode_exponential, m_config.m_trigger_enabled ? m_config.m_average_count : 1);
+}
+
+void oscilloscope_renderer::reset() {
+    m_trigger.reset();
+    m_correlation_trigger.reset();
+    m_average.reset();
+    m_band_split.reset();
+    m_auto_gain.reset();
+    m_tuner.reset();
+    m_pitch.reset();
+    m_timebase_period = 0.0;
+}
+
+void oscilloscope_renderer::discard_device_resources() {
+    m_glow_bitmap.Release();
+    m_raster_bitmap.Release();
+}
+
+void oscilloscope_renderer::update_trigger_parameters() {
+    oscilloscope_trigger::parameters parameters;
+    parameters.m_level = (audio_sample) m_config.get_trigger_level();
+    parameters.m_hysteresis = (audio_sample) m_config.get_trigger_hysteresis();
+    parameters.m_slope = (m_config.m_trigger_slope == oscilloscope_config::trigger_slope_falling) ? oscilloscope_trigger::slope_falling : oscilloscope_trigger::slope_rising;
+    if (m_config.m_trigger_source == oscilloscope_config::trigger_source_sum) {
+        parameters.m_source = oscilloscope_trigger::source_sum;
+    } else if (m_config.m_trigger_source >= oscilloscope_config::trigger_source_channel_1) {
+        parameters.m_source = oscilloscope_trigger::source_channel + (m_config.m_trigger_source - oscilloscope_config::trigger_source_channel_1);
+    } else {
+        parameters.m_source = oscilloscope_trigger::source_any;
+    }
+    parameters.m_channel_mask = m_config.m_channel_mask;
+    parameters.m_holdoff = m_config.get_trigger_holdoff();
+    // Setting the parameters resets the trigger, so unchanged ones are not applied again.
+    if (parameters != m_trigger.get_parameters()) {
+        m_trigger.set_parameters(parameters);
+    }
+}
+
+HRESULT oscilloscope_renderer::render(ID2D1Factory * factory, ID2D1RenderTarget * target, ID2D1Brush * brush, const oscilloscope_sample_window_view & input, double window_time, pfc::threadPool * pool) {
+    PFC_TRACE_SCOPE(RenderChunk);
+    HRESULT hr = S_OK;
+
+    oscilloscope_sample_window_view window;
+    {
+        PFC_TRACE_SCOPE(channel_matrix);
+        window = m_channel_matrix.apply(input);
+    }
+
+    target->SetAntialiasMode(m_config.m_low_quality_enabled ? D2D1_ANTIALIAS_MODE_ALIASED : D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+
+    D2D1_SIZE_F rtSize = target->GetSize();
+    D2D1_SIZE_F scopeSize = rtSize;
+    if (m_config.m_spectrum_enabled) {
+        scopeSize.height = floor(rtSize.height * 0.75f);
+    }
+
+    {
+        // With the trigger enabled, the window holds twice the samples that are shown, and the
+        // trigger picks which of them.
+        t_uint32 sample_count = m_config.m_trigger_enabled ? window.m_sample_count / 2 : window.m_sample_count;
+
+        // Hidden channels and channels too small to be seen are culled here, before any of their
+        // samples are touched.
+        t_uint32 trace_count = (window.m_channel_count > 0 && sample_count > 0) ? layout_channels(window.m_channel_count, sample_count, scopeSize) : 0;
+
+        // The zoom sets the height that the peak is scaled to.
+        if (m_config.m_auto_gain_enabled && trace_count > 0) {
+            PFC_TRACE_SCOPE(auto_gain);
+            m_auto_gain.update(window, window_time, m_channel_transforms.get_ptr(), trace_count);
+            float gain = (float) m_auto_gain.get_gain();
+            for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+                m_channel_transforms[trace_index].m_y_scale *= gain;
+            }
+        }
+
+        // The tuner follows the channel that the trigger follows, and tells it the period.
+        if (m_config.m_tuner_enabled && trace_count > 0) {
+            PFC_TRACE_SCOPE(tuner);
+            m_tuner.update(window, window_time, get_source_channel());
+            double frequency = m_tuner.get_frequency();
+            m_trigger.set_period_hint(frequency > 0.0 ? (double) window.m_sample_rate / frequency : 0.0);
+        }
+
+        t_uint32 trigger_index = 0;
+        if (m_config.m_trigger_enabled && trace_count > 0) {
+            PFC_TRACE_SCOPE(trigger);
+            if (m_config.m_trigger_mode == oscilloscope_config::trigger_mode_correlation) {
+                trigger_index = m_correlation_trigger.find(window, sample_count);
+            } else {
+                trigger_index = m_trigger.find(window, sample_count, window_time, m_config.m_trigger_predictive_enabled);
+            }
+        }
+
+        // The trigger looks at the signal as it is; only what is drawn is split into bands, which
+        // are laid out as the low, mid and high band of each trace in turn.
+        oscilloscope_sample_window_view source = window;
+        const oscilloscope_channel_transform * transforms = m_channel_transforms.get_ptr();
+        t_uint32 group_count = 1;
+        if (m_config.m_band_split_enabled && trace_count > 0) {
+            PFC_TRACE_SCOPE(band_split);
+            source = m_band_split.process(window, window_time);
+            group_count = oscilloscope_band_split::band_count;
+            m_band_transforms.set_size(group_count * trace_count);
+            for (t_uint32 band = 0; band < group_count; ++band) {
+                for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+                    oscilloscope_channel_transform & t = m_band_transforms[band * trace_count + trace_index];
+                    t = m_channel_transforms[trace_index];
+                    t.m_channel_index = t.m_channel_index * oscilloscope_band_split::band_count + band;
+                }
+            }
+            transforms = m_band_transforms.get_ptr();
+        }
+
+        if (trace_count > 0) {
+            PFC_TRACE_SCOPE(geometry);
+            oscilloscope_sample_window_view shown = source.get_range(trigger_index, sample_count);
+            {
+                PFC_TRACE_SCOPE(average);
+                shown = m_average.add(shown);
+            }
+            t_uint32 total_count = group_count * trace_count;
+            m_points.set_size(total_count * sample_count);
+            if (pool != nullptr && total_count * sample_count >= g_parallel_vertex_threshold) {
+                vertex_tiles tiles = {shown, transforms, total_count, m_points.get_ptr()};
+                pool->parallelFor(0, sample_count, g_vertex_tile_length, tiles);
+            } else {
+                oscilloscope_generate_vertices(shown, transforms, total_count, m_points.get_ptr());
+            }
+        }
+
+        CComPtr<ID2D1StrokeStyle> pStrokeStyle;
+        if (trace_count > 0) {
+            D2D1_STROKE_STYLE_PROPERTIES strokeStyleProperties = D2D1::StrokeStyleProperties(D2D1_CAP_STYLE_FLAT, D2D1_CAP_STYLE_FLAT, D2D1_CAP_STYLE_FLAT, D2D1_LINE_JOIN_BEVEL);
+            factory->CreateStrokeStyle(strokeStyleProperties, nullptr, 0, &pStrokeStyle);
+        }
+
+        if (SUCCEEDED(hr) && m_config.m_glow_enabled && trace_count > 0) {
+            hr = draw_glow(target, brush, scopeSize, group_count * trace_count, sample_count, pool);
+        }
+
+        // The bands have colors of their own, which take precedence over a color mode.
+        bool colored = m_config.m_color_mode != oscilloscope_config::color_mode_solid && group_count == 1 && trace_count > 0;
+        if (SUCCEEDED(hr) && colored) {
+            hr = draw_colored_traces(factory, target, brush, pStrokeStyle, transforms, trace_count, sample_count);
+        }
+
+        // Without hardware rendering, aliased traces are better drawn by the tiles of the
+        // rasterizer on pool than by the software renderer of Direct2D on a single thread.
+        bool rasterized = !colored && trace_count > 0 && m_config.m_low_quality_enabled && !m_config.m_hw_rendering_enabled;
+        if (SUCCEEDED(hr) && rasterized) {
+            hr = draw_rasterized_traces(target, brush, scopeSize, group_count, trace_count, sample_count, pool);
+        }
+
+        // Each group of traces is one geometry, drawn with one brush.
+        for (t_uint32 group = 0; group < group_count && trace_count > 0 && !colored && !rasterized && SUCCEEDED(hr); ++group) {
+            CComPtr<ID2D1SolidColorBrush> pBandBrush;
+            if (group_count > 1) {
+                hr = target->CreateSolidColorBrush(g_band_colors[group], D2D1::BrushProperties(brush->GetOpacity()), &pBandBrush);
+            }
+            ID2D1Brush * group_brush = pBandBrush ? pBandBrush.p : brush;
+
+            // Aliased, the traces are stroked here and filled as a mesh, which spares Direct2D
+            // the work of stroking the path itself.
+            if (SUCCEEDED(hr) && m_config.m_low_quality_enabled) {
+                hr = draw_mesh(target, group_brush, m_points.get_ptr() + (t_size) group * trace_count * sample_count, trace_count, sample_count, pool);
+                continue;
+            }
+
+            CComPtr<ID2D1PathGeometry> pPath;
+            if (SUCCEEDED(hr)) {
+                hr = factory->CreatePathGeometry(&pPath);
+            }
+
+            CComPtr<ID2D1GeometrySink> pSink;
+            if (SUCCEEDED(hr)) {
+                hr = pPath->Open(&pSink);
+            }
+
+            if (SUCCEEDED(hr)) {
+                PFC_TRACE_SCOPE(geometry);
+                for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+                    const D2D1_POINT_2F * points = m_points.get_ptr() + (group * trace_count + trace_index) * sample_count;
+                    pSink->BeginFigure(points[0], D2D1_FIGURE_BEGIN_HOLLOW);
+                    pSink->AddLines(points + 1, sample_count - 1);
+                    pSink->EndFigure(D2D1_FIGURE_END_OPEN);
+                }
+                hr = pSink->Close();
+            }
+
+            if (SUCCEEDED(hr)) {
+                PFC_TRACE_SCOPE(draw);
+                target->DrawGeometry(pPath, group_brush, (FLOAT)m_config.get_line_stroke_width(), pStrokeStyle);
+            }
+        }
+
+        if (SUCCEEDED(hr) && m_config.m_spectrum_enabled) {
+            hr = m_spectrum.render(factory, target, brush, window, m_channel_transforms.get_ptr(), trace_count, D2D1::RectF(0.0f, scopeSize.height, rtSize.width, rtSize.height));
+        }
+
+        if (SUCCEEDED(hr) && m_config.m_tuner_enabled) {
+            hr = render_tuner(target, brush, rtSize);
+        }
+
+        if (SUCCEEDED(hr) && m_config.m_timebase_periods > 0 && m_pitch.get_frequency() > 0.0) {
+            pfc::string8 text;
+            text << pfc::format_float(m_pitch.get_frequency(), 0, 1) << " Hz";
+            hr = draw_text(target, brush, text, D2D1::RectF(8.0f, 4.0f, rtSize.width - 8.0f, rtSize.height), DWRITE_TEXT_ALIGNMENT_TRAILING);
+        }
+    }
+
+    return hr;
+}
+
+// Draws the glow of the traces whose vertices are in m_points, scaled up from half the size of the
+// target. The glow is drawn over what is already there, which on the dark backgrounds that it is
+// meant for is close to adding it.
+HRESULT oscilloscope_renderer::draw_glow(ID2D1RenderTarget * target, ID2D1Brush * brush, D2D1_SIZE_F size, t_uint32 trace_count, t_uint32 sample_count, pfc::threadPool * pool) {
+    PFC_TRACE_SCOPE(glow);
+
+    // Brushes of more than one color make a white glow.
+    D2D1_COLOR_F color = D2D1::ColorF(D2D1::ColorF::White);
+    CComQIPtr<ID2D1SolidColorBrush> pSolidBrush(brush);
+    if (pSolidBrush) {
+        color = pSolidBrush->GetColor();
+    }
+
+    m_glow.render(m_points.get_ptr(), trace_count, sample_count, D2D1::SizeU((UINT32) ceil(size.width), (UINT32) ceil(size.height)), g_glow_radius, color, pool);
+    D2D1_SIZE_U glow_size = D2D1::SizeU(m_glow.get_width(), m_glow.get_height());
+    if (glow_size.width == 0 || glow_size.height == 0) {
+        return S_OK;
+    }
+
+    HRESULT hr = update_bitmap(target, glow_size, m_glow.get_pixels(), m_glow.get_stride(), m_glow_bitmap);
+    if (SUCCEEDED(hr)) {
+        target->DrawBitmap(m_glow_bitmap, D2D1::RectF(0.0f, 0.0f, 2.0f * glow_size.width, 2.0f * glow_size.height), brush->GetOpacity(), D2D1_BITMAP_INTERPOLATION_MODE_LINEAR);
+    }
+
+    return hr;
+}
+
+// Strokes trace_count traces of sample_count vertices each, which follow each other in points,
+// into m_strip, with the same flat ends and bevel joins as the stroke style of the paths.
+void oscilloscope_renderer::stroke_traces(const D2D1_POINT_2F * points, t_uint32 trace_count, t_uint32 sample_count, pfc::threadPool * pool) {
+    float stroke_width = (float) m_config.get_line_stroke_width();
+    m_strip.set_size((t_size) trace_count * oscilloscope_get_strip_length(sample_count));
+    if (pool != nullptr && trace_count * sample_count >= g_parallel_vertex_threshold) {
+        strip_tiles tiles = {points, trace_count, sample_count, stroke_width, m_strip.get_ptr()};
+        pool->parallelFor(0, sample_count, g_vertex_tile_length, tiles);
+    } else {
+        oscilloscope_tessellate_traces(points, trace_count, sample_count, stroke_width, oscilloscope_join_bevel, 0.0f, m_strip.get_ptr());
+    }
+}
+
+// Draws the traces whose vertices are in m_points into pixels of their own, group by group, each
+// in its color, and draws the pixels over the target.
+HRESULT oscilloscope_renderer::draw_rasterized_traces(ID2D1RenderTarget * target, ID2D1Brush * brush, D2D1_SIZE_F size, t_uint32 group_count, t_uint32 trace_count, t_uint32 sample_count, pfc::threadPool * pool) {
+    PFC_TRACE_SCOPE(rasterized_traces);
+    if (sample_count < 2) {
+        return S_OK;
+    }
+
+    // Brushes of more than one color draw white traces.
+    D2D1_COLOR_F color = D2D1::ColorF(D2D1::ColorF::White);
+    CComQIPtr<ID2D1SolidColorBrush> pSolidBrush(brush);
+    if (pSolidBrush) {
+        color = pSolidBrush->GetColor();
+    }
+
+    stroke_traces(m_points.get_ptr(), group_count * trace_count, sample_count, pool);
+    m_raster.render(m_strip.get_ptr(), group_count, trace_count, oscilloscope_get_strip_length(sample_count), group_count > 1 ? g_band_colors : &color, brush->GetOpacity(), D2D1::SizeU((UINT32) ceil(size.width), (UINT32) ceil(size.height)), pool);
+    D2D1_SIZE_U raster_size = D2D1::SizeU(m_raster.get_width(), m_raster.get_height());
+    if (raster_size.width == 0 || raster_size.height == 0) {
+        return S_OK;
+    }
+
+    HRESULT hr = update_bitmap(target, raster_size, m_raster.get_pixels(), m_raster.get_stride(), m_raster_bitmap);
+    if (SUCCEEDED(hr)) {
+        target->DrawBitmap(m_raster_bitmap, D2D1::RectF(0.0f, 0.0f, (FLOAT) raster_size.width, (FLOAT) raster_size.height), 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+    }
+
+    return hr;
+}
+
+// Fills trace_count traces of sample_count vertices each, which follow each other in points, as
+// the triangles of their strokes. Meshes are only drawn by aliased targets. The empty triangles of
+// the strips are left out, which leaves two triangles for every segment and two for every join
+// that turns.
+HRESULT oscilloscope_renderer::draw_mesh(ID2D1RenderTarget * target, ID2D1Brush * brush, const D2D1_POINT_2F * points, t_uint32 trace_count, t_uint32 sample_count, pfc::threadPool * pool) {
+    PFC_TRACE_SCOPE(mesh);
+    if (sample_count < 2) {
+        return S_OK;
+    }
+
+    stroke_traces(points, trace_count, sample_count, pool);
+    t_uint32 strip_length = oscilloscope_get_strip_length(sample_count);
+    m_triangles.set_size((t_size) trace_count * (strip_length - 2));
+    D2D1_TRIANGLE * triangles = m_triangles.get_ptr();
+    t_size triangle_count = 0;
+    for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+        const D2D1_POINT_2F * strip = m_strip.get_ptr() + (t_size) trace_index * strip_length;
+        for (t_uint32 vertex_index = 0; vertex_index + 2 < strip_length; ++vertex_index) {
+            const D2D1_POINT_2F & a = strip[vertex_index];
+            const D2D1_POINT_2F & b = strip[vertex_index + 1];
+            const D2D1_POINT_2F & c = strip[vertex_index + 2];
+            if ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) != 0.0f) {
+                D2D1_TRIANGLE & triangle = triangles[triangle_count++];
+                triangle.point1 = a;
+                triangle.point2 = b;
+                triangle.point3 = c;
+            }
+        }
+    }
+
+    CComPtr<ID2D1Mesh> pMesh;
+    HRESULT hr = target->CreateMesh(&pMesh);
+
+    CComPtr<ID2D1TessellationSink> pSink;
+    if (SUCCEEDED(hr)) {
+        hr = pMesh->Open(&pSink);
+    }
+
+    if (SUCCEEDED(hr)) {
+        pSink->AddTriangles(triangles, (UINT32) triangle_count);
+        hr = pSink->Close();
+    }
+
+    if (SUCCEEDED(hr)) {
+        PFC_TRACE_SCOPE(draw);
+        target->FillMesh(pMesh, brush);
+    }
+
+    return hr;
+}
+
+// Draws the traces whose vertices are in m_points in the colors of their vertices. Each run of
+// segments whose first vertices fall into the same color bucket is a figure of the geometry of that
+// bucket, so the traces take one draw call per color that occurs, however often the color changes.
+HRESULT oscilloscope_renderer::draw_colored_traces(ID2D1Factory * factory, ID2D1RenderTarget * target, ID2D1Brush * brush, ID2D1StrokeStyle * stroke_style, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, t_uint32 sample_count) {
+    HRESULT hr = S_OK;
+
+    t_uint32 source = oscilloscope_color_source_amplitude;
+    if (m_config.m_color_mode == oscilloscope_config::color_mode_slope) {
+        source = oscilloscope_color_source_slope;
+    } else if (m_config.m_color_mode == oscilloscope_config::color_mode_time) {
+        source = oscilloscope_color_source_time;
+    }
+
+    m_buckets.set_size(trace_count * sample_count);
+    {
+        PFC_TRACE_SCOPE(classify);
+        for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+            t_size offset = (t_size) trace_index * sample_count;
+            oscilloscope_classify_vertices(m_points.get_ptr() + offset, sample_count, transforms[trace_index], source, m_buckets.get_ptr() + offset);
+        }
+    }
+
+    CComPtr<ID2D1PathGeometry> paths[oscilloscope_color_bucket_count];
+    CComPtr<ID2D1GeometrySink> sinks[oscilloscope_color_bucket_count];
+    {
+        PFC_TRACE_SCOPE(geometry);
+        for (t_uint32 trace_index = 0; trace_index < trace_count && SUCCEEDED(hr); ++trace_index) {
+            const D2D1_POINT_2F * points = m_points.get_ptr() + (t_size) trace_index * sample_count;
+            const t_uint8 * buckets = m_buckets.get_ptr() + (t_size) trace_index * sample_count;
+            t_uint32 begin = 0;
+            while (begin + 1 < sample_count && SUCCEEDED(hr)) {
+                t_uint32 bucket = buckets[begin];
+                t_uint32 end = begin + 1;
+                while (end + 1 < sample_count && buckets[end] == bucket) {
+                    ++end;
+                }
+
+                if (!sinks[bucket]) {
+                    hr = factory->CreatePathGeometry(&paths[bucket]);
+                    if (SUCCEEDED(hr)) {
+                        hr = paths[bucket]->Open(&sinks[bucket]);
+                    }
+                    if (FAILED(hr)) {
+                        break;
+                    }
+                }
+
+                // Neighbouring runs share a vertex, so the trace stays connected.
+                sinks[bucket]->BeginFigure(points[begin], D2D1_FIGURE_BEGIN_HOLLOW);
+                sinks[bucket]->AddLines(points + begin + 1, end - begin);
+                sinks[bucket]->EndFigure(D2D1_FIGURE_END_OPEN);
+                begin = end;
+            }
+        }
+    }
+
+    for (t_uint32 bucket = 0; bucket < oscilloscope_color_bucket_count; ++bucket) {
+        if (!sinks[bucket]) {
+            continue;
+        }
+        HRESULT close_hr = sinks[bucket]->Close();
+        if (SUCCEEDED(hr)) {
+            hr = close_hr;
+        }
+
+        CComPtr<ID2D1SolidColorBrush> pBucketBrush;
+        if (SUCCEEDED(hr)) {
+            hr = target->CreateSolidColorBrush(get_bucket_color(bucket), D2D1::BrushProperties(brush->GetOpacity()), &pBucketBrush);
+        }
+
+        if (SUCCEEDED(hr)) {
+            PFC_TRACE_SCOPE(draw);
+            target->DrawGeometry(paths[bucket], pBucketBrush, (FLOAT)m_config.get_line_stroke_width(), stroke_style);
+        }
+    }
+
+    return hr;
+}
+
+// The tuner and the pitch detector follow the channel that the trigger follows, or the downmix.
+t_uint32 oscilloscope_renderer::get_source_channel() const {
+    if (m_config.m_trigger_source >= oscilloscope_config::trigger_source_channel_1) {
+        t_uint32 channel_index = m_config.m_trigger_source - oscilloscope_config::trigger_source_channel_1;
+        if (m_config.is_channel_visible(channel_index)) {
+            return channel_index;
+        }
+    }
+    return oscilloscope_tuner::source_downmix;
+}
+
+double oscilloscope_renderer::get_window_duration() const {
+    if (m_config.m_timebase_periods > 0 && m_timebase_period > 0.0) {
+        return pfc::clip_t<double>(m_config.m_timebase_periods * m_timebase_period, 0.001, 0.8);
+    }
+    return m_config.get_window_duration();
+}
+
+void oscilloscope_renderer::analyze_pitch(const oscilloscope_sample_window_view & window, double window_time) {
+    PFC_TRACE_SCOPE(pitch);
+    PFC_STATIC_ASSERT((t_uint32) oscilloscope_pitch::source_downmix == (t_uint32) oscilloscope_tuner::source_downmix);
+    // The detector copies the samples it needs, so render() is free to reuse the matrix output.
+    m_pitch.analyze(m_channel_matrix.apply(window), window_time, get_source_channel());
+
+    // Small changes of pitch, as from vibrato, leave the timebase alone, and so does a pause.
+    double frequency = m_pitch.get_frequency();
+    if (frequency > 0.0) {
+        double period = 1.0 / frequency;
+        if (m_timebase_period == 0.0 || fabs(period - m_timebase_period) > 0.03 * m_timebase_period) {
+            m_timebase_period = period;
+        }
+    }
+}
+
+HRESULT oscilloscope_renderer::render_tuner(ID2D1RenderTarget * target, ID2D1Brush * brush, D2D1_SIZE_F size) {
+    pfc::string8 text;
+    oscilloscope_tuner::g_format(m_tuner.get_frequency(), text);
+    if (text.is_empty()) {
+        return S_OK;
+    }
+
+    return draw_text(target, brush, text, D2D1::RectF(8.0f, 4.0f, size.width - 8.0f, size.height), DWRITE_TEXT_ALIGNMENT_LEADING);
+}
+
+HRESULT oscilloscope_renderer::draw_text(ID2D1RenderTarget * target, ID2D1Brush * brush, const char * text, const D2D1_RECT_F & rect, DWRITE_TEXT_ALIGNMENT alignment) {
+    HRESULT hr = S_OK;
+
+    if (!m_text_format) {
+        if (!m_write_factory) {
+            hr = DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), reinterpret_cast<IUnknown **>(&m_write_factory));
+        }
+        if (SUCCEEDED(hr)) {
+            hr = m_write_factory->CreateTextFormat(L"Segoe UI", nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 16.0f, L"", &m_text_format);
+        }
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    m_text_format->SetTextAlignment(alignment);
+    pfc::stringcvt::string_wide_from_utf8 wide_text(text);
+    target->DrawText(wide_text, (UINT32) wide_text.length(), m_text_format, rect, brush);
+
+    return hr;
+}
+
+HRESULT oscilloscope_renderer::render_overview(ID2D1Factory * factory, ID2D1RenderTarget * target, ID2D1Brush * brush, const oscilloscope_overview & overview, double position) {
+    PFC_TRACE_SCOPE(overview);
+    HRESULT hr = S_OK;
+
+    target->SetAntialiasMode(m_config.m_low_quality_enabled ? D2D1_ANTIALIAS_MODE_ALIASED : D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+
+    D2D1_SIZE_F rtSize = target->GetSize();
+    t_uint32 column_count = (t_uint32) rtSize.width;
+    t_uint32 channel_count = overview.get_channel_count();
+    t_uint32 trace_count = (column_count > 1 && channel_count > 0) ? layout_channels(channel_count, column_count, rtSize) : 0;
+    if (trace_count == 0) {
+        return hr;
+    }
+
+    CComPtr<ID2D1PathGeometry> pPath;
+
+    hr = factory->CreatePathGeometry(&pPath);
+
+    if (SUCCEEDED(hr)) {
+        CComPtr<ID2D1GeometrySink> pSink;
+
+        hr = pPath->Open(&pSink);
+
+        if (SUCCEEDED(hr)) {
+            PFC_TRACE_SCOPE(geometry);
+            // Traces overlap in the overlay layout, and must not cancel each other out there.
+            pSink->SetFillMode(D2D1_FILL_MODE_WINDING);
+
+            // Each envelope is a closed figure along the maxima from left to right and back along
+            // the minima.
+            t_uint64 sample_count = overview.get_sample_count();
+            m_points.set_size(2 * column_count);
+            D2D1_POINT_2F * points = m_points.get_ptr();
+            for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+                const oscilloscope_channel_transform & transform = m_channel_transforms[trace_index];
+                for (t_uint32 column = 0; column < column_count; ++column) {
+                    t_uint64 begin = sample_count * column / column_count;
+                    t_uint64 end = pfc::max_t<t_uint64>(sample_count * (column + 1) / column_count, begin + 1);
+                    float range_min = 0.0f, range_max = 0.0f;
+                    overview.get_range(transform.m_channel_index, begin, end, range_min, range_max);
+
+                    float x = transform.m_x_offset + (float) column * transform.m_x_scale;
+                    points[column] = D2D1::Point2F(x, transform.m_y_offset - range_max * transform.m_y_scale);
+                    points[2 * column_count - 1 - column] = D2D1::Point2F(x, transform.m_y_offset - range_min * transform.m_y_scale);
+                }
+                pSink->BeginFigure(points[0], D2D1_FIGURE_BEGIN_FILLED);
+                pSink->AddLines(points + 1, 2 * column_count - 1);
+                pSink->EndFigure(D2D1_FIGURE_END_CLOSED);
+            }
+
+            hr = pSink->Close();
+        }
+    }
+
+    if (SUCCEEDED(hr)) {
+        PFC_TRACE_SCOPE(draw);
+        // The envelope is dimmed so that the cursor stands out where it crosses it.
+        brush->SetOpacity(0.6f);
+        target->FillGeometry(pPath, brush);
+        brush->SetOpacity(1.0f);
+
+        float fraction = (float) pfc::clip_t<double>(position * overview.get_sample_rate() / (double) overview.get_sample_count(), 0.0, 1.0);
+        for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+            const oscilloscope_channel_transform & transform = m_channel_transforms[trace_index];
+            float x = transform.m_x_offset + fraction * (float) (column_count - 1) * transform.m_x_scale;
+            target->DrawLine(D2D1::Point2F(x, transform.m_y_offset - transform.m_y_scale), D2D1::Point2F(x, transform.m_y_offset + transform.m_y_scale), brush, (FLOAT)m_config.get_line_stroke_width());
+        }
+    }
+
+    return hr;
+}
+
+t_uint32 oscilloscope_renderer::layout_channels(t_uint32 channel_count, t_uint32 sample_count, D2D1_SIZE_F size) {
+    m_channel_transforms.set_size(channel_count);
+
+    t_uint32 trace_count = 0;
+    t_uint32 position_count = pfc::max_t<t_uint32>(channel_count, oscilloscope_config::channel_order_count);
+    for (t_uint32 position = 0; position < position_count; ++position) {
+        t_uint32 channel_index = m_config.get_channel_at(position);
+        if (channel_index < channel_count && m_config.is_channel_visible(channel_index)) {
+            m_channel_transforms[trace_count++].m_channel_index = channel_index;
+        }
+    }
+
+    if (trace_count == 0) {
+        return 0;
+    }
+
+    t_uint32 column_count = 1;
+    t_uint32 row_count = 1;
+    if (m_config.m_channel_layout == oscilloscope_config::channel_layout_stacked) {
+        row_count = trace_count;
+    } else if (m_config.m_channel_layout == oscilloscope_config::channel_layout_grid) {
+        while (column_count * column_count < trace_count) {
+            ++column_count;
+        }
+        row_count = (trace_count + column_count - 1) / column_count;
+    }
+
+    float cell_width = size.width / (float) column_count;
+    float cell_height = size.height / (float) row_count;
+    if (cell_width < 1.0f || cell_height < 1.0f) {
+        return 0;
+    }
+
+    float zoom = (float) m_config.get_zoom_factor();
+    for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+        t_uint32 cell_index = (m_config.m_channel_layout == oscilloscope_config::channel_layout_overlay) ? 0 : trace_index;
+        oscilloscope_channel_transform & transform = m_channel_transforms[trace_index];
+        transform.m_x_offset = (float) (cell_index % column_count) * cell_width;
+        transform.m_x_scale = sample_count > 1 ? cell_width / (float) (sample_count - 1) : 0.0f;
+        transform.m_y_offset = ((float) (cell_index / column_count) + 0.5f) * cell_height + 0.5f;
+        transform.m_y_scale = zoom * cell_height / 2;
+    }
+
+    return trace_count;
+}
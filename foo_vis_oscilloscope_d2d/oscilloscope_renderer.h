@@ -0,0 +1,105 @@
+#pragma once
+
+#include "oscilloscope_auto_gain.h"
+#include "oscilloscope_average.h"
+#include "oscilloscope_band_split.h"
+#include "oscilloscope_channel_matrix.h"
+#include "oscilloscope_config.h"
+#include "oscilloscope_geometry.h"
+#include "oscilloscope_glow.h"
+#include "oscilloscope_overview.h"
+#include "oscilloscope_pitch.h"
+#include "oscilloscope_rasterizer.h"
+#include "oscilloscope_spectrum.h"
+#include "oscilloscope_tessellator.h"
+#include "oscilloscope_trigger.h"
+#include "oscilloscope_tuner.h"
+
+// Draws the traces of one window of audio onto any Direct2D render target: the window's own, or
+// the offscreen bitmaps of the frame exporter. The trigger, averaging, auto gain and tuner state
+// carries over from one call to the next, so a renderer should be fed consecutive windows.
+class oscilloscope_renderer {
+public:
+    oscilloscope_renderer();
+
+    // Takes a copy of the configuration. Triggers whose settings changed are reset.
+    void set_config(const oscilloscope_config & config);
+    const oscilloscope_config & get_config() const {return m_config;}
+
+    void reset();
+
+    // Forgets the resources that belong to the device of the target, as when the device is lost.
+    void discard_device_resources();
+
+    // Draws the traces of window, whose first sample is at window_time, between BeginDraw() and
+    // EndDraw() of target; the background is left to the caller. The samples are read in place.
+    // With the band split, every trace is drawn as its low, mid and high band, each in its color.
+    // Otherwise the color mode may color the traces vertex by vertex instead of with brush.
+    // A channel matrix is applied first; the channels that it makes are the channels of the window
+    // as far as everything else is concerned.
+    // With the spectrum enabled, its strip takes the bottom quarter of the target.
+    // With the glow enabled, the traces are drawn over their glow in the color of brush.
+    // In Low Quality Mode, the traces are stroked into triangles and filled as a mesh or, without
+    // hardware rendering, rasterized on the CPU in tiles.
+    // Large frames have their vertices generated and stroked, and the glow blurred, on pool, if
+    // not null.
+    HRESULT render(ID2D1Factory * factory, ID2D1RenderTarget * target, ID2D1Brush * brush, const oscilloscope_sample_window_view & input, double window_time, pfc::threadPool * pool);
+
+    // With the automatic timebase, the window spans m_timebase_periods periods of the fundamental
+    // that the pitch detector found in the samples passed to analyze_pitch(), which must follow
+    // each other without gaps from the time returned by get_pitch_next_time(). Otherwise, and
+    // until a fundamental is found, this is the configured window duration.
+    double get_window_duration() const;
+    double get_pitch_next_time(double now) {return m_pitch.get_next_time(now);}
+    void analyze_pitch(const oscilloscope_sample_window_view & window, double window_time);
+
+    // Draws the envelope of every channel of a whole track, one pixel column at a time, with a
+    // cursor at playback position.
+    HRESULT render_overview(ID2D1Factory * factory, ID2D1RenderTarget * target, ID2D1Brush * brush, const oscilloscope_overview & overview, double position);
+
+private:
+    t_uint32 layout_channels(t_uint32 channel_count, t_uint32 sample_count, D2D1_SIZE_F size);
+    void update_trigger_parameters();
+    t_uint32 get_source_channel() const;
+    HRESULT draw_glow(ID2D1RenderTarget * target, ID2D1Brush * brush, D2D1_SIZE_F size, t_uint32 trace_count, t_uint32 sample_count, pfc::threadPool * pool);
+    void stroke_traces(const D2D1_POINT_2F * points, t_uint32 trace_count, t_uint32 sample_count, pfc::threadPool * pool);
+    HRESULT draw_rasterized_traces(ID2D1RenderTarget * target, ID2D1Brush * brush, D2D1_SIZE_F size, t_uint32 group_count, t_uint32 trace_count, t_uint32 sample_count, pfc::threadPool * pool);
+    HRESULT draw_mesh(ID2D1RenderTarget * target, ID2D1Brush * brush, const D2D1_POINT_2F * points, t_uint32 trace_count, t_uint32 sample_count, pfc::threadPool * pool);
+    HRESULT draw_colored_traces(ID2D1Factory * factory, ID2D1RenderTarget * target, ID2D1Brush * brush, ID2D1StrokeStyle * stroke_style, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, t_uint32 sample_count);
+    HRESULT render_tuner(ID2D1RenderTarget * target, ID2D1Brush * brush, D2D1_SIZE_F size);
+    HRESULT draw_text(ID2D1RenderTarget * target, ID2D1Brush * brush, const char * text, const D2D1_RECT_F & rect, DWRITE_TEXT_ALIGNMENT alignment);
+
+    oscilloscope_config m_config;
+
+    oscilloscope_channel_matrix m_channel_matrix;
+    oscilloscope_trigger m_trigger;
+    oscilloscope_correlation_trigger m_correlation_trigger;
+    oscilloscope_average m_average;
+    oscilloscope_band_split m_band_split;
+    oscilloscope_auto_gain m_auto_gain;
+    oscilloscope_spectrum m_spectrum;
+    oscilloscope_tuner m_tuner;
+    oscilloscope_pitch m_pitch;
+    // Period that the automatic timebase is based on, in seconds, or 0 if none was found yet.
+    double m_timebase_period;
+
+    pfc::array_t<oscilloscope_channel_transform> m_channel_transforms;
+    // With the band split, the transforms of the low, mid and high band of every trace in turn.
+    pfc::array_t<oscilloscope_channel_transform> m_band_transforms;
+    pfc::array_t<D2D1_POINT_2F> m_points;
+    // Color bucket of each vertex in m_points, with a color mode.
+    pfc::array_t<t_uint8> m_buckets;
+    // In Low Quality Mode, the triangle strips of the traces of a group, or of all groups when they
+    // are rasterized here, and the triangles of a mesh.
+    pfc::array_t<D2D1_POINT_2F> m_strip;
+    pfc::array_t<D2D1_TRIANGLE> m_triangles;
+
+    oscilloscope_glow m_glow;
+    // Kept from one frame to the next while the size of the glow stays the same.
+    CComPtr<ID2D1Bitmap> m_glow_bitmap;
+    oscilloscope_rasterizer m_raster;
+    CComPtr<ID2D1Bitmap> m_raster_bitmap;
+
+    CComPtr<IDWriteFactory> m_write_factory;
+    CComPtr<IDWriteTextFormat> m_text_format;
+};
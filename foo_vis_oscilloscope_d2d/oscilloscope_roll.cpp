@@ -0,0 +1,237 @@
+#include "stdafx.h"
+
+#include "oscilloscope_roll.h"
+
+oscilloscope_roll::oscilloscope_roll()
+    : m_write_column(0)
+    , m_sample_rate(0)
+    , m_channel_count(0)
+    , m_have_position(false)
+    , m_next_sample(0)
+    , m_column_length(1.0)
+    , m_column_fill(0.0)
+    , m_pending_count(0)
+{
+    m_size = D2D1::SizeU(0, 0);
+}
+
+void oscilloscope_roll::set_config(const oscilloscope_config & config) {
+    bool layout_changed = config.m_roll_duration_seconds != m_config.m_roll_duration_seconds
+        || config.m_channel_layout != m_config.m_channel_layout
+        || config.m_channel_mask != m_config.m_channel_mask
+        || config.m_channel_order != m_config.m_channel_order
+        || config.m_zoom_percent != m_config.m_zoom_percent
+        || config.m_line_stroke_width != m_config.m_line_stroke_width;
+
+    m_config = config;
+    if (layout_changed) {
+        reset();
+    }
+}
+
+void oscilloscope_roll::reset() {
+    m_bitmap_target.Release();
+    m_size = D2D1::SizeU(0, 0);
+    m_sample_rate = 0;
+    m_channel_count = 0;
+    m_have_position = false;
+    m_pending_count = 0;
+}
+
+double oscilloscope_roll::get_next_time(double now) {
+    if (m_have_position && m_sample_rate > 0) {
+        double next = (double) m_next_sample / (double) m_sample_rate;
+        // Stream time only runs backwards after a seek.
+        if (next < now + 0.1 && now - next < m_config.get_roll_duration()) {
+            return next;
+        }
+    }
+    m_have_position = false;
+    return now;
+}
+
+HRESULT oscilloscope_roll::render(ID2D1RenderTarget * target, ID2D1Brush * brush, const D2D1_COLOR_F & background, const oscilloscope_sample_window_view & window, double window_time) {
+    PFC_TRACE_SCOPE(roll);
+    HRESULT hr = S_OK;
+
+    D2D1_SIZE_F rtSize = target->GetSize();
+    D2D1_SIZE_U size = D2D1::SizeU((UINT32) rtSize.width, (UINT32) rtSize.height);
+    if (size.width == 0 || size.height == 0) {
+        return hr;
+    }
+
+    bool format_changed = !window.is_empty() && (window.m_sample_rate != m_sample_rate || window.m_channel_count != m_channel_count);
+    if (!m_bitmap_target || size.width != m_size.width || size.height != m_size.height || format_changed) {
+        if (window.is_empty() && m_sample_rate == 0) {
+            return hr;
+        }
+
+        // Starts a new recording on a blank bitmap.
+        m_bitmap_target.Release();
+        hr = target->CreateCompatibleRenderTarget(D2D1::SizeF((FLOAT) size.width, (FLOAT) size.height), &m_bitmap_target);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        m_bitmap_target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+        m_bitmap_target->BeginDraw();
+        m_bitmap_target->Clear(background);
+        hr = m_bitmap_target->EndDraw();
+        if (FAILED(hr)) {
+            return hr;
+        }
+
+        m_size = size;
+        m_write_column = 0;
+        m_pending_count = 0;
+        m_column_fill = 0.0;
+        if (format_changed) {
+            m_sample_rate = window.m_sample_rate;
+            m_channel_count = window.m_channel_count;
+            m_have_position = false;
+        }
+        m_column_length = pfc::max_t<double>((double) m_sample_rate * m_config.get_roll_duration() / (double) size.width, 1.0);
+        layout_traces(m_channel_count, size);
+    }
+
+    if (!window.is_empty()) {
+        if (!m_have_position) {
+            m_next_sample = (t_int64) floor(window_time * window.m_sample_rate + 0.5);
+            m_have_position = true;
+        }
+        add_samples(window);
+        m_next_sample += window.m_sample_count;
+    }
+
+    draw_columns(brush, background);
+
+    // The column after the last one written is the oldest, and goes to the left edge.
+    CComPtr<ID2D1Bitmap> bitmap;
+    hr = m_bitmap_target->GetBitmap(&bitmap);
+    if (SUCCEEDED(hr)) {
+        PFC_TRACE_SCOPE(draw);
+        float width = (float) size.width;
+        float height = (float) size.height;
+        float split = (float) m_write_column;
+        target->DrawBitmap(bitmap, D2D1::RectF(0.0f, 0.0f, width - split, height), 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, D2D1::RectF(split, 0.0f, width, height));
+        if (m_write_column > 0) {
+            target->DrawBitmap(bitmap, D2D1::RectF(width - split, 0.0f, width, height), 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, D2D1::RectF(0.0f, 0.0f, split, height));
+        }
+    }
+
+    return hr;
+}
+
+void oscilloscope_roll::layout_traces(t_uint32 channel_count, D2D1_SIZE_U size) {
+    m_traces.set_size(channel_count);
+
+    t_uint32 trace_count = 0;
+    t_uint32 position_count = pfc::max_t<t_uint32>(channel_count, oscilloscope_config::channel_order_count);
+    for (t_uint32 position = 0; position < position_count; ++position) {
+        t_uint32 channel_index = m_config.get_channel_at(position);
+        if (channel_index < channel_count && m_config.is_channel_visible(channel_index)) {
+            m_traces[trace_count++].m_channel_index = channel_index;
+        }
+    }
+    m_traces.set_size(trace_count);
+
+    // A grid would need a circular region per cell, so it rolls stacked instead.
+    t_uint32 row_count = (m_config.m_channel_layout == oscilloscope_config::channel_layout_overlay) ? 1 : pfc::max_t<t_uint32>(trace_count, 1);
+    float cell_height = (float) size.height / (float) row_count;
+    float zoom = (float) m_config.get_zoom_factor();
+    for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+        t_uint32 row = (row_count == 1) ? 0 : trace_index;
+        m_traces[trace_index].m_y_offset = ((float) row + 0.5f) * cell_height;
+        m_traces[trace_index].m_y_scale = zoom * cell_height / 2;
+    }
+
+    m_column_min.set_size(trace_count);
+    m_column_max.set_size(trace_count);
+    m_last_sample.set_size(trace_count);
+    for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+        m_column_min[trace_index] = m_column_max[trace_index] = m_last_sample[trace_index] = 0;
+    }
+}
+
+void oscilloscope_roll::add_samples(const oscilloscope_sample_window_view & window) {
+    t_uint32 trace_count = m_traces.get_size();
+    if (trace_count == 0) {
+        return;
+    }
+
+    for (t_uint32 sample_index = 0; sample_index < window.m_sample_count; ++sample_index) {
+        const audio_sample * frame = window.get_frame(sample_index);
+        for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+            audio_sample value = frame[m_traces[trace_index].m_channel_index];
+            m_column_min[trace_index] = pfc::min_t(m_column_min[trace_index], value);
+            m_column_max[trace_index] = pfc::max_t(m_column_max[trace_index], value);
+            m_last_sample[trace_index] = value;
+        }
+
+        m_column_fill += 1.0;
+        if (m_column_fill >= m_column_length) {
+            m_column_fill -= m_column_length;
+
+            t_size offset = (t_size) m_pending_count * trace_count * 2;
+            if (m_pending.get_size() < offset + trace_count * 2) {
+                m_pending.set_size(pfc::max_t<t_size>(offset + trace_count * 2, m_pending.get_size() * 2));
+            }
+            for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+                m_pending[offset + trace_index * 2] = m_column_min[trace_index];
+                m_pending[offset + trace_index * 2 + 1] = m_column_max[trace_index];
+                m_column_min[trace_index] = m_column_max[trace_index] = m_last_sample[trace_index];
+            }
+            ++m_pending_count;
+        }
+    }
+}
+
+void oscilloscope_roll::draw_columns(ID2D1Brush * brush, const D2D1_COLOR_F & background) {
+    if (m_pending_count == 0) {
+        return;
+    }
+
+    // Columns that would be overwritten within this frame are skipped.
+    t_uint32 width = m_size.width;
+    t_uint32 skip = m_pending_count > width ? m_pending_count - width : 0;
+    t_uint32 count = m_pending_count - skip;
+    m_write_column = (t_uint32) (((t_uint64) m_write_column + skip) % width);
+
+    m_bitmap_target->BeginDraw();
+
+    float height = (float) m_size.height;
+    t_uint32 first_run = pfc::min_t<t_uint32>(count, width - m_write_column);
+    m_bitmap_target->PushAxisAlignedClip(D2D1::RectF((float) m_write_column, 0.0f, (float) (m_write_column + first_run), height), D2D1_ANTIALIAS_MODE_ALIASED);
+    m_bitmap_target->Clear(background);
+    m_bitmap_target->PopAxisAlignedClip();
+    if (count > first_run) {
+        m_bitmap_target->PushAxisAlignedClip(D2D1::RectF(0.0f, 0.0f, (float) (count - first_run), height), D2D1_ANTIALIAS_MODE_ALIASED);
+        m_bitmap_target->Clear(background);
+        m_bitmap_target->PopAxisAlignedClip();
+    }
+
+    // Each column of each trace is a bar from its minimum to its maximum, at least as thick as
+    // the line stroke, so that quiet passages stay visible.
+    t_uint32 trace_count = m_traces.get_size();
+    float stroke_width = (float) m_config.get_line_stroke_width();
+    const audio_sample * pending = m_pending.get_ptr() + (t_size) skip * trace_count * 2;
+    for (t_uint32 column_index = 0; column_index < count; ++column_index) {
+        float x = (float) ((m_write_column + column_index) % width);
+        for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index, pending += 2) {
+            const trace & t = m_traces[trace_index];
+            float top = t.m_y_offset - (float) pending[1] * t.m_y_scale;
+            float bottom = t.m_y_offset - (float) pending[0] * t.m_y_scale;
+            if (bottom - top < stroke_width) {
+                float center = (top + bottom) / 2;
+                top = center - stroke_width / 2;
+                bottom = center + stroke_width / 2;
+            }
+            m_bitmap_target->FillRectangle(D2D1::RectF(x, top, x + 1.0f, bottom), brush);
+        }
+    }
+
+    m_write_column = (m_write_column + count) % width;
+    m_pending_count = 0;
+
+    // A failure here means the device was lost, which the window target reports as well.
+    m_bitmap_target->EndDraw();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "oscilloscope_config.h"
+#include "oscilloscope_sample_window.h"
+
+// Free-running chart recorder display: the traces scroll from right to left across the roll
+// duration. Each pixel column holds the minimum and maximum of the samples that fell into it.
+// Columns are drawn once, as their samples arrive, into a circular offscreen bitmap, which is
+// composited onto the target in two parts around its write position. The cost of a frame thus
+// depends on the audio that arrived since the previous one, not on the roll duration.
+class oscilloscope_roll {
+public:
+    oscilloscope_roll();
+
+    // Takes a copy of the configuration. The recording starts over if the layout changed.
+    void set_config(const oscilloscope_config & config);
+
+    // Forgets the recording and the offscreen bitmap, as when the device is lost.
+    void reset();
+
+    // Returns the stream time from which the next window should start for the recording to
+    // continue seamlessly, given the current stream time. After a seek or a long gap the
+    // recording starts over from now.
+    double get_next_time(double now);
+
+    // Records window, which starts at window_time, and draws the recording between BeginDraw()
+    // and EndDraw() of target. An empty window only redraws what was recorded before.
+    HRESULT render(ID2D1RenderTarget * target, ID2D1Brush * brush, const D2D1_COLOR_F & background, const oscilloscope_sample_window_view & window, double window_time);
+
+private:
+    struct trace {
+        t_uint32 m_channel_index;
+        float m_y_offset;
+        float m_y_scale;
+    };
+
+    void layout_traces(t_uint32 channel_count, D2D1_SIZE_U size);
+    void add_samples(const oscilloscope_sample_window_view & window);
+    void draw_columns(ID2D1Brush * brush, const D2D1_COLOR_F & background);
+
+    oscilloscope_config m_config;
+
+    CComPtr<ID2D1BitmapRenderTarget> m_bitmap_target;
+    D2D1_SIZE_U m_size;
+    t_uint32 m_write_column;
+
+    t_uint32 m_sample_rate;
+    t_uint32 m_channel_count;
+    bool m_have_position;
+    t_int64 m_next_sample;
+
+    // Samples per column, and how many samples of the current column have been seen.
+    double m_column_length;
+    double m_column_fill;
+
+    pfc::array_t<trace> m_traces;
+    // Running minimum and maximum of each trace over the current column, and the last sample of
+    // each trace, which starts the next column so that consecutive columns connect.
+    pfc::array_t<audio_sample> m_column_min;
+    pfc::array_t<audio_sample> m_column_max;
+    pfc::array_t<audio_sample> m_last_sample;
+    // Completed columns that are not drawn yet; minimum and maximum of every trace per column.
+    pfc::array_t<audio_sample> m_pending;
+    t_uint32 m_pending_count;
+};
@@ -0,0 +1,77 @@
+#include "stdafx.h"
+
+#include "oscilloscope_sample_buffer.h"
+
+oscilloscope_sample_buffer::oscilloscope_sample_buffer()
+    : m_sample_rate(44100)
+    , m_channel_count(1)
+    , m_start(0)
+    , m_offset(0)
+    , m_count(0)
+{
+}
+
+void oscilloscope_sample_buffer::reset(t_uint32 sample_rate, t_uint32 channel_count, t_int64 start) {
+    m_sample_rate = sample_rate;
+    m_channel_count = channel_count;
+    m_start = start;
+    m_offset = 0;
+    m_count = 0;
+}
+
+void oscilloscope_sample_buffer::append(const audio_sample * samples, t_size sample_count) {
+    if (m_offset > m_count) {
+        memmove(m_samples.get_ptr(), m_samples.get_ptr() + m_offset * m_channel_count, m_count * m_channel_count * sizeof(audio_sample));
+        m_offset = 0;
+    }
+
+    t_size size = (m_offset + m_count + sample_count) * m_channel_count;
+    if (m_samples.get_size() < size) {
+        m_samples.set_size(size);
+    }
+    memcpy(m_samples.get_ptr() + (m_offset + m_count) * m_channel_count, samples, sample_count * m_channel_count * sizeof(audio_sample));
+    m_count += sample_count;
+}
+
+void oscilloscope_sample_buffer::discard(t_int64 first) {
+    if (first > m_start) {
+        t_size drop = (t_size) pfc::min_t<t_int64>(first - m_start, m_count);
+        m_offset += drop;
+        m_count -= drop;
+        m_start += drop;
+    }
+}
+
+oscilloscope_sample_window_view oscilloscope_sample_buffer::get_window(t_int64 first, t_size count, bool downmix) {
+    // Silence before the held samples, the held samples, and silence after them.
+    t_size lead = (t_size) pfc::clip_t<t_int64>(m_start - first, 0, count);
+    t_size copy_end = (t_size) pfc::clip_t<t_int64>(m_start + (t_int64) m_count - first, lead, count);
+    const audio_sample * held = m_samples.get_ptr() + (m_offset + (t_size) (first + (t_int64) lead - m_start)) * m_channel_count;
+
+    if (lead == 0 && copy_end == count && !(downmix && m_channel_count > 1)) {
+        return oscilloscope_sample_window_view(held, m_channel_count, (t_uint32) count, m_sample_rate);
+    }
+
+    if (m_window.get_size() < count * m_channel_count) {
+        m_window.set_size(count * m_channel_count);
+    }
+    audio_sample * out = m_window.get_ptr();
+    memset(out, 0, lead * m_channel_count * sizeof(audio_sample));
+    if (copy_end > lead) {
+        memcpy(out + lead * m_channel_count, held, (copy_end - lead) * m_channel_count * sizeof(audio_sample));
+    }
+    memset(out + copy_end * m_channel_count, 0, (count - copy_end) * m_channel_count * sizeof(audio_sample));
+
+    if (downmix && m_channel_count > 1) {
+        audio_sample scale = (audio_sample) 1 / (audio_sample) m_channel_count;
+        for (t_size sample_index = 0; sample_index < count; ++sample_index) {
+            audio_sample sum = 0;
+            for (t_uint32 channel_index = 0; channel_index < m_channel_count; ++channel_index) {
+                sum += out[sample_index * m_channel_count + channel_index];
+            }
+            out[sample_index] = sum * scale;
+        }
+        return oscilloscope_sample_window_view(out, 1, (t_uint32) count, m_sample_rate);
+    }
+    return oscilloscope_sample_window_view(out, m_channel_count, (t_uint32) count, m_sample_rate);
+}
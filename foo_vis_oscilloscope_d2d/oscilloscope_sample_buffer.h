@@ -0,0 +1,45 @@
+#pragma once
+
+#include "oscilloscope_sample_window.h"
+
+// Interleaved samples of a stream that is appended to as it is decoded, and read as windows that
+// only move forward in time. Positions before the first or after the last held sample read as
+// silence.
+class oscilloscope_sample_buffer {
+public:
+    oscilloscope_sample_buffer();
+
+    // Starts over without samples; the next sample appended is at position start.
+    void reset(t_uint32 sample_rate, t_uint32 channel_count, t_int64 start);
+
+    t_uint32 get_sample_rate() const {return m_sample_rate;}
+    t_uint32 get_channel_count() const {return m_channel_count;}
+
+    // Position one past the last held sample.
+    t_int64 get_end() const {return m_start + (t_int64) m_count;}
+
+    // Appends sample_count frames.
+    void append(const audio_sample * samples, t_size sample_count);
+
+    // Drops the samples before position first, which are not needed again.
+    void discard(t_int64 first);
+
+    // Returns the samples of [first, first + count), valid until the next call. Windows that lie
+    // within the held samples are returned in place; only silence padding and downmixing go
+    // through a copy.
+    oscilloscope_sample_window_view get_window(t_int64 first, t_size count, bool downmix);
+
+private:
+    t_uint32 m_sample_rate;
+    t_uint32 m_channel_count;
+
+    // Position of the first held sample, which is m_offset samples into m_samples, and number of
+    // samples held. Samples before the offset are no longer needed; they are only dropped once
+    // they outnumber the held ones, to keep the moves rare.
+    t_int64 m_start;
+    t_size m_offset;
+    t_size m_count;
+    pfc::array_t<audio_sample> m_samples;
+
+    pfc::array_t<audio_sample> m_window;
+};
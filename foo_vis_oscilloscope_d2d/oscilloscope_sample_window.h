@@ -0,0 +1,25 @@
+#pragma once
+
+// Non-owning view of a window of interleaved samples, such as the data of an audio_chunk or a
+// range of a decode buffer. Frames are densely interleaved, so the channel count is also the
+// stride from one frame to the next. Views are cheap to copy; the samples must outlive them.
+struct oscilloscope_sample_window_view {
+    const audio_sample * m_samples;
+    t_uint32 m_channel_count;
+    t_uint32 m_sample_count;
+    t_uint32 m_sample_rate;
+
+    oscilloscope_sample_window_view() : m_samples(nullptr), m_channel_count(0), m_sample_count(0), m_sample_rate(0) {}
+    oscilloscope_sample_window_view(const audio_sample * samples, t_uint32 channel_count, t_uint32 sample_count, t_uint32 sample_rate)
+        : m_samples(samples), m_channel_count(channel_count), m_sample_count(sample_count), m_sample_rate(sample_rate) {}
+
+    bool is_empty() const {return m_channel_count == 0 || m_sample_count == 0;}
+    t_size get_data_size() const {return (t_size) m_channel_count * m_sample_count;}
+    const audio_sample * get_frame(t_uint32 sample_index) const {return m_samples + (t_size) sample_index * m_channel_count;}
+
+    // Returns frames [begin, begin + count) of this window.
+    oscilloscope_sample_window_view get_range(t_uint32 begin, t_uint32 count) const {
+        PFC_ASSERT(begin <= m_sample_count && count <= m_sample_count - begin);
+        return oscilloscope_sample_window_view(get_frame(begin), m_channel_count, count, m_sample_rate);
+    }
+};
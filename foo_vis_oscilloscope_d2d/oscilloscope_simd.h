@@ -0,0 +1,9 @@
+#pragma once
+
+// SSE2 is part of the x64 baseline and is enabled by default for x86 builds since Visual Studio 2012.
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define OSCILLOSCOPE_HAVE_SSE2 1
+#include <emmintrin.h>
+#else
+#define OSCILLOSCOPE_HAVE_SSE2 0
+#endif
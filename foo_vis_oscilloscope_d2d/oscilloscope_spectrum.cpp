@@ -0,0 +1,145 @@
+#include "stdafx.h"
+
+#include "oscilloscope_spectrum.h"
+#include "oscilloscope_simd.h"
+
+#include <foobar2000/helpers/VisUtils.h>
+
+namespace {
+    // Windows of up to 800 ms at high sample rates would call for transforms far larger than the
+    // strip can show.
+    const t_size g_max_fft_size = 16384;
+    const double g_min_frequency = 20.0;
+    const float g_floor_db = -90.0f;
+}
+
+oscilloscope_spectrum::oscilloscope_spectrum()
+    : m_plan(nullptr)
+    , m_column_plan(nullptr)
+    , m_column_sample_rate(0)
+{
+}
+
+HRESULT oscilloscope_spectrum::render(ID2D1Factory * factory, ID2D1RenderTarget * target, ID2D1Brush * brush, const oscilloscope_sample_window_view & window, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, const D2D1_RECT_F & rect) {
+    PFC_TRACE_SCOPE(spectrum);
+    HRESULT hr = S_OK;
+
+    t_uint32 column_count = (t_uint32) (rect.right - rect.left);
+    float height = rect.bottom - rect.top;
+    if (window.m_sample_count < 4 || window.m_sample_rate == 0 || trace_count == 0 || column_count < 2 || height < 1.0f) {
+        return hr;
+    }
+
+    analyze(window, transforms, trace_count);
+    map_columns(column_count, window.m_sample_rate);
+
+    // The power of each column is the largest of its bins, scaled so that a full-scale sine reads
+    // 0 dB: the Hann window halves the amplitude, and a real sine splits over two bins.
+    const float * power = m_re.get_ptr();
+    float scale = 4.0f / (float) m_plan->get_size();
+    float power_scale = scale * scale;
+    m_points.set_size(column_count + 2);
+    D2D1_POINT_2F * points = m_points.get_ptr();
+    for (t_uint32 column = 0; column < column_count; ++column) {
+        float peak = 0.0f;
+        for (t_uint32 bin = m_column_bins[2 * column]; bin < m_column_bins[2 * column + 1]; ++bin) {
+            peak = pfc::max_t(peak, power[bin]);
+        }
+        float level = 10.0f * log10f(peak * power_scale + 1e-20f);
+        float fraction = pfc::clip_t<float>(1.0f - level / g_floor_db, 0.0f, 1.0f);
+        points[column + 1] = D2D1::Point2F(rect.left + (float) column, rect.bottom - fraction * height);
+    }
+    points[0] = D2D1::Point2F(rect.left, rect.bottom);
+    points[column_count + 1] = D2D1::Point2F(rect.left + (float) (column_count - 1), rect.bottom);
+
+    CComPtr<ID2D1PathGeometry> pPath;
+    hr = factory->CreatePathGeometry(&pPath);
+    if (SUCCEEDED(hr)) {
+        CComPtr<ID2D1GeometrySink> pSink;
+        hr = pPath->Open(&pSink);
+        if (SUCCEEDED(hr)) {
+            pSink->BeginFigure(points[0], D2D1_FIGURE_BEGIN_FILLED);
+            pSink->AddLines(points + 1, column_count + 1);
+            pSink->EndFigure(D2D1_FIGURE_END_CLOSED);
+            hr = pSink->Close();
+        }
+    }
+
+    if (SUCCEEDED(hr)) {
+        PFC_TRACE_SCOPE(draw);
+        brush->SetOpacity(0.6f);
+        target->FillGeometry(pPath, brush);
+        brush->SetOpacity(1.0f);
+    }
+
+    return hr;
+}
+
+// Leaves the power of every bin in m_re.
+void oscilloscope_spectrum::analyze(const oscilloscope_sample_window_view & window, const oscilloscope_channel_transform * transforms, t_uint32 trace_count) {
+    t_size fft_size = pfc::min_t<t_size>(VisUtils::MatchFFTSize(window.m_sample_count), g_max_fft_size);
+    if (m_plan == nullptr || m_plan->get_size() != fft_size) {
+        m_plan = &oscilloscope_fft_plan::g_get_plan(fft_size);
+        m_input.set_size(fft_size);
+        m_re.set_size(m_plan->get_bin_count());
+        m_im.set_size(m_plan->get_bin_count());
+    }
+
+    // The transform covers the middle of the window, which is downmixed and windowed in one pass.
+    const oscilloscope_sample_window_view range = window.get_range((window.m_sample_count - (t_uint32) fft_size) / 2, (t_uint32) fft_size);
+    const float * hann = m_plan->get_window();
+    float * input = m_input.get_ptr();
+    float gain = 1.0f / (float) trace_count;
+    for (t_uint32 sample_index = 0; sample_index < range.m_sample_count; ++sample_index) {
+        const audio_sample * frame = range.get_frame(sample_index);
+        audio_sample sum = 0;
+        for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+            sum += frame[transforms[trace_index].m_channel_index];
+        }
+        input[sample_index] = (float) sum * gain * hann[sample_index];
+    }
+
+    float * re = m_re.get_ptr();
+    float * im = m_im.get_ptr();
+    m_plan->forward(input, re, im);
+
+    t_size bin_count = m_plan->get_bin_count();
+    t_size bin = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+    for (; bin + 4 <= bin_count; bin += 4) {
+        __m128 r = _mm_load_ps(re + bin);
+        __m128 i = _mm_load_ps(im + bin);
+        _mm_store_ps(re + bin, _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i)));
+    }
+#endif
+    for (; bin < bin_count; ++bin) {
+        re[bin] = re[bin] * re[bin] + im[bin] * im[bin];
+    }
+}
+
+// Column c is centered on the frequency 20 Hz * (Nyquist / 20 Hz)^(c / (column_count - 1)). Low
+// columns that fall between two bins take the nearest one.
+void oscilloscope_spectrum::map_columns(t_uint32 column_count, t_uint32 sample_rate) {
+    if (m_column_plan == m_plan && m_column_sample_rate == sample_rate && m_column_bins.get_size() == 2 * column_count) {
+        return;
+    }
+    m_column_plan = m_plan;
+    m_column_sample_rate = sample_rate;
+    m_column_bins.set_size(2 * column_count);
+
+    double bin_limit = (double) (m_plan->get_bin_count() - 1);
+    double nyquist = (double) sample_rate / 2;
+    double min_frequency = pfc::min_t<double>(g_min_frequency, nyquist / 2);
+    double ratio = log(nyquist / min_frequency) / (double) (column_count - 1);
+    double bins_per_hz = (double) m_plan->get_size() / (double) sample_rate;
+    for (t_uint32 column = 0; column < column_count; ++column) {
+        double begin = floor(min_frequency * exp(((double) column - 0.5) * ratio) * bins_per_hz + 0.5);
+        double end = floor(min_frequency * exp(((double) column + 0.5) * ratio) * bins_per_hz + 0.5);
+        if (end <= begin) {
+            begin = floor(min_frequency * exp((double) column * ratio) * bins_per_hz + 0.5);
+            end = begin + 1;
+        }
+        m_column_bins[2 * column] = (t_uint32) pfc::clip_t<double>(begin, 0.0, bin_limit);
+        m_column_bins[2 * column + 1] = (t_uint32) pfc::clip_t<double>(end, 1.0, bin_limit + 1);
+    }
+}
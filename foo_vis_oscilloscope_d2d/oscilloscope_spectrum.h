@@ -0,0 +1,34 @@
+#pragma once
+
+#include "oscilloscope_fft.h"
+#include "oscilloscope_geometry.h"
+
+// Magnitude spectrum of the drawn channels on a logarithmic frequency axis, drawn as a strip below
+// the traces. The transform runs on the samples of the window that is drawn, with the cached plan
+// of the size that VisUtils::MatchFFTSize() picks for the window, so no spectrum chunk is fetched
+// from the visualisation stream.
+class oscilloscope_spectrum {
+public:
+    oscilloscope_spectrum();
+
+    // Computes the spectrum of the downmix of the trace_count channels of window, and draws it into
+    // rect between BeginDraw() and EndDraw() of target.
+    HRESULT render(ID2D1Factory * factory, ID2D1RenderTarget * target, ID2D1Brush * brush, const oscilloscope_sample_window_view & window, const oscilloscope_channel_transform * transforms, t_uint32 trace_count, const D2D1_RECT_F & rect);
+
+private:
+    void analyze(const oscilloscope_sample_window_view & window, const oscilloscope_channel_transform * transforms, t_uint32 trace_count);
+    void map_columns(t_uint32 column_count, t_uint32 sample_rate);
+
+    const oscilloscope_fft_plan * m_plan;
+    pfc::mem_block_aligned_t<float> m_input;
+    pfc::mem_block_aligned_t<float> m_re;
+    pfc::mem_block_aligned_t<float> m_im;
+
+    // First bin and one past the last bin of each column, for the plan size, sample rate and column
+    // count they were computed for.
+    pfc::array_t<t_uint32> m_column_bins;
+    const oscilloscope_fft_plan * m_column_plan;
+    t_uint32 m_column_sample_rate;
+
+    pfc::array_t<D2D1_POINT_2F> m_points;
+};
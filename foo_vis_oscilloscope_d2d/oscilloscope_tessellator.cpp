@@ -0,0 +1,193 @@
+#include "stdafx.h"
+
+#include "oscilloscope_tessellator.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    struct stroke_parameters {
+        float m_half_width;
+        float m_limit_squared;
+        bool m_miter;
+    };
+
+    // Computes the four strip vertices of the join at point between the segment from prev and the
+    // segment to next. A segment of no length, as at either end of a trace, takes the normal of the
+    // other. The edges of the two segments meet at point + m * 2 h / |m|^2 on the left, where m is
+    // the sum of their unit normals, which is more than limit h away when |m| < 2 / limit.
+    void stroke_join(const oscilloscope_point & prev, const oscilloscope_point & point, const oscilloscope_point & next, const stroke_parameters & parameters, oscilloscope_point * out) {
+        float dx0 = point.x - prev.x;
+        float dy0 = point.y - prev.y;
+        float dx1 = next.x - point.x;
+        float dy1 = next.y - point.y;
+        float length0 = sqrt(dx0 * dx0 + dy0 * dy0);
+        float length1 = sqrt(dx1 * dx1 + dy1 * dy1);
+        float inverse0 = (length0 > 0.0f) ? 1.0f / length0 : 0.0f;
+        float inverse1 = (length1 > 0.0f) ? 1.0f / length1 : 0.0f;
+        float nx0 = -dy0 * inverse0;
+        float ny0 = dx0 * inverse0;
+        float nx1 = -dy1 * inverse1;
+        float ny1 = dx1 * inverse1;
+        if (!(length0 > 0.0f)) {
+            nx0 = nx1;
+            ny0 = ny1;
+        }
+        if (!(length1 > 0.0f)) {
+            nx1 = nx0;
+            ny1 = ny0;
+        }
+
+        float h = parameters.m_half_width;
+        out[0].x = point.x + nx0 * h;
+        out[0].y = point.y + ny0 * h;
+        out[1].x = point.x - nx0 * h;
+        out[1].y = point.y - ny0 * h;
+        out[2].x = point.x + nx1 * h;
+        out[2].y = point.y + ny1 * h;
+        out[3].x = point.x - nx1 * h;
+        out[3].y = point.y - ny1 * h;
+
+        float mx = nx0 + nx1;
+        float my = ny0 + ny1;
+        float m_squared = mx * mx + my * my;
+        if (parameters.m_miter && m_squared * parameters.m_limit_squared >= 4.0f) {
+            float scale = (2.0f * h) / m_squared;
+            float vx = mx * scale;
+            float vy = my * scale;
+            // Turning left puts the right side on the outside.
+            if (dx0 * dy1 - dy0 * dx1 > 0.0f) {
+                out[1].x = out[3].x = point.x - vx;
+                out[1].y = out[3].y = point.y - vy;
+            } else {
+                out[0].x = out[2].x = point.x + vx;
+                out[0].y = out[2].y = point.y + vy;
+            }
+        }
+    }
+
+#if OSCILLOSCOPE_HAVE_SSE2
+    inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // stroke_join() for the four vertices at points[0] to points[3], whose neighbors on both sides
+    // must exist. The interleaved points are split into x and y vectors with shuffles, and the
+    // strip vertices are interleaved again with two transposes, one for each pair.
+    void stroke_joins(const oscilloscope_point * points, const stroke_parameters & parameters, oscilloscope_point * out) {
+        const float * p = (const float *) points;
+        __m128 prev_01 = _mm_loadu_ps(p - 2);
+        __m128 prev_23 = _mm_loadu_ps(p + 2);
+        __m128 point_01 = _mm_loadu_ps(p);
+        __m128 point_23 = _mm_loadu_ps(p + 4);
+        __m128 next_01 = _mm_loadu_ps(p + 2);
+        __m128 next_23 = _mm_loadu_ps(p + 6);
+        __m128 prev_x = _mm_shuffle_ps(prev_01, prev_23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 prev_y = _mm_shuffle_ps(prev_01, prev_23, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 x = _mm_shuffle_ps(point_01, point_23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(point_01, point_23, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 next_x = _mm_shuffle_ps(next_01, next_23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 next_y = _mm_shuffle_ps(next_01, next_23, _MM_SHUFFLE(3, 1, 3, 1));
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 half_width = _mm_set1_ps(parameters.m_half_width);
+        __m128 dx0 = _mm_sub_ps(x, prev_x);
+        __m128 dy0 = _mm_sub_ps(y, prev_y);
+        __m128 dx1 = _mm_sub_ps(next_x, x);
+        __m128 dy1 = _mm_sub_ps(next_y, y);
+        __m128 length0 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx0, dx0), _mm_mul_ps(dy0, dy0)));
+        __m128 length1 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx1, dx1), _mm_mul_ps(dy1, dy1)));
+        __m128 valid0 = _mm_cmpgt_ps(length0, zero);
+        __m128 valid1 = _mm_cmpgt_ps(length1, zero);
+        __m128 inverse0 = _mm_and_ps(valid0, _mm_div_ps(one, length0));
+        __m128 inverse1 = _mm_and_ps(valid1, _mm_div_ps(one, length1));
+        __m128 nx0 = _mm_mul_ps(_mm_xor_ps(dy0, sign), inverse0);
+        __m128 ny0 = _mm_mul_ps(dx0, inverse0);
+        __m128 nx1 = _mm_mul_ps(_mm_xor_ps(dy1, sign), inverse1);
+        __m128 ny1 = _mm_mul_ps(dx1, inverse1);
+        nx0 = select(valid0, nx0, nx1);
+        ny0 = select(valid0, ny0, ny1);
+        nx1 = select(valid1, nx1, nx0);
+        ny1 = select(valid1, ny1, ny0);
+
+        __m128 x0 = _mm_add_ps(x, _mm_mul_ps(nx0, half_width));
+        __m128 y0 = _mm_add_ps(y, _mm_mul_ps(ny0, half_width));
+        __m128 x1 = _mm_sub_ps(x, _mm_mul_ps(nx0, half_width));
+        __m128 y1 = _mm_sub_ps(y, _mm_mul_ps(ny0, half_width));
+        __m128 x2 = _mm_add_ps(x, _mm_mul_ps(nx1, half_width));
+        __m128 y2 = _mm_add_ps(y, _mm_mul_ps(ny1, half_width));
+        __m128 x3 = _mm_sub_ps(x, _mm_mul_ps(nx1, half_width));
+        __m128 y3 = _mm_sub_ps(y, _mm_mul_ps(ny1, half_width));
+
+        if (parameters.m_miter) {
+            __m128 mx = _mm_add_ps(nx0, nx1);
+            __m128 my = _mm_add_ps(ny0, ny1);
+            __m128 m_squared = _mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my));
+            __m128 miter = _mm_cmpge_ps(_mm_mul_ps(m_squared, _mm_set1_ps(parameters.m_limit_squared)), _mm_set1_ps(4.0f));
+            __m128 scale = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(2.0f), half_width), m_squared);
+            __m128 vx = _mm_mul_ps(mx, scale);
+            __m128 vy = _mm_mul_ps(my, scale);
+            __m128 right_outer = _mm_and_ps(miter, _mm_cmpgt_ps(_mm_sub_ps(_mm_mul_ps(dx0, dy1), _mm_mul_ps(dy0, dx1)), zero));
+            __m128 left_outer = _mm_andnot_ps(right_outer, miter);
+            __m128 left_x = _mm_add_ps(x, vx);
+            __m128 left_y = _mm_add_ps(y, vy);
+            __m128 right_x = _mm_sub_ps(x, vx);
+            __m128 right_y = _mm_sub_ps(y, vy);
+            x0 = select(left_outer, left_x, x0);
+            y0 = select(left_outer, left_y, y0);
+            x2 = select(left_outer, left_x, x2);
+            y2 = select(left_outer, left_y, y2);
+            x1 = select(right_outer, right_x, x1);
+            y1 = select(right_outer, right_y, y1);
+            x3 = select(right_outer, right_x, x3);
+            y3 = select(right_outer, right_y, y3);
+        }
+
+        _MM_TRANSPOSE4_PS(x0, y0, x1, y1);
+        _MM_TRANSPOSE4_PS(x2, y2, x3, y3);
+        float * o = (float *) out;
+        _mm_storeu_ps(o, x0);
+        _mm_storeu_ps(o + 4, x2);
+        _mm_storeu_ps(o + 8, y0);
+        _mm_storeu_ps(o + 12, y2);
+        _mm_storeu_ps(o + 16, x1);
+        _mm_storeu_ps(o + 20, x3);
+        _mm_storeu_ps(o + 24, y1);
+        _mm_storeu_ps(o + 28, y3);
+    }
+#endif
+}
+
+void oscilloscope_tessellate_traces(const oscilloscope_point * points, t_uint32 trace_count, t_uint32 sample_count, float stroke_width, t_uint32 join, float miter_limit, oscilloscope_point * strip) {
+    oscilloscope_tessellate_traces(points, trace_count, sample_count, 0, sample_count, stroke_width, join, miter_limit, strip);
+}
+
+void oscilloscope_tessellate_traces(const oscilloscope_point * points, t_uint32 trace_count, t_uint32 sample_count, t_uint32 begin, t_uint32 end, float stroke_width, t_uint32 join, float miter_limit, oscilloscope_point * strip) {
+    stroke_parameters parameters;
+    parameters.m_half_width = 0.5f * stroke_width;
+    parameters.m_limit_squared = miter_limit * miter_limit;
+    parameters.m_miter = join == oscilloscope_join_miter;
+
+    t_uint32 strip_length = oscilloscope_get_strip_length(sample_count);
+    for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+        const oscilloscope_point * trace_points = points + (t_size) trace_index * sample_count;
+        oscilloscope_point * trace_strip = strip + (t_size) trace_index * strip_length;
+
+        t_uint32 sample_index = begin;
+#if OSCILLOSCOPE_HAVE_SSE2
+        // The first and the last vertex lack a neighbor and are left to the scalar loop.
+        if (sample_index == 0 && sample_index < end) {
+            stroke_join(trace_points[0], trace_points[0], trace_points[pfc::min_t<t_uint32>(1, sample_count - 1)], parameters, trace_strip);
+            ++sample_index;
+        }
+        for (; sample_index + 4 <= end && sample_index + 4 < sample_count; sample_index += 4) {
+            stroke_joins(trace_points + sample_index, parameters, trace_strip + 4 * sample_index);
+        }
+#endif
+        for (; sample_index < end; ++sample_index) {
+            const oscilloscope_point & prev = trace_points[sample_index - pfc::min_t<t_uint32>(sample_index, 1)];
+            const oscilloscope_point & next = trace_points[pfc::min_t<t_uint32>(sample_index + 1, sample_count - 1)];
+            stroke_join(prev, trace_points[sample_index], next, parameters, trace_strip + 4 * sample_index);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "oscilloscope_types.h"
+
+// Joins between the segments of a stroked trace. A miter join whose point would reach further than
+// the miter limit from the vertex falls back to a bevel.
+enum {
+    oscilloscope_join_bevel = 0,
+    oscilloscope_join_miter,
+    oscilloscope_join_count
+};
+
+// Every vertex of a trace becomes four vertices of its triangle strip, so that the strip of a trace
+// of sample_count vertices is as long as this.
+inline t_uint32 oscilloscope_get_strip_length(t_uint32 sample_count) {return 4 * sample_count;}
+
+// Strokes trace_count traces of sample_count vertices each, which follow each other in points,
+// with lines of stroke_width and flat ends, and writes the triangle strip of trace n to
+// strip + n * oscilloscope_get_strip_length(sample_count). The four strip vertices of a vertex are
+// its left and right side along the normal of the segment before it, then along the normal of the
+// segment after it, so that every segment is a rectangle and the triangles between the two pairs
+// bevel the join. A miter join puts both vertices of the outer side at the point where the edges
+// of the two segments meet, unless that is more than miter_limit half widths from the vertex. The
+// strip can be drawn as it is or as a list of triangles; the triangles of a join that does not
+// turn are empty.
+void oscilloscope_tessellate_traces(const oscilloscope_point * points, t_uint32 trace_count, t_uint32 sample_count, float stroke_width, t_uint32 join, float miter_limit, oscilloscope_point * strip);
+
+// Strokes vertices [begin, end) only. The output layout is that of the whole traces, so disjoint
+// ranges can be stroked independently and give the same result as a single call.
+void oscilloscope_tessellate_traces(const oscilloscope_point * points, t_uint32 trace_count, t_uint32 sample_count, t_uint32 begin, t_uint32 end, float stroke_width, t_uint32 join, float miter_limit, oscilloscope_point * strip);
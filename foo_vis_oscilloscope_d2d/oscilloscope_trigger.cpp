@@ -0,0 +1,532 @@
+#include "stdafx.h"
+
+#include "oscilloscope_trigger.h"
+
+#ifdef PFC_HAVE_PROFILER
+namespace {
+    class trigger_profiler_static {
+    public:
+        trigger_profiler_static() : m_hit_count(0), m_miss_count(0) {}
+        ~trigger_profiler_static() {
+            try {
+                t_uint64 total = m_hit_count + m_miss_count;
+                pfc::string_fixed_t<511> message;
+                message << "profiler: " << pfc::format_pad_left<pfc::string_fixed_t<127> >(48, ' ', "oscilloscope_trigger_prediction") << " - "
+                    << m_hit_count << " hits, " << m_miss_count << " misses";
+                if (total > 0) {
+                    message << " (" << (m_hit_count * 100 / total) << "% hit rate)";
+                }
+                message << "\n";
+                OutputDebugStringA(message);
+            } catch (...) {
+            }
+        }
+        void add_hit() {m_hit_count++;}
+        void add_miss() {m_miss_count++;}
+    private:
+        t_uint64 m_hit_count, m_miss_count;
+    };
+
+    trigger_profiler_static g_trigger_profiler;
+}
+#endif
+
+namespace {
+    // The scanner is a small state machine driven by a transition table. Each sample is classified
+    // as below the arm level (0), inside the hysteresis band (1) or at or above the trigger level (2).
+    // The trigger fires when a sample at or above the trigger level is confirmed by the next sample.
+    enum {
+        state_idle = 0,
+        state_armed,
+        state_pending,
+        state_mask = 0x3,
+        state_fire = 0x4
+    };
+
+    const t_uint8 g_transitions[3][3] = {
+        /* idle */    {state_armed, state_idle,  state_idle},
+        /* armed */   {state_armed, state_armed, state_pending},
+        /* pending */ {state_armed, state_armed, state_idle | state_fire},
+    };
+
+    class sample_source_channel {
+    public:
+        sample_source_channel(const audio_sample * samples, t_uint32 channel_count, t_uint32 channel_index)
+            : m_samples(samples + channel_index), m_stride(channel_count) {}
+        audio_sample operator[](t_uint32 sample_index) const {return m_samples[sample_index * m_stride];}
+    private:
+        const audio_sample * m_samples;
+        t_uint32 m_stride;
+    };
+
+    class sample_source_sum {
+    public:
+        sample_source_sum(const audio_sample * samples, t_uint32 channel_count, t_uint32)
+            : m_samples(samples), m_channel_count(channel_count), m_scale((audio_sample) 1.0 / (audio_sample) channel_count) {}
+        audio_sample operator[](t_uint32 sample_index) const {
+            const audio_sample * frame = m_samples + sample_index * m_channel_count;
+            audio_sample sum = 0;
+            for (t_uint32 channel_index = 0; channel_index < m_channel_count; ++channel_index) {
+                sum += frame[channel_index];
+            }
+            return sum * m_scale;
+        }
+    private:
+        const audio_sample * m_samples;
+        t_uint32 m_channel_count;
+        audio_sample m_scale;
+    };
+
+    template<int t_sign>
+    inline unsigned classify(audio_sample sample, audio_sample level, audio_sample arm_level) {
+        audio_sample value = t_sign * sample;
+        return (unsigned) (value >= arm_level) + (unsigned) (value >= level);
+    }
+
+    // Returns the first trigger point in [begin, end) or end if there is none. The caller must ensure
+    // that 1 <= begin and that sample end is readable. The state machine is started at the last sample
+    // below the arm level before begin, where its state is known without looking further back. At most
+    // history samples before begin are examined; if none of them is below the arm level, the scan
+    // starts unarmed at the earliest of them.
+    template<int t_sign, typename t_source>
+    t_uint32 scan_template(const audio_sample * samples, t_uint32 channel_count, t_uint32 channel_index, audio_sample level, audio_sample arm_level, t_uint32 begin, t_uint32 end, t_uint32 history) {
+        t_source source(samples, channel_count, channel_index);
+
+        t_uint32 first = begin - 1 - pfc::min_t<t_uint32>(history, begin - 1);
+        t_uint32 start = begin - 1;
+        while (start > first && classify<t_sign>(source[start], level, arm_level) != 0) {
+            --start;
+        }
+
+        unsigned state = state_idle;
+        for (t_uint32 sample_index = start; sample_index <= end; ++sample_index) {
+            unsigned entry = g_transitions[state][classify<t_sign>(source[sample_index], level, arm_level)];
+            if ((entry & state_fire) && sample_index - 1 >= begin) {
+                return sample_index - 1;
+            }
+            state = entry & state_mask;
+        }
+        return end;
+    }
+}
+
+// One instance of the scanner per slope and source type, so that the inner loop branches on neither.
+const oscilloscope_trigger::scan_func oscilloscope_trigger::g_scanners[slope_count][2] = {
+    {&scan_template<1, sample_source_channel>, &scan_template<1, sample_source_sum>},
+    {&scan_template<-1, sample_source_channel>, &scan_template<-1, sample_source_sum>},
+};
+
+oscilloscope_trigger::parameters::parameters()
+    : m_level(0)
+    , m_hysteresis(0)
+    , m_slope(slope_rising)
+    , m_source(source_any)
+    , m_channel_mask(~0u)
+    , m_holdoff(0.0)
+{
+}
+
+bool oscilloscope_trigger::parameters::operator==(const parameters & other) const {
+    return m_level == other.m_level
+        && m_hysteresis == other.m_hysteresis
+        && m_slope == other.m_slope
+        && m_source == other.m_source
+        && m_channel_mask == other.m_channel_mask
+        && m_holdoff == other.m_holdoff;
+}
+
+oscilloscope_trigger::oscilloscope_trigger()
+    : m_period_hint(0.0)
+    , m_hit_count(0)
+    , m_miss_count(0)
+{
+    set_parameters(parameters());
+}
+
+void oscilloscope_trigger::reset() {
+    m_locked = false;
+    m_have_last_position = false;
+    m_last_position = 0;
+    m_last_channel_index = 0;
+    m_period = 0.0;
+    m_sample_rate = 0;
+    m_channel_count = 0;
+}
+
+void oscilloscope_trigger::set_parameters(const parameters & p_parameters) {
+    m_parameters = p_parameters;
+
+    // A falling edge is a rising edge of the inverted signal.
+    t_uint32 slope = (m_parameters.m_slope < slope_count) ? m_parameters.m_slope : slope_rising;
+    audio_sample sign = (slope == slope_falling) ? (audio_sample) -1 : (audio_sample) 1;
+    m_level = sign * m_parameters.m_level;
+    m_arm_level = m_level - pfc::max_t<audio_sample>(m_parameters.m_hysteresis, 0);
+    m_scan_channel = g_scanners[slope][0];
+    m_scan_sum = g_scanners[slope][1];
+
+    reset();
+}
+
+// Scans the configured source and returns the earliest trigger point in [begin, end) or end. At most
+// history samples before begin are examined to find the state of the scanner at begin.
+t_uint32 oscilloscope_trigger::scan(const audio_sample * samples, t_uint32 channel_count, t_uint32 begin, t_uint32 end, t_uint32 history, t_uint32 & out_channel_index) const {
+    if (m_parameters.m_source == source_sum) {
+        out_channel_index = 0;
+        return m_scan_sum(samples, channel_count, 0, m_level, m_arm_level, begin, end, history);
+    } else if (m_parameters.m_source >= source_channel) {
+        t_uint32 channel_index = pfc::min_t<t_uint32>(m_parameters.m_source - source_channel, channel_count - 1);
+        if (is_channel_enabled(channel_index)) {
+            out_channel_index = channel_index;
+            return m_scan_channel(samples, channel_count, channel_index, m_level, m_arm_level, begin, end, history);
+        }
+    }
+
+    t_uint32 trigger_index = end;
+    for (t_uint32 channel_index = 0; channel_index < channel_count; ++channel_index) {
+        if (!is_channel_enabled(channel_index)) {
+            continue;
+        }
+        t_uint32 index = m_scan_channel(samples, channel_count, channel_index, m_level, m_arm_level, begin, trigger_index, history);
+        if (index < trigger_index) {
+            trigger_index = index;
+            out_channel_index = channel_index;
+        }
+    }
+    return trigger_index;
+}
+
+// Scans a single channel of the configured source, or the downmix if the source is source_sum.
+t_uint32 oscilloscope_trigger::scan_channel(const audio_sample * samples, t_uint32 channel_count, t_uint32 channel_index, t_uint32 begin, t_uint32 end, t_uint32 history) const {
+    if (m_parameters.m_source == source_sum) {
+        return m_scan_sum(samples, channel_count, 0, m_level, m_arm_level, begin, end, history);
+    } else {
+        return m_scan_channel(samples, channel_count, channel_index, m_level, m_arm_level, begin, end, history);
+    }
+}
+
+t_uint32 oscilloscope_trigger::find(const oscilloscope_sample_window_view & window, t_uint32 sample_count, double window_start_time, bool predictive) {
+#ifdef PFC_HAVE_PROFILER
+    profiler(oscilloscope_trigger_find);
+#endif
+
+    const audio_sample * samples = window.m_samples;
+    t_uint32 channel_count = window.m_channel_count;
+    t_uint32 sample_count_total = window.m_sample_count;
+    t_uint32 sample_rate = window.m_sample_rate;
+
+    if (channel_count == 0 || sample_count < 3) {
+        m_locked = false;
+        return sample_count;
+    }
+
+    if (sample_rate != m_sample_rate || channel_count != m_channel_count) {
+        reset();
+        m_sample_rate = sample_rate;
+        m_channel_count = channel_count;
+    }
+
+    t_int64 window_start = (t_int64) floor(window_start_time * sample_rate + 0.5);
+
+    // The stream time starts over after a seek, so a previous trigger point in the future is meaningless.
+    if (m_have_last_position && window_start + sample_count_total < m_last_position) {
+        m_have_last_position = false;
+        m_locked = false;
+    }
+
+    // No trigger point is accepted before the holdoff time has passed since the previous one.
+    t_uint32 holdoff_begin = 1;
+    t_uint32 holdoff_samples = (t_uint32) (m_parameters.m_holdoff * sample_rate + 0.5);
+    if (holdoff_samples > 0 && m_have_last_position) {
+        t_int64 begin = m_last_position + holdoff_samples - window_start;
+        if (begin >= sample_count - 1) {
+            return sample_count;
+        } else if (begin > 1) {
+            holdoff_begin = (t_uint32) begin;
+        }
+    }
+
+    t_uint32 trigger_index = sample_count;
+
+    if (predictive && m_locked) {
+        trigger_index = find_predicted(samples, channel_count, sample_count, window_start, holdoff_begin);
+        if (trigger_index < sample_count) {
+            m_hit_count++;
+#ifdef PFC_HAVE_PROFILER
+            g_trigger_profiler.add_hit();
+#endif
+        } else {
+            m_miss_count++;
+#ifdef PFC_HAVE_PROFILER
+            g_trigger_profiler.add_miss();
+#endif
+        }
+    }
+
+    if (trigger_index >= sample_count) {
+        trigger_index = find_full(samples, channel_count, sample_count, sample_count_total, holdoff_begin);
+    }
+
+    if (trigger_index < sample_count) {
+        m_last_position = window_start + trigger_index;
+        m_have_last_position = true;
+    }
+    return trigger_index;
+}
+
+// Searches only a small neighborhood around the position where the next trigger point is expected,
+// based on the previous trigger position and the estimated period. If the window has not moved past
+// the previous trigger point, that point itself is expected again; finding it keeps the lock but
+// says nothing new about the period.
+t_uint32 oscilloscope_trigger::find_predicted(const audio_sample * samples, t_uint32 channel_count, t_uint32 sample_count, t_int64 window_start, t_uint32 holdoff_begin) {
+    double elapsed = (double) (window_start - m_last_position);
+    double period_count = pfc::max_t<double>(ceil((elapsed + holdoff_begin) / m_period), 0.0);
+    double predicted = (double) m_last_position + period_count * m_period - (double) window_start;
+    double radius = m_period / 8.0 + 2.0;
+
+    double begin = pfc::max_t<double>(predicted - radius, holdoff_begin);
+    double end = pfc::min_t<double>(predicted + radius + 1.0, (double) (sample_count - 1));
+    if (begin >= end) {
+        return sample_count;
+    }
+
+    // The scanner looks back at most one period for its starting state, and a crossing that began
+    // further back than that does not count.
+    t_uint32 trigger_end = (t_uint32) end;
+    t_uint32 trigger_index = scan_channel(samples, channel_count, m_last_channel_index, (t_uint32) begin, trigger_end, (t_uint32) m_period);
+    if (trigger_index >= trigger_end) {
+        return sample_count;
+    }
+
+    if (period_count >= 1.0) {
+        t_int64 position = window_start + trigger_index;
+        double measured_period = (double) (position - m_last_position) / period_count;
+        m_period += (measured_period - m_period) * 0.5;
+    }
+
+    return trigger_index;
+}
+
+// Searches the whole window for the earliest trigger point and estimates the period from the
+// distance to the next trigger point on the same channel.
+t_uint32 oscilloscope_trigger::find_full(const audio_sample * samples, t_uint32 channel_count, t_uint32 sample_count, t_uint32 sample_count_total, t_uint32 holdoff_begin) {
+    t_uint32 channel_index = 0;
+    t_uint32 trigger_index = scan(samples, channel_count, holdoff_begin, sample_count - 1, holdoff_begin - 1, channel_index);
+
+    if (trigger_index >= sample_count - 1) {
+        m_locked = false;
+        return sample_count;
+    }
+
+    // The scanner is idle right after a trigger point, so the scans that follow it need not look
+    // back past it.
+    t_uint32 period_end = pfc::max_t<t_uint32>(sample_count_total, sample_count) - 1;
+
+    if (m_period_hint > 0.0) {
+        double radius = m_period_hint / 8.0 + 2.0;
+        double begin = pfc::max_t<double>((double) trigger_index + m_period_hint - radius, (double) (trigger_index + 1));
+        double end = pfc::min_t<double>((double) trigger_index + m_period_hint + radius + 1.0, (double) period_end);
+        if (begin < end) {
+            t_uint32 hinted_end = (t_uint32) end;
+            t_uint32 hinted_index = scan_channel(samples, channel_count, channel_index, (t_uint32) begin, hinted_end, (t_uint32) begin - trigger_index - 1);
+            if (hinted_index < hinted_end) {
+                m_period = (double) (hinted_index - trigger_index);
+                m_last_channel_index = channel_index;
+                m_locked = true;
+                return trigger_index;
+            }
+        }
+    }
+
+    t_uint32 next_index = scan_channel(samples, channel_count, channel_index, trigger_index + 1, period_end, 0);
+    if (next_index < period_end) {
+        m_period = (double) (next_index - trigger_index);
+        m_last_channel_index = channel_index;
+        m_locked = true;
+    } else {
+        m_locked = false;
+    }
+
+    return trigger_index;
+}
+
+const float oscilloscope_correlation_trigger::reference_blend = 0.1f;
+
+oscilloscope_correlation_trigger::oscilloscope_correlation_trigger()
+    : m_plan(nullptr)
+    , m_analysis_length(0)
+{
+    reset();
+}
+
+void oscilloscope_correlation_trigger::reset() {
+    m_have_reference = false;
+    m_period = 0;
+}
+
+void oscilloscope_correlation_trigger::prepare(t_uint32 analysis_length) {
+    if (analysis_length == m_analysis_length) {
+        return;
+    }
+
+    t_size fft_size = 4;
+    while (fft_size < 2 * (t_size) analysis_length) {
+        fft_size *= 2;
+    }
+
+    m_plan = &oscilloscope_fft_plan::g_get_plan(fft_size);
+    m_analysis_length = analysis_length;
+
+    m_buffer.set_size(fft_size);
+    m_spectrum_re.set_size(m_plan->get_bin_count());
+    m_spectrum_im.set_size(m_plan->get_bin_count());
+    m_reference_re.set_size(m_plan->get_bin_count());
+    m_reference_im.set_size(m_plan->get_bin_count());
+
+    reset();
+}
+
+// Copies count samples into the FFT input buffer and zero-pads the remainder.
+void oscilloscope_correlation_trigger::load(const float * source, t_uint32 count) {
+    t_size fft_size = m_plan->get_size();
+    float * buffer = m_buffer.get_ptr();
+    pfc::memcpy_t(buffer, source, count);
+    pfc::memset_null_t(buffer + count, fft_size - count);
+}
+
+t_uint32 oscilloscope_correlation_trigger::estimate_period(const float * signal, t_uint32 analysis_length) {
+    t_size bin_count = m_plan->get_bin_count();
+    float * re = m_spectrum_re.get_ptr();
+    float * im = m_spectrum_im.get_ptr();
+    float * autocorrelation = m_buffer.get_ptr();
+
+    load(signal, analysis_length);
+    m_plan->forward(autocorrelation, re, im);
+    for (t_size bin = 0; bin < bin_count; ++bin) {
+        re[bin] = re[bin] * re[bin] + im[bin] * im[bin];
+        im[bin] = 0.0f;
+    }
+    m_plan->inverse(re, im, autocorrelation);
+
+    if (!(autocorrelation[0] > 0.0f)) {
+        return 0;
+    }
+
+    // Skip the main lobe around lag 0, then take the first peak that comes close to the highest one
+    // so that a slightly stronger peak at a multiple of the period does not win.
+    t_uint32 lag_max = analysis_length / 2;
+    t_uint32 lag_begin = 1;
+    while (lag_begin < lag_max && autocorrelation[lag_begin] > 0.0f) {
+        ++lag_begin;
+    }
+
+    float peak = 0.0f;
+    for (t_uint32 lag = lag_begin; lag < lag_max; ++lag) {
+        peak = pfc::max_t(peak, autocorrelation[lag]);
+    }
+    if (!(peak > 0.0f)) {
+        return 0;
+    }
+
+    float threshold = 0.9f * peak;
+    for (t_uint32 lag = lag_begin; lag < lag_max; ++lag) {
+        if (autocorrelation[lag] >= threshold && autocorrelation[lag] >= autocorrelation[lag + 1]) {
+            return lag;
+        }
+    }
+    return 0;
+}
+
+t_uint32 oscilloscope_correlation_trigger::find(const oscilloscope_sample_window_view & window, t_uint32 sample_count) {
+#ifdef PFC_HAVE_PROFILER
+    profiler(oscilloscope_correlation_trigger_find);
+#endif
+
+    const audio_sample * samples = window.m_samples;
+    t_uint32 channel_count = window.m_channel_count;
+    if (channel_count == 0 || sample_count < 2) {
+        return 0;
+    }
+    PFC_ASSERT(window.m_sample_count >= 2 * sample_count);
+
+    t_uint32 analysis_length = pfc::min_t<t_uint32>(sample_count, max_analysis_length);
+    prepare(analysis_length);
+
+    // Correlate the downmixed signal so that every channel contributes to the alignment. Only the
+    // samples that fit in the FFT alongside the analysis window can ever be read, and mono input is
+    // used as it is.
+    t_uint32 signal_length = pfc::min_t<t_uint32>(2 * sample_count, (t_uint32) m_plan->get_size());
+    const float * signal;
+#if audio_sample_size == 32
+    if (channel_count == 1) {
+        signal = samples;
+    } else
+#endif
+    {
+        m_signal.set_size(signal_length);
+        float * downmix = m_signal.get_ptr();
+        float channel_scale = 1.0f / (float) channel_count;
+        for (t_uint32 sample_index = 0; sample_index < signal_length; ++sample_index) {
+            audio_sample sum = 0;
+            for (t_uint32 channel_index = 0; channel_index < channel_count; ++channel_index) {
+                sum += samples[sample_index * channel_count + channel_index];
+            }
+            downmix[sample_index] = (float) sum * channel_scale;
+        }
+        signal = downmix;
+    }
+
+    m_period = estimate_period(signal, analysis_length);
+
+    t_uint32 trigger_index = 0;
+    t_size bin_count = m_plan->get_bin_count();
+    float * re = m_spectrum_re.get_ptr();
+    float * im = m_spectrum_im.get_ptr();
+    const float * reference_re = m_reference_re.get_ptr();
+    const float * reference_im = m_reference_im.get_ptr();
+    float * correlation = m_buffer.get_ptr();
+
+    if (m_have_reference) {
+        // One period of lags is enough to find the best alignment; lags beyond fft_size - analysis_length
+        // would wrap around in the circular correlation.
+        t_uint32 lag_count = pfc::min_t<t_uint32>(sample_count, (t_uint32) (m_plan->get_size() - analysis_length));
+        if (m_period > 0) {
+            lag_count = pfc::min_t<t_uint32>(lag_count, m_period + 1);
+        }
+
+        load(signal, analysis_length + lag_count);
+        m_plan->forward(correlation, re, im);
+        for (t_size bin = 0; bin < bin_count; ++bin) {
+            float product_re = re[bin] * reference_re[bin] + im[bin] * reference_im[bin];
+            float product_im = im[bin] * reference_re[bin] - re[bin] * reference_im[bin];
+            re[bin] = product_re;
+            im[bin] = product_im;
+        }
+        m_plan->inverse(re, im, correlation);
+
+        float best = correlation[0];
+        for (t_uint32 lag = 1; lag < lag_count; ++lag) {
+            if (correlation[lag] > best) {
+                best = correlation[lag];
+                trigger_index = lag;
+            }
+        }
+    }
+
+    // Blend the aligned window into the reference instead of replacing it. Replacing it would let the
+    // rounding error of the integer lag accumulate from frame to frame and make the trace drift.
+    load(signal + trigger_index, analysis_length);
+    if (m_have_reference) {
+        float * blend_re = m_reference_re.get_ptr();
+        float * blend_im = m_reference_im.get_ptr();
+        m_plan->forward(correlation, re, im);
+        for (t_size bin = 0; bin < bin_count; ++bin) {
+            blend_re[bin] += (re[bin] - blend_re[bin]) * reference_blend;
+            blend_im[bin] += (im[bin] - blend_im[bin]) * reference_blend;
+        }
+    } else {
+        m_plan->forward(correlation, m_reference_re.get_ptr(), m_reference_im.get_ptr());
+        m_have_reference = true;
+    }
+
+    return trigger_index;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "oscilloscope_fft.h"
+#include "oscilloscope_sample_window.h"
+
+// Edge trigger with configurable level, slope, hysteresis, holdoff and source. Once a periodic
+// signal is locked, the search is restricted to a small neighborhood around the predicted position
+// of the next trigger point.
+class oscilloscope_trigger {
+public:
+    enum {
+        slope_rising = 0,
+        slope_falling,
+        slope_count
+    };
+
+    // Channels outside the channel mask are never scanned. A selected channel that is outside
+    // the mask falls back to source_any.
+    enum {
+        // Earliest trigger point on any channel in the mask.
+        source_any = 0,
+        // Average of all channels, the same downmix that the tuner follows.
+        source_sum,
+        // source_channel + n selects channel n.
+        source_channel
+    };
+
+    struct parameters {
+        parameters();
+        bool operator==(const parameters & other) const;
+        bool operator!=(const parameters & other) const {return !(*this == other);}
+
+        audio_sample m_level;
+        audio_sample m_hysteresis;
+        t_uint32 m_slope;
+        t_uint32 m_source;
+        // Bit n enables channel n; channels from 32 on are always enabled.
+        t_uint32 m_channel_mask;
+        double m_holdoff;
+    };
+
+    oscilloscope_trigger();
+
+    void reset();
+    void set_parameters(const parameters & p_parameters);
+    const parameters & get_parameters() const {return m_parameters;}
+
+    // Returns the index of the trigger point within the first sample_count samples of window, or
+    // sample_count if no trigger point was found. The rest of the window is used to estimate the
+    // period of the signal.
+    t_uint32 find(const oscilloscope_sample_window_view & window, t_uint32 sample_count, double window_start_time, bool predictive);
+
+    // Sets the expected period of the signal in samples, or 0 if unknown. When the whole window is
+    // searched, the period is then measured to the trigger point nearest to one hinted period
+    // later, rather than to the next trigger point, which may be a harmonic's.
+    void set_period_hint(double period) {m_period_hint = period;}
+
+    t_uint64 get_hit_count() const {return m_hit_count;}
+    t_uint64 get_miss_count() const {return m_miss_count;}
+
+private:
+    typedef t_uint32 (*scan_func)(const audio_sample * samples, t_uint32 channel_count, t_uint32 channel_index, audio_sample level, audio_sample arm_level, t_uint32 begin, t_uint32 end, t_uint32 history);
+
+    t_uint32 scan(const audio_sample * samples, t_uint32 channel_count, t_uint32 begin, t_uint32 end, t_uint32 history, t_uint32 & out_channel_index) const;
+    t_uint32 scan_channel(const audio_sample * samples, t_uint32 channel_count, t_uint32 channel_index, t_uint32 begin, t_uint32 end, t_uint32 history) const;
+
+    static const scan_func g_scanners[slope_count][2];
+
+    bool is_channel_enabled(t_uint32 channel_index) const {return channel_index >= 32 || (m_parameters.m_channel_mask & (1u << channel_index)) != 0;}
+
+    t_uint32 find_predicted(const audio_sample * samples, t_uint32 channel_count, t_uint32 sample_count, t_int64 window_start, t_uint32 holdoff_begin);
+    t_uint32 find_full(const audio_sample * samples, t_uint32 channel_count, t_uint32 sample_count, t_uint32 sample_count_total, t_uint32 holdoff_begin);
+
+    parameters m_parameters;
+    scan_func m_scan_channel;
+    scan_func m_scan_sum;
+    audio_sample m_level;
+    audio_sample m_arm_level;
+
+    bool m_locked;
+    bool m_have_last_position;
+    t_int64 m_last_position;
+    t_uint32 m_last_channel_index;
+    double m_period;
+    double m_period_hint;
+    t_uint32 m_sample_rate;
+    t_uint32 m_channel_count;
+
+    t_uint64 m_hit_count;
+    t_uint64 m_miss_count;
+};
+
+// Aligns each window to the previous one at the maximum of their cross-correlation. The search
+// range is bounded by the fundamental period, which is estimated from the autocorrelation of the
+// window. Both correlations are computed with a cached FFT plan on preallocated buffers.
+class oscilloscope_correlation_trigger {
+public:
+    oscilloscope_correlation_trigger();
+
+    void reset();
+
+    // Returns the index of the trigger point within the first sample_count samples of window,
+    // which must contain at least 2 * sample_count samples.
+    t_uint32 find(const oscilloscope_sample_window_view & window, t_uint32 sample_count);
+
+    // Returns the estimated period in samples, or 0 if no period was found.
+    t_uint32 get_period() const {return m_period;}
+
+private:
+    enum {
+        max_analysis_length = 8192
+    };
+
+    static const float reference_blend;
+
+    void prepare(t_uint32 analysis_length);
+    void load(const float * source, t_uint32 count);
+    t_uint32 estimate_period(const float * signal, t_uint32 analysis_length);
+
+    const oscilloscope_fft_plan * m_plan;
+    t_uint32 m_analysis_length;
+    bool m_have_reference;
+    t_uint32 m_period;
+
+    pfc::mem_block_aligned_t<float> m_signal;
+    pfc::mem_block_aligned_t<float> m_buffer;
+    pfc::mem_block_aligned_t<float> m_spectrum_re;
+    pfc::mem_block_aligned_t<float> m_spectrum_im;
+    pfc::mem_block_aligned_t<float> m_reference_re;
+    pfc::mem_block_aligned_t<float> m_reference_im;
+};
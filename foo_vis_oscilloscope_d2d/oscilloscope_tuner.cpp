@@ -0,0 +1,234 @@
+#include "stdafx.h"
+
+#include "oscilloscope_tuner.h"
+#include "oscilloscope_simd.h"
+
+namespace {
+    const double g_pi = 3.14159265358979323846;
+    // Bandwidth of the bins relative to their frequency; one semitone apart, they do not overlap.
+    const double g_quality = 17.0;
+    // Notes quieter than about -50 dBFS are not shown.
+    const float g_min_amplitude = 0.003f;
+    // Weight of the fundamental and of harmonics 2 to 4, which lie 12, 19 and 24 semitones higher.
+    const t_uint32 g_harmonic_offsets[] = {0, 12, 19, 24};
+    const float g_harmonic_weights[] = {1.0f, 0.5f, 0.5f, 0.5f};
+
+    double get_note_frequency(double note) {
+        return 440.0 * pow(2.0, (note - 69.0) / 12.0);
+    }
+}
+
+oscilloscope_tuner::oscilloscope_tuner()
+    : m_sample_rate(0)
+    , m_bin_count(0)
+    , m_have_position(false)
+    , m_next_sample(0)
+    , m_frequency(0.0)
+{
+}
+
+void oscilloscope_tuner::reset() {
+    m_sample_rate = 0;
+    m_have_position = false;
+    m_frequency = 0.0;
+}
+
+void oscilloscope_tuner::prepare(t_uint32 sample_rate) {
+    m_sample_rate = sample_rate;
+
+    m_bin_count = 0;
+    while (first_note + m_bin_count <= last_note && get_note_frequency(first_note + m_bin_count) < 0.45 * sample_rate) {
+        ++m_bin_count;
+    }
+
+    t_uint32 padded_count = (m_bin_count + 3) & ~3u;
+    m_pole_re.set_size(padded_count);
+    m_pole_im.set_size(padded_count);
+    m_gain.set_size(padded_count);
+    m_state_re.set_size(padded_count);
+    m_state_im.set_size(padded_count);
+    m_advance_re.set_size(padded_count);
+    m_advance_im.set_size(padded_count);
+    m_amplitude.set_size(padded_count);
+    for (t_uint32 bin = 0; bin < padded_count; ++bin) {
+        double pole_re = 0.0, pole_im = 0.0, gain = 0.0;
+        if (bin < m_bin_count) {
+            double frequency = get_note_frequency(first_note + bin);
+            double radius = exp(-g_pi * frequency / (g_quality * sample_rate));
+            double angle = 2.0 * g_pi * frequency / sample_rate;
+            pole_re = radius * cos(angle);
+            pole_im = radius * sin(angle);
+            // A sine of amplitude a leaves a magnitude of about a / (2 (1 - radius)).
+            gain = 2.0 * (1.0 - radius);
+        }
+        m_pole_re.get_ptr()[bin] = (float) pole_re;
+        m_pole_im.get_ptr()[bin] = (float) pole_im;
+        m_gain[bin] = (float) gain;
+        m_state_re.get_ptr()[bin] = 0.0f;
+        m_state_im.get_ptr()[bin] = 0.0f;
+    }
+}
+
+void oscilloscope_tuner::update(const oscilloscope_sample_window_view & window, double window_time, t_uint32 channel_index) {
+    if (window.is_empty()) {
+        return;
+    }
+
+    if (window.m_sample_rate != m_sample_rate) {
+        prepare(window.m_sample_rate);
+        m_have_position = false;
+        m_frequency = 0.0;
+    }
+
+    // After a seek the bins simply ring down into the new material.
+    t_int64 window_start = (t_int64) floor(window_time * m_sample_rate + 0.5);
+    t_int64 window_end = window_start + window.m_sample_count;
+    if (!m_have_position || m_next_sample < window_start || m_next_sample > window_end) {
+        m_have_position = true;
+        m_next_sample = window_start;
+    }
+
+    t_uint32 begin = (t_uint32) (m_next_sample - window_start);
+    t_uint32 count = window.m_sample_count - begin;
+    m_next_sample = window_end;
+    if (count == 0 || m_bin_count == 0) {
+        return;
+    }
+
+    if (m_input.get_size() < count) {
+        m_input.set_size(count);
+    }
+    float * input = m_input.get_ptr();
+    t_uint32 channel_count = window.m_channel_count;
+    if (channel_index == source_downmix) {
+        float scale = 1.0f / (float) channel_count;
+        for (t_uint32 index = 0; index < count; ++index) {
+            const audio_sample * frame = window.get_frame(begin + index);
+            audio_sample sum = 0;
+            for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+                sum += frame[channel];
+            }
+            input[index] = (float) sum * scale;
+        }
+    } else {
+        const audio_sample * samples = window.get_frame(begin) + pfc::min_t<t_uint32>(channel_index, channel_count - 1);
+        for (t_uint32 index = 0; index < count; ++index) {
+            input[index] = (float) samples[(t_size) index * channel_count];
+        }
+    }
+
+    process(input, count);
+    estimate();
+}
+
+// state(n) = pole * state(n - 1) + x(n), four bins at a time, with each group of bins kept in
+// registers for the whole run of samples.
+void oscilloscope_tuner::process(const float * input, t_uint32 count) {
+    t_uint32 padded_count = (m_bin_count + 3) & ~3u;
+    const float * pole_re = m_pole_re.get_ptr();
+    const float * pole_im = m_pole_im.get_ptr();
+    float * state_re = m_state_re.get_ptr();
+    float * state_im = m_state_im.get_ptr();
+    float * advance_re = m_advance_re.get_ptr();
+    float * advance_im = m_advance_im.get_ptr();
+
+    t_uint32 bin = 0;
+#if OSCILLOSCOPE_HAVE_SSE2
+    for (; bin < padded_count; bin += 4) {
+        __m128 pr = _mm_load_ps(pole_re + bin);
+        __m128 pi = _mm_load_ps(pole_im + bin);
+        __m128 yr = _mm_load_ps(state_re + bin);
+        __m128 yi = _mm_load_ps(state_im + bin);
+        __m128 ar = _mm_setzero_ps();
+        __m128 ai = _mm_setzero_ps();
+        for (t_uint32 index = 0; index < count; ++index) {
+            __m128 x = _mm_set1_ps(input[index]);
+            __m128 nr = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(pr, yr), _mm_mul_ps(pi, yi)), x);
+            __m128 ni = _mm_add_ps(_mm_mul_ps(pr, yi), _mm_mul_ps(pi, yr));
+            ar = _mm_add_ps(ar, _mm_add_ps(_mm_mul_ps(nr, yr), _mm_mul_ps(ni, yi)));
+            ai = _mm_add_ps(ai, _mm_sub_ps(_mm_mul_ps(ni, yr), _mm_mul_ps(nr, yi)));
+            yr = nr;
+            yi = ni;
+        }
+        _mm_store_ps(state_re + bin, yr);
+        _mm_store_ps(state_im + bin, yi);
+        _mm_store_ps(advance_re + bin, ar);
+        _mm_store_ps(advance_im + bin, ai);
+    }
+#endif
+    for (; bin < padded_count; ++bin) {
+        float pr = pole_re[bin], pi = pole_im[bin];
+        float yr = state_re[bin], yi = state_im[bin];
+        float ar = 0.0f, ai = 0.0f;
+        for (t_uint32 index = 0; index < count; ++index) {
+            float nr = pr * yr - pi * yi + input[index];
+            float ni = pr * yi + pi * yr;
+            ar += nr * yr + ni * yi;
+            ai += ni * yr - nr * yi;
+            yr = nr;
+            yi = ni;
+        }
+        state_re[bin] = yr;
+        state_im[bin] = yi;
+        advance_re[bin] = ar;
+        advance_im[bin] = ai;
+    }
+
+    // Bins that rang out are cleared before they decay into denormals.
+    for (bin = 0; bin < padded_count; ++bin) {
+        if (fabs(state_re[bin]) + fabs(state_im[bin]) < 1e-15f) {
+            state_re[bin] = state_im[bin] = 0.0f;
+        }
+    }
+}
+
+void oscilloscope_tuner::estimate() {
+    const float * state_re = m_state_re.get_ptr();
+    const float * state_im = m_state_im.get_ptr();
+    float * amplitude = m_amplitude.get_ptr();
+    for (t_uint32 bin = 0; bin < m_bin_count; ++bin) {
+        amplitude[bin] = sqrt(state_re[bin] * state_re[bin] + state_im[bin] * state_im[bin]) * m_gain[bin];
+    }
+
+    // Ties go to the lower note, so that a note is not mistaken for its own harmonic.
+    t_uint32 best_bin = 0;
+    float best_score = 0.0f;
+    for (t_uint32 bin = 0; bin < m_bin_count; ++bin) {
+        float score = 0.0f;
+        for (t_uint32 harmonic = 0; harmonic < harmonic_count && bin + g_harmonic_offsets[harmonic] < m_bin_count; ++harmonic) {
+            score += amplitude[bin + g_harmonic_offsets[harmonic]] * g_harmonic_weights[harmonic];
+        }
+        if (score > best_score) {
+            best_score = score;
+            best_bin = bin;
+        }
+    }
+
+    if (amplitude[best_bin] < g_min_amplitude) {
+        m_frequency = 0.0;
+        return;
+    }
+
+    // The phase advance belongs to whatever dominates the bin, which is the note only if it lies
+    // within a semitone of the bin.
+    double note = first_note + best_bin;
+    double frequency = atan2((double) m_advance_im.get_ptr()[best_bin], (double) m_advance_re.get_ptr()[best_bin]) * m_sample_rate / (2.0 * g_pi);
+    if (!(frequency > get_note_frequency(note - 1.0) && frequency < get_note_frequency(note + 1.0))) {
+        frequency = get_note_frequency(note);
+    }
+    m_frequency = frequency;
+}
+
+void oscilloscope_tuner::g_format(double frequency, pfc::string_base & out) {
+    static const char * const g_names[12] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+
+    out.reset();
+    if (frequency <= 0.0) {
+        return;
+    }
+
+    double position = 69.0 + 12.0 * log(frequency / 440.0) / log(2.0);
+    int note = (int) floor(position + 0.5);
+    int cents = (int) floor((position - note) * 100.0 + 0.5);
+    out << g_names[((note % 12) + 12) % 12] << (note / 12 - 1) << " " << (cents >= 0 ? "+" : "") << cents << " ct  " << pfc::format_float(frequency, 0, 1) << " Hz";
+}
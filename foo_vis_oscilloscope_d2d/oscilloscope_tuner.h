@@ -0,0 +1,63 @@
+#pragma once
+
+#include "oscilloscope_sample_window.h"
+
+// Pitch readout. A bank of damped complex resonators, one per semitone from A0 to C8, acts as a
+// sliding DFT with an exponential window: every new sample updates each bin in constant time, so
+// the cost of a frame depends only on the samples that arrived since the previous one. The note is
+// the bin whose harmonics are strongest; its frequency is refined from the phase advance of the bin
+// from one sample to the next, averaged over the new samples.
+class oscilloscope_tuner {
+public:
+    enum {
+        // Pass as the channel index to follow the downmix of all channels.
+        source_downmix = 0xffffffff
+    };
+
+    oscilloscope_tuner();
+
+    void reset();
+
+    // Adds the samples of channel channel_index of window, whose first sample is at window_time,
+    // that are newer than those added before, and updates the estimate.
+    void update(const oscilloscope_sample_window_view & window, double window_time, t_uint32 channel_index);
+
+    // Returns the frequency of the current note in Hz, or 0 if no note stands out.
+    double get_frequency() const {return m_frequency;}
+
+    // Formats a frequency as the nearest note and its deviation, such as "A4 +3 ct  440.8 Hz".
+    static void g_format(double frequency, pfc::string_base & out);
+
+private:
+    enum {
+        first_note = 21,
+        last_note = 108,
+        harmonic_count = 4
+    };
+
+    void prepare(t_uint32 sample_rate);
+    void process(const float * input, t_uint32 count);
+    void estimate();
+
+    t_uint32 m_sample_rate;
+    t_uint32 m_bin_count;
+
+    bool m_have_position;
+    t_int64 m_next_sample;
+
+    // Pole r e^(i w) of each bin, the factor that scales its magnitude to the amplitude of a sine
+    // at its frequency, its state, and the sum of state(n) * conj(state(n - 1)) over the new samples.
+    // Bins are padded to a multiple of four with silent ones.
+    pfc::mem_block_aligned_t<float> m_pole_re;
+    pfc::mem_block_aligned_t<float> m_pole_im;
+    pfc::array_t<float> m_gain;
+    pfc::mem_block_aligned_t<float> m_state_re;
+    pfc::mem_block_aligned_t<float> m_state_im;
+    pfc::mem_block_aligned_t<float> m_advance_re;
+    pfc::mem_block_aligned_t<float> m_advance_im;
+
+    pfc::array_t<float> m_input;
+    pfc::array_t<float> m_amplitude;
+
+    double m_frequency;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+// Point, color and size types shared by the geometry and software rendering code. On Windows they
+// are the Direct2D types, so buffers are passed to Direct2D without conversion; elsewhere they are
+// layout-compatible structures, so that code can be built and tested without Direct2D.
+#ifdef _WIN32
+typedef D2D1_POINT_2F oscilloscope_point;
+typedef D2D1_COLOR_F oscilloscope_color;
+typedef D2D1_SIZE_U oscilloscope_size;
+#else
+struct oscilloscope_point {
+    float x;
+    float y;
+};
+
+struct oscilloscope_color {
+    float r;
+    float g;
+    float b;
+    float a;
+};
+
+struct oscilloscope_size {
+    t_uint32 width;
+    t_uint32 height;
+};
+#endif
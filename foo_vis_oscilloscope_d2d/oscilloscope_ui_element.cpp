@@ -1,6 +1,7 @@
 #include "stdafx.h"
 
 #include "oscilloscope_ui_element.h"
+#include "oscilloscope_export.h"
 
 void oscilloscope_ui_element_instance::g_get_name(pfc::string_base & p_out) {
     p_out = "Oscilloscope (Direct2D)";
@@ -49,6 +50,8 @@ void oscilloscope_ui_element_instance::set_configuration(ui_element_config::ptr
 
     UpdateChannelMode();
     UpdateRefreshRateLimit();
+    m_renderer.set_config(m_config);
+    m_roll.set_config(m_config);
 }
 
 ui_element_config::ptr oscilloscope_ui_element_instance::get_configuration() {
@@ -60,6 +63,7 @@ ui_element_config::ptr oscilloscope_ui_element_instance::get_configuration() {
 void oscilloscope_ui_element_instance::notify(const GUID & p_what, t_size p_param1, const void * p_param2, t_size p_param2size) {
     if (p_what == ui_element_notify_colors_changed) {
         m_pStrokeBrush.Release();
+        m_roll.reset();
         Invalidate();
     }
 }
@@ -100,10 +104,12 @@ LRESULT oscilloscope_ui_element_instance::OnCreate(LPCREATESTRUCT lpCreateStruct
 
 void oscilloscope_ui_element_instance::OnDestroy() {
     m_vis_stream.release();
+    m_overview_loader.reset();
 
     m_pDirect2dFactory.Release();
     m_pRenderTarget.Release();
     m_pStrokeBrush.Release();
+    m_roll.reset();
 }
 
 void oscilloscope_ui_element_instance::OnTimer(UINT_PTR nIDEvent) {
@@ -134,32 +140,53 @@ void oscilloscope_ui_element_instance::OnSize(UINT nType, CSize size) {
 }
 
 HRESULT oscilloscope_ui_element_instance::Render() {
+    PFC_TRACE_SCOPE(Render);
     HRESULT hr = S_OK;
 
     hr = CreateDeviceResources();
 
     if (SUCCEEDED(hr)) {
         m_pRenderTarget->BeginDraw();
-        m_pRenderTarget->SetAntialiasMode(m_config.m_low_quality_enabled ? D2D1_ANTIALIAS_MODE_ALIASED : D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
 
         m_pRenderTarget->SetTransform(D2D1::Matrix3x2F::Identity());
 
         t_ui_color colorBackground = m_callback->query_std_color(ui_color_background);
 
-		m_pRenderTarget->Clear(D2D1::ColorF(GetRValue(colorBackground) / 255.0f, GetGValue(colorBackground) / 255.0f, GetBValue(colorBackground) / 255.0f));
+        D2D1_COLOR_F background = D2D1::ColorF(GetRValue(colorBackground) / 255.0f, GetGValue(colorBackground) / 255.0f, GetBValue(colorBackground) / 255.0f);
 
-        if (m_vis_stream.is_valid()) {
+		m_pRenderTarget->Clear(background);
+
+        if (m_config.m_overview_enabled) {
+            RenderOverview();
+        } else if (m_config.m_roll_enabled) {
+            RenderRoll(background);
+        } else if (m_vis_stream.is_valid()) {
             double time;
             if (m_vis_stream->get_absolute_time(time)) {
-                double window_duration = m_config.get_window_duration();
-                audio_chunk_impl chunk;
-                if (m_vis_stream->get_chunk_absolute(chunk, time - window_duration / 2, window_duration * (m_config.m_trigger_enabled ? 2 : 1))) {
-                    RenderChunk(chunk);
+                if (m_config.m_timebase_periods > 0) {
+                    // The pitch detector sees every sample once, whatever the window shows.
+                    double pitch_time = m_renderer.get_pitch_next_time(time);
+                    if (time > pitch_time && m_vis_stream->get_chunk_absolute(m_chunk, pitch_time, time - pitch_time)) {
+                        oscilloscope_sample_window_view pitch_window(m_chunk.get_data(), m_chunk.get_channel_count(), m_chunk.get_sample_count(), m_chunk.get_sample_rate());
+                        m_renderer.analyze_pitch(pitch_window, pitch_time);
+                    }
+                }
+                double window_duration = m_renderer.get_window_duration();
+                double chunk_time = time - window_duration / 2;
+                if (m_vis_stream->get_chunk_absolute(m_chunk, chunk_time, window_duration * (m_config.m_trigger_enabled ? 2 : 1))) {
+                    RenderChunk(m_chunk, chunk_time);
                 }
             }
         }
 
-        hr = m_pRenderTarget->EndDraw();
+        if (!m_config.m_overview_enabled) {
+            m_overview_loader.reset();
+        }
+
+        {
+            PFC_TRACE_SCOPE(EndDraw);
+            hr = m_pRenderTarget->EndDraw();
+        }
 
         if (hr == D2DERR_RECREATE_TARGET)
         {
@@ -168,134 +195,105 @@ HRESULT oscilloscope_ui_element_instance::Render() {
         }
     }
 
+    // Drains the per-thread trace buffers into the session every frame, so that recordings of
+    // any length fit in them.
+    if (pfc::tracer::isEnabled()) {
+        pfc::tracer::collect();
+    }
+
     return hr;
 }
 
-HRESULT oscilloscope_ui_element_instance::RenderChunk(const audio_chunk &chunk) {
-    HRESULT hr = S_OK;
-
+HRESULT oscilloscope_ui_element_instance::RenderChunk(const audio_chunk &chunk, double chunk_time) {
     D2D1_SIZE_F rtSize = m_pRenderTarget->GetSize();
 
-    CComPtr<ID2D1PathGeometry> pPath;
-
-    hr = m_pDirect2dFactory->CreatePathGeometry(&pPath);
+    // The chunk is drawn in place; only resampling writes the samples anew.
+    oscilloscope_sample_window_view window(chunk.get_data(), chunk.get_channel_count(), chunk.get_sample_count(), chunk.get_sample_rate());
 
-    if (SUCCEEDED(hr)) {
-        CComPtr<ID2D1GeometrySink> pSink;
-            
-        hr = pPath->Open(&pSink);
-
-        audio_chunk_impl chunk2;
-        chunk2.copy(chunk);
-
-        if (m_config.m_resample_enabled) {
-            unsigned display_sample_rate = (unsigned) (rtSize.width / m_config.get_window_duration());
-            unsigned target_sample_rate = chunk.get_sample_rate();
-            while (target_sample_rate >= 2 && target_sample_rate > display_sample_rate) {
-                target_sample_rate /= 2;
-            }
-            if (target_sample_rate != chunk.get_sample_rate()) {
-                dsp::ptr resampler;
-                metadb_handle::ptr track;
-                if (static_api_ptr_t<playback_control>()->get_now_playing(track) && resampler_entry::g_create(resampler, chunk.get_sample_rate(), target_sample_rate, 1.0f)) {
-                    dsp_chunk_list_impl chunk_list;
-                    chunk_list.add_chunk(&chunk);
-                    resampler->run(&chunk_list, track, dsp::FLUSH);
-                    resampler->flush();
-
-                    bool consistent_format = true;
-                    unsigned total_sample_count = 0;
-                    for (t_size chunk_index = 0; chunk_index < chunk_list.get_count(); ++chunk_index) {
-                        if ((chunk_list.get_item(chunk_index)->get_sample_rate() == chunk_list.get_item(0)->get_sample_rate())
-                            && (chunk_list.get_item(chunk_index)->get_channel_count() == chunk_list.get_item(0)->get_channel_count())) {
-                                total_sample_count += chunk_list.get_item(chunk_index)->get_sample_count();
-                        } else {
-                            consistent_format = false;
-                            break;
-                        }
-                    }
-                    if (consistent_format && chunk_list.get_count() > 0) {
-                        unsigned channel_count = chunk_list.get_item(0)->get_channels();
-                        unsigned sample_rate = chunk_list.get_item(0)->get_sample_rate();
-
-                        pfc::array_t<audio_sample> buffer;
-                        buffer.prealloc(channel_count * total_sample_count);
-                        for (t_size chunk_index = 0; chunk_index < chunk_list.get_count(); ++chunk_index) {
-                            audio_chunk * c = chunk_list.get_item(chunk_index);
-                            buffer.append_fromptr(c->get_data(), c->get_channel_count() * c->get_sample_count());
-                        }
-
-                        chunk2.set_data(buffer.get_ptr(), total_sample_count, channel_count, sample_rate);
-                    }
-                }
-            }
+    if (m_config.m_resample_enabled) {
+        PFC_TRACE_SCOPE(resample);
+        unsigned display_sample_rate = (unsigned) (rtSize.width / m_renderer.get_window_duration());
+        unsigned target_sample_rate = chunk.get_sample_rate();
+        while (target_sample_rate >= 2 && target_sample_rate > display_sample_rate) {
+            target_sample_rate /= 2;
         }
-
-        t_uint32 channel_count = chunk2.get_channel_count();
-        t_uint32 sample_count_total = chunk2.get_sample_count();
-        t_uint32 sample_count = m_config.m_trigger_enabled ? sample_count_total / 2 : sample_count_total;
-        const audio_sample *samples = chunk2.get_data();
-
-        if (m_config.m_trigger_enabled) {
-            t_uint32 cross_min = sample_count;
-            t_uint32 cross_max = 0;
-
-            for (t_uint32 channel_index = 0; channel_index < channel_count; ++channel_index) {
-                audio_sample sample0 = samples[channel_index];
-                audio_sample sample1 = samples[1 * channel_count + channel_index];
-                audio_sample sample2;
-                for (t_uint32 sample_index = 2; sample_index < sample_count; ++sample_index) {
-                    sample2 = samples[sample_index * channel_count + channel_index];
-                    if ((sample0 < 0.0) && (sample1 >= 0.0) && (sample2 >= 0.0)) {
-                        if (cross_min > sample_index - 1)
-                            cross_min = sample_index - 1;
-                        if (cross_max < sample_index - 1)
-                            cross_max = sample_index - 1;
+        if (target_sample_rate != chunk.get_sample_rate()) {
+            dsp::ptr resampler;
+            metadb_handle::ptr track;
+            if (static_api_ptr_t<playback_control>()->get_now_playing(track) && resampler_entry::g_create(resampler, chunk.get_sample_rate(), target_sample_rate, 1.0f)) {
+                dsp_chunk_list_impl chunk_list;
+                chunk_list.add_chunk(&chunk);
+                resampler->run(&chunk_list, track, dsp::FLUSH);
+                resampler->flush();
+
+                bool consistent_format = true;
+                unsigned total_sample_count = 0;
+                for (t_size chunk_index = 0; chunk_index < chunk_list.get_count(); ++chunk_index) {
+                    if ((chunk_list.get_item(chunk_index)->get_sample_rate() == chunk_list.get_item(0)->get_sample_rate())
+                        && (chunk_list.get_item(chunk_index)->get_channel_count() == chunk_list.get_item(0)->get_channel_count())) {
+                            total_sample_count += chunk_list.get_item(chunk_index)->get_sample_count();
+                    } else {
+                        consistent_format = false;
+                        break;
                     }
-                    sample0 = sample1;
-                    sample1 = sample2;
                 }
-            }
+                if (consistent_format && chunk_list.get_count() > 0) {
+                    unsigned channel_count = chunk_list.get_item(0)->get_channels();
+                    unsigned sample_rate = chunk_list.get_item(0)->get_sample_rate();
 
-            samples += cross_min * channel_count;
-        }
+                    if (m_resampled.get_size() < channel_count * total_sample_count) {
+                        m_resampled.set_size(channel_count * total_sample_count);
+                    }
+                    audio_sample * out = m_resampled.get_ptr();
+                    for (t_size chunk_index = 0; chunk_index < chunk_list.get_count(); ++chunk_index) {
+                        audio_chunk * c = chunk_list.get_item(chunk_index);
+                        pfc::memcpy_t(out, c->get_data(), c->get_channel_count() * c->get_sample_count());
+                        out += c->get_channel_count() * c->get_sample_count();
+                    }
 
-        for (t_uint32 channel_index = 0; channel_index < channel_count; ++channel_index) {
-            float zoom = (float) m_config.get_zoom_factor();
-            float channel_baseline = (float) (channel_index + 0.5) / (float) channel_count * rtSize.height;
-            for (t_uint32 sample_index = 0; sample_index < sample_count; ++sample_index) {
-                audio_sample sample = samples[sample_index * channel_count + channel_index];
-                float x = (float) sample_index / (float) (sample_count - 1) * rtSize.width;
-                float y = channel_baseline - sample * zoom * rtSize.height / 2 / channel_count + 0.5f;
-                if (sample_index == 0) {
-                    pSink->BeginFigure(D2D1::Point2F(x, y), D2D1_FIGURE_BEGIN_HOLLOW);
-                } else {
-                    pSink->AddLine(D2D1::Point2F(x, y));
+                    window = oscilloscope_sample_window_view(m_resampled.get_ptr(), channel_count, total_sample_count, sample_rate);
                 }
             }
-            if (channel_count > 0 && sample_count > 0) {
-                pSink->EndFigure(D2D1_FIGURE_END_OPEN);
-            }
         }
+    }
+
+    return m_renderer.render(m_pDirect2dFactory, m_pRenderTarget, m_pStrokeBrush, window, chunk_time, &m_thread_pool);
+}
 
-        if (SUCCEEDED(hr)) {
-            hr = pSink->Close();
+// Records the audio that arrived since the previous frame, and draws the recording.
+HRESULT oscilloscope_ui_element_instance::RenderRoll(const D2D1_COLOR_F & background) {
+    oscilloscope_sample_window_view window;
+    double window_time = 0.0;
+    double time;
+    if (m_vis_stream.is_valid() && m_vis_stream->get_absolute_time(time)) {
+        window_time = m_roll.get_next_time(time);
+        if (time > window_time && m_vis_stream->get_chunk_absolute(m_chunk, window_time, time - window_time)) {
+            window = oscilloscope_sample_window_view(m_chunk.get_data(), m_chunk.get_channel_count(), m_chunk.get_sample_count(), m_chunk.get_sample_rate());
         }
+    }
 
-        if (SUCCEEDED(hr)) {
-            D2D1_STROKE_STYLE_PROPERTIES strokeStyleProperties = D2D1::StrokeStyleProperties(D2D1_CAP_STYLE_FLAT, D2D1_CAP_STYLE_FLAT, D2D1_CAP_STYLE_FLAT, D2D1_LINE_JOIN_BEVEL);
+    return m_roll.render(m_pRenderTarget, m_pStrokeBrush, background, window, window_time);
+}
 
-            CComPtr<ID2D1StrokeStyle> pStrokeStyle;
-            m_pDirect2dFactory->CreateStrokeStyle(strokeStyleProperties, nullptr, 0, &pStrokeStyle);
+// Shows the whole playing track. Its overview is loaded in the background; until it is ready,
+// nothing is drawn.
+HRESULT oscilloscope_ui_element_instance::RenderOverview() {
+    static_api_ptr_t<playback_control> playback;
+    metadb_handle_ptr track;
+    if (!playback->get_now_playing(track)) {
+        m_overview_loader.reset();
+        return S_OK;
+    }
 
-            m_pRenderTarget->DrawGeometry(pPath, m_pStrokeBrush, (FLOAT)m_config.get_line_stroke_width(), pStrokeStyle);
-        }
+    m_overview_loader.request(track);
+    const oscilloscope_overview * overview = m_overview_loader.get_overview();
+    if (overview == nullptr) {
+        return S_OK;
     }
 
-    return hr;
+    return m_renderer.render_overview(m_pDirect2dFactory, m_pRenderTarget, m_pStrokeBrush, *overview, playback->playback_get_position());
 }
 
-
 void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point) {
 	if (m_callback->is_edit_mode_enabled()) {
 		SetMsgHandled(FALSE);
@@ -307,7 +305,145 @@ void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point)
 		menu.AppendMenu(MF_SEPARATOR);
 		menu.AppendMenu(MF_STRING | (m_config.m_downmix_enabled ? MF_CHECKED : 0), IDM_DOWNMIX_ENABLED, TEXT("Downmix Channels"));
 		menu.AppendMenu(MF_STRING | (m_config.m_low_quality_enabled ? MF_CHECKED : 0), IDM_LOW_QUALITY_ENABLED, TEXT("Low Quality Mode"));
-		menu.AppendMenu(MF_STRING | (m_config.m_trigger_enabled ? MF_CHECKED : 0), IDM_TRIGGER_ENABLED, TEXT("Trigger on Zero Crossing"));
+		menu.AppendMenu(MF_STRING | (m_config.m_overview_enabled ? MF_CHECKED : 0), IDM_OVERVIEW_ENABLED, TEXT("Track Overview"));
+		menu.AppendMenu(MF_STRING | (m_config.m_roll_enabled ? MF_CHECKED : 0), IDM_ROLL_ENABLED, TEXT("Roll Mode"));
+		menu.AppendMenu(MF_STRING | (m_config.m_spectrum_enabled ? MF_CHECKED : 0), IDM_SPECTRUM_ENABLED, TEXT("Spectrum"));
+		menu.AppendMenu(MF_STRING | (m_config.m_tuner_enabled ? MF_CHECKED : 0), IDM_TUNER_ENABLED, TEXT("Tuner"));
+		menu.AppendMenu(MF_STRING | (m_config.m_band_split_enabled ? MF_CHECKED : 0), IDM_BAND_SPLIT_ENABLED, TEXT("Band Split"));
+		menu.AppendMenu(MF_STRING | (m_config.m_glow_enabled ? MF_CHECKED : 0), IDM_GLOW_ENABLED, TEXT("Glow"));
+		menu.AppendMenu(MF_STRING | (m_config.m_trigger_enabled ? MF_CHECKED : 0), IDM_TRIGGER_ENABLED, TEXT("Trigger"));
+
+		CMenu triggerModeMenu;
+		triggerModeMenu.CreatePopupMenu();
+		triggerModeMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_mode == oscilloscope_config::trigger_mode_zero_crossing) ? MF_CHECKED : 0), IDM_TRIGGER_MODE_ZERO_CROSSING, TEXT("Zero Crossing"));
+		triggerModeMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_mode == oscilloscope_config::trigger_mode_correlation) ? MF_CHECKED : 0), IDM_TRIGGER_MODE_CORRELATION, TEXT("Autocorrelation"));
+		triggerModeMenu.AppendMenu(MF_SEPARATOR);
+		triggerModeMenu.AppendMenu(MF_STRING | (m_config.m_trigger_predictive_enabled ? MF_CHECKED : 0) | ((m_config.m_trigger_mode == oscilloscope_config::trigger_mode_zero_crossing) ? 0 : MF_GRAYED), IDM_TRIGGER_PREDICTIVE_ENABLED, TEXT("Predictive Trigger Search"));
+
+		CMenu triggerSlopeMenu;
+		triggerSlopeMenu.CreatePopupMenu();
+		triggerSlopeMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_slope == oscilloscope_config::trigger_slope_rising) ? MF_CHECKED : 0), IDM_TRIGGER_SLOPE_RISING, TEXT("Rising"));
+		triggerSlopeMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_slope == oscilloscope_config::trigger_slope_falling) ? MF_CHECKED : 0), IDM_TRIGGER_SLOPE_FALLING, TEXT("Falling"));
+
+		CMenu triggerLevelMenu;
+		triggerLevelMenu.CreatePopupMenu();
+		triggerLevelMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_level_percent == -50) ? MF_CHECKED : 0), IDM_TRIGGER_LEVEL_MINUS_50, TEXT("-50%"));
+		triggerLevelMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_level_percent == -25) ? MF_CHECKED : 0), IDM_TRIGGER_LEVEL_MINUS_25, TEXT("-25%"));
+		triggerLevelMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_level_percent == -10) ? MF_CHECKED : 0), IDM_TRIGGER_LEVEL_MINUS_10, TEXT("-10%"));
+		triggerLevelMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_level_percent == 0) ? MF_CHECKED : 0), IDM_TRIGGER_LEVEL_0, TEXT("0%"));
+		triggerLevelMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_level_percent == 10) ? MF_CHECKED : 0), IDM_TRIGGER_LEVEL_10, TEXT("+10%"));
+		triggerLevelMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_level_percent == 25) ? MF_CHECKED : 0), IDM_TRIGGER_LEVEL_25, TEXT("+25%"));
+		triggerLevelMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_level_percent == 50) ? MF_CHECKED : 0), IDM_TRIGGER_LEVEL_50, TEXT("+50%"));
+
+		CMenu triggerHysteresisMenu;
+		triggerHysteresisMenu.CreatePopupMenu();
+		triggerHysteresisMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_hysteresis_percent == 0) ? MF_CHECKED : 0), IDM_TRIGGER_HYSTERESIS_0, TEXT("Off"));
+		triggerHysteresisMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_hysteresis_percent == 1) ? MF_CHECKED : 0), IDM_TRIGGER_HYSTERESIS_1, TEXT("1%"));
+		triggerHysteresisMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_hysteresis_percent == 2) ? MF_CHECKED : 0), IDM_TRIGGER_HYSTERESIS_2, TEXT("2%"));
+		triggerHysteresisMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_hysteresis_percent == 5) ? MF_CHECKED : 0), IDM_TRIGGER_HYSTERESIS_5, TEXT("5%"));
+		triggerHysteresisMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_hysteresis_percent == 10) ? MF_CHECKED : 0), IDM_TRIGGER_HYSTERESIS_10, TEXT("10%"));
+		triggerHysteresisMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_hysteresis_percent == 20) ? MF_CHECKED : 0), IDM_TRIGGER_HYSTERESIS_20, TEXT("20%"));
+
+		CMenu triggerHoldoffMenu;
+		triggerHoldoffMenu.CreatePopupMenu();
+		triggerHoldoffMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_holdoff_millis == 0) ? MF_CHECKED : 0), IDM_TRIGGER_HOLDOFF_0, TEXT("Off"));
+		triggerHoldoffMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_holdoff_millis == 1) ? MF_CHECKED : 0), IDM_TRIGGER_HOLDOFF_1, TEXT("1 ms"));
+		triggerHoldoffMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_holdoff_millis == 2) ? MF_CHECKED : 0), IDM_TRIGGER_HOLDOFF_2, TEXT("2 ms"));
+		triggerHoldoffMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_holdoff_millis == 5) ? MF_CHECKED : 0), IDM_TRIGGER_HOLDOFF_5, TEXT("5 ms"));
+		triggerHoldoffMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_holdoff_millis == 10) ? MF_CHECKED : 0), IDM_TRIGGER_HOLDOFF_10, TEXT("10 ms"));
+		triggerHoldoffMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_holdoff_millis == 20) ? MF_CHECKED : 0), IDM_TRIGGER_HOLDOFF_20, TEXT("20 ms"));
+		triggerHoldoffMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_holdoff_millis == 50) ? MF_CHECKED : 0), IDM_TRIGGER_HOLDOFF_50, TEXT("50 ms"));
+		triggerHoldoffMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_holdoff_millis == 100) ? MF_CHECKED : 0), IDM_TRIGGER_HOLDOFF_100, TEXT("100 ms"));
+
+		CMenu triggerSourceMenu;
+		triggerSourceMenu.CreatePopupMenu();
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_any) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_ANY, TEXT("Any Channel"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_sum) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_SUM, TEXT("Downmix"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_channel_1) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_CHANNEL_1, TEXT("Channel 1"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_channel_1 + 1) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_CHANNEL_2, TEXT("Channel 2"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_channel_1 + 2) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_CHANNEL_3, TEXT("Channel 3"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_channel_1 + 3) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_CHANNEL_4, TEXT("Channel 4"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_channel_1 + 4) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_CHANNEL_5, TEXT("Channel 5"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_channel_1 + 5) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_CHANNEL_6, TEXT("Channel 6"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_channel_1 + 6) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_CHANNEL_7, TEXT("Channel 7"));
+		triggerSourceMenu.AppendMenu(MF_STRING | ((m_config.m_trigger_source == oscilloscope_config::trigger_source_channel_1 + 7) ? MF_CHECKED : 0), IDM_TRIGGER_SOURCE_CHANNEL_8, TEXT("Channel 8"));
+
+		UINT edgeTriggerFlags = (m_config.m_trigger_enabled && m_config.m_trigger_mode == oscilloscope_config::trigger_mode_zero_crossing) ? 0 : MF_GRAYED;
+
+		menu.AppendMenu(MF_STRING | (m_config.m_trigger_enabled ? 0 : MF_GRAYED), triggerModeMenu, TEXT("Trigger Mode"));
+		menu.AppendMenu(MF_STRING | edgeTriggerFlags, triggerSourceMenu, TEXT("Trigger Source"));
+		menu.AppendMenu(MF_STRING | edgeTriggerFlags, triggerSlopeMenu, TEXT("Trigger Slope"));
+		menu.AppendMenu(MF_STRING | edgeTriggerFlags, triggerLevelMenu, TEXT("Trigger Level"));
+		menu.AppendMenu(MF_STRING | edgeTriggerFlags, triggerHysteresisMenu, TEXT("Trigger Hysteresis"));
+		menu.AppendMenu(MF_STRING | edgeTriggerFlags, triggerHoldoffMenu, TEXT("Trigger Holdoff"));
+
+		CMenu averageMenu;
+		averageMenu.CreatePopupMenu();
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_count == 1) ? MF_CHECKED : 0), IDM_AVERAGE_COUNT_1, TEXT("Off"));
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_count == 2) ? MF_CHECKED : 0), IDM_AVERAGE_COUNT_2, TEXT("2"));
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_count == 4) ? MF_CHECKED : 0), IDM_AVERAGE_COUNT_4, TEXT("4"));
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_count == 8) ? MF_CHECKED : 0), IDM_AVERAGE_COUNT_8, TEXT("8"));
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_count == 16) ? MF_CHECKED : 0), IDM_AVERAGE_COUNT_16, TEXT("16"));
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_count == 32) ? MF_CHECKED : 0), IDM_AVERAGE_COUNT_32, TEXT("32"));
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_count == 64) ? MF_CHECKED : 0), IDM_AVERAGE_COUNT_64, TEXT("64"));
+		averageMenu.AppendMenu(MF_SEPARATOR);
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_mode == oscilloscope_config::average_mode_exponential) ? MF_CHECKED : 0), IDM_AVERAGE_MODE_EXPONENTIAL, TEXT("Exponential"));
+		averageMenu.AppendMenu(MF_STRING | ((m_config.m_average_mode == oscilloscope_config::average_mode_boxcar) ? MF_CHECKED : 0), IDM_AVERAGE_MODE_BOXCAR, TEXT("Boxcar"));
+
+		menu.AppendMenu(MF_STRING | (m_config.m_trigger_enabled ? 0 : MF_GRAYED), averageMenu, TEXT("Averaging"));
+
+		CMenu channelOrderMenu;
+		channelOrderMenu.CreatePopupMenu();
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.m_channel_order == oscilloscope_config::default_channel_order) ? MF_CHECKED : 0), IDM_CHANNEL_ORDER_DEFAULT, TEXT("Default"));
+		channelOrderMenu.AppendMenu(MF_STRING, IDM_CHANNEL_ORDER_REVERSE, TEXT("Reverse"));
+		channelOrderMenu.AppendMenu(MF_SEPARATOR);
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.get_channel_position(0) == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MOVE_UP_1, TEXT("Move Channel 1 Up"));
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.get_channel_position(1) == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MOVE_UP_2, TEXT("Move Channel 2 Up"));
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.get_channel_position(2) == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MOVE_UP_3, TEXT("Move Channel 3 Up"));
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.get_channel_position(3) == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MOVE_UP_4, TEXT("Move Channel 4 Up"));
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.get_channel_position(4) == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MOVE_UP_5, TEXT("Move Channel 5 Up"));
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.get_channel_position(5) == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MOVE_UP_6, TEXT("Move Channel 6 Up"));
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.get_channel_position(6) == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MOVE_UP_7, TEXT("Move Channel 7 Up"));
+		channelOrderMenu.AppendMenu(MF_STRING | ((m_config.get_channel_position(7) == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MOVE_UP_8, TEXT("Move Channel 8 Up"));
+
+		CMenu colorModeMenu;
+		colorModeMenu.CreatePopupMenu();
+		colorModeMenu.AppendMenu(MF_STRING | ((m_config.m_color_mode == oscilloscope_config::color_mode_solid) ? MF_CHECKED : 0), IDM_COLOR_MODE_SOLID, TEXT("Solid"));
+		colorModeMenu.AppendMenu(MF_STRING | ((m_config.m_color_mode == oscilloscope_config::color_mode_amplitude) ? MF_CHECKED : 0), IDM_COLOR_MODE_AMPLITUDE, TEXT("By Amplitude"));
+		colorModeMenu.AppendMenu(MF_STRING | ((m_config.m_color_mode == oscilloscope_config::color_mode_slope) ? MF_CHECKED : 0), IDM_COLOR_MODE_SLOPE, TEXT("By Slope"));
+		colorModeMenu.AppendMenu(MF_STRING | ((m_config.m_color_mode == oscilloscope_config::color_mode_time) ? MF_CHECKED : 0), IDM_COLOR_MODE_TIME, TEXT("By Time in Window"));
+
+		menu.AppendMenu(MF_STRING | (m_config.m_band_split_enabled ? MF_GRAYED : 0), colorModeMenu, TEXT("Trace Color"));
+
+		CMenu channelMatrixMenu;
+		channelMatrixMenu.CreatePopupMenu();
+		channelMatrixMenu.AppendMenu(MF_STRING | ((m_config.m_channel_matrix == oscilloscope_config::channel_matrix_none) ? MF_CHECKED : 0), IDM_CHANNEL_MATRIX_NONE, TEXT("None"));
+		channelMatrixMenu.AppendMenu(MF_STRING | ((m_config.m_channel_matrix == oscilloscope_config::channel_matrix_mid_side) ? MF_CHECKED : 0), IDM_CHANNEL_MATRIX_MID_SIDE, TEXT("Mid/Side"));
+		channelMatrixMenu.AppendMenu(MF_STRING | ((m_config.m_channel_matrix == oscilloscope_config::channel_matrix_difference) ? MF_CHECKED : 0), IDM_CHANNEL_MATRIX_DIFFERENCE, TEXT("Difference (L-R)"));
+		channelMatrixMenu.AppendMenu(MF_STRING | ((m_config.m_channel_matrix == oscilloscope_config::channel_matrix_fold_down) ? MF_CHECKED : 0), IDM_CHANNEL_MATRIX_FOLD_DOWN, TEXT("Fold Down to Stereo"));
+		channelMatrixMenu.AppendMenu(MF_STRING | ((m_config.m_channel_matrix == oscilloscope_config::channel_matrix_custom) ? MF_CHECKED : 0) | ((m_config.m_custom_matrix_input_count == 0) ? MF_GRAYED : 0), IDM_CHANNEL_MATRIX_CUSTOM, TEXT("Custom"));
+		channelMatrixMenu.AppendMenu(MF_SEPARATOR);
+		channelMatrixMenu.AppendMenu(MF_STRING, IDM_CHANNEL_MATRIX_PASTE, TEXT("Paste Custom Matrix"));
+
+		CMenu channelsMenu;
+		channelsMenu.CreatePopupMenu();
+		channelsMenu.AppendMenu(MF_STRING | ((m_config.m_channel_layout == oscilloscope_config::channel_layout_stacked) ? MF_CHECKED : 0), IDM_CHANNEL_LAYOUT_STACKED, TEXT("Stacked"));
+		channelsMenu.AppendMenu(MF_STRING | ((m_config.m_channel_layout == oscilloscope_config::channel_layout_overlay) ? MF_CHECKED : 0), IDM_CHANNEL_LAYOUT_OVERLAY, TEXT("Overlay"));
+		channelsMenu.AppendMenu(MF_STRING | ((m_config.m_channel_layout == oscilloscope_config::channel_layout_grid) ? MF_CHECKED : 0), IDM_CHANNEL_LAYOUT_GRID, TEXT("Grid"));
+		channelsMenu.AppendMenu(MF_SEPARATOR);
+		channelsMenu.AppendMenu(MF_STRING | (m_config.is_channel_visible(0) ? MF_CHECKED : 0), IDM_CHANNEL_VISIBLE_1, TEXT("Channel 1"));
+		channelsMenu.AppendMenu(MF_STRING | (m_config.is_channel_visible(1) ? MF_CHECKED : 0), IDM_CHANNEL_VISIBLE_2, TEXT("Channel 2"));
+		channelsMenu.AppendMenu(MF_STRING | (m_config.is_channel_visible(2) ? MF_CHECKED : 0), IDM_CHANNEL_VISIBLE_3, TEXT("Channel 3"));
+		channelsMenu.AppendMenu(MF_STRING | (m_config.is_channel_visible(3) ? MF_CHECKED : 0), IDM_CHANNEL_VISIBLE_4, TEXT("Channel 4"));
+		channelsMenu.AppendMenu(MF_STRING | (m_config.is_channel_visible(4) ? MF_CHECKED : 0), IDM_CHANNEL_VISIBLE_5, TEXT("Channel 5"));
+		channelsMenu.AppendMenu(MF_STRING | (m_config.is_channel_visible(5) ? MF_CHECKED : 0), IDM_CHANNEL_VISIBLE_6, TEXT("Channel 6"));
+		channelsMenu.AppendMenu(MF_STRING | (m_config.is_channel_visible(6) ? MF_CHECKED : 0), IDM_CHANNEL_VISIBLE_7, TEXT("Channel 7"));
+		channelsMenu.AppendMenu(MF_STRING | (m_config.is_channel_visible(7) ? MF_CHECKED : 0), IDM_CHANNEL_VISIBLE_8, TEXT("Channel 8"));
+		channelsMenu.AppendMenu(MF_SEPARATOR);
+		channelsMenu.AppendMenu(MF_STRING, channelOrderMenu, TEXT("Channel Order"));
+		channelsMenu.AppendMenu(MF_STRING, channelMatrixMenu, TEXT("Channel Matrix"));
+
+		menu.AppendMenu(MF_STRING, channelsMenu, TEXT("Channels"));
 
 		CMenu durationMenu;
 		durationMenu.CreatePopupMenu();
@@ -350,6 +486,27 @@ void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point)
 
 		menu.AppendMenu(MF_STRING, durationMenu, TEXT("Window Duration"));
 
+		CMenu timebaseMenu;
+		timebaseMenu.CreatePopupMenu();
+		timebaseMenu.AppendMenu(MF_STRING | ((m_config.m_timebase_periods == 0) ? MF_CHECKED : 0), IDM_TIMEBASE_PERIODS_0, TEXT("Off"));
+		timebaseMenu.AppendMenu(MF_STRING | ((m_config.m_timebase_periods == 1) ? MF_CHECKED : 0), IDM_TIMEBASE_PERIODS_1, TEXT("1 Period"));
+		timebaseMenu.AppendMenu(MF_STRING | ((m_config.m_timebase_periods == 2) ? MF_CHECKED : 0), IDM_TIMEBASE_PERIODS_2, TEXT("2 Periods"));
+		timebaseMenu.AppendMenu(MF_STRING | ((m_config.m_timebase_periods == 4) ? MF_CHECKED : 0), IDM_TIMEBASE_PERIODS_4, TEXT("4 Periods"));
+		timebaseMenu.AppendMenu(MF_STRING | ((m_config.m_timebase_periods == 8) ? MF_CHECKED : 0), IDM_TIMEBASE_PERIODS_8, TEXT("8 Periods"));
+
+		menu.AppendMenu(MF_STRING, timebaseMenu, TEXT("Auto Timebase"));
+
+		CMenu rollDurationMenu;
+		rollDurationMenu.CreatePopupMenu();
+		rollDurationMenu.AppendMenu(MF_STRING | ((m_config.m_roll_duration_seconds == 1) ? MF_CHECKED : 0), IDM_ROLL_DURATION_1, TEXT("1 s"));
+		rollDurationMenu.AppendMenu(MF_STRING | ((m_config.m_roll_duration_seconds == 2) ? MF_CHECKED : 0), IDM_ROLL_DURATION_2, TEXT("2 s"));
+		rollDurationMenu.AppendMenu(MF_STRING | ((m_config.m_roll_duration_seconds == 5) ? MF_CHECKED : 0), IDM_ROLL_DURATION_5, TEXT("5 s"));
+		rollDurationMenu.AppendMenu(MF_STRING | ((m_config.m_roll_duration_seconds == 10) ? MF_CHECKED : 0), IDM_ROLL_DURATION_10, TEXT("10 s"));
+		rollDurationMenu.AppendMenu(MF_STRING | ((m_config.m_roll_duration_seconds == 20) ? MF_CHECKED : 0), IDM_ROLL_DURATION_20, TEXT("20 s"));
+		rollDurationMenu.AppendMenu(MF_STRING | ((m_config.m_roll_duration_seconds == 30) ? MF_CHECKED : 0), IDM_ROLL_DURATION_30, TEXT("30 s"));
+
+		menu.AppendMenu(MF_STRING | (m_config.m_roll_enabled ? 0 : MF_GRAYED), rollDurationMenu, TEXT("Roll Duration"));
+
 		CMenu zoomMenu;
 		zoomMenu.CreatePopupMenu();
 		zoomMenu.AppendMenu(MF_STRING | ((m_config.m_zoom_percent == 5) ? MF_CHECKED : 0), IDM_ZOOM_5, TEXT("5 %"));
@@ -388,6 +545,19 @@ void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point)
 
 		menu.AppendMenu(MF_STRING, zoomMenu, TEXT("Zoom"));
 
+		menu.AppendMenu(MF_STRING | (m_config.m_auto_gain_enabled ? MF_CHECKED : 0), IDM_AUTO_GAIN_ENABLED, TEXT("Auto Gain"));
+
+		CMenu autoGainWindowMenu;
+		autoGainWindowMenu.CreatePopupMenu();
+		autoGainWindowMenu.AppendMenu(MF_STRING | ((m_config.m_auto_gain_window_millis == 250) ? MF_CHECKED : 0), IDM_AUTO_GAIN_WINDOW_250, TEXT("250 ms"));
+		autoGainWindowMenu.AppendMenu(MF_STRING | ((m_config.m_auto_gain_window_millis == 500) ? MF_CHECKED : 0), IDM_AUTO_GAIN_WINDOW_500, TEXT("500 ms"));
+		autoGainWindowMenu.AppendMenu(MF_STRING | ((m_config.m_auto_gain_window_millis == 1000) ? MF_CHECKED : 0), IDM_AUTO_GAIN_WINDOW_1000, TEXT("1 s"));
+		autoGainWindowMenu.AppendMenu(MF_STRING | ((m_config.m_auto_gain_window_millis == 2000) ? MF_CHECKED : 0), IDM_AUTO_GAIN_WINDOW_2000, TEXT("2 s"));
+		autoGainWindowMenu.AppendMenu(MF_STRING | ((m_config.m_auto_gain_window_millis == 5000) ? MF_CHECKED : 0), IDM_AUTO_GAIN_WINDOW_5000, TEXT("5 s"));
+		autoGainWindowMenu.AppendMenu(MF_STRING | ((m_config.m_auto_gain_window_millis == 10000) ? MF_CHECKED : 0), IDM_AUTO_GAIN_WINDOW_10000, TEXT("10 s"));
+
+		menu.AppendMenu(MF_STRING | (m_config.m_auto_gain_enabled ? 0 : MF_GRAYED), autoGainWindowMenu, TEXT("Auto Gain Window"));
+
 		CMenu refreshRateLimitMenu;
 		refreshRateLimitMenu.CreatePopupMenu();
 		refreshRateLimitMenu.AppendMenu(MF_STRING | ((m_config.m_refresh_rate_limit_hz == 20) ? MF_CHECKED : 0), IDM_REFRESH_RATE_LIMIT_20, TEXT("20 Hz"));
@@ -442,6 +612,40 @@ void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point)
 
 		menu.AppendMenu(MF_STRING | (m_config.m_resample_enabled ? MF_CHECKED : 0), IDM_RESAMPLE_ENABLED, TEXT("Resample For Display"));
 		menu.AppendMenu(MF_STRING | (m_config.m_hw_rendering_enabled ? MF_CHECKED : 0), IDM_HW_RENDERING_ENABLED, TEXT("Allow Hardware Rendering"));
+		menu.AppendMenu(MF_STRING | (pfc::tracer::isEnabled() ? MF_CHECKED : 0), IDM_TRACE_ENABLED, TEXT("Record Performance Trace"));
+
+		CMenu exportFrameRateMenu;
+		exportFrameRateMenu.CreatePopupMenu();
+		exportFrameRateMenu.AppendMenu(MF_STRING | ((m_config.m_export_frame_rate_hz == 24) ? MF_CHECKED : 0), IDM_EXPORT_FRAME_RATE_24, TEXT("24 fps"));
+		exportFrameRateMenu.AppendMenu(MF_STRING | ((m_config.m_export_frame_rate_hz == 25) ? MF_CHECKED : 0), IDM_EXPORT_FRAME_RATE_25, TEXT("25 fps"));
+		exportFrameRateMenu.AppendMenu(MF_STRING | ((m_config.m_export_frame_rate_hz == 30) ? MF_CHECKED : 0), IDM_EXPORT_FRAME_RATE_30, TEXT("30 fps"));
+		exportFrameRateMenu.AppendMenu(MF_STRING | ((m_config.m_export_frame_rate_hz == 50) ? MF_CHECKED : 0), IDM_EXPORT_FRAME_RATE_50, TEXT("50 fps"));
+		exportFrameRateMenu.AppendMenu(MF_STRING | ((m_config.m_export_frame_rate_hz == 60) ? MF_CHECKED : 0), IDM_EXPORT_FRAME_RATE_60, TEXT("60 fps"));
+
+		CMenu exportResolutionMenu;
+		exportResolutionMenu.CreatePopupMenu();
+		exportResolutionMenu.AppendMenu(MF_STRING | ((m_config.m_export_resolution == oscilloscope_config::export_resolution_window) ? MF_CHECKED : 0), IDM_EXPORT_RESOLUTION_WINDOW, TEXT("Window Size"));
+		exportResolutionMenu.AppendMenu(MF_STRING | ((m_config.m_export_resolution == oscilloscope_config::export_resolution_720p) ? MF_CHECKED : 0), IDM_EXPORT_RESOLUTION_720P, TEXT("1280 x 720"));
+		exportResolutionMenu.AppendMenu(MF_STRING | ((m_config.m_export_resolution == oscilloscope_config::export_resolution_1080p) ? MF_CHECKED : 0), IDM_EXPORT_RESOLUTION_1080P, TEXT("1920 x 1080"));
+		exportResolutionMenu.AppendMenu(MF_STRING | ((m_config.m_export_resolution == oscilloscope_config::export_resolution_1440p) ? MF_CHECKED : 0), IDM_EXPORT_RESOLUTION_1440P, TEXT("2560 x 1440"));
+		exportResolutionMenu.AppendMenu(MF_STRING | ((m_config.m_export_resolution == oscilloscope_config::export_resolution_2160p) ? MF_CHECKED : 0), IDM_EXPORT_RESOLUTION_2160P, TEXT("3840 x 2160"));
+
+		CMenu exportFormatMenu;
+		exportFormatMenu.CreatePopupMenu();
+		exportFormatMenu.AppendMenu(MF_STRING | ((m_config.m_export_format == oscilloscope_config::export_format_png) ? MF_CHECKED : 0), IDM_EXPORT_FORMAT_PNG, TEXT("PNG"));
+		exportFormatMenu.AppendMenu(MF_STRING | ((m_config.m_export_format == oscilloscope_config::export_format_ppm) ? MF_CHECKED : 0), IDM_EXPORT_FORMAT_PPM, TEXT("PPM"));
+
+		CMenu exportMenu;
+		exportMenu.CreatePopupMenu();
+		exportMenu.AppendMenu(MF_STRING, IDM_EXPORT_FRAMES, TEXT("Export Frames..."));
+		exportMenu.AppendMenu(MF_SEPARATOR);
+		exportMenu.AppendMenu(MF_STRING, exportFrameRateMenu, TEXT("Frame Rate"));
+		exportMenu.AppendMenu(MF_STRING, exportResolutionMenu, TEXT("Resolution"));
+		exportMenu.AppendMenu(MF_STRING, exportFormatMenu, TEXT("Format"));
+
+		menu.AppendMenu(MF_SEPARATOR);
+
+		menu.AppendMenu(MF_STRING, exportMenu, TEXT("Export"));
 
 		menu.SetMenuDefaultItem(IDM_TOGGLE_FULLSCREEN);
 
@@ -462,9 +666,297 @@ void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point)
 		case IDM_LOW_QUALITY_ENABLED:
 			m_config.m_low_quality_enabled = !m_config.m_low_quality_enabled;
 			break;
+		case IDM_OVERVIEW_ENABLED:
+			m_config.m_overview_enabled = !m_config.m_overview_enabled;
+			break;
+		case IDM_ROLL_ENABLED:
+			m_config.m_roll_enabled = !m_config.m_roll_enabled;
+			break;
+		case IDM_SPECTRUM_ENABLED:
+			m_config.m_spectrum_enabled = !m_config.m_spectrum_enabled;
+			break;
+		case IDM_TUNER_ENABLED:
+			m_config.m_tuner_enabled = !m_config.m_tuner_enabled;
+			break;
+		case IDM_BAND_SPLIT_ENABLED:
+			m_config.m_band_split_enabled = !m_config.m_band_split_enabled;
+			break;
+		case IDM_COLOR_MODE_SOLID:
+			m_config.m_color_mode = oscilloscope_config::color_mode_solid;
+			break;
+		case IDM_COLOR_MODE_AMPLITUDE:
+			m_config.m_color_mode = oscilloscope_config::color_mode_amplitude;
+			break;
+		case IDM_COLOR_MODE_SLOPE:
+			m_config.m_color_mode = oscilloscope_config::color_mode_slope;
+			break;
+		case IDM_COLOR_MODE_TIME:
+			m_config.m_color_mode = oscilloscope_config::color_mode_time;
+			break;
+		case IDM_GLOW_ENABLED:
+			m_config.m_glow_enabled = !m_config.m_glow_enabled;
+			break;
+		case IDM_TRACE_ENABLED:
+			ToggleTrace();
+			break;
+		case IDM_EXPORT_FRAMES:
+			ExportFrames();
+			break;
+		case IDM_EXPORT_FRAME_RATE_24:
+			m_config.m_export_frame_rate_hz = 24;
+			break;
+		case IDM_EXPORT_FRAME_RATE_25:
+			m_config.m_export_frame_rate_hz = 25;
+			break;
+		case IDM_EXPORT_FRAME_RATE_30:
+			m_config.m_export_frame_rate_hz = 30;
+			break;
+		case IDM_EXPORT_FRAME_RATE_50:
+			m_config.m_export_frame_rate_hz = 50;
+			break;
+		case IDM_EXPORT_FRAME_RATE_60:
+			m_config.m_export_frame_rate_hz = 60;
+			break;
+		case IDM_EXPORT_RESOLUTION_WINDOW:
+			m_config.m_export_resolution = oscilloscope_config::export_resolution_window;
+			break;
+		case IDM_EXPORT_RESOLUTION_720P:
+			m_config.m_export_resolution = oscilloscope_config::export_resolution_720p;
+			break;
+		case IDM_EXPORT_RESOLUTION_1080P:
+			m_config.m_export_resolution = oscilloscope_config::export_resolution_1080p;
+			break;
+		case IDM_EXPORT_RESOLUTION_1440P:
+			m_config.m_export_resolution = oscilloscope_config::export_resolution_1440p;
+			break;
+		case IDM_EXPORT_RESOLUTION_2160P:
+			m_config.m_export_resolution = oscilloscope_config::export_resolution_2160p;
+			break;
+		case IDM_EXPORT_FORMAT_PNG:
+			m_config.m_export_format = oscilloscope_config::export_format_png;
+			break;
+		case IDM_EXPORT_FORMAT_PPM:
+			m_config.m_export_format = oscilloscope_config::export_format_ppm;
+			break;
 		case IDM_TRIGGER_ENABLED:
 			m_config.m_trigger_enabled = !m_config.m_trigger_enabled;
 			break;
+		case IDM_TRIGGER_PREDICTIVE_ENABLED:
+			m_config.m_trigger_predictive_enabled = !m_config.m_trigger_predictive_enabled;
+			break;
+		case IDM_TRIGGER_MODE_ZERO_CROSSING:
+			m_config.m_trigger_mode = oscilloscope_config::trigger_mode_zero_crossing;
+			break;
+		case IDM_TRIGGER_MODE_CORRELATION:
+			m_config.m_trigger_mode = oscilloscope_config::trigger_mode_correlation;
+			break;
+		case IDM_TRIGGER_SLOPE_RISING:
+			m_config.m_trigger_slope = oscilloscope_config::trigger_slope_rising;
+			break;
+		case IDM_TRIGGER_SLOPE_FALLING:
+			m_config.m_trigger_slope = oscilloscope_config::trigger_slope_falling;
+			break;
+		case IDM_TRIGGER_LEVEL_MINUS_50:
+			m_config.m_trigger_level_percent = -50;
+			break;
+		case IDM_TRIGGER_LEVEL_MINUS_25:
+			m_config.m_trigger_level_percent = -25;
+			break;
+		case IDM_TRIGGER_LEVEL_MINUS_10:
+			m_config.m_trigger_level_percent = -10;
+			break;
+		case IDM_TRIGGER_LEVEL_0:
+			m_config.m_trigger_level_percent = 0;
+			break;
+		case IDM_TRIGGER_LEVEL_10:
+			m_config.m_trigger_level_percent = 10;
+			break;
+		case IDM_TRIGGER_LEVEL_25:
+			m_config.m_trigger_level_percent = 25;
+			break;
+		case IDM_TRIGGER_LEVEL_50:
+			m_config.m_trigger_level_percent = 50;
+			break;
+		case IDM_TRIGGER_HYSTERESIS_0:
+			m_config.m_trigger_hysteresis_percent = 0;
+			break;
+		case IDM_TRIGGER_HYSTERESIS_1:
+			m_config.m_trigger_hysteresis_percent = 1;
+			break;
+		case IDM_TRIGGER_HYSTERESIS_2:
+			m_config.m_trigger_hysteresis_percent = 2;
+			break;
+		case IDM_TRIGGER_HYSTERESIS_5:
+			m_config.m_trigger_hysteresis_percent = 5;
+			break;
+		case IDM_TRIGGER_HYSTERESIS_10:
+			m_config.m_trigger_hysteresis_percent = 10;
+			break;
+		case IDM_TRIGGER_HYSTERESIS_20:
+			m_config.m_trigger_hysteresis_percent = 20;
+			break;
+		case IDM_TRIGGER_HOLDOFF_0:
+			m_config.m_trigger_holdoff_millis = 0;
+			break;
+		case IDM_TRIGGER_HOLDOFF_1:
+			m_config.m_trigger_holdoff_millis = 1;
+			break;
+		case IDM_TRIGGER_HOLDOFF_2:
+			m_config.m_trigger_holdoff_millis = 2;
+			break;
+		case IDM_TRIGGER_HOLDOFF_5:
+			m_config.m_trigger_holdoff_millis = 5;
+			break;
+		case IDM_TRIGGER_HOLDOFF_10:
+			m_config.m_trigger_holdoff_millis = 10;
+			break;
+		case IDM_TRIGGER_HOLDOFF_20:
+			m_config.m_trigger_holdoff_millis = 20;
+			break;
+		case IDM_TRIGGER_HOLDOFF_50:
+			m_config.m_trigger_holdoff_millis = 50;
+			break;
+		case IDM_TRIGGER_HOLDOFF_100:
+			m_config.m_trigger_holdoff_millis = 100;
+			break;
+		case IDM_TRIGGER_SOURCE_ANY:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_any;
+			break;
+		case IDM_TRIGGER_SOURCE_SUM:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_sum;
+			break;
+		case IDM_TRIGGER_SOURCE_CHANNEL_1:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_channel_1;
+			break;
+		case IDM_TRIGGER_SOURCE_CHANNEL_2:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_channel_1 + 1;
+			break;
+		case IDM_TRIGGER_SOURCE_CHANNEL_3:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_channel_1 + 2;
+			break;
+		case IDM_TRIGGER_SOURCE_CHANNEL_4:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_channel_1 + 3;
+			break;
+		case IDM_TRIGGER_SOURCE_CHANNEL_5:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_channel_1 + 4;
+			break;
+		case IDM_TRIGGER_SOURCE_CHANNEL_6:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_channel_1 + 5;
+			break;
+		case IDM_TRIGGER_SOURCE_CHANNEL_7:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_channel_1 + 6;
+			break;
+		case IDM_TRIGGER_SOURCE_CHANNEL_8:
+			m_config.m_trigger_source = oscilloscope_config::trigger_source_channel_1 + 7;
+			break;
+		case IDM_AVERAGE_COUNT_1:
+			m_config.m_average_count = 1;
+			break;
+		case IDM_AVERAGE_COUNT_2:
+			m_config.m_average_count = 2;
+			break;
+		case IDM_AVERAGE_COUNT_4:
+			m_config.m_average_count = 4;
+			break;
+		case IDM_AVERAGE_COUNT_8:
+			m_config.m_average_count = 8;
+			break;
+		case IDM_AVERAGE_COUNT_16:
+			m_config.m_average_count = 16;
+			break;
+		case IDM_AVERAGE_COUNT_32:
+			m_config.m_average_count = 32;
+			break;
+		case IDM_AVERAGE_COUNT_64:
+			m_config.m_average_count = 64;
+			break;
+		case IDM_AVERAGE_MODE_EXPONENTIAL:
+			m_config.m_average_mode = oscilloscope_config::average_mode_exponential;
+			break;
+		case IDM_AVERAGE_MODE_BOXCAR:
+			m_config.m_average_mode = oscilloscope_config::average_mode_boxcar;
+			break;
+		case IDM_CHANNEL_LAYOUT_STACKED:
+			m_config.m_channel_layout = oscilloscope_config::channel_layout_stacked;
+			break;
+		case IDM_CHANNEL_LAYOUT_OVERLAY:
+			m_config.m_channel_layout = oscilloscope_config::channel_layout_overlay;
+			break;
+		case IDM_CHANNEL_LAYOUT_GRID:
+			m_config.m_channel_layout = oscilloscope_config::channel_layout_grid;
+			break;
+		case IDM_CHANNEL_MATRIX_NONE:
+			m_config.m_channel_matrix = oscilloscope_config::channel_matrix_none;
+			break;
+		case IDM_CHANNEL_MATRIX_MID_SIDE:
+			m_config.m_channel_matrix = oscilloscope_config::channel_matrix_mid_side;
+			break;
+		case IDM_CHANNEL_MATRIX_DIFFERENCE:
+			m_config.m_channel_matrix = oscilloscope_config::channel_matrix_difference;
+			break;
+		case IDM_CHANNEL_MATRIX_FOLD_DOWN:
+			m_config.m_channel_matrix = oscilloscope_config::channel_matrix_fold_down;
+			break;
+		case IDM_CHANNEL_MATRIX_CUSTOM:
+			m_config.m_channel_matrix = oscilloscope_config::channel_matrix_custom;
+			break;
+		case IDM_CHANNEL_MATRIX_PASTE:
+			PasteCustomMatrix();
+			break;
+		case IDM_CHANNEL_VISIBLE_1:
+			m_config.m_channel_mask ^= 1u << 0;
+			break;
+		case IDM_CHANNEL_VISIBLE_2:
+			m_config.m_channel_mask ^= 1u << 1;
+			break;
+		case IDM_CHANNEL_VISIBLE_3:
+			m_config.m_channel_mask ^= 1u << 2;
+			break;
+		case IDM_CHANNEL_VISIBLE_4:
+			m_config.m_channel_mask ^= 1u << 3;
+			break;
+		case IDM_CHANNEL_VISIBLE_5:
+			m_config.m_channel_mask ^= 1u << 4;
+			break;
+		case IDM_CHANNEL_VISIBLE_6:
+			m_config.m_channel_mask ^= 1u << 5;
+			break;
+		case IDM_CHANNEL_VISIBLE_7:
+			m_config.m_channel_mask ^= 1u << 6;
+			break;
+		case IDM_CHANNEL_VISIBLE_8:
+			m_config.m_channel_mask ^= 1u << 7;
+			break;
+		case IDM_CHANNEL_ORDER_DEFAULT:
+			m_config.m_channel_order = oscilloscope_config::default_channel_order;
+			break;
+		case IDM_CHANNEL_ORDER_REVERSE:
+			m_config.reverse_channel_order();
+			break;
+		case IDM_CHANNEL_MOVE_UP_1:
+			m_config.move_channel_up(0);
+			break;
+		case IDM_CHANNEL_MOVE_UP_2:
+			m_config.move_channel_up(1);
+			break;
+		case IDM_CHANNEL_MOVE_UP_3:
+			m_config.move_channel_up(2);
+			break;
+		case IDM_CHANNEL_MOVE_UP_4:
+			m_config.move_channel_up(3);
+			break;
+		case IDM_CHANNEL_MOVE_UP_5:
+			m_config.move_channel_up(4);
+			break;
+		case IDM_CHANNEL_MOVE_UP_6:
+			m_config.move_channel_up(5);
+			break;
+		case IDM_CHANNEL_MOVE_UP_7:
+			m_config.move_channel_up(6);
+			break;
+		case IDM_CHANNEL_MOVE_UP_8:
+			m_config.move_channel_up(7);
+			break;
 		case IDM_RESAMPLE_ENABLED:
 			m_config.m_resample_enabled = !m_config.m_resample_enabled;
 			break;
@@ -576,6 +1068,39 @@ void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point)
 		case IDM_WINDOW_DURATION_800:
 			m_config.m_window_duration_millis = 800;
 			break;
+		case IDM_TIMEBASE_PERIODS_0:
+			m_config.m_timebase_periods = 0;
+			break;
+		case IDM_TIMEBASE_PERIODS_1:
+			m_config.m_timebase_periods = 1;
+			break;
+		case IDM_TIMEBASE_PERIODS_2:
+			m_config.m_timebase_periods = 2;
+			break;
+		case IDM_TIMEBASE_PERIODS_4:
+			m_config.m_timebase_periods = 4;
+			break;
+		case IDM_TIMEBASE_PERIODS_8:
+			m_config.m_timebase_periods = 8;
+			break;
+		case IDM_ROLL_DURATION_1:
+			m_config.m_roll_duration_seconds = 1;
+			break;
+		case IDM_ROLL_DURATION_2:
+			m_config.m_roll_duration_seconds = 2;
+			break;
+		case IDM_ROLL_DURATION_5:
+			m_config.m_roll_duration_seconds = 5;
+			break;
+		case IDM_ROLL_DURATION_10:
+			m_config.m_roll_duration_seconds = 10;
+			break;
+		case IDM_ROLL_DURATION_20:
+			m_config.m_roll_duration_seconds = 20;
+			break;
+		case IDM_ROLL_DURATION_30:
+			m_config.m_roll_duration_seconds = 30;
+			break;
 		case IDM_ZOOM_5:
 			m_config.m_zoom_percent = 5;
 			break;
@@ -675,6 +1200,27 @@ void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point)
 		case IDM_ZOOM_1000:
 			m_config.m_zoom_percent = 1000;
 			break;
+		case IDM_AUTO_GAIN_ENABLED:
+			m_config.m_auto_gain_enabled = !m_config.m_auto_gain_enabled;
+			break;
+		case IDM_AUTO_GAIN_WINDOW_250:
+			m_config.m_auto_gain_window_millis = 250;
+			break;
+		case IDM_AUTO_GAIN_WINDOW_500:
+			m_config.m_auto_gain_window_millis = 500;
+			break;
+		case IDM_AUTO_GAIN_WINDOW_1000:
+			m_config.m_auto_gain_window_millis = 1000;
+			break;
+		case IDM_AUTO_GAIN_WINDOW_2000:
+			m_config.m_auto_gain_window_millis = 2000;
+			break;
+		case IDM_AUTO_GAIN_WINDOW_5000:
+			m_config.m_auto_gain_window_millis = 5000;
+			break;
+		case IDM_AUTO_GAIN_WINDOW_10000:
+			m_config.m_auto_gain_window_millis = 10000;
+			break;
 		case IDM_REFRESH_RATE_LIMIT_20:
 			m_config.m_refresh_rate_limit_hz = 20;
 			UpdateRefreshRateLimit();
@@ -807,6 +1353,8 @@ void oscilloscope_ui_element_instance::OnContextMenu(CWindow wnd, CPoint point)
 			break;
 		}
 
+		m_renderer.set_config(m_config);
+		m_roll.set_config(m_config);
 		Invalidate();
 	}
 }
@@ -829,6 +1377,73 @@ void oscilloscope_ui_element_instance::UpdateRefreshRateLimit() {
     m_refresh_interval = pfc::clip_t<DWORD>(1000 / m_config.m_refresh_rate_limit_hz, 5, 1000);
 }
 
+// Starts recording, or stops and writes everything recorded since to the profile folder as a
+// Chrome trace, for chrome://tracing or Perfetto. Tracing is process-wide, not per instance.
+void oscilloscope_ui_element_instance::ToggleTrace() {
+    if (!pfc::tracer::isEnabled()) {
+        pfc::string8 discarded;
+        pfc::tracer::exportChromeTrace(discarded);
+        pfc::tracer::setEnabled(true);
+        return;
+    }
+
+    pfc::tracer::setEnabled(false);
+    pfc::string8 trace;
+    pfc::tracer::exportChromeTrace(trace);
+
+    pfc::string8 path = core_api::pathInProfile("foo_vis_oscilloscope_d2d-trace.json");
+    try {
+        abort_callback_dummy abort;
+        file::ptr f;
+        filesystem::g_open_write_new(f, path, abort);
+        f->write_string_raw(trace, abort);
+        console::formatter() << core_api::get_my_file_name() << ": performance trace written to " << file_path_display(path);
+    } catch (std::exception & exc) {
+        console::formatter() << core_api::get_my_file_name() << ": exception while writing performance trace: " << exc;
+    }
+}
+
+// Takes a custom channel matrix from the clipboard, one row of weights for each output channel,
+// and switches to it.
+void oscilloscope_ui_element_instance::PasteCustomMatrix() {
+    pfc::string8 text;
+    float weights[oscilloscope_config::custom_matrix_max_channels * oscilloscope_config::custom_matrix_max_channels];
+    t_uint32 input_count, output_count;
+    if (!uGetClipboardString(text) || !oscilloscope_channel_matrix::g_parse_custom_weights(text, weights, input_count, output_count)) {
+        popup_message::g_show("Copy a channel matrix to the clipboard first: one row for each output channel, with a weight for each input channel, such as \"0.5 0.5; 0.5 -0.5\" for mid/side. Rows are separated by semicolons or line breaks. There can be up to 8 input and output channels, and weights from -16 to 16.", "Oscilloscope");
+        return;
+    }
+
+    pfc::memcpy_t(m_config.m_custom_matrix_weights, weights, (t_size) input_count * output_count);
+    m_config.m_custom_matrix_input_count = input_count;
+    m_config.m_custom_matrix_output_count = output_count;
+    m_config.m_channel_matrix = oscilloscope_config::channel_matrix_custom;
+}
+
+// Exports the playing track, or else the focused one, with the current settings and colors.
+void oscilloscope_ui_element_instance::ExportFrames() {
+    metadb_handle_ptr track;
+    if (!static_api_ptr_t<playback_control>()->get_now_playing(track) && !static_api_ptr_t<playlist_manager>()->activeplaylist_get_focus_item_handle(track)) {
+        popup_message::g_show("Play or select the track to export first.", "Oscilloscope");
+        return;
+    }
+
+    pfc::string8 directory;
+    if (!uBrowseForFolder(m_hWnd, "Choose the folder for the exported frames", directory)) {
+        return;
+    }
+
+    t_uint32 width, height;
+    if (!m_config.get_export_size(width, height)) {
+        CRect rcClient;
+        GetClientRect(rcClient);
+        width = pfc::max_t<t_uint32>(rcClient.Width(), 1);
+        height = pfc::max_t<t_uint32>(rcClient.Height(), 1);
+    }
+
+    oscilloscope_export_frames(core_api::get_main_window(), track, m_config, m_callback->query_std_color(ui_color_background), m_callback->query_std_color(ui_color_text), width, height, directory);
+}
+
 HRESULT oscilloscope_ui_element_instance::CreateDeviceIndependentResources() {
     HRESULT hr = S_OK;
 
@@ -869,6 +1484,8 @@ HRESULT oscilloscope_ui_element_instance::CreateDeviceResources() {
 void oscilloscope_ui_element_instance::DiscardDeviceResources() {
     m_pRenderTarget.Release();
     m_pStrokeBrush.Release();
+    m_roll.reset();
+    m_renderer.discard_device_resources();
 }
 
 static service_factory_single_t< ui_element_impl_visualisation< oscilloscope_ui_element_instance> > g_ui_element_factory;
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "oscilloscope_config.h"
+#include "oscilloscope_renderer.h"
+#include "oscilloscope_overview_loader.h"
+#include "oscilloscope_roll.h"
 
 class oscilloscope_ui_element_instance : public ui_element_instance, public CWindowImpl<oscilloscope_ui_element_instance> {
 public:
@@ -30,9 +33,14 @@ public:
     void ToggleFullScreen();
     void UpdateChannelMode();
     void UpdateRefreshRateLimit();
+    void ToggleTrace();
+    void PasteCustomMatrix();
+    void ExportFrames();
 
     HRESULT Render();
-    HRESULT RenderChunk(const audio_chunk &chunk);
+    HRESULT RenderChunk(const audio_chunk &chunk, double chunk_time);
+    HRESULT RenderRoll(const D2D1_COLOR_F & background);
+    HRESULT RenderOverview();
     HRESULT CreateDeviceIndependentResources();
     HRESULT CreateDeviceResources();
     void DiscardDeviceResources();
@@ -60,8 +68,104 @@ private:
 		IDM_HW_RENDERING_ENABLED,
 		IDM_DOWNMIX_ENABLED,
 		IDM_TRIGGER_ENABLED,
+		IDM_TRIGGER_PREDICTIVE_ENABLED,
+		IDM_TRIGGER_MODE_ZERO_CROSSING,
+		IDM_TRIGGER_MODE_CORRELATION,
+		IDM_TRIGGER_SLOPE_RISING,
+		IDM_TRIGGER_SLOPE_FALLING,
+		IDM_TRIGGER_LEVEL_MINUS_50,
+		IDM_TRIGGER_LEVEL_MINUS_25,
+		IDM_TRIGGER_LEVEL_MINUS_10,
+		IDM_TRIGGER_LEVEL_0,
+		IDM_TRIGGER_LEVEL_10,
+		IDM_TRIGGER_LEVEL_25,
+		IDM_TRIGGER_LEVEL_50,
+		IDM_TRIGGER_HYSTERESIS_0,
+		IDM_TRIGGER_HYSTERESIS_1,
+		IDM_TRIGGER_HYSTERESIS_2,
+		IDM_TRIGGER_HYSTERESIS_5,
+		IDM_TRIGGER_HYSTERESIS_10,
+		IDM_TRIGGER_HYSTERESIS_20,
+		IDM_TRIGGER_HOLDOFF_0,
+		IDM_TRIGGER_HOLDOFF_1,
+		IDM_TRIGGER_HOLDOFF_2,
+		IDM_TRIGGER_HOLDOFF_5,
+		IDM_TRIGGER_HOLDOFF_10,
+		IDM_TRIGGER_HOLDOFF_20,
+		IDM_TRIGGER_HOLDOFF_50,
+		IDM_TRIGGER_HOLDOFF_100,
+		IDM_TRIGGER_SOURCE_ANY,
+		IDM_TRIGGER_SOURCE_SUM,
+		IDM_TRIGGER_SOURCE_CHANNEL_1,
+		IDM_TRIGGER_SOURCE_CHANNEL_2,
+		IDM_TRIGGER_SOURCE_CHANNEL_3,
+		IDM_TRIGGER_SOURCE_CHANNEL_4,
+		IDM_TRIGGER_SOURCE_CHANNEL_5,
+		IDM_TRIGGER_SOURCE_CHANNEL_6,
+		IDM_TRIGGER_SOURCE_CHANNEL_7,
+		IDM_TRIGGER_SOURCE_CHANNEL_8,
+		IDM_AVERAGE_COUNT_1,
+		IDM_AVERAGE_COUNT_2,
+		IDM_AVERAGE_COUNT_4,
+		IDM_AVERAGE_COUNT_8,
+		IDM_AVERAGE_COUNT_16,
+		IDM_AVERAGE_COUNT_32,
+		IDM_AVERAGE_COUNT_64,
+		IDM_AVERAGE_MODE_EXPONENTIAL,
+		IDM_AVERAGE_MODE_BOXCAR,
+		IDM_CHANNEL_LAYOUT_STACKED,
+		IDM_CHANNEL_LAYOUT_OVERLAY,
+		IDM_CHANNEL_LAYOUT_GRID,
+		IDM_CHANNEL_MATRIX_NONE,
+		IDM_CHANNEL_MATRIX_MID_SIDE,
+		IDM_CHANNEL_MATRIX_DIFFERENCE,
+		IDM_CHANNEL_MATRIX_FOLD_DOWN,
+		IDM_CHANNEL_MATRIX_CUSTOM,
+		IDM_CHANNEL_MATRIX_PASTE,
+		IDM_CHANNEL_VISIBLE_1,
+		IDM_CHANNEL_VISIBLE_2,
+		IDM_CHANNEL_VISIBLE_3,
+		IDM_CHANNEL_VISIBLE_4,
+		IDM_CHANNEL_VISIBLE_5,
+		IDM_CHANNEL_VISIBLE_6,
+		IDM_CHANNEL_VISIBLE_7,
+		IDM_CHANNEL_VISIBLE_8,
+		IDM_CHANNEL_ORDER_DEFAULT,
+		IDM_CHANNEL_ORDER_REVERSE,
+		IDM_CHANNEL_MOVE_UP_1,
+		IDM_CHANNEL_MOVE_UP_2,
+		IDM_CHANNEL_MOVE_UP_3,
+		IDM_CHANNEL_MOVE_UP_4,
+		IDM_CHANNEL_MOVE_UP_5,
+		IDM_CHANNEL_MOVE_UP_6,
+		IDM_CHANNEL_MOVE_UP_7,
+		IDM_CHANNEL_MOVE_UP_8,
 		IDM_RESAMPLE_ENABLED,
 		IDM_LOW_QUALITY_ENABLED,
+		IDM_OVERVIEW_ENABLED,
+		IDM_ROLL_ENABLED,
+		IDM_SPECTRUM_ENABLED,
+		IDM_TUNER_ENABLED,
+		IDM_BAND_SPLIT_ENABLED,
+		IDM_COLOR_MODE_SOLID,
+		IDM_COLOR_MODE_AMPLITUDE,
+		IDM_COLOR_MODE_SLOPE,
+		IDM_COLOR_MODE_TIME,
+		IDM_GLOW_ENABLED,
+		IDM_TRACE_ENABLED,
+		IDM_EXPORT_FRAMES,
+		IDM_EXPORT_FRAME_RATE_24,
+		IDM_EXPORT_FRAME_RATE_25,
+		IDM_EXPORT_FRAME_RATE_30,
+		IDM_EXPORT_FRAME_RATE_50,
+		IDM_EXPORT_FRAME_RATE_60,
+		IDM_EXPORT_RESOLUTION_WINDOW,
+		IDM_EXPORT_RESOLUTION_720P,
+		IDM_EXPORT_RESOLUTION_1080P,
+		IDM_EXPORT_RESOLUTION_1440P,
+		IDM_EXPORT_RESOLUTION_2160P,
+		IDM_EXPORT_FORMAT_PNG,
+		IDM_EXPORT_FORMAT_PPM,
 		IDM_WINDOW_DURATION_1,
 		IDM_WINDOW_DURATION_2,
 		IDM_WINDOW_DURATION_3,
@@ -98,6 +202,17 @@ private:
 		IDM_WINDOW_DURATION_500,
 		IDM_WINDOW_DURATION_600,
 		IDM_WINDOW_DURATION_800,
+		IDM_TIMEBASE_PERIODS_0,
+		IDM_TIMEBASE_PERIODS_1,
+		IDM_TIMEBASE_PERIODS_2,
+		IDM_TIMEBASE_PERIODS_4,
+		IDM_TIMEBASE_PERIODS_8,
+		IDM_ROLL_DURATION_1,
+		IDM_ROLL_DURATION_2,
+		IDM_ROLL_DURATION_5,
+		IDM_ROLL_DURATION_10,
+		IDM_ROLL_DURATION_20,
+		IDM_ROLL_DURATION_30,
 		IDM_ZOOM_5,
 		IDM_ZOOM_10,
 		IDM_ZOOM_15,
@@ -131,6 +246,13 @@ private:
 		IDM_ZOOM_600,
 		IDM_ZOOM_800,
 		IDM_ZOOM_1000,
+		IDM_AUTO_GAIN_ENABLED,
+		IDM_AUTO_GAIN_WINDOW_250,
+		IDM_AUTO_GAIN_WINDOW_500,
+		IDM_AUTO_GAIN_WINDOW_1000,
+		IDM_AUTO_GAIN_WINDOW_2000,
+		IDM_AUTO_GAIN_WINDOW_5000,
+		IDM_AUTO_GAIN_WINDOW_10000,
 		IDM_REFRESH_RATE_LIMIT_20,
 		IDM_REFRESH_RATE_LIMIT_30,
 		IDM_REFRESH_RATE_LIMIT_50,
@@ -176,6 +298,15 @@ private:
     DWORD m_last_refresh;
     DWORD m_refresh_interval;
 
+    // Reused from frame to frame, so that their storage is only allocated once.
+    audio_chunk_impl m_chunk;
+    pfc::array_t<audio_sample> m_resampled;
+
+    oscilloscope_renderer m_renderer;
+    oscilloscope_roll m_roll;
+    oscilloscope_overview_loader m_overview_loader;
+    pfc::threadPool m_thread_pool;
+
     visualisation_stream_v2::ptr m_vis_stream;
 
     CComPtr<ID2D1Factory> m_pDirect2dFactory;
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #include "targetver.h"
 
 // Windows Header Files:
@@ -19,3 +21,15 @@
 
 #include <d2d1.h>
 #include <d2d1helper.h>
+#include <dwrite.h>
+
+#else
+
+// Outside Windows only the modules that depend on neither the foobar2000 SDK nor Direct2D are built,
+// by the tests and benchmarks in tests/.
+#include <pfc/pfc.h>
+
+#include <float.h>
+#include <math.h>
+
+#endif
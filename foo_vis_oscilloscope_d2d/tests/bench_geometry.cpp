@@ -0,0 +1,60 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_geometry.h"
+
+#include <stdio.h>
+
+namespace {
+    struct generate_vertices_func {
+        const oscilloscope_sample_window_view * m_window;
+        const oscilloscope_channel_transform * m_transforms;
+        oscilloscope_point * m_points;
+        bool m_generic;
+
+        void operator()() const {
+            if (m_generic) {
+                oscilloscope_generate_vertices_generic(*m_window, 0, m_window->m_sample_count, m_transforms, m_window->m_channel_count, m_points);
+            } else {
+                oscilloscope_generate_vertices(*m_window, m_transforms, m_window->m_channel_count, m_points);
+            }
+        }
+    };
+}
+
+// Time per frame of the kernels specialized for 1, 2, 6 and 8 channels against the generic kernel,
+// on a window of the size drawn at 48 kHz with the default window duration.
+void oscilloscope_geometry_bench() {
+    const t_uint32 sample_count = 4800;
+    const t_uint32 channel_counts[] = {1, 2, 6, 8};
+    t_uint32 seed = 1;
+
+    printf("  %-10s %14s %14s %8s\n", "channels", "specialized", "generic", "speedup");
+    for (t_size c = 0; c < PFC_TABSIZE(channel_counts); ++c) {
+        t_uint32 channel_count = channel_counts[c];
+        pfc::array_t<audio_sample> samples;
+        samples.set_size(channel_count * sample_count);
+        oscilloscope_fill_random(samples.get_ptr(), samples.get_size(), seed);
+        oscilloscope_sample_window_view window(samples.get_ptr(), channel_count, sample_count, 48000);
+
+        oscilloscope_channel_transform transforms[8];
+        for (t_uint32 trace_index = 0; trace_index < channel_count; ++trace_index) {
+            oscilloscope_channel_transform & transform = transforms[trace_index];
+            transform.m_channel_index = trace_index;
+            transform.m_x_offset = 0.0f;
+            transform.m_x_scale = 0.25f;
+            transform.m_y_offset = 100.0f * (float) (trace_index + 1);
+            transform.m_y_scale = 50.0f;
+        }
+
+        pfc::array_t<oscilloscope_point> points;
+        points.set_size(channel_count * sample_count);
+
+        generate_vertices_func func = {&window, transforms, points.get_ptr(), false};
+        double specialized = oscilloscope_bench_time(func);
+        func.m_generic = true;
+        double generic = oscilloscope_bench_time(func);
+
+        printf("  %-10u %11.2f ns %11.2f ns %7.2fx\n", channel_count, specialized * 1e9 / sample_count, generic * 1e9 / sample_count, generic / specialized);
+    }
+}
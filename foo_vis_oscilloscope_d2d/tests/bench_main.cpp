@@ -0,0 +1,29 @@
+#include "stdafx.h"
+
+#include "tests.h"
+
+#include <stdio.h>
+
+namespace {
+    struct bench_entry {
+        const char * m_name;
+        void (* m_func)();
+    };
+
+    const bench_entry g_benches[] = {
+        {"geometry", oscilloscope_geometry_bench},
+        {"tessellator", oscilloscope_tessellator_bench},
+        {"tracer", oscilloscope_tracer_bench},
+    };
+}
+
+int main(int argc, char ** argv) {
+    for (t_size n = 0; n < PFC_TABSIZE(g_benches); ++n) {
+        if (argc > 1 && strcmp(argv[1], g_benches[n].m_name) != 0) {
+            continue;
+        }
+        printf("%s:\n", g_benches[n].m_name);
+        g_benches[n].m_func();
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_tessellator.h"
+
+#include <stdio.h>
+
+namespace {
+    struct tessellate_func {
+        const oscilloscope_point * m_points;
+        t_uint32 m_trace_count;
+        t_uint32 m_sample_count;
+        t_uint32 m_join;
+        // Ranges of fewer than four vertices never reach the SIMD loop, so stroking the traces three
+        // vertices at a time times the scalar loop.
+        bool m_scalar;
+        oscilloscope_point * m_strip;
+
+        void operator()() const {
+            if (!m_scalar) {
+                oscilloscope_tessellate_traces(m_points, m_trace_count, m_sample_count, 1.7f, m_join, 4.0f, m_strip);
+                return;
+            }
+            for (t_uint32 begin = 0; begin < m_sample_count; begin += 3) {
+                oscilloscope_tessellate_traces(m_points, m_trace_count, m_sample_count, begin, pfc::min_t(begin + 3, m_sample_count), 1.7f, m_join, 4.0f, m_strip);
+            }
+        }
+    };
+}
+
+// Time per vertex of stroking two traces of the size drawn at 48 kHz with the default window
+// duration, with either join, against the scalar loop.
+void oscilloscope_tessellator_bench() {
+    const t_uint32 trace_count = 2, sample_count = 4800;
+    pfc::array_t<audio_sample> samples;
+    samples.set_size(trace_count * sample_count);
+    t_uint32 seed = 1;
+    oscilloscope_fill_random(samples.get_ptr(), samples.get_size(), seed);
+
+    pfc::array_t<oscilloscope_point> points;
+    points.set_size(trace_count * sample_count);
+    for (t_uint32 n = 0; n < trace_count * sample_count; ++n) {
+        points[n].x = 0.25f * (float) (n % sample_count);
+        points[n].y = 100.0f * (float) (n / sample_count + 1) + 50.0f * (float) samples[n];
+    }
+    pfc::array_t<oscilloscope_point> strip;
+    strip.set_size(trace_count * oscilloscope_get_strip_length(sample_count));
+
+    const t_uint32 joins[] = {oscilloscope_join_bevel, oscilloscope_join_miter};
+    const char * const names[] = {"bevel", "miter"};
+    printf("  %-10s %14s %14s %8s\n", "join", "simd", "scalar", "speedup");
+    for (t_size n = 0; n < PFC_TABSIZE(joins); ++n) {
+        tessellate_func func = {points.get_ptr(), trace_count, sample_count, joins[n], false, strip.get_ptr()};
+        double simd = oscilloscope_bench_time(func);
+        func.m_scalar = true;
+        double scalar = oscilloscope_bench_time(func);
+
+        t_uint32 vertex_count = trace_count * sample_count;
+        printf("  %-10s %11.2f ns %11.2f ns %7.2fx\n", names[n], simd * 1e9 / vertex_count, scalar * 1e9 / vertex_count, scalar / simd);
+    }
+}
@@ -0,0 +1,68 @@
+#include "stdafx.h"
+
+#include "tests.h"
+
+#include <stdio.h>
+
+namespace {
+    // Fewer than a trace buffer holds, so that no event is dropped while timed.
+    const t_size scope_count = 1 << 14;
+
+    struct empty_scopes_func {
+        void operator()() const {
+            for (t_size n = 0; n < scope_count; ++n) {
+                PFC_TRACE_SCOPE(bench_empty);
+            }
+        }
+    };
+
+    struct timestamps_func {
+        t_uint64 m_sum;
+
+        void operator()() {
+            for (t_size n = 0; n < scope_count; ++n) {
+                m_sum += pfc::traceTimestamp();
+            }
+        }
+    };
+
+    // Mean time of an empty scope; the buffer is emptied between runs, outside the timed part.
+    double time_empty_scope() {
+        empty_scopes_func func;
+        pfc::string8 json;
+        double total = 0;
+        t_size runs = 0;
+        while (total < 0.2) {
+            pfc::hires_timer timer;
+            timer.start();
+            func();
+            total += timer.query();
+            ++runs;
+            pfc::tracer::exportChromeTrace(json);
+        }
+        return total / (double) (runs * scope_count);
+    }
+}
+
+// Cost of an empty PFC_TRACE_SCOPE with tracing enabled and disabled. Enabled scopes are meant to
+// stay under 50 ns, so that frames can be traced stage by stage without distorting them.
+void oscilloscope_tracer_bench() {
+    const bool was_enabled = pfc::tracer::isEnabled();
+    pfc::string8 json;
+    pfc::tracer::exportChromeTrace(json);
+
+    pfc::tracer::setEnabled(false);
+    double disabled = time_empty_scope();
+    pfc::tracer::setEnabled(true);
+    double enabled = time_empty_scope();
+    pfc::tracer::setEnabled(was_enabled);
+
+    // An enabled scope reads two timestamps, which virtual machines may make much slower than the
+    // rest of the scope.
+    timestamps_func timestamps = {0};
+    double timestamp = oscilloscope_bench_time(timestamps) / (double) scope_count;
+
+    printf("  disabled scope %8.2f ns\n", disabled * 1e9);
+    printf("  enabled scope  %8.2f ns%s\n", enabled * 1e9, enabled < 50e-9 ? "" : " (over the 50 ns budget)");
+    printf("  timestamp      %8.2f ns\n", timestamp * 1e9);
+}
@@ -0,0 +1,66 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_average.h"
+
+namespace {
+    // The boxcar average matches the mean of the last N windows computed from scratch. Loud windows
+    // leave rounding errors in the running sum that would swamp quiet ones; they must be gone two
+    // rounds of the ring after the last loud window.
+    void test_boxcar(t_uint32 count) {
+        const t_uint32 channel_count = 2, sample_count = 37, frame_count = 600;
+        const t_size size = channel_count * sample_count;
+
+        pfc::array_t<audio_sample> windows;
+        windows.set_size(size * frame_count);
+        t_uint32 seed = count;
+        oscilloscope_fill_random(windows.get_ptr(), windows.get_size(), seed);
+        for (t_uint32 frame = 100; frame < 200; ++frame) {
+            for (t_size index = 0; index < size; ++index) {
+                windows[frame * size + index] *= 1000;
+            }
+        }
+
+        oscilloscope_average average;
+        average.set_parameters(oscilloscope_average::mode_boxcar, count);
+        for (t_uint32 frame = 0; frame < frame_count; ++frame) {
+            oscilloscope_sample_window_view window(windows.get_ptr() + frame * size, channel_count, sample_count, 44100);
+            oscilloscope_sample_window_view result = average.add(window);
+            OSCILLOSCOPE_CHECK(result.m_channel_count == channel_count && result.m_sample_count == sample_count);
+
+            t_uint32 used = pfc::min_t(frame + 1, count);
+            bool settled = frame < 100 || frame >= 200 + 2 * count;
+            double tolerance = settled ? 1e-5 : 1e-1;
+            for (t_size index = 0; index < size; ++index) {
+                double expected = 0;
+                for (t_uint32 back = 0; back < used; ++back) {
+                    expected += windows[(frame - back) * size + index];
+                }
+                expected /= used;
+                OSCILLOSCOPE_CHECK(fabs(result.m_samples[index] - expected) < tolerance);
+            }
+        }
+    }
+
+    // The first window is taken as it is, and later ones are blended in with a weight of
+    // 1 / (windows seen) until N windows have been seen, which makes the plain mean up to then.
+    void test_exponential() {
+        const t_uint32 count = 4;
+        oscilloscope_average average;
+        average.set_parameters(oscilloscope_average::mode_exponential, count);
+        audio_sample values[] = {1, 3, 5, 7, 9};
+        double expected[] = {1, 2, 3, 4, 4 + (9 - 4) / 4.0};
+        for (t_size n = 0; n < PFC_TABSIZE(values); ++n) {
+            oscilloscope_sample_window_view result = average.add(oscilloscope_sample_window_view(values + n, 1, 1, 44100));
+            OSCILLOSCOPE_CHECK(fabs(result.m_samples[0] - expected[n]) < 1e-6);
+        }
+    }
+}
+
+void oscilloscope_average_test() {
+    const t_uint32 counts[] = {1, 2, 3, 8, 16};
+    for (t_size n = 0; n < PFC_TABSIZE(counts); ++n) {
+        test_boxcar(counts[n]);
+    }
+    test_exponential();
+}
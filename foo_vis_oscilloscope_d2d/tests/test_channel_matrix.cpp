@@ -0,0 +1,121 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_channel_matrix.h"
+
+namespace {
+    const t_uint32 g_max_channels = oscilloscope_channel_matrix::custom_max_channels;
+
+    // Custom matrices of every shape that has a kernel of its own, and of one that does not, match
+    // the weighted sums computed in double. The odd sample count leaves a tail after the SIMD loops.
+    void test_custom(t_uint32 input_count, t_uint32 output_count) {
+        const t_uint32 sample_count = 1023;
+        t_uint32 seed = input_count * 16 + output_count;
+
+        pfc::array_t<audio_sample> weights_random;
+        weights_random.set_size(input_count * output_count);
+        oscilloscope_fill_random(weights_random.get_ptr(), weights_random.get_size(), seed);
+        float weights[g_max_channels * g_max_channels];
+        for (t_size index = 0; index < weights_random.get_size(); ++index) {
+            weights[index] = (float) weights_random[index] * 2.0f;
+        }
+
+        pfc::array_t<audio_sample> samples;
+        samples.set_size(sample_count * input_count);
+        oscilloscope_fill_random(samples.get_ptr(), samples.get_size(), seed);
+
+        oscilloscope_channel_matrix matrix;
+        matrix.set_custom_weights(weights, input_count, output_count);
+        matrix.set_mode(oscilloscope_channel_matrix::mode_custom);
+        oscilloscope_sample_window_view result = matrix.apply(oscilloscope_sample_window_view(samples.get_ptr(), input_count, sample_count, 44100));
+        OSCILLOSCOPE_CHECK(result.m_channel_count == output_count && result.m_sample_count == sample_count);
+        for (t_uint32 sample_index = 0; sample_index < sample_count; ++sample_index) {
+            for (t_uint32 output = 0; output < output_count; ++output) {
+                double expected = 0;
+                for (t_uint32 input = 0; input < input_count; ++input) {
+                    expected += (double) weights[output * input_count + input] * samples[sample_index * input_count + input];
+                }
+                OSCILLOSCOPE_CHECK(fabs(result.m_samples[sample_index * output_count + output] - expected) < 1e-5);
+            }
+        }
+
+        // Windows with a different channel count are passed through.
+        audio_sample other[(g_max_channels + 1) * 4] = {};
+        t_uint32 other_count = input_count + 1;
+        oscilloscope_sample_window_view passed = matrix.apply(oscilloscope_sample_window_view(other, other_count, 4, 44100));
+        OSCILLOSCOPE_CHECK(passed.m_samples == other && passed.m_channel_count == other_count);
+    }
+
+    // A custom matrix with the weights of a preset mixes like the preset.
+    void test_custom_matches_preset() {
+        const t_uint32 sample_count = 257;
+        pfc::array_t<audio_sample> samples;
+        samples.set_size(sample_count * 2);
+        t_uint32 seed = 7;
+        oscilloscope_fill_random(samples.get_ptr(), samples.get_size(), seed);
+        oscilloscope_sample_window_view window(samples.get_ptr(), 2, sample_count, 44100);
+
+        oscilloscope_channel_matrix preset, custom;
+        preset.set_mode(oscilloscope_channel_matrix::mode_mid_side);
+        const float weights[] = {0.5f, 0.5f, 0.5f, -0.5f};
+        custom.set_custom_weights(weights, 2, 2);
+        custom.set_mode(oscilloscope_channel_matrix::mode_custom);
+        oscilloscope_sample_window_view expected = preset.apply(window);
+        oscilloscope_sample_window_view result = custom.apply(window);
+        OSCILLOSCOPE_CHECK(result.m_channel_count == 2 && memcmp(result.m_samples, expected.m_samples, sample_count * 2 * sizeof(audio_sample)) == 0);
+
+        // New weights take effect without a change of mode, and invalid ones turn the matrix off.
+        const float difference[] = {1.0f, -1.0f};
+        custom.set_custom_weights(difference, 2, 1);
+        result = custom.apply(window);
+        OSCILLOSCOPE_CHECK(result.m_channel_count == 1 && fabs(result.m_samples[3] - (samples[6] - samples[7])) < 1e-6);
+        const float invalid[] = {1.0f, 100.0f};
+        custom.set_custom_weights(invalid, 2, 1);
+        result = custom.apply(window);
+        OSCILLOSCOPE_CHECK(result.m_samples == window.m_samples);
+    }
+
+    void test_parse() {
+        float weights[g_max_channels * g_max_channels];
+        t_uint32 input_count, output_count;
+
+        OSCILLOSCOPE_CHECK(oscilloscope_channel_matrix::g_parse_custom_weights("0.5 0.5; 0.5 -0.5", weights, input_count, output_count));
+        OSCILLOSCOPE_CHECK(input_count == 2 && output_count == 2);
+        OSCILLOSCOPE_CHECK(weights[0] == 0.5f && weights[1] == 0.5f && weights[2] == 0.5f && weights[3] == -0.5f);
+
+        // Rows are packed however they were separated.
+        OSCILLOSCOPE_CHECK(oscilloscope_channel_matrix::g_parse_custom_weights("\t1 0 .25\r\n\r\n0 +1 -2.5e-1;\n", weights, input_count, output_count));
+        OSCILLOSCOPE_CHECK(input_count == 3 && output_count == 2);
+        const float expected[] = {1.0f, 0.0f, 0.25f, 0.0f, 1.0f, -0.25f};
+        for (t_size index = 0; index < PFC_TABSIZE(expected); ++index) {
+            OSCILLOSCOPE_CHECK(weights[index] == expected[index]);
+        }
+
+        OSCILLOSCOPE_CHECK(oscilloscope_channel_matrix::g_parse_custom_weights("1 1 1 1 1 1 1 1", weights, input_count, output_count));
+        OSCILLOSCOPE_CHECK(input_count == 8 && output_count == 1);
+
+        const char * const invalid[] = {
+            "",
+            " ; \n",
+            "1 2; 3",         // rows of different lengths
+            "1, 2",           // commas are not separators
+            "1 x",
+            "-",
+            "1 1 1 1 1 1 1 1 1",
+            "1;1;1;1;1;1;1;1;1",
+            "16.5",
+        };
+        for (t_size n = 0; n < PFC_TABSIZE(invalid); ++n) {
+            OSCILLOSCOPE_CHECK(!oscilloscope_channel_matrix::g_parse_custom_weights(invalid[n], weights, input_count, output_count));
+        }
+    }
+}
+
+void oscilloscope_channel_matrix_test() {
+    const t_uint32 shapes[][2] = {{2, 1}, {2, 2}, {6, 2}, {8, 2}, {3, 5}, {1, 8}};
+    for (t_size n = 0; n < PFC_TABSIZE(shapes); ++n) {
+        test_custom(shapes[n][0], shapes[n][1]);
+    }
+    test_custom_matches_preset();
+    test_parse();
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_geometry.h"
+
+namespace {
+    void make_transforms(t_uint32 trace_count, oscilloscope_channel_transform * transforms) {
+        for (t_uint32 trace_index = 0; trace_index < trace_count; ++trace_index) {
+            oscilloscope_channel_transform & transform = transforms[trace_index];
+            transform.m_channel_index = trace_index;
+            transform.m_x_offset = 3.0f + (float) trace_index;
+            transform.m_x_scale = 0.75f;
+            transform.m_y_offset = 40.0f * (float) (trace_index + 1);
+            transform.m_y_scale = 17.5f;
+        }
+    }
+
+    bool is_equal(const pfc::array_t<oscilloscope_point> & a, const pfc::array_t<oscilloscope_point> & b) {
+        return a.get_size() == b.get_size() && memcmp(a.get_ptr(), b.get_ptr(), a.get_size() * sizeof(oscilloscope_point)) == 0;
+    }
+
+    // Every kernel, including the SSE2 stereo kernel with its odd tail, gives the result of the
+    // generic kernel, for the whole window and for disjoint ranges of it.
+    void test_channel_count(t_uint32 channel_count, t_uint32 sample_count, t_uint32 & seed) {
+        pfc::array_t<audio_sample> samples;
+        samples.set_size(channel_count * sample_count);
+        oscilloscope_fill_random(samples.get_ptr(), samples.get_size(), seed);
+        oscilloscope_sample_window_view window(samples.get_ptr(), channel_count, sample_count, 44100);
+
+        oscilloscope_channel_transform transforms[8];
+        make_transforms(channel_count, transforms);
+
+        pfc::array_t<oscilloscope_point> expected, points, ranges;
+        expected.set_size(channel_count * sample_count);
+        points.set_size(channel_count * sample_count);
+        ranges.set_size(channel_count * sample_count);
+
+        oscilloscope_generate_vertices_generic(window, 0, sample_count, transforms, channel_count, expected.get_ptr());
+        oscilloscope_generate_vertices(window, transforms, channel_count, points.get_ptr());
+        OSCILLOSCOPE_CHECK(is_equal(points, expected));
+
+        const t_uint32 splits[] = {0, 1, 4, 7, sample_count / 2 + 1, sample_count};
+        for (t_size n = 0; n + 1 < PFC_TABSIZE(splits); ++n) {
+            t_uint32 begin = pfc::min_t(splits[n], sample_count);
+            t_uint32 end = pfc::min_t(splits[n + 1], sample_count);
+            if (begin < end) {
+                oscilloscope_generate_vertices(window, begin, end, transforms, channel_count, ranges.get_ptr());
+            }
+        }
+        OSCILLOSCOPE_CHECK(is_equal(ranges, expected));
+
+        for (t_uint32 trace_index = 0; trace_index < channel_count; ++trace_index) {
+            const oscilloscope_channel_transform & transform = transforms[trace_index];
+            for (t_uint32 sample_index = 0; sample_index < sample_count; sample_index += 13) {
+                const oscilloscope_point & point = expected[trace_index * sample_count + sample_index];
+                OSCILLOSCOPE_CHECK(point.x == transform.m_x_offset + (float) sample_index * transform.m_x_scale);
+                OSCILLOSCOPE_CHECK(point.y == transform.m_y_offset - window.get_frame(sample_index)[trace_index] * transform.m_y_scale);
+            }
+        }
+    }
+
+    // A mapping that skips or reorders channels only reads the channels that are drawn.
+    void test_mapping(t_uint32 & seed) {
+        const t_uint32 channel_count = 6, sample_count = 101;
+        pfc::array_t<audio_sample> samples;
+        samples.set_size(channel_count * sample_count);
+        oscilloscope_fill_random(samples.get_ptr(), samples.get_size(), seed);
+        oscilloscope_sample_window_view window(samples.get_ptr(), channel_count, sample_count, 48000);
+
+        oscilloscope_channel_transform transforms[2];
+        make_transforms(2, transforms);
+        transforms[0].m_channel_index = 4;
+        transforms[1].m_channel_index = 1;
+
+        pfc::array_t<oscilloscope_point> points;
+        points.set_size(2 * sample_count);
+        oscilloscope_generate_vertices(window, transforms, 2, points.get_ptr());
+        for (t_uint32 sample_index = 0; sample_index < sample_count; ++sample_index) {
+            OSCILLOSCOPE_CHECK(points[sample_index].y == transforms[0].m_y_offset - window.get_frame(sample_index)[4] * transforms[0].m_y_scale);
+            OSCILLOSCOPE_CHECK(points[sample_count + sample_index].y == transforms[1].m_y_offset - window.get_frame(sample_index)[1] * transforms[1].m_y_scale);
+        }
+    }
+}
+
+void oscilloscope_geometry_test() {
+    t_uint32 seed = 1;
+    const t_uint32 channel_counts[] = {1, 2, 3, 6, 8};
+    const t_uint32 sample_counts[] = {1, 2, 3, 64, 257};
+    for (t_size c = 0; c < PFC_TABSIZE(channel_counts); ++c) {
+        for (t_size s = 0; s < PFC_TABSIZE(sample_counts); ++s) {
+            test_channel_count(channel_counts[c], sample_counts[s], seed);
+        }
+    }
+    test_mapping(seed);
+}
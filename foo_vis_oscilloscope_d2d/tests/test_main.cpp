@@ -0,0 +1,38 @@
+#include "stdafx.h"
+
+#include "tests.h"
+
+#include <stdio.h>
+
+namespace {
+    struct test_entry {
+        const char * m_name;
+        void (* m_func)();
+    };
+
+    const test_entry g_tests[] = {
+        {"average", oscilloscope_average_test},
+        {"channel_matrix", oscilloscope_channel_matrix_test},
+        {"geometry", oscilloscope_geometry_test},
+        {"overview", oscilloscope_overview_test},
+        {"rasterizer", oscilloscope_rasterizer_test},
+        {"stages", oscilloscope_stages_test},
+        {"tessellator", oscilloscope_tessellator_test},
+    };
+}
+
+int main(int argc, char ** argv) {
+    for (t_size n = 0; n < PFC_TABSIZE(g_tests); ++n) {
+        if (argc > 1 && strcmp(argv[1], g_tests[n].m_name) != 0) {
+            continue;
+        }
+        try {
+            g_tests[n].m_func();
+        } catch (const std::exception & e) {
+            printf("%s: FAILED\n%s\n", g_tests[n].m_name, e.what());
+            return 1;
+        }
+        printf("%s: OK\n", g_tests[n].m_name);
+    }
+    return 0;
+}
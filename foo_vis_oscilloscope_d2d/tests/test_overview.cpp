@@ -0,0 +1,195 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_overview.h"
+
+#include <stdio.h>
+
+namespace {
+    void append_le(pfc::array_t<t_uint8> & out, t_uint32 value, t_size byte_count) {
+        for (t_size n = 0; n < byte_count; ++n) {
+            out.append_single((t_uint8) (value >> (8 * n)));
+        }
+    }
+
+    // Writes a canonical PCM WAV file with a "LIST" chunk before "data", which the reader has to
+    // skip. Samples are given as raw little-endian words of bits_per_sample bits.
+    void write_wav(const char * path, t_uint32 format_tag, t_uint32 channel_count, t_uint32 sample_rate, t_uint32 bits_per_sample, const t_uint32 * words, t_size word_count) {
+        t_uint32 bytes_per_sample = bits_per_sample / 8;
+        t_uint32 data_size = (t_uint32) (word_count * bytes_per_sample);
+
+        pfc::array_t<t_uint8> file;
+        file.append_fromptr((const t_uint8 *) "RIFF", 4);
+        append_le(file, 4 + 24 + 12 + 8 + data_size, 4);
+        file.append_fromptr((const t_uint8 *) "WAVEfmt ", 8);
+        append_le(file, 16, 4);
+        append_le(file, format_tag, 2);
+        append_le(file, channel_count, 2);
+        append_le(file, sample_rate, 4);
+        append_le(file, sample_rate * channel_count * bytes_per_sample, 4);
+        append_le(file, channel_count * bytes_per_sample, 2);
+        append_le(file, bits_per_sample, 2);
+        file.append_fromptr((const t_uint8 *) "LIST", 4);
+        append_le(file, 4, 4);
+        file.append_fromptr((const t_uint8 *) "INFO", 4);
+        file.append_fromptr((const t_uint8 *) "data", 4);
+        append_le(file, data_size, 4);
+        for (t_size n = 0; n < word_count; ++n) {
+            append_le(file, words[n], bytes_per_sample);
+        }
+
+        FILE * f = fopen(path, "wb");
+        OSCILLOSCOPE_CHECK(f != nullptr);
+        OSCILLOSCOPE_CHECK(fwrite(file.get_ptr(), 1, file.get_size(), f) == file.get_size());
+        fclose(f);
+    }
+
+    // The envelope that the overview should report for [begin, end) of channel, from the samples
+    // themselves: the extremes rounded outwards to the 16-bit grid of the cache.
+    void get_expected_range(const pfc::array_t<audio_sample> & samples, t_uint32 channel_count, t_uint32 channel, t_uint64 begin, t_uint64 end, float & out_min, float & out_max) {
+        audio_sample range_min = samples[(t_size) begin * channel_count + channel];
+        audio_sample range_max = range_min;
+        for (t_uint64 index = begin; index < end; ++index) {
+            range_min = pfc::min_t(range_min, samples[(t_size) index * channel_count + channel]);
+            range_max = pfc::max_t(range_max, samples[(t_size) index * channel_count + channel]);
+        }
+        out_min = (float) floor(range_min * 32767) * (1.0f / 32767);
+        out_max = (float) ceil(range_max * 32767) * (1.0f / 32767);
+    }
+
+    // Every bucket of every level, queried with a range that covers exactly that bucket, holds the
+    // envelope of its samples.
+    void check_levels(const oscilloscope_overview & overview, const pfc::array_t<audio_sample> & samples) {
+        t_uint32 channel_count = overview.get_channel_count();
+        t_uint64 sample_count = overview.get_sample_count();
+        t_uint32 level_count = 0;
+        for (t_uint64 bucket_length = oscilloscope_overview::block_length; ; bucket_length *= 2) {
+            ++level_count;
+            for (t_uint64 begin = 0; begin < sample_count; begin += bucket_length) {
+                t_uint64 end = pfc::min_t(begin + bucket_length, sample_count);
+                for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+                    float range_min, range_max, expected_min, expected_max;
+                    OSCILLOSCOPE_CHECK(overview.get_range(channel, begin, begin + bucket_length, range_min, range_max));
+                    get_expected_range(samples, channel_count, channel, begin, end, expected_min, expected_max);
+                    OSCILLOSCOPE_CHECK(range_min == expected_min && range_max == expected_max);
+                }
+            }
+            if (bucket_length >= sample_count) {
+                break;
+            }
+        }
+        OSCILLOSCOPE_CHECK(level_count == 6);
+
+        // Unaligned ranges are answered from whole buckets, so the envelope may be wider than the
+        // range but never narrower.
+        for (t_uint64 begin = 0; begin < sample_count; begin += 777) {
+            t_uint64 end = pfc::min_t(begin + 1500, sample_count);
+            float range_min, range_max, expected_min, expected_max;
+            OSCILLOSCOPE_CHECK(overview.get_range(1, begin, end, range_min, range_max));
+            get_expected_range(samples, channel_count, 1, begin, end, expected_min, expected_max);
+            OSCILLOSCOPE_CHECK(range_min <= expected_min && range_max >= expected_max);
+        }
+
+        float range_min, range_max;
+        OSCILLOSCOPE_CHECK(!overview.get_range(0, sample_count, sample_count + 10, range_min, range_max));
+        OSCILLOSCOPE_CHECK(!overview.get_range(channel_count, 0, sample_count, range_min, range_max));
+    }
+
+    // A stereo 16-bit track of 20 blocks, the last one partial, so that the pyramid has levels of
+    // 20, 10, 5, 3, 2 and 1 buckets and the reader has to return more than one buffer.
+    void test_pyramid() {
+        const t_uint32 channel_count = 2, sample_rate = 44100;
+        const t_size sample_count = 19 * oscilloscope_overview::block_length + 100;
+
+        pfc::array_t<t_uint32> words;
+        pfc::array_t<audio_sample> samples;
+        words.set_size(sample_count * channel_count);
+        samples.set_size(sample_count * channel_count);
+        t_uint32 seed = 1;
+        for (t_size index = 0; index < sample_count; ++index) {
+            seed = seed * 1664525 + 1013904223;
+            // A ramp that reaches full scale in both directions, and noise of growing amplitude.
+            t_int16 values[2] = {
+                (t_int16) ((t_int32) (index * 65535 / (sample_count - 1)) - 32768),
+                (t_int16) (((t_int32) ((seed >> 16) & 0xffff) - 32768) * (t_int32) (index + 1) / (t_int32) sample_count)
+            };
+            for (t_uint32 channel = 0; channel < channel_count; ++channel) {
+                words[index * channel_count + channel] = (t_uint16) values[channel];
+                samples[index * channel_count + channel] = (audio_sample) values[channel] * (audio_sample) (1.0 / 32768);
+            }
+        }
+
+        pfc::string8 wav_path, cache_path, cache_name;
+        oscilloscope_get_temp_path("oscilloscope_overview_test.wav", wav_path);
+        oscilloscope_overview::g_get_cache_file_name(wav_path, cache_name);
+        oscilloscope_get_temp_path(cache_name, cache_path);
+        write_wav(wav_path, 1, channel_count, sample_rate, 16, words.get_ptr(), words.get_size());
+
+        const t_uint64 timestamp = 0x0123456789abcdefull;
+        {
+            oscilloscope_overview_wav_source source;
+            OSCILLOSCOPE_CHECK(source.open(wav_path));
+            OSCILLOSCOPE_CHECK(source.get_channel_count() == channel_count && source.get_sample_rate() == sample_rate);
+
+            oscilloscope_overview overview;
+            OSCILLOSCOPE_CHECK(overview.build(source, cache_path, wav_path, timestamp));
+            OSCILLOSCOPE_CHECK(overview.get_channel_count() == channel_count && overview.get_sample_rate() == sample_rate);
+            OSCILLOSCOPE_CHECK(overview.get_sample_count() == sample_count);
+            check_levels(overview, samples);
+        }
+
+        // The cache file written by build() is mapped back and gives the same answers; it is only
+        // accepted for the track and modification time it was built from.
+        {
+            oscilloscope_overview overview;
+            OSCILLOSCOPE_CHECK(!overview.open(cache_path, wav_path, timestamp + 1));
+            OSCILLOSCOPE_CHECK(!overview.open(cache_path, "other.wav", timestamp));
+            OSCILLOSCOPE_CHECK(overview.open(cache_path, wav_path, timestamp));
+            OSCILLOSCOPE_CHECK(overview.get_sample_count() == sample_count && overview.get_sample_rate() == sample_rate);
+            check_levels(overview, samples);
+        }
+
+        remove(wav_path);
+        remove(cache_path);
+    }
+
+    // Each supported sample format decodes to the same values.
+    void test_formats() {
+        struct format {
+            t_uint32 m_format_tag;
+            t_uint32 m_bits_per_sample;
+            t_uint32 m_words[3];
+        };
+        // -1, 0 and 0.5 in each format.
+        const format formats[] = {
+            {1, 8, {0x00, 0x80, 0xc0}},
+            {1, 16, {0x8000, 0, 0x4000}},
+            {1, 24, {0x800000, 0, 0x400000}},
+            {1, 32, {0x80000000u, 0, 0x40000000}},
+            {3, 32, {0xbf800000u, 0, 0x3f000000}},
+        };
+
+        pfc::string8 wav_path;
+        oscilloscope_get_temp_path("oscilloscope_overview_format_test.wav", wav_path);
+        for (t_size n = 0; n < PFC_TABSIZE(formats); ++n) {
+            write_wav(wav_path, formats[n].m_format_tag, 1, 8000, formats[n].m_bits_per_sample, formats[n].m_words, 3);
+            oscilloscope_overview_wav_source source;
+            OSCILLOSCOPE_CHECK(source.open(wav_path));
+            audio_sample out[4];
+            OSCILLOSCOPE_CHECK(source.read(out, 4) == 3);
+            OSCILLOSCOPE_CHECK(out[0] == -1 && out[1] == 0 && out[2] == 0.5f);
+            OSCILLOSCOPE_CHECK(source.read(out, 4) == 0);
+        }
+
+        // 12-bit samples are not supported.
+        write_wav(wav_path, 1, 1, 8000, 12, formats[0].m_words, 3);
+        oscilloscope_overview_wav_source source;
+        OSCILLOSCOPE_CHECK(!source.open(wav_path));
+        remove(wav_path);
+    }
+}
+
+void oscilloscope_overview_test() {
+    test_formats();
+    test_pyramid();
+}
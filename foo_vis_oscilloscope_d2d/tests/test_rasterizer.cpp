@@ -0,0 +1,109 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_rasterizer.h"
+#include "oscilloscope_tessellator.h"
+
+namespace {
+    oscilloscope_color make_color(float r, float g, float b, float a) {
+        oscilloscope_color color = {r, g, b, a};
+        return color;
+    }
+
+    oscilloscope_size make_size(t_uint32 width, t_uint32 height) {
+        oscilloscope_size size = {width, height};
+        return size;
+    }
+
+    // A pixel is covered if its center is inside a triangle; the later layer is drawn over the
+    // earlier one, and the padding at the end of each row stays clear.
+    void test_coverage() {
+        const oscilloscope_point strip[] = {
+            {1.0f, 1.0f}, {1.0f, 3.0f}, {5.0f, 1.0f}, {5.0f, 3.0f},
+            {4.0f, 2.0f}, {4.0f, 6.0f}, {6.0f, 2.0f}, {6.0f, 6.0f},
+        };
+        const oscilloscope_color colors[] = {make_color(1.0f, 0.0f, 0.0f, 1.0f), make_color(0.0f, 0.0f, 1.0f, 1.0f)};
+        oscilloscope_rasterizer raster;
+        raster.render(strip, 2, 1, 4, colors, 0.5f, make_size(7, 7), nullptr);
+        OSCILLOSCOPE_CHECK(raster.get_width() == 7 && raster.get_height() == 7 && raster.get_stride() == 8);
+
+        const t_uint32 red = 0x80800000, blue = 0x80000080;
+        for (t_uint32 row = 0; row < 7; ++row) {
+            for (t_uint32 column = 0; column < 8; ++column) {
+                t_uint32 expected = 0;
+                if (column >= 4 && column < 6 && row >= 2 && row < 6) {
+                    expected = blue;
+                } else if (column >= 1 && column < 5 && row >= 1 && row < 3) {
+                    expected = red;
+                }
+                OSCILLOSCOPE_CHECK(raster.get_pixels()[row * raster.get_stride() + column] == expected);
+            }
+        }
+    }
+
+    // Noisy sine waves that cross each other and run off the image, stroked in two layers of
+    // different widths and colors. Where triangles overlap, the pixel shows the last one, so any
+    // change of order between threads would show.
+    void make_strip(t_uint32 layer_count, t_uint32 trace_count, t_uint32 sample_count, t_uint32 width, t_uint32 height, pfc::array_t<oscilloscope_point> & strip) {
+        pfc::array_t<audio_sample> random;
+        random.set_size(trace_count * sample_count);
+        t_uint32 seed = trace_count * sample_count;
+        oscilloscope_fill_random(random.get_ptr(), random.get_size(), seed);
+
+        pfc::array_t<oscilloscope_point> points;
+        points.set_size(trace_count * sample_count);
+        for (t_uint32 n = 0; n < trace_count * sample_count; ++n) {
+            t_uint32 trace_index = n / sample_count;
+            points[n].x = (float) (n % sample_count) * (float) (width + 20) / (float) sample_count - 10.0f;
+            float phase = 6.2831853f * (3.0f * points[n].x / (float) width + (float) trace_index);
+            points[n].y = (float) height * ((float) (trace_index + 1) / (float) (trace_count + 1) + 0.4f * sin(phase) + 0.02f * (float) random[n]);
+        }
+
+        t_uint32 layer_length = trace_count * oscilloscope_get_strip_length(sample_count);
+        strip.set_size(layer_count * layer_length);
+        for (t_uint32 layer = 0; layer < layer_count; ++layer) {
+            float stroke_width = 6.0f - 4.0f * (float) layer;
+            oscilloscope_tessellate_traces(points.get_ptr(), trace_count, sample_count, stroke_width, oscilloscope_join_miter, 4.0f, strip.get_ptr() + layer * layer_length);
+        }
+    }
+
+    // The pixels drawn on the calling thread alone are the pixels drawn by pools of any number of
+    // threads, including binning in more than one chunk.
+    void test_threads(t_uint32 trace_count, t_uint32 sample_count, t_uint32 width, t_uint32 height) {
+        const t_uint32 layer_count = 2;
+        pfc::array_t<oscilloscope_point> strip;
+        make_strip(layer_count, trace_count, sample_count, width, height, strip);
+        const oscilloscope_color colors[] = {make_color(0.2f, 0.6f, 1.0f, 1.0f), make_color(1.0f, 1.0f, 0.4f, 1.0f)};
+        t_uint32 strip_length = oscilloscope_get_strip_length(sample_count);
+
+        oscilloscope_rasterizer expected;
+        expected.render(strip.get_ptr(), layer_count, trace_count, strip_length, colors, 0.9f, make_size(width, height), nullptr);
+        t_size size = (t_size) expected.get_stride() * expected.get_height();
+
+        t_size covered = 0;
+        for (t_size n = 0; n < size; ++n) {
+            covered += expected.get_pixels()[n] != 0 ? 1 : 0;
+        }
+        OSCILLOSCOPE_CHECK(covered > size / 20 && covered < size);
+
+        // Workers in addition to the calling thread.
+        const t_size worker_counts[] = {0, 1, 3, 7};
+        for (t_size n = 0; n < PFC_TABSIZE(worker_counts); ++n) {
+            pfc::threadPool pool(worker_counts[n]);
+            oscilloscope_rasterizer raster;
+            // Twice, the second time into the buffers left by the first.
+            for (int pass = 0; pass < 2; ++pass) {
+                raster.render(strip.get_ptr(), layer_count, trace_count, strip_length, colors, 0.9f, make_size(width, height), &pool);
+                OSCILLOSCOPE_CHECK(raster.get_stride() == expected.get_stride() && raster.get_height() == expected.get_height());
+                OSCILLOSCOPE_CHECK(memcmp(raster.get_pixels(), expected.get_pixels(), size * sizeof(t_uint32)) == 0);
+            }
+        }
+    }
+}
+
+void oscilloscope_rasterizer_test() {
+    test_coverage();
+    test_threads(3, 200, 333, 250);
+    // 2 layers x 4 traces x (19200 - 2) triangles make ten chunks of binning.
+    test_threads(4, 4800, 1280, 720);
+}
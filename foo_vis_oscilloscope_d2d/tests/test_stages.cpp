@@ -0,0 +1,118 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_average.h"
+#include "oscilloscope_band_split.h"
+#include "oscilloscope_channel_matrix.h"
+#include "oscilloscope_sample_buffer.h"
+
+namespace {
+    // Stages that the samples of a frame go through on their way to the vertices, as set up by
+    // oscilloscope_renderer::set_config(), and the source of the export that feeds them.
+    struct chain_config {
+        t_uint32 m_matrix_mode;
+        t_uint32 m_average_count;
+        bool m_band_split;
+        bool m_downmix;
+    };
+
+    const t_uint32 g_channel_count = 2;
+    const t_uint32 g_sample_rate = 48000;
+    const t_size g_window_length = 1600;
+    const t_size g_frame_step = 800;
+    const t_size g_frame_count = 12;
+
+    // Bytes of samples that a stage hands on which are not a view of the samples that it was given.
+    t_size get_copied_bytes(const oscilloscope_sample_window_view & input, const oscilloscope_sample_window_view & output) {
+        return output.m_samples == input.m_samples ? 0 : output.get_data_size() * sizeof(audio_sample);
+    }
+
+    // Runs the frames of a track through the stages in the order of oscilloscope_renderer::render()
+    // and returns the bytes that each frame copied, which must be the same for every frame.
+    // Windows start first_offset samples into the track; negative offsets need silence padding.
+    t_size run_chain(const chain_config & config, t_int64 first_offset) {
+        const t_size track_length = g_window_length + g_frame_step * g_frame_count;
+        pfc::array_t<audio_sample> track;
+        track.set_size(track_length * g_channel_count);
+        t_uint32 seed = 1;
+        oscilloscope_fill_random(track.get_ptr(), track.get_size(), seed);
+
+        oscilloscope_sample_buffer buffer;
+        buffer.reset(g_sample_rate, g_channel_count, 0);
+        buffer.append(track.get_ptr(), track_length);
+        // Windows returned in place point into the held samples, at the offset of their position.
+        const audio_sample * held = buffer.get_window(0, track_length, false).m_samples;
+
+        oscilloscope_channel_matrix matrix;
+        matrix.set_mode(config.m_matrix_mode);
+        oscilloscope_average average;
+        average.set_parameters(oscilloscope_average::mode_exponential, config.m_average_count);
+        oscilloscope_band_split band_split;
+
+        t_size frame_bytes = 0;
+        for (t_size frame_index = 0; frame_index < g_frame_count; ++frame_index) {
+            t_int64 first = first_offset + (t_int64) (frame_index * g_frame_step);
+            oscilloscope_sample_window_view input = buffer.get_window(first, g_window_length, config.m_downmix);
+            t_size bytes = 0;
+            if (first < 0 || input.m_samples != held + (t_size) first * g_channel_count) {
+                bytes += input.get_data_size() * sizeof(audio_sample);
+            }
+
+            oscilloscope_sample_window_view window = matrix.apply(input);
+            bytes += get_copied_bytes(input, window);
+
+            oscilloscope_sample_window_view source = window;
+            if (config.m_band_split) {
+                source = band_split.process(window, (double) first / g_sample_rate);
+                bytes += get_copied_bytes(window, source);
+            }
+
+            // As if the trigger had picked a crossing in the first half of the window.
+            oscilloscope_sample_window_view range = source.get_range((t_uint32) (frame_index * 37 % (g_window_length / 2)), g_window_length / 2);
+            oscilloscope_sample_window_view shown = average.add(range);
+            bytes += get_copied_bytes(range, shown);
+
+            OSCILLOSCOPE_CHECK(shown.m_sample_count == g_window_length / 2);
+            OSCILLOSCOPE_CHECK(frame_index == 0 || bytes == frame_bytes);
+            frame_bytes = bytes;
+        }
+        return frame_bytes;
+    }
+}
+
+// With every stage off, the vertices are generated from the decoded samples themselves; each stage
+// that is enabled adds one copy of the window that it produces, and nothing else.
+void oscilloscope_stages_test() {
+    const t_size sample = sizeof(audio_sample);
+    // Three bands of two channels make six lanes, padded to eight.
+    const t_size band_lanes = 8;
+
+    const chain_config all_off = {oscilloscope_channel_matrix::mode_none, 1, false, false};
+    OSCILLOSCOPE_CHECK(run_chain(all_off, 0) == 0);
+
+    // Windows that start before the track are padded with silence in a copy.
+    OSCILLOSCOPE_CHECK(run_chain(all_off, -(t_int64) (g_frame_step * g_frame_count)) == g_window_length * g_channel_count * sample);
+
+    const chain_config downmix = {oscilloscope_channel_matrix::mode_none, 1, false, true};
+    OSCILLOSCOPE_CHECK(run_chain(downmix, 0) == g_window_length * sample);
+
+    // Mid/side keeps the channel count; the difference mixes to a single channel.
+    const chain_config mid_side = {oscilloscope_channel_matrix::mode_mid_side, 1, false, false};
+    OSCILLOSCOPE_CHECK(run_chain(mid_side, 0) == g_window_length * g_channel_count * sample);
+    const chain_config difference = {oscilloscope_channel_matrix::mode_difference, 1, false, false};
+    OSCILLOSCOPE_CHECK(run_chain(difference, 0) == g_window_length * sample);
+
+    // The fold-down does not apply to stereo, which passes through.
+    const chain_config fold_down = {oscilloscope_channel_matrix::mode_fold_down, 1, false, false};
+    OSCILLOSCOPE_CHECK(run_chain(fold_down, 0) == 0);
+
+    // The average only holds the half of the window that is shown.
+    const chain_config averaged = {oscilloscope_channel_matrix::mode_none, 8, false, false};
+    OSCILLOSCOPE_CHECK(run_chain(averaged, 0) == g_window_length / 2 * g_channel_count * sample);
+
+    const chain_config bands = {oscilloscope_channel_matrix::mode_none, 1, true, false};
+    OSCILLOSCOPE_CHECK(run_chain(bands, 0) == g_window_length * band_lanes * sample);
+
+    const chain_config all_on = {oscilloscope_channel_matrix::mode_mid_side, 8, true, false};
+    OSCILLOSCOPE_CHECK(run_chain(all_on, 0) == (g_window_length * g_channel_count + g_window_length * band_lanes + g_window_length / 2 * band_lanes) * sample);
+}
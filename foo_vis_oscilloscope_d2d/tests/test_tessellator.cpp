@@ -0,0 +1,110 @@
+#include "stdafx.h"
+
+#include "tests.h"
+#include "oscilloscope_tessellator.h"
+
+namespace {
+    oscilloscope_point make_point(float x, float y) {
+        oscilloscope_point point = {x, y};
+        return point;
+    }
+
+    bool is_point(const oscilloscope_point & point, float x, float y) {
+        return point.x == x && point.y == y;
+    }
+
+    // A staircase of right angles, alternately a turn from +x to +y and from +y to +x. The
+    // coordinates are multiples of 10 and the half width is 1, so every vertex of the strip is
+    // exact. The trace is long enough for the vertices in the middle to go through the SIMD loop.
+    void test_staircase(t_uint32 join, float miter_limit, bool expect_miter) {
+        const t_uint32 sample_count = 13;
+        oscilloscope_point points[sample_count];
+        for (t_uint32 n = 0; n < sample_count; ++n) {
+            points[n] = make_point(10.0f * (float) ((n + 1) / 2), 10.0f * (float) (n / 2));
+        }
+        oscilloscope_point strip[4 * sample_count];
+        oscilloscope_tessellate_traces(points, 1, sample_count, 2.0f, join, miter_limit, strip);
+
+        // Both ends take the normal of their only segment, which is along +y for the first and
+        // along -x for the last.
+        const oscilloscope_point & first = points[0];
+        OSCILLOSCOPE_CHECK(is_point(strip[0], first.x, first.y + 1) && is_point(strip[1], first.x, first.y - 1));
+        OSCILLOSCOPE_CHECK(is_point(strip[2], first.x, first.y + 1) && is_point(strip[3], first.x, first.y - 1));
+        const oscilloscope_point & last = points[sample_count - 1];
+        const oscilloscope_point * end = strip + 4 * (sample_count - 1);
+        OSCILLOSCOPE_CHECK(is_point(end[0], last.x - 1, last.y) && is_point(end[1], last.x + 1, last.y));
+        OSCILLOSCOPE_CHECK(is_point(end[2], last.x - 1, last.y) && is_point(end[3], last.x + 1, last.y));
+
+        for (t_uint32 n = 1; n + 1 < sample_count; ++n) {
+            float x = points[n].x, y = points[n].y;
+            const oscilloscope_point * out = strip + 4 * n;
+            if (n % 2 == 1) {
+                // From +x to +y: a left turn, with the right side on the outside.
+                OSCILLOSCOPE_CHECK(is_point(out[0], x, y + 1) && is_point(out[2], x - 1, y));
+                if (expect_miter) {
+                    OSCILLOSCOPE_CHECK(is_point(out[1], x + 1, y - 1) && is_point(out[3], x + 1, y - 1));
+                } else {
+                    OSCILLOSCOPE_CHECK(is_point(out[1], x, y - 1) && is_point(out[3], x + 1, y));
+                }
+            } else {
+                // From +y to +x: a right turn, with the left side on the outside.
+                OSCILLOSCOPE_CHECK(is_point(out[1], x + 1, y) && is_point(out[3], x, y - 1));
+                if (expect_miter) {
+                    OSCILLOSCOPE_CHECK(is_point(out[0], x - 1, y + 1) && is_point(out[2], x - 1, y + 1));
+                } else {
+                    OSCILLOSCOPE_CHECK(is_point(out[0], x - 1, y) && is_point(out[2], x, y + 1));
+                }
+            }
+        }
+    }
+
+    // Random traces, with repeated vertices for segments of no length, stroked in one call and in
+    // disjoint ranges. Ranges shorter than four vertices go through the scalar loop only, so this
+    // also holds the SIMD loop to the results of the scalar one.
+    void test_ranges(t_uint32 trace_count, t_uint32 sample_count, t_uint32 join, t_uint32 & seed) {
+        pfc::array_t<audio_sample> random;
+        random.set_size(2 * trace_count * sample_count);
+        oscilloscope_fill_random(random.get_ptr(), random.get_size(), seed);
+        pfc::array_t<oscilloscope_point> points;
+        points.set_size(trace_count * sample_count);
+        for (t_size n = 0; n < points.get_size(); ++n) {
+            if (n % 7 == 3) {
+                points[n] = points[n - 1];
+            } else {
+                points[n] = make_point(100.0f * (float) random[2 * n], 100.0f * (float) random[2 * n + 1]);
+            }
+        }
+
+        t_size strip_size = (t_size) trace_count * oscilloscope_get_strip_length(sample_count);
+        pfc::array_t<oscilloscope_point> expected, ranges;
+        expected.set_size(strip_size);
+        ranges.set_size(strip_size);
+        oscilloscope_tessellate_traces(points.get_ptr(), trace_count, sample_count, 3.5f, join, 4.0f, expected.get_ptr());
+
+        const t_uint32 lengths[] = {1, 3, 2, 5, 4, 9, 1, 16};
+        for (t_uint32 offset = 0; offset < PFC_TABSIZE(lengths); ++offset) {
+            pfc::fill_array_t(ranges, make_point(-1.0f, -1.0f));
+            t_uint32 begin = 0;
+            for (t_uint32 n = offset; begin < sample_count; ++n) {
+                t_uint32 end = pfc::min_t(begin + lengths[n % PFC_TABSIZE(lengths)], sample_count);
+                oscilloscope_tessellate_traces(points.get_ptr(), trace_count, sample_count, begin, end, 3.5f, join, 4.0f, ranges.get_ptr());
+                begin = end;
+            }
+            OSCILLOSCOPE_CHECK(memcmp(ranges.get_ptr(), expected.get_ptr(), strip_size * sizeof(oscilloscope_point)) == 0);
+        }
+    }
+}
+
+void oscilloscope_tessellator_test() {
+    test_staircase(oscilloscope_join_bevel, 0.0f, false);
+    // The miter of a right angle reaches sqrt(2) half widths from the vertex.
+    test_staircase(oscilloscope_join_miter, 1.5f, true);
+    test_staircase(oscilloscope_join_miter, 1.4f, false);
+
+    t_uint32 seed = 3;
+    const t_uint32 sample_counts[] = {1, 2, 5, 6, 37, 480};
+    for (t_size n = 0; n < PFC_TABSIZE(sample_counts); ++n) {
+        test_ranges(1, sample_counts[n], oscilloscope_join_bevel, seed);
+        test_ranges(3, sample_counts[n], oscilloscope_join_miter, seed);
+    }
+}
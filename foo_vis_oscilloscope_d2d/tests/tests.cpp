@@ -0,0 +1,17 @@
+#include "stdafx.h"
+
+#include "tests.h"
+
+void oscilloscope_check(bool condition, const char * text, const char * file, int line) {
+    if (!condition) {
+        pfc::string_formatter message;
+        message << file << ":" << line << ": check failed: " << text;
+        throw std::runtime_error(message.get_ptr());
+    }
+}
+
+void oscilloscope_get_temp_path(const char * name, pfc::string_base & out) {
+    const char * folder = getenv("TMPDIR");
+    out.reset();
+    out << ((folder != nullptr && *folder != 0) ? folder : "/tmp") << "/" << name;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Shared by the tests and the benchmarks of the modules that build outside Windows; see makefile.
+
+// Unlike PFC_ASSERT, checks are made in release builds too. A failed check throws, which ends the run.
+#define OSCILLOSCOPE_CHECK(condition) oscilloscope_check(!!(condition), #condition, __FILE__, __LINE__)
+
+void oscilloscope_check(bool condition, const char * text, const char * file, int line);
+
+// Path of a scratch file in the temporary folder.
+void oscilloscope_get_temp_path(const char * name, pfc::string_base & out);
+
+// Fills samples with reproducible pseudo-random values in [-1, 1).
+inline void oscilloscope_fill_random(audio_sample * samples, t_size count, t_uint32 & seed) {
+    for (t_size n = 0; n < count; ++n) {
+        seed = seed * 1664525 + 1013904223;
+        samples[n] = (audio_sample) ((double) (seed >> 8) / (double) (1 << 23) - 1.0);
+    }
+}
+
+// Calls func until at least a fifth of a second has passed and returns the mean time of one call
+// in seconds.
+template<typename t_func> double oscilloscope_bench_time(t_func & func) {
+    func();
+    t_size count = 0;
+    pfc::hires_timer timer;
+    timer.start();
+    double elapsed;
+    do {
+        func();
+        ++count;
+        elapsed = timer.query();
+    } while (elapsed < 0.2);
+    return elapsed / (double) count;
+}
+
+void oscilloscope_average_test();
+void oscilloscope_channel_matrix_test();
+void oscilloscope_geometry_test();
+void oscilloscope_overview_test();
+void oscilloscope_rasterizer_test();
+void oscilloscope_stages_test();
+void oscilloscope_tessellator_test();
+
+void oscilloscope_geometry_bench();
+void oscilloscope_tessellator_bench();
+void oscilloscope_tracer_bench();
@@ -1,5 +1,48 @@
 #include "pfc.h"
 
+#if audio_sample_size == 32
+#if PFC_HAVE_CPUID
+#define PFC_AUDIO_MATH_SSE2 1
+#if !defined(_MSC_VER) || _MSC_VER >= 1700
+#define PFC_AUDIO_MATH_AVX2 1
+#endif
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+// AArch64 only: ARMv7 NEON flushes denormals, which the scalar code does not.
+#define PFC_AUDIO_MATH_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+#ifndef PFC_AUDIO_MATH_SSE2
+#define PFC_AUDIO_MATH_SSE2 0
+#endif
+#ifndef PFC_AUDIO_MATH_AVX2
+#define PFC_AUDIO_MATH_AVX2 0
+#endif
+#ifndef PFC_AUDIO_MATH_NEON
+#define PFC_AUDIO_MATH_NEON 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PFC_AUDIO_MATH_TARGET(X) __attribute__((target(X)))
+#else
+#define PFC_AUDIO_MATH_TARGET(X)
+#endif
+
+// audio_math::rint32() / rint64() round to nearest even where they map to a hardware conversion, and half up - floor(x + 0.5) - elsewhere.
+// The vector conversions below follow whichever the scalar code does on this compiler, assuming the default round-to-nearest mode.
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define PFC_AUDIO_MATH_RINT32_NEAREST 1
+#else
+#define PFC_AUDIO_MATH_RINT32_NEAREST 0
+#endif
+#if defined(_MSC_VER) && defined(_M_IX86)
+#define PFC_AUDIO_MATH_RINT64_NEAREST 1
+#else
+#define PFC_AUDIO_MATH_RINT64_NEAREST 0
+#endif
+
 static audio_sample noopt_calculate_peak(const audio_sample * p_src,t_size p_num)
 {
 	audio_sample peak = 0;
@@ -55,18 +98,429 @@ inline static void noopt_scale(const audio_sample * p_source,t_size p_count,audi
 		p_output[n] = p_source[n] * p_scale;
 }
 
+static void noopt_remove_denormals(audio_sample * p_buffer,t_size p_count) {
+#if audio_sample_size == 32
+	t_uint32 * ptr = reinterpret_cast<t_uint32*>(p_buffer);
+	for(;p_count;p_count--)
+	{
+		t_uint32 t = *ptr;
+		if ((t & 0x007FFFFF) && !(t & 0x7F800000)) *ptr=0;
+		ptr++;
+	}
+#elif audio_sample_size == 64
+	t_uint64 * ptr = reinterpret_cast<t_uint64*>(p_buffer);
+	for(;p_count;p_count--)
+	{
+		t_uint64 t = *ptr;
+		if ((t & 0x000FFFFFFFFFFFFF) && !(t & 0x7FF0000000000000)) *ptr=0;
+		ptr++;
+	}
+#else
+#error unsupported
+#endif
+}
+
+static void noopt_add_offset(audio_sample * p_buffer,audio_sample p_delta,t_size p_count) {
+	for(t_size n=0;n<p_count;n++) {
+		p_buffer[n] += p_delta;
+	}
+}
+
+#if PFC_AUDIO_MATH_SSE2
+// cvtps2dq rounds to nearest even and returns 0x80000000 for NaN and out of range input, like the scalar x86 conversions.
+PFC_AUDIO_MATH_TARGET("sse2") static inline __m128i sse2_round_tie_up(__m128 p_val, __m128i p_rounded) {
+	// nearest-even rounds half of the ties down; floor(x + 0.5) rounds all of them up
+	__m128 tie = _mm_cmpeq_ps(_mm_sub_ps(p_val, _mm_cvtepi32_ps(p_rounded)), _mm_set1_ps(0.5f));
+	return _mm_sub_epi32(p_rounded, _mm_castps_si128(tie));
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static inline __m128i sse2_rint32(__m128 p_val) {
+	__m128i rounded = _mm_cvtps_epi32(p_val);
+#if !PFC_AUDIO_MATH_RINT32_NEAREST
+	rounded = sse2_round_tie_up(p_val, rounded);
+#endif
+	return rounded;
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static inline __m128i sse2_rint64_clip32(__m128 p_val) {
+	__m128i rounded = _mm_cvtps_epi32(p_val);
+#if !PFC_AUDIO_MATH_RINT64_NEAREST
+	rounded = sse2_round_tie_up(p_val, rounded);
+#endif
+	// 0x80000000 is the correct result for NaN and large negative input; flip it to 0x7FFFFFFF for positive input that the scalar
+	// code clips, i.e. anything from 2^31 up to where its own 64-bit conversion overflows to a negative value at 2^63
+	__m128 overflow = _mm_and_ps(_mm_cmpge_ps(p_val, _mm_set1_ps(2147483648.0f)), _mm_cmplt_ps(p_val, _mm_set1_ps(9223372036854775808.0f)));
+	return _mm_xor_si128(rounded, _mm_castps_si128(overflow));
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static void sse2_scale(const audio_sample * p_source,t_size p_count,audio_sample * p_output,audio_sample p_scale) {
+	const __m128 scale = _mm_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		_mm_storeu_ps(p_output + n, _mm_mul_ps(_mm_loadu_ps(p_source + n), scale));
+	}
+	noopt_scale(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static void sse2_convert_to_16bit(const audio_sample * p_source,t_size p_count,t_int16 * p_output,float p_scale) {
+	const __m128 scale = _mm_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		__m128i lo = sse2_rint32(_mm_mul_ps(_mm_loadu_ps(p_source + n), scale));
+		__m128i hi = sse2_rint32(_mm_mul_ps(_mm_loadu_ps(p_source + n + 4), scale));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p_output + n), _mm_packs_epi32(lo, hi));
+	}
+	noopt_convert_to_16bit(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static void sse2_convert_to_32bit(const audio_sample * p_source,t_size p_count,t_int32 * p_output,float p_scale) {
+	const __m128 scale = _mm_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p_output + n), sse2_rint64_clip32(_mm_mul_ps(_mm_loadu_ps(p_source + n), scale)));
+	}
+	noopt_convert_to_32bit(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static void sse2_convert_from_int16(const t_int16 * p_source,t_size p_count,audio_sample * p_output,float p_scale) {
+	const __m128 scale = _mm_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_source + n));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+		_mm_storeu_ps(p_output + n, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(p_output + n + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+	noopt_convert_from_int16(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static void sse2_convert_from_int32(const t_int32 * p_source,t_size p_count,audio_sample * p_output,float p_scale) {
+	const __m128 scale = _mm_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_source + n));
+		_mm_storeu_ps(p_output + n, _mm_mul_ps(_mm_cvtepi32_ps(in), scale));
+	}
+	noopt_convert_from_int32(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static audio_sample sse2_calculate_peak(const audio_sample * p_src,t_size p_num) {
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 peak = _mm_setzero_ps();
+	t_size n = 0;
+	for(;n + 4 <= p_num;n += 4) {
+		// maxps returns its second operand when the first is NaN, so NaNs are skipped like in the scalar loop
+		peak = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(p_src + n), abs_mask), peak);
+	}
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+	audio_sample ret = _mm_cvtss_f32(peak);
+	audio_sample tail = noopt_calculate_peak(p_src + n, p_num - n);
+	if (tail > ret) ret = tail;
+	return ret;
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static void sse2_remove_denormals(audio_sample * p_buffer,t_size p_count) {
+	const __m128i mantissa_mask = _mm_set1_epi32(0x007FFFFF);
+	const __m128i exponent_mask = _mm_set1_epi32(0x7F800000);
+	const __m128i zero = _mm_setzero_si128();
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		__m128i * ptr = reinterpret_cast<__m128i*>(p_buffer + n);
+		__m128i t = _mm_loadu_si128(ptr);
+		__m128i zero_mantissa = _mm_cmpeq_epi32(_mm_and_si128(t, mantissa_mask), zero);
+		__m128i zero_exponent = _mm_cmpeq_epi32(_mm_and_si128(t, exponent_mask), zero);
+		__m128i denormal = _mm_andnot_si128(zero_mantissa, zero_exponent);
+		_mm_storeu_si128(ptr, _mm_andnot_si128(denormal, t));
+	}
+	noopt_remove_denormals(p_buffer + n, p_count - n);
+}
+
+PFC_AUDIO_MATH_TARGET("sse2") static void sse2_add_offset(audio_sample * p_buffer,audio_sample p_delta,t_size p_count) {
+	const __m128 delta = _mm_set1_ps(p_delta);
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		_mm_storeu_ps(p_buffer + n, _mm_add_ps(_mm_loadu_ps(p_buffer + n), delta));
+	}
+	noopt_add_offset(p_buffer + n, p_delta, p_count - n);
+}
+#endif // PFC_AUDIO_MATH_SSE2
+
+#if PFC_AUDIO_MATH_AVX2
+// Same as the SSE2 code, eight lanes wide.
+PFC_AUDIO_MATH_TARGET("avx2") static inline __m256i avx2_round_tie_up(__m256 p_val, __m256i p_rounded) {
+	__m256 tie = _mm256_cmp_ps(_mm256_sub_ps(p_val, _mm256_cvtepi32_ps(p_rounded)), _mm256_set1_ps(0.5f), _CMP_EQ_OQ);
+	return _mm256_sub_epi32(p_rounded, _mm256_castps_si256(tie));
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static inline __m256i avx2_rint32(__m256 p_val) {
+	__m256i rounded = _mm256_cvtps_epi32(p_val);
+#if !PFC_AUDIO_MATH_RINT32_NEAREST
+	rounded = avx2_round_tie_up(p_val, rounded);
+#endif
+	return rounded;
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static inline __m256i avx2_rint64_clip32(__m256 p_val) {
+	__m256i rounded = _mm256_cvtps_epi32(p_val);
+#if !PFC_AUDIO_MATH_RINT64_NEAREST
+	rounded = avx2_round_tie_up(p_val, rounded);
+#endif
+	__m256 overflow = _mm256_and_ps(_mm256_cmp_ps(p_val, _mm256_set1_ps(2147483648.0f), _CMP_GE_OQ), _mm256_cmp_ps(p_val, _mm256_set1_ps(9223372036854775808.0f), _CMP_LT_OQ));
+	return _mm256_xor_si256(rounded, _mm256_castps_si256(overflow));
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static void avx2_scale(const audio_sample * p_source,t_size p_count,audio_sample * p_output,audio_sample p_scale) {
+	const __m256 scale = _mm256_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		_mm256_storeu_ps(p_output + n, _mm256_mul_ps(_mm256_loadu_ps(p_source + n), scale));
+	}
+	noopt_scale(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static void avx2_convert_to_16bit(const audio_sample * p_source,t_size p_count,t_int16 * p_output,float p_scale) {
+	const __m256 scale = _mm256_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 16 <= p_count;n += 16) {
+		__m256i lo = avx2_rint32(_mm256_mul_ps(_mm256_loadu_ps(p_source + n), scale));
+		__m256i hi = avx2_rint32(_mm256_mul_ps(_mm256_loadu_ps(p_source + n + 8), scale));
+		// packs works within 128-bit lanes; restore the sample order afterwards
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p_output + n), packed);
+	}
+	noopt_convert_to_16bit(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static void avx2_convert_to_32bit(const audio_sample * p_source,t_size p_count,t_int32 * p_output,float p_scale) {
+	const __m256 scale = _mm256_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p_output + n), avx2_rint64_clip32(_mm256_mul_ps(_mm256_loadu_ps(p_source + n), scale)));
+	}
+	noopt_convert_to_32bit(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static void avx2_convert_from_int16(const t_int16 * p_source,t_size p_count,audio_sample * p_output,float p_scale) {
+	const __m256 scale = _mm256_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		__m256i in = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p_source + n)));
+		_mm256_storeu_ps(p_output + n, _mm256_mul_ps(_mm256_cvtepi32_ps(in), scale));
+	}
+	noopt_convert_from_int16(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static void avx2_convert_from_int32(const t_int32 * p_source,t_size p_count,audio_sample * p_output,float p_scale) {
+	const __m256 scale = _mm256_set1_ps(p_scale);
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		__m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p_source + n));
+		_mm256_storeu_ps(p_output + n, _mm256_mul_ps(_mm256_cvtepi32_ps(in), scale));
+	}
+	noopt_convert_from_int32(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static audio_sample avx2_calculate_peak(const audio_sample * p_src,t_size p_num) {
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	__m256 peak = _mm256_setzero_ps();
+	t_size n = 0;
+	for(;n + 8 <= p_num;n += 8) {
+		peak = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(p_src + n), abs_mask), peak);
+	}
+	__m128 peak4 = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+	peak4 = _mm_max_ps(peak4, _mm_shuffle_ps(peak4, peak4, _MM_SHUFFLE(1, 0, 3, 2)));
+	peak4 = _mm_max_ps(peak4, _mm_shuffle_ps(peak4, peak4, _MM_SHUFFLE(2, 3, 0, 1)));
+	audio_sample ret = _mm_cvtss_f32(peak4);
+	audio_sample tail = noopt_calculate_peak(p_src + n, p_num - n);
+	if (tail > ret) ret = tail;
+	return ret;
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static void avx2_remove_denormals(audio_sample * p_buffer,t_size p_count) {
+	const __m256i mantissa_mask = _mm256_set1_epi32(0x007FFFFF);
+	const __m256i exponent_mask = _mm256_set1_epi32(0x7F800000);
+	const __m256i zero = _mm256_setzero_si256();
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		__m256i * ptr = reinterpret_cast<__m256i*>(p_buffer + n);
+		__m256i t = _mm256_loadu_si256(ptr);
+		__m256i zero_mantissa = _mm256_cmpeq_epi32(_mm256_and_si256(t, mantissa_mask), zero);
+		__m256i zero_exponent = _mm256_cmpeq_epi32(_mm256_and_si256(t, exponent_mask), zero);
+		__m256i denormal = _mm256_andnot_si256(zero_mantissa, zero_exponent);
+		_mm256_storeu_si256(ptr, _mm256_andnot_si256(denormal, t));
+	}
+	noopt_remove_denormals(p_buffer + n, p_count - n);
+}
+
+PFC_AUDIO_MATH_TARGET("avx2") static void avx2_add_offset(audio_sample * p_buffer,audio_sample p_delta,t_size p_count) {
+	const __m256 delta = _mm256_set1_ps(p_delta);
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		_mm256_storeu_ps(p_buffer + n, _mm256_add_ps(_mm256_loadu_ps(p_buffer + n), delta));
+	}
+	noopt_add_offset(p_buffer + n, p_delta, p_count - n);
+}
+#endif // PFC_AUDIO_MATH_AVX2
+
+#if PFC_AUDIO_MATH_NEON
+// floor(x + 0.5) with the saturating behavior of the scalar AArch64 conversions: truncate, then correct by the fractional part.
+static inline int32x4_t neon_rint32(float32x4_t p_val) {
+	int32x4_t truncated = vcvtq_s32_f32(p_val);
+	float32x4_t fraction = vsubq_f32(p_val, vcvtq_f32_s32(truncated));
+	uint32x4_t up = vcgeq_f32(fraction, vdupq_n_f32(0.5f));
+	uint32x4_t down = vcltq_f32(fraction, vdupq_n_f32(-0.5f));
+	truncated = vqsubq_s32(truncated, vreinterpretq_s32_u32(up));
+	return vqaddq_s32(truncated, vreinterpretq_s32_u32(down));
+}
+
+static void neon_scale(const audio_sample * p_source,t_size p_count,audio_sample * p_output,audio_sample p_scale) {
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		vst1q_f32(p_output + n, vmulq_n_f32(vld1q_f32(p_source + n), p_scale));
+	}
+	noopt_scale(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+static void neon_convert_to_16bit(const audio_sample * p_source,t_size p_count,t_int16 * p_output,float p_scale) {
+	t_size n = 0;
+	for(;n + 8 <= p_count;n += 8) {
+		int16x4_t lo = vqmovn_s32(neon_rint32(vmulq_n_f32(vld1q_f32(p_source + n), p_scale)));
+		int16x4_t hi = vqmovn_s32(neon_rint32(vmulq_n_f32(vld1q_f32(p_source + n + 4), p_scale)));
+		vst1q_s16(p_output + n, vcombine_s16(lo, hi));
+	}
+	noopt_convert_to_16bit(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+static void neon_convert_to_32bit(const audio_sample * p_source,t_size p_count,t_int32 * p_output,float p_scale) {
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		vst1q_s32(p_output + n, neon_rint32(vmulq_n_f32(vld1q_f32(p_source + n), p_scale)));
+	}
+	noopt_convert_to_32bit(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+static void neon_convert_from_int16(const t_int16 * p_source,t_size p_count,audio_sample * p_output,float p_scale) {
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		vst1q_f32(p_output + n, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(p_source + n))), p_scale));
+	}
+	noopt_convert_from_int16(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+static void neon_convert_from_int32(const t_int32 * p_source,t_size p_count,audio_sample * p_output,float p_scale) {
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		vst1q_f32(p_output + n, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(p_source + n)), p_scale));
+	}
+	noopt_convert_from_int32(p_source + n, p_count - n, p_output + n, p_scale);
+}
+
+static audio_sample neon_calculate_peak(const audio_sample * p_src,t_size p_num) {
+	float32x4_t peak = vdupq_n_f32(0);
+	t_size n = 0;
+	for(;n + 4 <= p_num;n += 4) {
+		// vmaxq propagates NaN; select on a comparison instead to skip NaNs like the scalar loop
+		float32x4_t temp = vabsq_f32(vld1q_f32(p_src + n));
+		peak = vbslq_f32(vcgtq_f32(temp, peak), temp, peak);
+	}
+	audio_sample ret = vmaxvq_f32(peak);
+	audio_sample tail = noopt_calculate_peak(p_src + n, p_num - n);
+	if (tail > ret) ret = tail;
+	return ret;
+}
+
+static void neon_remove_denormals(audio_sample * p_buffer,t_size p_count) {
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		t_uint32 * ptr = reinterpret_cast<t_uint32*>(p_buffer + n);
+		uint32x4_t t = vld1q_u32(ptr);
+		uint32x4_t nonzero_mantissa = vtstq_u32(t, vdupq_n_u32(0x007FFFFF));
+		uint32x4_t zero_exponent = vceqq_u32(vandq_u32(t, vdupq_n_u32(0x7F800000)), vdupq_n_u32(0));
+		vst1q_u32(ptr, vbicq_u32(t, vandq_u32(nonzero_mantissa, zero_exponent)));
+	}
+	noopt_remove_denormals(p_buffer + n, p_count - n);
+}
+
+static void neon_add_offset(audio_sample * p_buffer,audio_sample p_delta,t_size p_count) {
+	const float32x4_t delta = vdupq_n_f32(p_delta);
+	t_size n = 0;
+	for(;n + 4 <= p_count;n += 4) {
+		vst1q_f32(p_buffer + n, vaddq_f32(vld1q_f32(p_buffer + n), delta));
+	}
+	noopt_add_offset(p_buffer + n, p_delta, p_count - n);
+}
+#endif // PFC_AUDIO_MATH_NEON
+
+namespace {
+	using pfc::audio_math_kernels;
+
+	const audio_math_kernels g_kernels_scalar = {
+		"scalar", noopt_scale, noopt_convert_to_16bit, noopt_convert_to_32bit, noopt_convert_from_int16, noopt_convert_from_int32, noopt_calculate_peak, noopt_remove_denormals, noopt_add_offset
+	};
+#if PFC_AUDIO_MATH_SSE2
+	const audio_math_kernels g_kernels_sse2 = {
+		"SSE2", sse2_scale, sse2_convert_to_16bit, sse2_convert_to_32bit, sse2_convert_from_int16, sse2_convert_from_int32, sse2_calculate_peak, sse2_remove_denormals, sse2_add_offset
+	};
+#endif
+#if PFC_AUDIO_MATH_AVX2
+	const audio_math_kernels g_kernels_avx2 = {
+		"AVX2", avx2_scale, avx2_convert_to_16bit, avx2_convert_to_32bit, avx2_convert_from_int16, avx2_convert_from_int32, avx2_calculate_peak, avx2_remove_denormals, avx2_add_offset
+	};
+#endif
+#if PFC_AUDIO_MATH_NEON
+	const audio_math_kernels g_kernels_neon = {
+		"NEON", neon_scale, neon_convert_to_16bit, neon_convert_to_32bit, neon_convert_from_int16, neon_convert_from_int32, neon_calculate_peak, neon_remove_denormals, neon_add_offset
+	};
+#endif
+
+	class kernels_list {
+	public:
+		kernels_list() : m_count() {
+			add(g_kernels_scalar);
+#if PFC_AUDIO_MATH_SSE2
+			if (pfc::query_cpu_feature_set(pfc::CPU_HAVE_SSE2)) add(g_kernels_sse2);
+#endif
+#if PFC_AUDIO_MATH_AVX2
+			if (pfc::query_cpu_feature_set(pfc::CPU_HAVE_AVX2)) add(g_kernels_avx2);
+#endif
+#if PFC_AUDIO_MATH_NEON
+			add(g_kernels_neon);
+#endif
+		}
+		t_size get_count() const {return m_count;}
+		const audio_math_kernels & get(t_size p_index) const {PFC_ASSERT(p_index < m_count); return *m_items[p_index];}
+		const audio_math_kernels & get_best() const {return *m_items[m_count - 1];}
+	private:
+		void add(const audio_math_kernels & p_kernels) {m_items[m_count++] = &p_kernels;}
+
+		const audio_math_kernels * m_items[4];
+		t_size m_count;
+	};
+
+	const kernels_list & g_get_kernels_list() {
+		static const kernels_list g_list;
+		return g_list;
+	}
+
+	const audio_math_kernels & g_get_kernels() {
+		return g_get_kernels_list().get_best();
+	}
+}
+
 
 namespace pfc {
 
 	void audio_math::scale(const audio_sample * p_source,t_size p_count,audio_sample * p_output,audio_sample p_scale)
 	{
-		noopt_scale(p_source,p_count,p_output,p_scale);
+		g_get_kernels().scale(p_source,p_count,p_output,p_scale);
 	}
-	
+
 	void audio_math::convert_to_int16(const audio_sample * p_source,t_size p_count,t_int16 * p_output,audio_sample p_scale)
 	{
 		audio_sample scale = (audio_sample)(p_scale * 0x8000);
-		noopt_convert_to_16bit(p_source,p_count,p_output,scale);
+		g_get_kernels().convert_to_int16(p_source,p_count,p_output,scale);
 	}
 
 	audio_sample audio_math::convert_to_int16_calculate_peak(const audio_sample * p_source,t_size p_count,t_int16 * p_output,audio_sample p_scale)
@@ -79,14 +533,14 @@ namespace pfc {
 	void audio_math::convert_from_int16(const t_int16 * p_source,t_size p_count,audio_sample * p_output,audio_sample p_scale)
 	{
 		audio_sample scale = (audio_sample) ( p_scale / (double) 0x8000 );
-		noopt_convert_from_int16(p_source,p_count,p_output,scale);
+		g_get_kernels().convert_from_int16(p_source,p_count,p_output,scale);
 	}
 
 	void audio_math::convert_to_int32(const audio_sample * p_source,t_size p_count,t_int32 * p_output,audio_sample p_scale)
 	{
 		audio_sample scale = (audio_sample)(p_scale * 0x80000000);
 		{
-			noopt_convert_to_32bit(p_source,p_count,p_output,scale);
+			g_get_kernels().convert_to_int32(p_source,p_count,p_output,scale);
 		}
 	}
 
@@ -99,41 +553,29 @@ namespace pfc {
 	void audio_math::convert_from_int32(const t_int32 * p_source,t_size p_count,audio_sample * p_output,audio_sample p_scale)
 	{
 		audio_sample scale = (audio_sample) ( p_scale / (double) 0x80000000 );
-		noopt_convert_from_int32(p_source,p_count,p_output,scale);
+		g_get_kernels().convert_from_int32(p_source,p_count,p_output,scale);
 	}
 
 
 	audio_sample audio_math::calculate_peak(const audio_sample * p_source,t_size p_count)
 	{
-		return noopt_calculate_peak(p_source,p_count);
+		return g_get_kernels().calculate_peak(p_source,p_count);
 	}
 
 	void audio_math::remove_denormals(audio_sample * p_buffer,t_size p_count) {
-#if audio_sample_size == 32
-		t_uint32 * ptr = reinterpret_cast<t_uint32*>(p_buffer);
-		for(;p_count;p_count--)
-		{
-			t_uint32 t = *ptr;
-			if ((t & 0x007FFFFF) && !(t & 0x7F800000)) *ptr=0;
-			ptr++;
-		}
-#elif audio_sample_size == 64
-		t_uint64 * ptr = reinterpret_cast<t_uint64*>(p_buffer);
-		for(;p_count;p_count--)
-		{
-			t_uint64 t = *ptr;
-			if ((t & 0x000FFFFFFFFFFFFF) && !(t & 0x7FF0000000000000)) *ptr=0;
-			ptr++;
-		}
-#else
-#error unsupported
-#endif
+		g_get_kernels().remove_denormals(p_buffer,p_count);
 	}
 
 	void audio_math::add_offset(audio_sample * p_buffer,audio_sample p_delta,t_size p_count) {
-		for(t_size n=0;n<p_count;n++) {
-			p_buffer[n] += p_delta;
-		}
+		g_get_kernels().add_offset(p_buffer,p_delta,p_count);
+	}
+
+	t_size audio_math::get_kernels_count() {
+		return g_get_kernels_list().get_count();
+	}
+
+	const audio_math_kernels & audio_math::get_kernels(t_size p_index) {
+		return g_get_kernels_list().get(p_index);
 	}
 
 
@@ -15,6 +15,20 @@ typedef double audio_sample;
 #define audio_sample_bytes (audio_sample_size/8)
 
 namespace pfc {
+	//! One implementation of the audio_math array routines. The scale parameters are the final multipliers. \n
+	//! All implementations produce bit-identical results to the scalar one, including rounding, clipping, NaN and denormal handling.
+	struct audio_math_kernels {
+		const char * name;
+		void (*scale)(const audio_sample * p_source, t_size p_count, audio_sample * p_output, audio_sample p_scale);
+		void (*convert_to_int16)(const audio_sample * p_source, t_size p_count, t_int16 * p_output, audio_sample p_scale);
+		void (*convert_to_int32)(const audio_sample * p_source, t_size p_count, t_int32 * p_output, audio_sample p_scale);
+		void (*convert_from_int16)(const t_int16 * p_source, t_size p_count, audio_sample * p_output, audio_sample p_scale);
+		void (*convert_from_int32)(const t_int32 * p_source, t_size p_count, audio_sample * p_output, audio_sample p_scale);
+		audio_sample (*calculate_peak)(const audio_sample * p_source, t_size p_count);
+		void (*remove_denormals)(audio_sample * p_buffer, t_size p_count);
+		void (*add_offset)(audio_sample * p_buffer, audio_sample p_delta, t_size p_count);
+	};
+
 	// made a class so it can be redirected to an alternate class more easily than with namespacing
 	// in win desktop fb2k these are implemented in a DLL
 	class audio_math {
@@ -32,6 +46,10 @@ namespace pfc {
 		static void remove_denormals(audio_sample * p_buffer, t_size p_count);
 		static void add_offset(audio_sample * p_buffer, audio_sample p_delta, t_size p_count);
 
+		//! Implementations usable on this CPU; index 0 is the scalar reference, the last one is used by the functions above.
+		static t_size get_kernels_count();
+		static const audio_math_kernels & get_kernels(t_size p_index);
+
 		static inline t_uint64 time_to_samples(double p_time, t_uint32 p_sample_rate) {
 			return (t_uint64)floor((double)p_sample_rate * p_time + 0.5);
 		}
@@ -3,14 +3,42 @@
 
 #if PFC_HAVE_CPUID
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
 namespace pfc {
+	static void query_cpuid(int p_out[4], unsigned p_leaf) {
+#ifdef _MSC_VER
+		__cpuidex(p_out, p_leaf, 0);
+#else
+		unsigned a = 0, b = 0, c = 0, d = 0;
+		__cpuid_count(p_leaf, 0, a, b, c, d);
+		p_out[0] = a; p_out[1] = b; p_out[2] = c; p_out[3] = d;
+#endif
+	}
+
+	// Returns the XCR0 register; only valid when CPUID reports OSXSAVE.
+	static t_uint64 query_xcr0() {
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned lo, hi;
+		__asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+		return ((t_uint64) hi << 32) | lo;
+#endif
+	}
+
 	bool query_cpu_feature_set(unsigned p_value) {
 #ifdef _MSC_VER
 		__try {
 #endif
-			if (p_value & (CPU_HAVE_SSE | CPU_HAVE_SSE2 | CPU_HAVE_SSE3 | CPU_HAVE_SSSE3 | CPU_HAVE_SSE41 | CPU_HAVE_SSE42)) {
+			if (p_value & (CPU_HAVE_SSE | CPU_HAVE_SSE2 | CPU_HAVE_SSE3 | CPU_HAVE_SSSE3 | CPU_HAVE_SSE41 | CPU_HAVE_SSE42 | CPU_HAVE_AVX | CPU_HAVE_AVX2)) {
 				int buffer[4];
-				__cpuid(buffer,1);
+				query_cpuid(buffer,1);
 				if (p_value & CPU_HAVE_SSE) {
 					if ((buffer[3]&(1<<25)) == 0) return false;
 				}
@@ -29,14 +57,26 @@ namespace pfc {
 				if (p_value & CPU_HAVE_SSE42) {
 					if ((buffer[2]&(1<<20)) == 0) return false;
 				}
+				if (p_value & (CPU_HAVE_AVX | CPU_HAVE_AVX2)) {
+					// AVX itself, OSXSAVE, and XMM + YMM state enabled by the OS
+					if ((buffer[2]&(1<<28)) == 0 || (buffer[2]&(1<<27)) == 0) return false;
+					if ((query_xcr0() & 6) != 6) return false;
+				}
+				if (p_value & CPU_HAVE_AVX2) {
+					int buffer_ext[4];
+					query_cpuid(buffer_ext,0);
+					if ((unsigned)buffer_ext[0] < 7) return false;
+					query_cpuid(buffer_ext,7);
+					if ((buffer_ext[1]&(1<<5)) == 0) return false;
+				}
 			}
-	#ifdef _M_IX86
+	#if defined(_M_IX86) || defined(__i386__)
 			if (p_value & (CPU_HAVE_3DNOW_EX | CPU_HAVE_3DNOW)) {
 				int buffer_amd[4];
-				__cpuid(buffer_amd,0x80000000);
+				query_cpuid(buffer_amd,0x80000000);
 				if ((unsigned)buffer_amd[0] < 0x80000001) return false;
-				__cpuid(buffer_amd,0x80000001);
-			
+				query_cpuid(buffer_amd,0x80000001);
+
 				if (p_value & CPU_HAVE_3DNOW) {
 					if ((buffer_amd[3]&(1<<31)) == 0) return false;
 				}
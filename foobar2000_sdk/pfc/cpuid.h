@@ -1,6 +1,6 @@
 
-// CPUID stuff supported only on MSVC for now, irrelevant for non x86
-#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+// CPUID stuff supported on MSVC and GCC/Clang, irrelevant for non x86
+#if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))) || ((defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__)))
 #define PFC_HAVE_CPUID 1
 namespace pfc {
 	enum {
@@ -12,6 +12,8 @@ namespace pfc {
 		CPU_HAVE_SSSE3		= 1 << 5,
 		CPU_HAVE_SSE41		= 1 << 6,
 		CPU_HAVE_SSE42		= 1 << 7,
+		CPU_HAVE_AVX		= 1 << 8, // also checks that the OS saves YMM state
+		CPU_HAVE_AVX2		= 1 << 9,
 	};
 
 	bool query_cpu_feature_set(unsigned p_value);
@@ -2,6 +2,9 @@
 
 #ifndef _WIN32
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 namespace pfc {
@@ -30,4 +33,75 @@ void fileHandle::close() {
     clear();
 }
 
+bool fileMapping::open( const char * path ) {
+    close();
+#ifdef _WIN32
+    fileHandle f( CreateFileW( stringcvt::string_wide_from_utf8( path ), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL ) );
+    if (!f.isValid()) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx( f.h, &size ) || (t_uint64) size.QuadPart > (t_uint64) SIZE_MAX) return false;
+    return map( f.h, (size_t) size.QuadPart, false );
+#else
+    fileHandle f( ::open( path, O_RDONLY | O_CLOEXEC ) );
+    if (!f.isValid()) return false;
+    struct stat st;
+    if (fstat( f.h, &st ) != 0 || (t_uint64) st.st_size > (t_uint64) SIZE_MAX) return false;
+    return map( f.h, (size_t) st.st_size, false );
+#endif
+}
+
+bool fileMapping::create( const char * path, size_t size ) {
+    close();
+#ifdef _WIN32
+    fileHandle f( CreateFileW( stringcvt::string_wide_from_utf8( path ), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL ) );
+    if (!f.isValid()) return false;
+#else
+    fileHandle f( ::open( path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) );
+    if (!f.isValid()) return false;
+    // Mapping grows the file on Windows; here it has to be sized first.
+    if (ftruncate( f.h, (off_t) size ) != 0) return false;
+#endif
+    return map( f.h, size, true );
+}
+
+bool fileMapping::map( fileHandle_t h, size_t size, bool writable ) {
+    // Empty files cannot be mapped on either platform.
+    if (size == 0) return false;
+#ifdef _WIN32
+    t_uint64 size64 = size;
+    HANDLE mapping = CreateFileMapping( h, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD) (size64 >> 32), (DWORD) size64, NULL );
+    if (mapping == NULL) return false;
+    // The view keeps the mapping object alive.
+    void * data = MapViewOfFile( mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size );
+    CloseHandle( mapping );
+    if (data == NULL) return false;
+#else
+    void * data = mmap( NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, h, 0 );
+    if (data == MAP_FAILED) return false;
+#endif
+    m_data = data;
+    m_size = size;
+    return true;
+}
+
+bool fileMapping::flush() {
+    if (m_data == nullptr) return false;
+#ifdef _WIN32
+    return FlushViewOfFile( m_data, m_size ) != FALSE;
+#else
+    return msync( m_data, m_size, MS_SYNC ) == 0;
+#endif
+}
+
+void fileMapping::close() {
+    if (m_data == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile( m_data );
+#else
+    munmap( m_data, m_size );
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
 }
\ No newline at end of file
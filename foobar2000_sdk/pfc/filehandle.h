@@ -26,4 +26,30 @@ namespace pfc {
         fileHandle( const fileHandle & );
         void operator=( const fileHandle & );
     };
+
+    //! Maps a whole file into memory. \n
+    //! open() maps an existing file read-only; create() creates or truncates a file to the given size and maps it writable, so that it can be filled in place. \n
+    //! Paths are UTF-8. The mapping does not keep the file open; the file stays mapped until close() or destruction.
+    class fileMapping {
+    public:
+        fileMapping() : m_data(), m_size() {}
+        ~fileMapping() { close(); }
+        bool open( const char * path );
+        bool create( const char * path, size_t size );
+        //! Writes modified pages back to the file.
+        bool flush();
+        void close();
+        bool isValid() const { return m_data != nullptr; }
+        const void * data() const { return m_data; }
+        void * data() { return m_data; }
+        size_t size() const { return m_size; }
+    private:
+        bool map( fileHandle_t h, size_t size, bool writable );
+
+        void * m_data;
+        size_t m_size;
+
+        fileMapping( const fileMapping & );
+        void operator=( const fileMapping & );
+    };
 }
@@ -0,0 +1,292 @@
+#pragma once
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace pfc {
+	//! Atomic operations on t_size with the orderings the lock-free rings below need.
+	inline t_size atomicLoadAcquire(const volatile t_size & p_var) {
+#ifdef _MSC_VER
+		t_size ret = p_var;
+#if defined(_M_IX86) || defined(_M_X64)
+		_ReadWriteBarrier(); // x86 loads already have acquire semantics; only the compiler needs to be kept in check
+#else
+		MemoryBarrier();
+#endif
+		return ret;
+#else
+		return __atomic_load_n(&p_var, __ATOMIC_ACQUIRE);
+#endif
+	}
+
+	inline void atomicStoreRelease(volatile t_size & p_var, t_size p_value) {
+#ifdef _MSC_VER
+#if defined(_M_IX86) || defined(_M_X64)
+		_ReadWriteBarrier();
+#else
+		MemoryBarrier();
+#endif
+		p_var = p_value;
+#else
+		__atomic_store_n(&p_var, p_value, __ATOMIC_RELEASE);
+#endif
+	}
+
+	//! Stores p_desired if p_var equals p_expected and returns true; otherwise loads the current value into p_expected and returns false.
+	inline bool atomicCompareExchange(volatile t_size & p_var, t_size & p_expected, t_size p_desired) {
+#ifdef _MSC_VER
+#ifdef _WIN64
+		const t_size prev = (t_size) _InterlockedCompareExchange64(reinterpret_cast<volatile __int64*>(&p_var), (__int64) p_desired, (__int64) p_expected);
+#else
+		const t_size prev = (t_size) _InterlockedCompareExchange(reinterpret_cast<volatile long*>(&p_var), (long) p_desired, (long) p_expected);
+#endif
+		if (prev == p_expected) return true;
+		p_expected = prev;
+		return false;
+#else
+		return __atomic_compare_exchange_n(&p_var, &p_expected, p_desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+	}
+
+	namespace lockfree_ring_impl {
+		enum { cacheLineSize = 64 };
+
+		// Keeps the indices written by different threads on separate cache lines, regardless of how the owning object is aligned.
+		struct cacheLinePad {
+			char m_pad[cacheLineSize];
+		};
+
+		inline t_size roundCapacity(t_size p_capacity) {
+			t_size ret = 1;
+			while(ret < p_capacity) ret <<= 1;
+			return ret;
+		}
+	}
+
+	//! Bounded single-producer / single-consumer ring of plain-old-data items. \n
+	//! Neither side ever waits or takes a lock: every call completes in a bounded number of steps. Items are written and read in contiguous spans, so a block is handed over with one memcpy (two where it wraps around). \n
+	//! Producer side: writeAvailable(), writeBegin() / writeCommit(), write(), push(). Consumer side: readAvailable(), readBegin() / readCommit(), read(), pop(). \n
+	//! setCapacity() and reset() must not be called while either side is active.
+	template<typename T> class spscRing {
+	public:
+		spscRing() : m_mask(~(t_size)0), m_write(0), m_readCache(0), m_read(0), m_writeCache(0) {}
+		//! Capacity is rounded up to a power of two.
+		explicit spscRing(t_size p_capacity) : m_mask(~(t_size)0), m_write(0), m_readCache(0), m_read(0), m_writeCache(0) {setCapacity(p_capacity);}
+
+		void setCapacity(t_size p_capacity) {
+			const t_size capacity = lockfree_ring_impl::roundCapacity(p_capacity);
+			m_buffer.set_size(capacity);
+			m_mask = capacity - 1;
+			reset();
+		}
+		t_size capacity() const {return m_mask + 1;}
+		void reset() {m_write = m_readCache = m_read = m_writeCache = 0;}
+
+		// Producer side
+
+		t_size writeAvailable() {return writeAvailable(capacity());}
+
+		//! Returns the contiguous free span at the write position; outCount receives its length, 0 when the ring is full. Fill any part of it and publish with writeCommit().
+		T * writeBegin(t_size & p_outCount) {
+			m_readCache = atomicLoadAcquire(m_read);
+			const t_size offset = m_write & m_mask;
+			p_outCount = pfc::min_t<t_size>(capacity() - (m_write - m_readCache), capacity() - offset);
+			return m_buffer.get_ptr() + offset;
+		}
+		void writeCommit(t_size p_count) {
+			PFC_ASSERT(p_count <= capacity() - (m_write - m_readCache));
+			atomicStoreRelease(m_write, m_write + p_count);
+		}
+
+		//! Copies as many items as fit and returns their number.
+		t_size write(const T * p_items, t_size p_count) {
+			p_count = pfc::min_t(p_count, writeAvailable(p_count));
+			const t_size offset = m_write & m_mask, first = pfc::min_t(p_count, capacity() - offset);
+			__unsafe__memcpy_t(m_buffer.get_ptr() + offset, p_items, first);
+			__unsafe__memcpy_t(m_buffer.get_ptr(), p_items + first, p_count - first);
+			atomicStoreRelease(m_write, m_write + p_count);
+			return p_count;
+		}
+		bool push(const T & p_item) {
+			if (writeAvailable(1) == 0) return false;
+			m_buffer.get_ptr()[m_write & m_mask] = p_item;
+			atomicStoreRelease(m_write, m_write + 1);
+			return true;
+		}
+
+		// Consumer side
+
+		t_size readAvailable() {return readAvailable(capacity());}
+
+		//! Returns the contiguous span of items at the read position; outCount receives its length, 0 when the ring is empty. Release any part of it with readCommit().
+		const T * readBegin(t_size & p_outCount) {
+			m_writeCache = atomicLoadAcquire(m_write);
+			const t_size offset = m_read & m_mask;
+			p_outCount = pfc::min_t<t_size>(m_writeCache - m_read, capacity() - offset);
+			return m_buffer.get_ptr() + offset;
+		}
+		void readCommit(t_size p_count) {
+			PFC_ASSERT(p_count <= m_writeCache - m_read);
+			atomicStoreRelease(m_read, m_read + p_count);
+		}
+
+		//! Copies out up to p_count items and returns their number.
+		t_size read(T * p_items, t_size p_count) {
+			p_count = pfc::min_t(p_count, readAvailable(p_count));
+			const t_size offset = m_read & m_mask, first = pfc::min_t(p_count, capacity() - offset);
+			__unsafe__memcpy_t(p_items, m_buffer.get_ptr() + offset, first);
+			__unsafe__memcpy_t(p_items + first, m_buffer.get_ptr(), p_count - first);
+			atomicStoreRelease(m_read, m_read + p_count);
+			return p_count;
+		}
+		bool pop(T & p_item) {
+			if (readAvailable(1) == 0) return false;
+			p_item = m_buffer.get_ptr()[m_read & m_mask];
+			atomicStoreRelease(m_read, m_read + 1);
+			return true;
+		}
+	private:
+		// The cached position of the other side is only refreshed when it shows less than p_wanted.
+		t_size writeAvailable(t_size p_wanted) {
+			t_size free = capacity() - (m_write - m_readCache);
+			if (free < p_wanted) {
+				m_readCache = atomicLoadAcquire(m_read);
+				free = capacity() - (m_write - m_readCache);
+			}
+			return free;
+		}
+		t_size readAvailable(t_size p_wanted) {
+			t_size count = m_writeCache - m_read;
+			if (count < p_wanted) {
+				m_writeCache = atomicLoadAcquire(m_write);
+				count = m_writeCache - m_read;
+			}
+			return count;
+		}
+
+		// Positions count all items ever written / read, modulo the t_size range; the buffer index is position & m_mask. Each side keeps a copy of
+		// the other side's position and only reloads it from the shared cache line when the copy shows too little space.
+		lockfree_ring_impl::cacheLinePad m_pad0;
+		mem_block_aligned_t<T, lockfree_ring_impl::cacheLineSize> m_buffer;
+		// Capacity - 1; all ones while no buffer is allocated, for a capacity of 0.
+		t_size m_mask;
+		lockfree_ring_impl::cacheLinePad m_pad1;
+		volatile t_size m_write;
+		t_size m_readCache;
+		lockfree_ring_impl::cacheLinePad m_pad2;
+		volatile t_size m_read;
+		t_size m_writeCache;
+		lockfree_ring_impl::cacheLinePad m_pad3;
+
+		PFC_CLASS_NOT_COPYABLE_EX(spscRing)
+	};
+
+	//! Bounded multi-producer / single-consumer ring of plain-old-data items. \n
+	//! Producers reserve a span of slots with a compare-and-swap - lock-free, though a producer may retry when others race it - and publish each slot once copied. The consumer never waits and sees the items of each write() as one contiguous run, in reservation order. \n
+	//! Any thread may call writeAvailable(), write() and push(); only the consumer thread may call the read side. setCapacity() and reset() must not be called while either side is active.
+	template<typename T> class mpscRing {
+	public:
+		mpscRing() : m_mask(~(t_size)0), m_write(0), m_read(0), m_readyCache(0) {}
+		//! Capacity is rounded up to a power of two.
+		explicit mpscRing(t_size p_capacity) : m_mask(~(t_size)0), m_write(0), m_read(0), m_readyCache(0) {setCapacity(p_capacity);}
+
+		void setCapacity(t_size p_capacity) {
+			const t_size capacity = lockfree_ring_impl::roundCapacity(p_capacity);
+			m_buffer.set_size(capacity);
+			m_published.set_size(capacity);
+			m_mask = capacity - 1;
+			reset();
+		}
+		t_size capacity() const {return m_mask + 1;}
+		void reset() {
+			m_write = m_read = m_readyCache = 0;
+			for(t_size n = 0; n < capacity(); ++n) m_published.get_ptr()[n] = 0;
+		}
+
+		// Producer side, any thread
+
+		//! Free space at the time of the call; other producers may take it before this thread does.
+		t_size writeAvailable() {
+			const t_size read = atomicLoadAcquire(m_read);
+			const t_size used = atomicLoadAcquire(m_write) - read;
+			return used < capacity() ? capacity() - used : 0;
+		}
+
+		//! Reserves as many slots as are free, up to p_count, copies the items into them and returns their number.
+		t_size write(const T * p_items, t_size p_count) {
+			t_size position = atomicLoadAcquire(m_write), count;
+			for(;;) {
+				const t_size used = position - atomicLoadAcquire(m_read);
+				if (used > capacity()) {
+					// The consumer already moved past this position, so it is stale and the compare-and-swap would fail
+					position = atomicLoadAcquire(m_write);
+					continue;
+				}
+				count = pfc::min_t(p_count, capacity() - used);
+				if (count == 0) return 0;
+				if (atomicCompareExchange(m_write, position, position + count)) break;
+			}
+			const t_size offset = position & m_mask, first = pfc::min_t(count, capacity() - offset);
+			__unsafe__memcpy_t(m_buffer.get_ptr() + offset, p_items, first);
+			__unsafe__memcpy_t(m_buffer.get_ptr(), p_items + first, count - first);
+			for(t_size n = 0; n < count; ++n) {
+				atomicStoreRelease(m_published.get_ptr()[(position + n) & m_mask], position + n + 1);
+			}
+			return count;
+		}
+		bool push(const T & p_item) {return write(&p_item, 1) == 1;}
+
+		// Consumer side
+
+		//! Number of items published and not read yet, counting only up to the first slot a producer is still filling.
+		t_size readAvailable() {
+			updateReady();
+			return m_readyCache - m_read;
+		}
+
+		//! Returns the contiguous span of published items at the read position; outCount receives its length, 0 when nothing is ready. Release any part of it with readCommit().
+		const T * readBegin(t_size & p_outCount) {
+			updateReady();
+			const t_size offset = m_read & m_mask;
+			p_outCount = pfc::min_t<t_size>(m_readyCache - m_read, capacity() - offset);
+			return m_buffer.get_ptr() + offset;
+		}
+		void readCommit(t_size p_count) {
+			PFC_ASSERT(p_count <= m_readyCache - m_read);
+			atomicStoreRelease(m_read, m_read + p_count);
+		}
+
+		//! Copies out up to p_count published items and returns their number.
+		t_size read(T * p_items, t_size p_count) {
+			p_count = pfc::min_t(p_count, readAvailable());
+			const t_size offset = m_read & m_mask, first = pfc::min_t(p_count, capacity() - offset);
+			__unsafe__memcpy_t(p_items, m_buffer.get_ptr() + offset, first);
+			__unsafe__memcpy_t(p_items + first, m_buffer.get_ptr(), p_count - first);
+			atomicStoreRelease(m_read, m_read + p_count);
+			return p_count;
+		}
+		bool pop(T & p_item) {return read(&p_item, 1) == 1;}
+	private:
+		// A slot holds its position + 1 once published; positions are unique within t_size range, so stale values from earlier laps never match.
+		void updateReady() {
+			const t_size limit = m_read + capacity();
+			while(m_readyCache != limit && atomicLoadAcquire(m_published.get_ptr()[m_readyCache & m_mask]) == m_readyCache + 1) {
+				++m_readyCache;
+			}
+		}
+
+		lockfree_ring_impl::cacheLinePad m_pad0;
+		mem_block_aligned_t<T, lockfree_ring_impl::cacheLineSize> m_buffer;
+		mem_block_aligned_t<t_size, lockfree_ring_impl::cacheLineSize> m_published;
+		t_size m_mask;
+		lockfree_ring_impl::cacheLinePad m_pad1;
+		volatile t_size m_write;
+		lockfree_ring_impl::cacheLinePad m_pad2;
+		volatile t_size m_read;
+		t_size m_readyCache;
+		lockfree_ring_impl::cacheLinePad m_pad3;
+
+		PFC_CLASS_NOT_COPYABLE_EX(mpscRing)
+	};
+}
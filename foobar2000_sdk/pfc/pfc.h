@@ -210,6 +210,8 @@ namespace pfc {
 #endif
 
 #include "event.h"
+#include "thread_pool.h"
+#include "lockfree_ring.h"
 
 #include "audio_sample.h"
 #include "wildcard.h"
@@ -31,6 +31,343 @@ namespace {
 			PFC_ASSERT(fabs(timer.query() - 2.0) < 0.1);
 		}
 	};
+
+	// Inputs for the audio_math kernels: special values, exact rounding ties, ordinary samples and arbitrary bit patterns.
+	static void audio_math_selftest_fill(audio_sample * p_out, t_size p_count, t_uint32 & p_seed) {
+		static const t_uint32 specials[] = {
+			0x7FC00000, 0xFFC00001, // NaN
+			0x7F800000, 0xFF800000, // infinity
+			0x00000000, 0x80000000, // zero
+			0x3F800000, 0xBF800000, // full scale
+			0x3F7FFFFF, 0xBF7FFFFF, // just below full scale
+			0x00000001, 0x80000001, 0x007FFFFF, 0x807FFFFF, // denormal
+			0x00800000, 0x80800000, // smallest normal
+			0x501502F9, 0xD01502F9, // out of integer range
+		};
+		for(t_size n = 0; n < p_count; ++n) {
+			p_seed = p_seed * 1664525 + 1013904223;
+			t_uint32 random = p_seed >> 8;
+			union { t_uint32 i; float f; } value;
+			switch(p_seed & 7) {
+			case 0:
+				value.i = specials[random % PFC_TABSIZE(specials)];
+				break;
+			case 1: // tie when scaled for 16-bit output
+				value.f = ((float)(t_int32)(random & 0xFFFF) - 32768.f + 0.5f) / 32768.f;
+				break;
+			case 2: // tie when scaled for 32-bit output
+				value.f = ((float)(t_int32)(random & 0x3FFFFF) - 2097152.f + 0.5f) / 2147483648.f;
+				break;
+			case 3:
+				value.i = p_seed ^ (random << 13);
+				break;
+			default:
+				value.f = (float)random / (float)(1 << 24) * 3.f - 1.5f;
+				break;
+			}
+			p_out[n] = value.f;
+		}
+	}
+
+	// Every audio_math implementation available on this CPU must match the scalar one bit for bit.
+	static void audio_math_selftest() {
+		const audio_math_kernels & reference = audio_math::get_kernels(0);
+		t_uint32 seed = 1;
+		for(t_size index = 1; index < audio_math::get_kernels_count(); ++index) {
+			const audio_math_kernels & kernels = audio_math::get_kernels(index);
+			for(t_size count = 0; count < 200; count += (count < 40 ? 1 : 37)) {
+				for(t_size offset = 0; offset < 4; ++offset) {
+					pfc::array_t<audio_sample> input; input.set_size(count + offset);
+					audio_math_selftest_fill(input.get_ptr(), count + offset, seed);
+					const audio_sample * src = input.get_ptr() + offset;
+
+					pfc::array_t<audio_sample> out_f1, out_f2; out_f1.set_size(count + 1); out_f2.set_size(count + 1);
+					pfc::array_t<t_int16> out_16a, out_16b; out_16a.set_size(count + 1); out_16b.set_size(count + 1);
+					pfc::array_t<t_int32> out_32a, out_32b; out_32a.set_size(count + 1); out_32b.set_size(count + 1);
+
+					const audio_sample scales[] = {1.f, 32768.f, 2147483648.f, 12345.67f, -0.3f};
+					for(t_size s = 0; s < PFC_TABSIZE(scales); ++s) {
+						reference.scale(src, count, out_f1.get_ptr(), scales[s]);
+						kernels.scale(src, count, out_f2.get_ptr(), scales[s]);
+						PFC_ASSERT(memcmp(out_f1.get_ptr(), out_f2.get_ptr(), count * sizeof(audio_sample)) == 0);
+
+						reference.convert_to_int16(src, count, out_16a.get_ptr(), scales[s]);
+						kernels.convert_to_int16(src, count, out_16b.get_ptr(), scales[s]);
+						PFC_ASSERT(memcmp(out_16a.get_ptr(), out_16b.get_ptr(), count * sizeof(t_int16)) == 0);
+
+						reference.convert_to_int32(src, count, out_32a.get_ptr(), scales[s]);
+						kernels.convert_to_int32(src, count, out_32b.get_ptr(), scales[s]);
+						PFC_ASSERT(memcmp(out_32a.get_ptr(), out_32b.get_ptr(), count * sizeof(t_int32)) == 0);
+
+						reference.convert_from_int16(out_16a.get_ptr(), count, out_f1.get_ptr(), 1.f / scales[s]);
+						kernels.convert_from_int16(out_16a.get_ptr(), count, out_f2.get_ptr(), 1.f / scales[s]);
+						PFC_ASSERT(memcmp(out_f1.get_ptr(), out_f2.get_ptr(), count * sizeof(audio_sample)) == 0);
+
+						reference.convert_from_int32(out_32a.get_ptr(), count, out_f1.get_ptr(), 1.f / scales[s]);
+						kernels.convert_from_int32(out_32a.get_ptr(), count, out_f2.get_ptr(), 1.f / scales[s]);
+						PFC_ASSERT(memcmp(out_f1.get_ptr(), out_f2.get_ptr(), count * sizeof(audio_sample)) == 0);
+
+						if (count > 0) { // src is null for an empty input
+							memcpy(out_f1.get_ptr(), src, count * sizeof(audio_sample));
+							memcpy(out_f2.get_ptr(), src, count * sizeof(audio_sample));
+						}
+						reference.add_offset(out_f1.get_ptr(), scales[s] * 1e-45f, count);
+						kernels.add_offset(out_f2.get_ptr(), scales[s] * 1e-45f, count);
+						PFC_ASSERT(memcmp(out_f1.get_ptr(), out_f2.get_ptr(), count * sizeof(audio_sample)) == 0);
+					}
+
+					audio_sample peak1 = reference.calculate_peak(src, count), peak2 = kernels.calculate_peak(src, count);
+					PFC_ASSERT(memcmp(&peak1, &peak2, sizeof(audio_sample)) == 0);
+					(void) peak1; (void) peak2;
+
+					if (count > 0) {
+						memcpy(out_f1.get_ptr(), src, count * sizeof(audio_sample));
+						memcpy(out_f2.get_ptr(), src, count * sizeof(audio_sample));
+					}
+					reference.remove_denormals(out_f1.get_ptr(), count);
+					kernels.remove_denormals(out_f2.get_ptr(), count);
+					PFC_ASSERT(memcmp(out_f1.get_ptr(), out_f2.get_ptr(), count * sizeof(audio_sample)) == 0);
+				}
+			}
+		}
+	}
+
+	static void thread_pool_selftest_count(void * ctx, t_size index) {
+		reinterpret_cast<t_uint32*>(ctx)[index]++;
+	}
+
+	struct thread_pool_selftest_nested {
+		threadPool * m_pool;
+		t_uint32 * m_counts;
+		t_size m_innerCount;
+		static void task(void * ctx, t_size index) {
+			const thread_pool_selftest_nested & n = *reinterpret_cast<const thread_pool_selftest_nested*>(ctx);
+			n.m_pool->run(&thread_pool_selftest_count, n.m_counts + index * n.m_innerCount, n.m_innerCount);
+		}
+	};
+
+	struct thread_pool_selftest_chunks {
+		t_uint32 * m_counts;
+		t_size m_chunkSize;
+		void operator()(t_size begin, t_size end) const {
+			PFC_ASSERT(begin % m_chunkSize == 0 && end > begin && end - begin <= m_chunkSize);
+			for(t_size n = begin; n < end; ++n) m_counts[n]++;
+		}
+	};
+
+	struct thread_pool_selftest_order {
+		t_size * m_order;
+		t_size m_position;
+		static void task(void * ctx, t_size index) {
+			thread_pool_selftest_order & o = *reinterpret_cast<thread_pool_selftest_order*>(ctx);
+			o.m_order[o.m_position++] = index;
+		}
+	};
+
+	// Pushes 0, 1, 2... in batches of varying size, through the span interface or through write().
+	class spsc_ring_selftest_producer : public thread {
+	public:
+		spsc_ring_selftest_producer(spscRing<t_uint32> & p_ring, t_uint32 p_count) : m_ring(p_ring), m_count(p_count) {}
+		~spsc_ring_selftest_producer() {waitTillDone();}
+		void threadProc() {
+			t_uint32 next = 0, batch[37];
+			while(next < m_count) {
+				const t_uint32 wanted = pfc::min_t<t_uint32>(m_count - next, 1 + next % PFC_TABSIZE(batch));
+				t_size done;
+				if (next & 1) {
+					for(t_uint32 n = 0; n < wanted; ++n) batch[n] = next + n;
+					done = m_ring.write(batch, wanted);
+				} else {
+					t_uint32 * span = m_ring.writeBegin(done);
+					done = pfc::min_t<t_size>(done, wanted);
+					for(t_size n = 0; n < done; ++n) span[n] = next + (t_uint32) n;
+					m_ring.writeCommit(done);
+				}
+				next += (t_uint32) done;
+				if (done == 0) uSleepSeconds(0.001, false);
+			}
+		}
+	private:
+		spscRing<t_uint32> & m_ring;
+		const t_uint32 m_count;
+	};
+
+	struct mpsc_ring_selftest_item {
+		t_uint32 m_producer, m_value;
+	};
+
+	// Pushes runs of (producer, 0), (producer, 1)... in batches of varying size.
+	class mpsc_ring_selftest_producer : public thread {
+	public:
+		mpsc_ring_selftest_producer() : m_ring(NULL), m_producer(0), m_count(0) {}
+		~mpsc_ring_selftest_producer() {waitTillDone();}
+		void threadProc() {
+			mpsc_ring_selftest_item batch[11];
+			t_uint32 next = 0;
+			while(next < m_count) {
+				const t_uint32 wanted = pfc::min_t<t_uint32>(m_count - next, 1 + (next + m_producer) % PFC_TABSIZE(batch));
+				for(t_uint32 n = 0; n < wanted; ++n) {
+					batch[n].m_producer = m_producer; batch[n].m_value = next + n;
+				}
+				const t_size done = m_ring->write(batch, wanted);
+				next += (t_uint32) done;
+				if (done == 0) uSleepSeconds(0.001, false);
+			}
+		}
+		mpscRing<mpsc_ring_selftest_item> * m_ring;
+		t_uint32 m_producer, m_count;
+	};
+
+	// Items arrive complete and in order across wrap-arounds and full / empty rings.
+	static void lockfree_ring_selftest() {
+		enum { count = 20000, producer_count = 3 };
+		{
+			spscRing<t_uint32> ring(64);
+			PFC_ASSERT(ring.capacity() == 64);
+			spsc_ring_selftest_producer producer(ring, count);
+			producer.start();
+			t_uint32 next = 0, batch[29];
+			while(next < count) {
+				t_size done;
+				if (next & 1) {
+					done = ring.read(batch, PFC_TABSIZE(batch));
+					for(t_size n = 0; n < done; ++n) PFC_ASSERT(batch[n] == next + n);
+				} else {
+					const t_uint32 * span = ring.readBegin(done);
+					for(t_size n = 0; n < done; ++n) PFC_ASSERT(span[n] == next + n);
+					(void) span;
+					ring.readCommit(done);
+				}
+				next += (t_uint32) done;
+				if (done == 0) uSleepSeconds(0.001, false);
+			}
+			producer.waitTillDone();
+			PFC_ASSERT(ring.readAvailable() == 0);
+		}
+		{
+			mpscRing<mpsc_ring_selftest_item> ring(50);
+			PFC_ASSERT(ring.capacity() == 64);
+			mpsc_ring_selftest_producer producers[producer_count];
+			for(t_uint32 n = 0; n < producer_count; ++n) {
+				producers[n].m_ring = &ring; producers[n].m_producer = n; producers[n].m_count = count;
+				producers[n].start();
+			}
+			t_uint32 next[producer_count] = {};
+			t_uint32 total = 0;
+			while(total < count * producer_count) {
+				t_size done;
+				const mpsc_ring_selftest_item * span = ring.readBegin(done);
+				for(t_size n = 0; n < done; ++n) {
+					PFC_ASSERT(span[n].m_producer < producer_count && span[n].m_value == next[span[n].m_producer]);
+					next[span[n].m_producer]++;
+				}
+				ring.readCommit(done);
+				total += (t_uint32) done;
+				if (done == 0) uSleepSeconds(0.001, false);
+			}
+			for(t_uint32 n = 0; n < producer_count; ++n) producers[n].waitTillDone();
+			PFC_ASSERT(ring.readAvailable() == 0);
+		}
+	}
+
+	static void tracer_selftest_task(void *, t_size) {
+		PFC_TRACE_SCOPE(pfc_selftest_task);
+	}
+
+	class tracer_selftest_thread : public thread {
+	protected:
+		void threadProc() {
+			PFC_TRACE_SCOPE(pfc_selftest_thread);
+		}
+	};
+
+#if PFC_DEBUG
+	static t_size tracer_selftest_count(const char * p_text, const char * p_what) {
+		t_size count = 0;
+		for(const char * walk = strstr(p_text, p_what); walk != NULL; walk = strstr(walk + 1, p_what)) ++count;
+		return count;
+	}
+#endif
+
+	// Scopes from several threads end up in the export, with names escaped, including those of threads that have exited; nothing is recorded while disabled.
+	static void tracer_selftest() {
+		const bool wasEnabled = tracer::isEnabled();
+		pfc::string8 json;
+		tracer::setEnabled(false);
+		tracer::exportChromeTrace(json);
+		{
+			PFC_TRACE_SCOPE(pfc_selftest_disabled);
+		}
+		tracer::setEnabled(true);
+		{
+			threadPool pool(2);
+			PFC_TRACE_SCOPE(pfc_selftest_outer);
+			pool.run(&tracer_selftest_task, NULL, 4);
+			const t_uint64 now = traceTimestamp();
+			tracer::add("pfc_selftest_\"escaped\"", now, now);
+		}
+		// Threads that record one after another share one buffer, and keep their events after they exit.
+		const t_size buffers = tracer::bufferCount();
+		for(t_size n = 0; n < 8; ++n) {
+			tracer_selftest_thread thread;
+			thread.start();
+			thread.waitTillDone();
+		}
+		PFC_ASSERT(tracer::bufferCount() <= buffers + 1);
+		(void) buffers;
+		tracer::setEnabled(wasEnabled);
+		tracer::exportChromeTrace(json);
+		PFC_ASSERT(tracer_selftest_count(json, "\"traceEvents\"") == 1);
+		PFC_ASSERT(tracer_selftest_count(json, "pfc_selftest_disabled") == 0);
+		PFC_ASSERT(tracer_selftest_count(json, "\"pfc_selftest_outer\"") == 1);
+		PFC_ASSERT(tracer_selftest_count(json, "\"pfc_selftest_task\"") == 4);
+		PFC_ASSERT(tracer_selftest_count(json, "\"pfc_selftest_thread\"") == 8);
+		PFC_ASSERT(tracer_selftest_count(json, "\"pfc_selftest_\\\"escaped\\\"\"") == 1);
+		PFC_ASSERT(tracer::timestampFrequency() > 0);
+	}
+
+	// Every task runs exactly once - through run(), parallelFor(), nested run() calls and futures - with and without deterministic mode.
+	static void thread_pool_selftest() {
+		enum { count = 1000, inner_count = 50, future_count = 16 };
+		threadPool pool(3);
+		pfc::array_t<t_uint32> counts; counts.set_size(count);
+		pfc::array_t<t_size> order; order.set_size(count);
+		for(int pass = 0; pass < 2; ++pass) {
+			const bool deterministic = pass == 1;
+			pool.setDeterministic(deterministic);
+			counts.fill_null();
+
+			pool.run(&thread_pool_selftest_count, counts.get_ptr(), count);
+
+			thread_pool_selftest_chunks chunks = {counts.get_ptr(), 7};
+			pool.parallelFor(0, count, chunks.m_chunkSize, chunks);
+
+			thread_pool_selftest_nested nested = {&pool, counts.get_ptr(), inner_count};
+			pool.run(&thread_pool_selftest_nested::task, &nested, count / inner_count);
+
+			{
+				threadPool::future futures[future_count];
+				for(t_size n = 0; n < future_count; ++n) {
+					pool.submit(futures[n], &thread_pool_selftest_count, counts.get_ptr(), n);
+				}
+				for(t_size n = 0; n < future_count; n += 2) {
+					futures[n].wait();
+					PFC_ASSERT(futures[n].isDone());
+				}
+			}
+
+			for(t_size n = 0; n < count; ++n) {
+				PFC_ASSERT(counts[n] == (n < future_count ? 4 : 3));
+			}
+
+			if (deterministic) {
+				thread_pool_selftest_order o = {order.get_ptr(), 0};
+				pool.run(&thread_pool_selftest_order::task, &o, count);
+				PFC_ASSERT(o.m_position == count);
+				for(t_size n = 0; n < count; ++n) PFC_ASSERT(order[n] == n);
+			}
+		}
+	}
 }
 
 namespace pfc {
@@ -42,6 +379,10 @@ namespace pfc {
 		{
 			thread_selftest t; t.selftest();
 		}
+		audio_math_selftest();
+		thread_pool_selftest();
+		lockfree_ring_selftest();
+		tracer_selftest();
 
 	}
 	// Self test routines that fail at compile time if there's something seriously wrong
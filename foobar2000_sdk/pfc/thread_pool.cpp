@@ -0,0 +1,243 @@
+#include "pfc.h"
+
+namespace pfc {
+	void threadPool::worker::start(threadPool * pool, t_size queueIndex) {
+		m_pool = pool;
+		m_queueIndex = queueIndex;
+		thread::start();
+	}
+
+	void threadPool::worker::threadProc() {
+		for(;;) {
+			m_wake.wait_for(-1);
+			m_wake.set_state(false);
+			if (!m_pool->workerProc(m_queueIndex)) break;
+		}
+	}
+
+	threadPool::future::future() : m_pool(NULL), m_task(NULL), m_ctx(NULL), m_index(0), m_state(state_idle), m_prev(NULL), m_next(NULL) {}
+
+	void threadPool::future::wait() {
+		if (m_pool == NULL) return;
+		bool runHere = false;
+		{
+			mutexScope scope(m_pool->m_lock);
+			if (m_state == state_queued) {
+				m_pool->unlinkFuture(*this);
+				m_state = state_running;
+				runHere = true;
+			}
+		}
+		if (runHere) {
+			m_pool->runFuture(*this);
+			return;
+		}
+		for(;;) {
+			{
+				mutexScope scope(m_pool->m_lock);
+				if (m_state != state_running) return;
+			}
+			m_done.wait_for(-1);
+		}
+	}
+
+	bool threadPool::future::isDone() {
+		if (m_pool == NULL) return true;
+		mutexScope scope(m_pool->m_lock);
+		return m_state != state_queued && m_state != state_running;
+	}
+
+	threadPool::threadPool(t_size workerCount) : m_workerCountLimit(workerCount), m_workerCount(0), m_started(false), m_exit(false), m_deterministic(false), m_running(false), m_task(NULL), m_ctx(NULL), m_remaining(0), m_futureHead(NULL), m_futureTail(NULL) {
+		m_queues.set_size_discard(1);
+	}
+
+	threadPool::~threadPool() {
+		while(runQueuedFuture()) {}
+		stopWorkers();
+	}
+
+	void threadPool::setDeterministic(bool state) {
+		mutexScope scope(m_lock);
+		m_deterministic = state;
+	}
+
+	bool threadPool::isDeterministic() {
+		mutexScope scope(m_lock);
+		return m_deterministic;
+	}
+
+	void threadPool::startWorkers() {
+		m_started = true;
+		t_size count = m_workerCountLimit;
+		if (count == ~(t_size)0) count = getOptimalWorkerThreadCount();
+		if (count > 0) --count;
+		m_queues.set_size_discard(count + 1);
+		m_workers.set_size_discard(count);
+		for(t_size n = 0; n < count; ++n) {
+			try {
+				m_workers[n].start(this, n + 1);
+			} catch(const thread::exception_creation &) {
+				break;
+			}
+			m_workerCount = n + 1;
+		}
+	}
+
+	void threadPool::stopWorkers() {
+		{
+			mutexScope scope(m_lock);
+			m_exit = true;
+		}
+		wakeWorkers();
+		for(t_size n = 0; n < m_workerCount; ++n) {
+			m_workers[n].waitTillDone();
+		}
+		m_workerCount = 0;
+	}
+
+	void threadPool::wakeWorkers() {
+		for(t_size n = 0; n < m_workerCount; ++n) {
+			m_workers[n].wake();
+		}
+	}
+
+	bool threadPool::workerProc(t_size queueIndex) {
+		{
+			mutexScope scope(m_lock);
+			if (m_exit) return false;
+		}
+		do {
+			runTasks(queueIndex);
+		} while(runQueuedFuture());
+		return true;
+	}
+
+	void threadPool::run(task_t task, void * ctx, t_size count) {
+		bool parallel = false;
+		if (count > 1) {
+			mutexScope scope(m_lock);
+			if (!m_deterministic && !m_running) {
+				if (!m_started) startWorkers();
+				if (m_workerCount > 0) {
+					m_running = true;
+					m_remaining = count;
+					parallel = true;
+				}
+			}
+		}
+
+		if (!parallel) {
+			for(t_size n = 0; n < count; ++n) task(ctx, n);
+			return;
+		}
+
+		// Workers only read m_task / m_ctx after taking a task from a queue, under the queue lock.
+		m_task = task;
+		m_ctx = ctx;
+		const t_size queueCount = m_workerCount + 1;
+		for(t_size n = 0; n < queueCount; ++n) {
+			mutexScope scope(m_queues[n].m_lock);
+			m_queues[n].m_begin = count * n / queueCount;
+			m_queues[n].m_end = count * (n + 1) / queueCount;
+		}
+		wakeWorkers();
+
+		runTasks(0);
+
+		m_done.wait_for(-1);
+		mutexScope scope(m_lock);
+		m_done.set_state(false);
+		m_running = false;
+	}
+
+	void threadPool::runTasks(t_size queueIndex) {
+		t_size completed = 0, index;
+		while(popTask(queueIndex, index) || stealTask(queueIndex, index)) {
+			m_task(m_ctx, index);
+			++completed;
+		}
+		if (completed > 0) {
+			mutexScope scope(m_lock);
+			m_remaining -= completed;
+			if (m_remaining == 0) m_done.set_state(true);
+		}
+	}
+
+	bool threadPool::popTask(t_size queueIndex, t_size & outIndex) {
+		queue & q = m_queues[queueIndex];
+		mutexScope scope(q.m_lock);
+		if (q.m_begin == q.m_end) return false;
+		outIndex = q.m_begin++;
+		return true;
+	}
+
+	bool threadPool::stealTask(t_size queueIndex, t_size & outIndex) {
+		const t_size queueCount = m_workerCount + 1;
+		for(t_size offset = 1; offset < queueCount; ++offset) {
+			queue & q = m_queues[(queueIndex + offset) % queueCount];
+			mutexScope scope(q.m_lock);
+			if (q.m_begin < q.m_end) {
+				outIndex = --q.m_end;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void threadPool::submit(future & f, task_t task, void * ctx, t_size index) {
+		bool queued = false;
+		{
+			mutexScope scope(m_lock);
+			PFC_ASSERT(f.m_pool == NULL || f.m_state == future::state_idle || f.m_state == future::state_done);
+			f.m_pool = this;
+			f.m_task = task;
+			f.m_ctx = ctx;
+			f.m_index = index;
+			f.m_done.set_state(false);
+			if (!m_deterministic) {
+				if (!m_started) startWorkers();
+				if (m_workerCount > 0) {
+					f.m_state = future::state_queued;
+					f.m_prev = m_futureTail;
+					f.m_next = NULL;
+					if (m_futureTail != NULL) m_futureTail->m_next = &f;
+					else m_futureHead = &f;
+					m_futureTail = &f;
+					queued = true;
+				}
+			}
+			if (!queued) f.m_state = future::state_running;
+		}
+		if (queued) wakeWorkers();
+		else runFuture(f);
+	}
+
+	bool threadPool::runQueuedFuture() {
+		future * f;
+		{
+			mutexScope scope(m_lock);
+			f = m_futureHead;
+			if (f == NULL) return false;
+			unlinkFuture(*f);
+			f->m_state = future::state_running;
+		}
+		runFuture(*f);
+		return true;
+	}
+
+	void threadPool::runFuture(future & f) {
+		f.m_task(f.m_ctx, f.m_index);
+		// Signalled under the lock, so that a waiter which sees state_done knows this thread is done with f.
+		mutexScope scope(m_lock);
+		f.m_state = future::state_done;
+		f.m_done.set_state(true);
+	}
+
+	void threadPool::unlinkFuture(future & f) {
+		if (f.m_prev != NULL) f.m_prev->m_next = f.m_next;
+		else m_futureHead = f.m_next;
+		if (f.m_next != NULL) f.m_next->m_prev = f.m_prev;
+		else m_futureTail = f.m_prev;
+		f.m_prev = f.m_next = NULL;
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+namespace pfc {
+	//! Persistent pool of worker threads for data-parallel loops and asynchronous tasks. \n
+	//! run() splits its tasks into one contiguous range per thread; a thread takes tasks from the front of its own range and, once that is exhausted, steals from the back of the others. The calling thread takes part in the work. \n
+	//! Which thread executes a given task is not defined, so tasks should write disjoint outputs. Deterministic mode runs everything on the calling thread in index / submission order instead, for reproducible results of order-dependent work. \n
+	//! Tasks must not throw.
+	class threadPool {
+	public:
+		typedef void (*task_t)(void * ctx, t_size index);
+
+		//! @param workerCount Number of worker threads in addition to the calling thread; ~0 to use one less than getOptimalWorkerThreadCount(). The threads are started on first use.
+		threadPool(t_size workerCount = ~0);
+		~threadPool();
+
+		//! Runs task(ctx, i) for every i in [0, count) and returns once all of them have completed. \n
+		//! The tasks are run on the calling thread if there is only one, in deterministic mode, or if another run() is in progress - including a nested call from a task of this pool.
+		void run(task_t task, void * ctx, t_size count);
+
+		//! Calls func(chunkBegin, chunkEnd) for consecutive chunks of [begin, end) of at most chunkSize items each, through run(). \n
+		//! Chunk boundaries depend only on the arguments, never on the number of threads.
+		template<typename TFunc> void parallelFor(t_size begin, t_size end, t_size chunkSize, TFunc func) {
+			if (end <= begin) return;
+			if (chunkSize == 0) chunkSize = 1;
+			parallelForContext<TFunc> ctx = {begin, end, chunkSize, &func};
+			run(&parallelForTask<TFunc>, &ctx, (end - begin - 1) / chunkSize + 1);
+		}
+
+		//! Result of an asynchronous task started with submit(). \n
+		//! The destructor waits for the task; a future can be reused once its task has completed, and must be destroyed before the pool.
+		class future {
+		public:
+			future();
+			~future() {wait();}
+
+			//! Waits for the task to complete. A task that no worker has picked up yet is run on the calling thread instead.
+			void wait();
+			bool isDone();
+		private:
+			friend class threadPool;
+			enum state_t {
+				state_idle,
+				state_queued,
+				state_running,
+				state_done
+			};
+
+			threadPool * m_pool;
+			task_t m_task;
+			void * m_ctx;
+			t_size m_index;
+			// Guarded by m_pool->m_lock.
+			state_t m_state;
+			future * m_prev, * m_next;
+			pfc::event m_done;
+
+			PFC_CLASS_NOT_COPYABLE_EX(future)
+		};
+
+		//! Queues task(ctx, index) for asynchronous execution on a worker thread; f must not have a pending task. \n
+		//! In deterministic mode, or if the pool has no worker threads, the task is run on the calling thread before submit() returns.
+		void submit(future & f, task_t task, void * ctx, t_size index = 0);
+
+		//! Queues func() for asynchronous execution; func is referenced, not copied, and must stay valid until f has completed.
+		template<typename TFunc> void submit(future & f, TFunc & func) {
+			submit(f, &submitTask<TFunc>, &func);
+		}
+
+		void setDeterministic(bool state);
+		bool isDeterministic();
+	private:
+		template<typename TFunc> struct parallelForContext {
+			t_size m_begin, m_end, m_chunkSize;
+			TFunc * m_func;
+		};
+		template<typename TFunc> static void parallelForTask(void * ctx, t_size index) {
+			const parallelForContext<TFunc> & c = *reinterpret_cast<const parallelForContext<TFunc>*>(ctx);
+			const t_size chunkBegin = c.m_begin + index * c.m_chunkSize;
+			(*c.m_func)(chunkBegin, chunkBegin + pfc::min_t<t_size>(c.m_chunkSize, c.m_end - chunkBegin));
+		}
+		template<typename TFunc> static void submitTask(void * ctx, t_size) {
+			(*reinterpret_cast<TFunc*>(ctx))();
+		}
+
+		class worker : public thread {
+		public:
+			worker() : m_pool(NULL), m_queueIndex(0) {}
+			~worker() {waitTillDone();}
+
+			void start(threadPool * pool, t_size queueIndex);
+			void wake() {m_wake.set_state(true);}
+		protected:
+			void threadProc();
+		private:
+			threadPool * m_pool;
+			t_size m_queueIndex;
+			pfc::event m_wake;
+		};
+
+		// Tasks of the current run() not taken yet, [m_begin, m_end).
+		struct queue {
+			queue() : m_begin(0), m_end(0) {}
+			mutex m_lock;
+			t_size m_begin, m_end;
+		};
+
+		void startWorkers();
+		void stopWorkers();
+		void wakeWorkers();
+
+		bool workerProc(t_size queueIndex);
+		void runTasks(t_size queueIndex);
+		bool popTask(t_size queueIndex, t_size & outIndex);
+		bool stealTask(t_size queueIndex, t_size & outIndex);
+		bool runQueuedFuture();
+		void runFuture(future & f);
+		void unlinkFuture(future & f);
+
+		// m_lock guards everything below except the queues, which have their own locks, and m_task / m_ctx, which the owner of the current run() writes before filling the queues.
+		mutex m_lock;
+		t_size m_workerCountLimit;
+		t_size m_workerCount;
+		bool m_started, m_exit, m_deterministic;
+		array_staticsize_t<worker> m_workers;
+		array_staticsize_t<queue> m_queues;
+
+		bool m_running;
+		task_t m_task;
+		void * m_ctx;
+		t_size m_remaining;
+		pfc::event m_done;
+
+		future * m_futureHead, * m_futureTail;
+
+		PFC_CLASS_NOT_COPYABLE_EX(threadPool)
+	};
+}
@@ -72,5 +72,284 @@ profiler_static::~profiler_static()
 		return fileTimeUtoW(time(NULL));
 #endif
 	}
+
+
+	namespace {
+		struct trace_event {
+			const char * m_name;
+			t_uint64 m_start, m_end;
+		};
+
+		struct trace_session_event {
+			trace_event m_event;
+			t_size m_thread;
+		};
+
+		struct trace_buffer {
+			trace_buffer() : m_thread(0), m_dropped(0), m_droppedCollected(0)
+#ifdef _WIN32
+				, m_threadHandle(NULL)
+#endif
+			{}
+			spscRing<trace_event> m_ring;
+			t_size m_thread;
+			// Written by the owning thread only.
+			volatile t_size m_dropped;
+			t_size m_droppedCollected;
+#ifdef _WIN32
+			// Signaled once the owning thread has exited; NULL while the buffer is free.
+			HANDLE m_threadHandle;
+#endif
+		};
+
+		// Seconds on the clock the time stamp counter is calibrated against.
+		double traceClock() {
+#ifdef _WIN32
+			LARGE_INTEGER val, freq;
+			QueryPerformanceCounter(&val);
+			QueryPerformanceFrequency(&freq);
+			return (double)val.QuadPart / (double)freq.QuadPart;
+#else
+			timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+#endif
+		}
+
+		class trace_state {
+		public:
+			trace_state() : m_threadCount(0), m_capacity(1 << 16), m_dropped(0), m_frequency(0), m_anchored(false), m_anchorTimestamp(0), m_anchorClock(0) {}
+
+			// Guards everything but the producer side of the buffers.
+			mutex m_lock;
+			// Every buffer ever allocated; the ones in m_free belong to threads that have exited and are handed to the next new thread.
+			pfc::array_t<trace_buffer*> m_buffers;
+			pfc::array_t<trace_buffer*> m_free;
+			t_size m_threadCount;
+			pfc::array_t<trace_session_event, alloc_fast_aggressive> m_session;
+			t_size m_capacity;
+			t_size m_dropped;
+
+			// The time stamp counter is calibrated from the first time tracing is enabled, rather than at static initialization, so that programs that never trace do not read the clocks.
+			mutex m_frequencyLock;
+			double m_frequency;
+			bool m_anchored;
+			t_uint64 m_anchorTimestamp;
+			double m_anchorClock;
+		};
+
+		trace_state g_trace;
+		volatile t_size g_traceEnabled = 0;
+
+		// Called with m_frequencyLock held.
+		void traceAnchor() {
+			if (!g_trace.m_anchored) {
+				g_trace.m_anchorTimestamp = traceTimestamp();
+				g_trace.m_anchorClock = traceClock();
+				g_trace.m_anchored = true;
+			}
+		}
+
+#ifdef _WIN32
+		const DWORD g_traceTls = TlsAlloc();
+		trace_buffer * traceThreadBuffer() {return reinterpret_cast<trace_buffer*>(TlsGetValue(g_traceTls));}
+		void traceSetThreadBuffer(trace_buffer * p_buffer) {TlsSetValue(g_traceTls, p_buffer);}
+#else
+		__thread trace_buffer * g_traceThreadBuffer = NULL;
+		trace_buffer * traceThreadBuffer() {return g_traceThreadBuffer;}
+		void traceSetThreadBuffer(trace_buffer * p_buffer) {g_traceThreadBuffer = p_buffer;}
+#endif
+
+		void traceCollectBuffer(trace_buffer & p_buffer) {
+			for(;;) {
+				t_size count;
+				const trace_event * events = p_buffer.m_ring.readBegin(count);
+				if (count == 0) break;
+				for(t_size e = 0; e < count; ++e) {
+					trace_session_event item = {events[e], p_buffer.m_thread};
+					g_trace.m_session.append_single(item);
+				}
+				p_buffer.m_ring.readCommit(count);
+			}
+			const t_size dropped = atomicLoadAcquire(p_buffer.m_dropped);
+			g_trace.m_dropped += dropped - p_buffer.m_droppedCollected;
+			p_buffer.m_droppedCollected = dropped;
+		}
+
+		void traceCollect() {
+			for(t_size n = 0; n < g_trace.m_buffers.get_size(); ++n) {
+				traceCollectBuffer(*g_trace.m_buffers[n]);
+			}
+		}
+
+		// Called with m_lock held once the owning thread can no longer write to p_buffer; its events stay in the session.
+		void traceReleaseBuffer(trace_buffer * p_buffer) {
+			traceCollectBuffer(*p_buffer);
+			g_trace.m_free.append_single(p_buffer);
+		}
+
+#ifdef _WIN32
+		// TLS slots have no destructor that would run on the exiting thread, so exited threads are found from their handles when a new thread registers.
+		void traceReleaseExitedThreads() {
+			for(t_size n = 0; n < g_trace.m_buffers.get_size(); ++n) {
+				trace_buffer * buffer = g_trace.m_buffers[n];
+				if (buffer->m_threadHandle != NULL && WaitForSingleObject(buffer->m_threadHandle, 0) == WAIT_OBJECT_0) {
+					CloseHandle(buffer->m_threadHandle);
+					buffer->m_threadHandle = NULL;
+					traceReleaseBuffer(buffer);
+				}
+			}
+		}
+#else
+		void traceThreadExit(void * p_buffer) {
+			g_traceThreadBuffer = NULL;
+			mutexScope scope(g_trace.m_lock);
+			traceReleaseBuffer(reinterpret_cast<trace_buffer*>(p_buffer));
+		}
+
+		// Only there for its destructor, which runs on the exiting thread; the buffer itself is looked up through g_traceThreadBuffer.
+		class trace_thread_exit_key {
+		public:
+			trace_thread_exit_key() {pthread_key_create(&m_key, traceThreadExit);}
+			void set(trace_buffer * p_buffer) {pthread_setspecific(m_key, p_buffer);}
+		private:
+			pthread_key_t m_key;
+		};
+		trace_thread_exit_key g_traceThreadExitKey;
+#endif
+
+		trace_buffer * traceRegisterThread() {
+			mutexScope scope(g_trace.m_lock);
+#ifdef _WIN32
+			traceReleaseExitedThreads();
+#endif
+			trace_buffer * buffer;
+			const t_size freeCount = g_trace.m_free.get_size();
+			if (freeCount > 0) {
+				buffer = g_trace.m_free[freeCount - 1];
+				g_trace.m_free.set_size(freeCount - 1);
+				buffer->m_ring.reset();
+				buffer->m_dropped = 0;
+				buffer->m_droppedCollected = 0;
+			} else {
+				buffer = new trace_buffer;
+				g_trace.m_buffers.append_single(buffer);
+			}
+			if (buffer->m_ring.capacity() != lockfree_ring_impl::roundCapacity(g_trace.m_capacity)) {
+				buffer->m_ring.setCapacity(g_trace.m_capacity);
+			}
+			buffer->m_thread = g_trace.m_threadCount++;
+#ifdef _WIN32
+			buffer->m_threadHandle = OpenThread(SYNCHRONIZE, FALSE, GetCurrentThreadId());
+#else
+			g_traceThreadExitKey.set(buffer);
+#endif
+			traceSetThreadBuffer(buffer);
+			return buffer;
+		}
+
+		void traceWriteJSONString(pfc::string_base & p_out, const char * p_string) {
+			p_out.add_char('"');
+			for(; *p_string; ++p_string) {
+				const unsigned char c = (unsigned char) *p_string;
+				if (c == '"' || c == '\\') {
+					p_out.add_char('\\');
+					p_out.add_char(c);
+				} else if (c < 0x20) {
+					p_out << "\\u00" << pfc::format_hex(c, 2);
+				} else {
+					p_out.add_char(c);
+				}
+			}
+			p_out.add_char('"');
+		}
+	}
+
+	void tracer::setEnabled(bool p_state) {
+		if (p_state) {
+			mutexScope scope(g_trace.m_frequencyLock);
+			traceAnchor();
+		}
+		atomicStoreRelease(g_traceEnabled, p_state ? 1 : 0);
+	}
+
+	bool tracer::isEnabled() {
+		return atomicLoadAcquire(g_traceEnabled) != 0;
+	}
+
+	void tracer::setBufferCapacity(t_size p_events) {
+		mutexScope scope(g_trace.m_lock);
+		g_trace.m_capacity = p_events;
+	}
+
+	void tracer::add(const char * p_name, t_uint64 p_start, t_uint64 p_end) {
+		trace_buffer * buffer = traceThreadBuffer();
+		if (buffer == NULL) buffer = traceRegisterThread();
+		const trace_event event = {p_name, p_start, p_end};
+		if (!buffer->m_ring.push(event)) {
+			atomicStoreRelease(buffer->m_dropped, buffer->m_dropped + 1);
+		}
+	}
+
+	t_size tracer::bufferCount() {
+		mutexScope scope(g_trace.m_lock);
+		return g_trace.m_buffers.get_size();
+	}
+
+	void tracer::collect() {
+		mutexScope scope(g_trace.m_lock);
+		traceCollect();
+	}
+
+	void tracer::exportChromeTrace(pfc::string_base & p_out) {
+		const double frequency = timestampFrequency();
+		mutexScope scope(g_trace.m_lock);
+		traceCollect();
+
+		const t_size count = g_trace.m_session.get_size();
+		t_uint64 base = count > 0 ? g_trace.m_session[0].m_event.m_start : 0;
+		for(t_size n = 1; n < count; ++n) {
+			base = pfc::min_t(base, g_trace.m_session[n].m_event.m_start);
+		}
+
+		p_out = "{\"traceEvents\":[";
+		for(t_size n = 0; n < count; ++n) {
+			const trace_session_event & item = g_trace.m_session[n];
+			if (n > 0) p_out.add_char(',');
+			p_out << "\n{\"name\":";
+			traceWriteJSONString(p_out, item.m_event.m_name);
+			p_out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << item.m_thread
+				<< ",\"ts\":" << pfc::format_float((double)(item.m_event.m_start - base) * 1000000.0 / frequency, 0, 3)
+				<< ",\"dur\":" << pfc::format_float((double)(item.m_event.m_end - item.m_event.m_start) * 1000000.0 / frequency, 0, 3) << "}";
+		}
+		p_out << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":\"" << g_trace.m_dropped << "\"}}\n";
+
+		g_trace.m_session.set_size(0);
+		g_trace.m_dropped = 0;
+	}
+
+	double tracer::timestampFrequency() {
+#if PFC_TRACE_TSC
+		mutexScope scope(g_trace.m_frequencyLock);
+		if (g_trace.m_frequency == 0) {
+			// Measured from the first time tracing was enabled, over at least 50 ms; normally that much time has passed long before the first export.
+			traceAnchor();
+			double elapsed;
+			t_uint64 timestamp;
+			do {
+				timestamp = traceTimestamp();
+				elapsed = traceClock() - g_trace.m_anchorClock;
+			} while(elapsed < 0.05);
+			g_trace.m_frequency = (double)(timestamp - g_trace.m_anchorTimestamp) / elapsed;
+		}
+		return g_trace.m_frequency;
+#elif defined(_WIN32)
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		return (double)freq.QuadPart;
+#else
+		return 1000000000.0;
+#endif
+	}
     
 }
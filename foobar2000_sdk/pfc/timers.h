@@ -163,4 +163,74 @@ namespace pfc {
 	uint64_t fileTimeNow();
 }
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define PFC_TRACE_TSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define PFC_TRACE_TSC 1
+#else
+#define PFC_TRACE_TSC 0
+#ifndef _WIN32
+#include <time.h>
+#endif
+#endif
+
+namespace pfc {
+	//! Raw timestamp for trace events: the CPU time stamp counter on x86 - constant-rate on any CPU of the last decade - or a monotonic clock elsewhere. \n
+	//! Units per second are given by tracer::timestampFrequency().
+	inline t_uint64 traceTimestamp() {
+#if PFC_TRACE_TSC
+		return __rdtsc();
+#elif defined(_WIN32)
+		LARGE_INTEGER val;
+		QueryPerformanceCounter(&val);
+		return val.QuadPart;
+#else
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (t_uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+	}
+
+	//! Session-wide recorder of trace_scope events, exported as Chrome trace-event JSON for chrome://tracing or Perfetto. \n
+	//! Every thread records into its own lock-free buffer, created on its first event. When a thread exits, its events are collected and its buffer goes to the next thread that starts recording, so buffers never outnumber the threads that recorded at the same time. A scope costs two timestamps and one buffer write while enabled, and a flag check while disabled.
+	class tracer {
+	public:
+		static void setEnabled(bool p_state);
+		static bool isEnabled();
+
+		//! Events each thread can hold until the next collect(); applies to threads that have not recorded anything yet. Events that do not fit are dropped and counted.
+		static void setBufferCapacity(t_size p_events);
+
+		//! Records an event of the calling thread; p_name must stay valid until exported, normally a string literal.
+		static void add(const char * p_name, t_uint64 p_start, t_uint64 p_end);
+
+		//! Buffers allocated so far, including those kept for reuse.
+		static t_size bufferCount();
+
+		//! Moves the events of all threads into the session, making room in their buffers. Call periodically when recording long sessions.
+		static void collect();
+
+		//! Collects, writes the session as Chrome trace-event JSON and clears it.
+		static void exportChromeTrace(pfc::string_base & p_out);
+
+		//! Timestamp units per second. The time stamp counter is calibrated once against the system clock, from the first time tracing was enabled to the first call.
+		static double timestampFrequency();
+	};
+
+	class trace_scope {
+	public:
+		trace_scope(const char * p_name) : m_name(p_name), m_start(tracer::isEnabled() ? traceTimestamp() : 0) {}
+		~trace_scope() {if (m_start != 0) tracer::add(m_name, m_start, traceTimestamp());}
+	private:
+		const char * m_name;
+		t_uint64 m_start;
+
+		PFC_CLASS_NOT_COPYABLE_EX(trace_scope)
+	};
+}
+
+#define PFC_TRACE_SCOPE(name) pfc::trace_scope trace_scope_##name(#name);
+
 #endif